@@ -17,6 +17,11 @@
 static smartterm_ctx* g_ctx = NULL;
 static bool g_running = true;
 
+/* Background chat log export */
+static smartterm_export_job* g_export = NULL;
+static volatile bool g_export_done = false;
+static smartterm_line_handle_t g_export_line; /* Progress line, updated in place */
+
 /* Simulate incoming messages */
 static void* message_simulator(void* arg)
 {
@@ -61,6 +66,31 @@ static void* message_simulator(void* arg)
     return NULL;
 }
 
+/* Report export progress (runs on the export thread) */
+static void export_progress(smartterm_ctx* ctx, const smartterm_export_progress_t* progress,
+                            void* data)
+{
+    (void)ctx;
+    (void)data;
+    char text[128];
+
+    if (!progress->finished) {
+        int total = progress->lines_total > 0 ? progress->lines_total : 1;
+        snprintf(text, sizeof(text), "Exporting chat log... %d%%",
+                 progress->lines_done * 100 / total);
+    } else if (progress->result == SMARTTERM_OK) {
+        snprintf(text, sizeof(text), "Chat log exported to chat_log.txt");
+    } else {
+        snprintf(text, sizeof(text), "Export stopped: %s",
+                 smartterm_error_string(progress->result));
+    }
+    smartterm_line_update(g_export_line, text);
+
+    if (progress->finished) {
+        g_export_done = true;
+    }
+}
+
 /* Process chat command */
 static void process_command(smartterm_ctx* ctx, const char* input)
 {
@@ -84,6 +114,7 @@ static void process_command(smartterm_ctx* ctx, const char* input)
         smartterm_write(ctx, "  /users  - List users", CTX_NORMAL);
         smartterm_write(ctx, "  /clear  - Clear screen", CTX_NORMAL);
         smartterm_write(ctx, "  /export - Export chat log", CTX_NORMAL);
+        smartterm_write(ctx, "  /cancel - Cancel running export", CTX_NORMAL);
         smartterm_write(ctx, "  /quit   - Exit chat", CTX_NORMAL);
         smartterm_write(ctx, "", CTX_NORMAL);
         smartterm_write(ctx, "Just type a message and press Enter to send.", CTX_NORMAL);
@@ -98,12 +129,28 @@ static void process_command(smartterm_ctx* ctx, const char* input)
         smartterm_clear(ctx);
         smartterm_write(ctx, "--- Chat cleared ---", CTX_COMMENT);
     } else if (strcmp(input, "/export") == 0) {
-        int result = smartterm_export(ctx, "chat_log.txt", EXPORT_PLAIN, 0, -1, true);
-        if (result == SMARTTERM_OK) {
-            smartterm_write(ctx, "Chat log exported to chat_log.txt", CTX_SUCCESS);
-        } else {
+        if (g_export && !g_export_done) {
+            smartterm_write(ctx, "Export already in progress", CTX_WARNING);
+            return;
+        }
+        if (g_export) {
+            smartterm_export_wait(g_export);
+        }
+
+        /* Chat keeps flowing while the log is written */
+        g_export_done = false;
+        g_export_line = smartterm_write_live(ctx, "Exporting chat log... 0%", CTX_INFO);
+        g_export = smartterm_export_async(ctx, "chat_log.txt", EXPORT_PLAIN, 0, -1, true,
+                                          export_progress, NULL);
+        if (!g_export) {
             smartterm_write(ctx, "Failed to export chat log", CTX_ERROR);
         }
+    } else if (strcmp(input, "/cancel") == 0) {
+        if (g_export && !g_export_done) {
+            smartterm_export_cancel(g_export);
+        } else {
+            smartterm_write(ctx, "No export running", CTX_COMMENT);
+        }
     } else if (strcmp(input, "/quit") == 0 || strcmp(input, "/exit") == 0) {
         smartterm_write(ctx, "Disconnecting from chat...", CTX_WARNING);
         g_running = false;
@@ -178,6 +225,9 @@ int main(void)
     /* Cleanup */
     g_running = false;
     pthread_join(simulator_thread, NULL);
+    if (g_export) {
+        smartterm_export_wait(g_export);
+    }
     smartterm_cleanup(ctx);
 
     printf("Chat client exited.\n");
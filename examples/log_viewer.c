@@ -3,22 +3,30 @@
  *
  * Demonstrates real-time log monitoring with SmartTerm.
  * Simulates a log viewer with different log levels.
+ *
+ * Runs on a single thread: SmartTerm's descriptor and the log timer share
+ * one poll() loop, and commands arrive through a line handler.
  */
 
-#include <pthread.h>
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <smartterm.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/timerfd.h>
 #include <time.h>
 #include <unistd.h>
 
-/* Global context for worker thread */
-static smartterm_ctx* g_ctx = NULL;
-static bool g_running = true;
+static volatile sig_atomic_t g_running = true;
 static bool g_paused = false;
 
+/* Filtered view toggled by /debug, /only and /filter */
+static smartterm_view* g_view = NULL;
+static bool g_show_debug = true;
+
 /* Log levels */
 typedef enum { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERROR } log_level_t;
 
@@ -26,6 +34,7 @@ typedef enum { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERROR } log_level_t;
 static void generate_log(smartterm_ctx* ctx)
 {
     const char* components[] = {"WebServer", "Database", "Auth", "API", "Cache", "Queue"};
+    const char* tags[] = {"web", "db", "auth", "api", "cache", "queue"};
 
     const char* debug_msgs[] = {"Processing request", "Cache hit", "Query executed",
                                 "Connection pool status: OK"};
@@ -58,7 +67,8 @@ static void generate_log(smartterm_ctx* ctx)
         message = error_msgs[rand() % 4];
     }
 
-    const char* component = components[rand() % 6];
+    int component_index = rand() % 6;
+    const char* component = components[component_index];
 
     /* Format log entry */
     time_t now = time(NULL);
@@ -94,26 +104,17 @@ static void generate_log(smartterm_ctx* ctx)
 
     snprintf(buffer, sizeof(buffer), "[%s] [%s] [%s] %s", time_str, level_str, component, message);
 
-    smartterm_write(ctx, buffer, ctx_type);
+    const char* tag = tags[component_index];
+    smartterm_line_meta_t meta = {.context = ctx_type, .timestamp = now, .tag = tag};
+    smartterm_write_meta(ctx, buffer, &meta);
 }
 
-/* Log generator thread */
-static void* log_generator(void* arg)
+/* Arm log timer for the next entry (100-500ms) */
+static void schedule_log(int timer_fd)
 {
-    (void)arg;
-
-    while (g_running) {
-        usleep(100000 + (rand() % 400000)); /* 100-500ms delay */
-
-        if (!g_running)
-            break;
-        if (g_paused)
-            continue;
-
-        generate_log(g_ctx);
-    }
-
-    return NULL;
+    struct itimerspec spec = {0};
+    spec.it_value.tv_nsec = (100 + rand() % 400) * 1000000L;
+    timerfd_settime(timer_fd, 0, &spec, NULL);
 }
 
 /* Signal handler for Ctrl+C */
@@ -123,6 +124,102 @@ static void signal_handler(int sig)
     g_running = false;
 }
 
+/* Handle command line (NULL on EOF) */
+static void handle_command(smartterm_ctx* ctx, char* input, void* data)
+{
+    (void)data;
+
+    if (!input) {
+        g_running = false;
+        smartterm_set_line_handler(ctx, NULL, NULL);
+        return;
+    }
+
+    if (strlen(input) == 0) {
+        free(input);
+        return;
+    }
+
+    /* Process commands */
+    if (strcmp(input, "/quit") == 0 || strcmp(input, "/exit") == 0) {
+        smartterm_write(ctx, "Stopping log viewer...", CTX_WARNING);
+        g_running = false;
+    } else if (strcmp(input, "/pause") == 0) {
+        g_paused = true;
+        smartterm_write(ctx, "Log monitoring paused", CTX_WARNING);
+        smartterm_status_set(ctx, "Log Viewer", "PAUSED");
+    } else if (strcmp(input, "/resume") == 0) {
+        g_paused = false;
+        smartterm_write(ctx, "Log monitoring resumed", CTX_SUCCESS);
+        smartterm_status_set(ctx, "Log Viewer", "Monitoring");
+    } else if (strcmp(input, "/clear") == 0) {
+        smartterm_clear(ctx);
+        smartterm_write(ctx, "--- Logs cleared ---", CTX_COMMENT);
+    } else if (strcmp(input, "/export") == 0) {
+        int result = smartterm_export(ctx, "logs_export.txt", EXPORT_PLAIN, 0, -1, true);
+        if (result == SMARTTERM_OK) {
+            smartterm_write(ctx, "Logs exported to logs_export.txt", CTX_SUCCESS);
+        } else {
+            smartterm_write(ctx, "Failed to export logs", CTX_ERROR);
+        }
+    } else if (strcmp(input, "/save") == 0) {
+        if (smartterm_save_session(ctx, "logs.session") == SMARTTERM_OK) {
+            smartterm_write(ctx, "Session saved to logs.session", CTX_SUCCESS);
+        } else {
+            smartterm_write(ctx, "Failed to save session", CTX_ERROR);
+        }
+    } else if (strcmp(input, "/load") == 0) {
+        if (smartterm_load_session(ctx, "logs.session") != SMARTTERM_OK) {
+            smartterm_write(ctx, "Failed to load logs.session", CTX_ERROR);
+        }
+    } else if (strncmp(input, "/search ", 8) == 0) {
+        const char* pattern = input + 8;
+        smartterm_search_result_t* results;
+        int count;
+
+        int ret = smartterm_search(ctx, pattern, false, &results, &count);
+        if (ret == SMARTTERM_OK) {
+            smartterm_write_fmt(ctx, CTX_SUCCESS, "Found %d matches for: %s", count, pattern);
+            smartterm_write(ctx, "Use /next and /prev to navigate", CTX_COMMENT);
+            smartterm_free_search_results(results);
+        } else {
+            smartterm_write_fmt(ctx, CTX_ERROR, "Search failed for: %s", pattern);
+        }
+    } else if (strcmp(input, "/debug") == 0) {
+        g_show_debug = !g_show_debug;
+        smartterm_view_set_context_visible(g_view, CTX_DEBUG, g_show_debug);
+    } else if (strncmp(input, "/only ", 6) == 0) {
+        smartterm_view_set_tag(g_view, input + 6);
+    } else if (strncmp(input, "/filter ", 8) == 0) {
+        smartterm_view_set_substring(g_view, input + 8);
+    } else if (strcmp(input, "/all") == 0) {
+        g_show_debug = true;
+        smartterm_view_reset(g_view);
+    } else if (strcmp(input, "/next") == 0) {
+        if (smartterm_search_next(ctx) != SMARTTERM_OK) {
+            smartterm_write(ctx, "No search results", CTX_WARNING);
+        }
+    } else if (strcmp(input, "/prev") == 0) {
+        if (smartterm_search_prev(ctx) != SMARTTERM_OK) {
+            smartterm_write(ctx, "No search results", CTX_WARNING);
+        }
+    } else {
+        smartterm_write_fmt(ctx, CTX_ERROR, "Unknown command: %s", input);
+    }
+
+    int total_logs = smartterm_get_line_count(ctx);
+
+    /* Update status bar */
+    if (!g_paused) {
+        char status[64];
+        snprintf(status, sizeof(status), "Logs: %d | Errors: %d", total_logs,
+                 smartterm_get_context_count(ctx, CTX_ERROR));
+        smartterm_status_set(ctx, "Log Viewer", status);
+    }
+
+    free(input);
+}
+
 int main(void)
 {
     srand(time(NULL));
@@ -140,101 +237,54 @@ int main(void)
         return 1;
     }
 
-    g_ctx = ctx;
+    /* Filters are applied through a view so toggling never rewrites the buffer */
+    g_view = smartterm_view_create(ctx);
+    smartterm_set_view(ctx, g_view);
 
     /* Welcome messages */
     smartterm_write(ctx, "=== SmartTerm Log Viewer ===", CTX_INFO);
     smartterm_write(ctx, "Monitoring application logs...", CTX_SUCCESS);
     smartterm_write(ctx, "Commands: /pause, /resume, /clear, /export, /search, /quit", CTX_COMMENT);
+    smartterm_write(ctx, "Filters: /debug, /only <tag>, /filter <text>, /all", CTX_COMMENT);
+    smartterm_write(ctx, "Sessions: /save, /load", CTX_COMMENT);
     smartterm_write(ctx, "", CTX_NORMAL);
 
     /* Set status bar */
     smartterm_status_set(ctx, "Log Viewer", "Monitoring");
 
-    /* Start log generator thread */
-    pthread_t generator_thread;
-    pthread_create(&generator_thread, NULL, log_generator, NULL);
+    /* Commands arrive through the line handler */
+    smartterm_set_line_handler(ctx, handle_command, NULL);
 
-    /* Main loop */
-    int total_logs = 0;
+    /* Log entries are generated on a timer in the same loop */
+    int log_timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    schedule_log(log_timer);
 
-    while (g_running) {
-        /* Non-blocking input check would go here
-         * For simplicity, we'll just process on enter */
-        char* input = smartterm_read_line(ctx, NULL);
+    struct pollfd fds[2] = {{.fd = smartterm_get_fd(ctx), .events = POLLIN},
+                            {.fd = log_timer, .events = POLLIN}};
 
-        if (!input) {
+    /* Main loop */
+    while (g_running) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             break;
         }
 
-        if (strlen(input) == 0) {
-            free(input);
-            continue;
-        }
-
-        /* Process commands */
-        if (strcmp(input, "/quit") == 0 || strcmp(input, "/exit") == 0) {
-            smartterm_write(ctx, "Stopping log viewer...", CTX_WARNING);
-            g_running = false;
-        } else if (strcmp(input, "/pause") == 0) {
-            g_paused = true;
-            smartterm_write(ctx, "Log monitoring paused", CTX_WARNING);
-            smartterm_status_set(ctx, "Log Viewer", "PAUSED");
-        } else if (strcmp(input, "/resume") == 0) {
-            g_paused = false;
-            smartterm_write(ctx, "Log monitoring resumed", CTX_SUCCESS);
-            smartterm_status_set(ctx, "Log Viewer", "Monitoring");
-        } else if (strcmp(input, "/clear") == 0) {
-            smartterm_clear(ctx);
-            smartterm_write(ctx, "--- Logs cleared ---", CTX_COMMENT);
-            total_logs = 0;
-        } else if (strcmp(input, "/export") == 0) {
-            int result = smartterm_export(ctx, "logs_export.txt", EXPORT_PLAIN, 0, -1, true);
-            if (result == SMARTTERM_OK) {
-                smartterm_write(ctx, "Logs exported to logs_export.txt", CTX_SUCCESS);
-            } else {
-                smartterm_write(ctx, "Failed to export logs", CTX_ERROR);
-            }
-        } else if (strncmp(input, "/search ", 8) == 0) {
-            const char* pattern = input + 8;
-            smartterm_search_result_t* results;
-            int count;
-
-            int ret = smartterm_search(ctx, pattern, false, &results, &count);
-            if (ret == SMARTTERM_OK) {
-                smartterm_write_fmt(ctx, CTX_SUCCESS, "Found %d matches for: %s", count, pattern);
-                smartterm_write(ctx, "Use /next and /prev to navigate", CTX_COMMENT);
-                smartterm_free_search_results(results);
-            } else {
-                smartterm_write_fmt(ctx, CTX_ERROR, "Search failed for: %s", pattern);
-            }
-        } else if (strcmp(input, "/next") == 0) {
-            if (smartterm_search_next(ctx) != SMARTTERM_OK) {
-                smartterm_write(ctx, "No search results", CTX_WARNING);
-            }
-        } else if (strcmp(input, "/prev") == 0) {
-            if (smartterm_search_prev(ctx) != SMARTTERM_OK) {
-                smartterm_write(ctx, "No search results", CTX_WARNING);
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(log_timer, &expirations, sizeof(expirations)) > 0 && !g_paused) {
+                generate_log(ctx);
             }
-        } else {
-            smartterm_write_fmt(ctx, CTX_ERROR, "Unknown command: %s", input);
-        }
-
-        total_logs = smartterm_get_line_count(ctx);
-
-        /* Update status bar */
-        if (!g_paused) {
-            char status[64];
-            snprintf(status, sizeof(status), "Logs: %d", total_logs);
-            smartterm_status_set(ctx, "Log Viewer", status);
+            schedule_log(log_timer);
         }
 
-        free(input);
+        smartterm_step(ctx);
     }
 
     /* Cleanup */
-    g_running = false;
-    pthread_join(generator_thread, NULL);
+    close(log_timer);
+    smartterm_view_free(g_view);
     smartterm_cleanup(ctx);
 
     printf("Log viewer exited.\n");
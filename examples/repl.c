@@ -42,38 +42,7 @@ static double evaluate(const char* expr)
 }
 
 /* Tab completion for REPL commands */
-static char** repl_completer(const char* text, int start, int end, void* data)
-{
-    (void)start;
-    (void)end;
-    (void)data;
-
-    static const char* commands[] = {"help", "quit", "exit", "clear", "history", "export", NULL};
-
-    /* Count matches */
-    int match_count = 0;
-    for (int i = 0; commands[i]; i++) {
-        if (strncmp(text, commands[i], strlen(text)) == 0) {
-            match_count++;
-        }
-    }
-
-    if (match_count == 0) {
-        return NULL;
-    }
-
-    /* Allocate result array */
-    char** matches = calloc(match_count + 1, sizeof(char*));
-    int match_idx = 0;
-
-    for (int i = 0; commands[i]; i++) {
-        if (strncmp(text, commands[i], strlen(text)) == 0) {
-            matches[match_idx++] = strdup(commands[i]);
-        }
-    }
-
-    return matches;
-}
+static const char* commands[] = {"help", "quit", "exit", "clear", "history", "export", NULL};
 
 int main(void)
 {
@@ -89,7 +58,7 @@ int main(void)
     }
 
     /* Set tab completion */
-    smartterm_set_completer(ctx, repl_completer, NULL);
+    smartterm_completion_add_words(ctx, commands, -1, COMPLETE_COMMAND);
 
     /* Welcome message */
     smartterm_write(ctx, "SmartTerm Calculator REPL", CTX_INFO);
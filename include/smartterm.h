@@ -3,7 +3,7 @@
  *
  * A C library for terminal UIs with:
  * - Scrolling output buffer (top region)
- * - Input area with readline support (bottom)
+ * - Input area with integrated line editor (bottom)
  * - Status bar (separator)
  * - Context-aware coloring
  * - Thread-safe operations
@@ -17,6 +17,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +35,12 @@ typedef struct smartterm_ctx smartterm_ctx;
 /* Opaque handle to theme */
 typedef struct smartterm_theme smartterm_theme;
 
+/* Opaque handle to filtered view */
+typedef struct smartterm_view smartterm_view;
+
+/* Opaque handle to keymap */
+typedef struct smartterm_keymap smartterm_keymap;
+
 /* Context types for output coloring */
 typedef enum {
     CTX_NORMAL = 0,      /* Default text */
@@ -46,31 +53,67 @@ typedef enum {
     CTX_COMMENT,         /* Comments (green) */
     CTX_SPECIAL,         /* Special actions (cyan) */
     CTX_SEARCH,          /* Search context (magenta) */
-    CTX_USER_START = 100 /* User-defined contexts start here */
+    CTX_USER_START = 100 /* User-defined contexts start here (max 255) */
 } smartterm_context_t;
 
 /* Return codes */
 typedef enum {
-    SMARTTERM_OK = 0,       /* Success */
-    SMARTTERM_ERROR = -1,   /* Generic error */
-    SMARTTERM_NOMEM = -2,   /* Out of memory */
-    SMARTTERM_INVALID = -3, /* Invalid argument */
-    SMARTTERM_NOTINIT = -4, /* Not initialized */
-    SMARTTERM_IOERROR = -5  /* I/O error */
+    SMARTTERM_OK = 0,        /* Success */
+    SMARTTERM_ERROR = -1,    /* Generic error */
+    SMARTTERM_NOMEM = -2,    /* Out of memory */
+    SMARTTERM_INVALID = -3,  /* Invalid argument */
+    SMARTTERM_NOTINIT = -4,  /* Not initialized */
+    SMARTTERM_IOERROR = -5,  /* I/O error */
+    SMARTTERM_CANCELLED = -6 /* Operation cancelled */
 } smartterm_error_t;
 
+/* Words a completion vocabulary or source applies to */
+typedef enum {
+    COMPLETE_ANY,      /* Any word */
+    COMPLETE_COMMAND,  /* First word of the line */
+    COMPLETE_ARGUMENT  /* Words after the first */
+} smartterm_complete_scope_t;
+
+/* Completion source options (combine with |) */
+typedef enum {
+    SOURCE_CACHED = 1 << 0, /* Cache results; longer words filter those of shorter ones */
+    SOURCE_ASYNC = 1 << 1   /* Look up on a background thread; results cached per word */
+} smartterm_source_flags_t;
+
+/* Export formats */
+typedef enum {
+    EXPORT_PLAIN,    /* Plain text */
+    EXPORT_ANSI,     /* With ANSI color codes */
+    EXPORT_MARKDOWN, /* Markdown format */
+    EXPORT_HTML,     /* HTML format */
+    EXPORT_JSONL,    /* One JSON object per line, with full metadata */
+    EXPORT_BINARY    /* Session file image (load with smartterm_load_session) */
+} smartterm_export_format_t;
+
 /* Configuration options */
 typedef struct {
-    int max_lines;            /* Maximum output lines (default: 1000) */
-    int output_height;        /* Output window height (0 = auto) */
-    bool status_bar_enabled;  /* Show status bar (default: true) */
-    const char* prompt;       /* Default prompt (default: "> ") */
-    bool history_enabled;     /* Enable readline history (default: true) */
-    const char* history_file; /* History file path (NULL = no file) */
-    int history_size;         /* Max history entries (default: 1000) */
-    smartterm_theme* theme;   /* Theme (NULL = default) */
-    bool multiline_enabled;   /* Enable multi-line input (default: false) */
-    bool thread_safe;         /* Enable thread safety (default: true) */
+    int max_lines;                        /* Maximum lines in memory (default: 1000) */
+    size_t max_bytes;                     /* Scrollback memory budget (0 = unlimited) */
+    int hot_lines;                        /* Lines kept uncompressed (default: 10000, 0 = all) */
+    const char* spill_dir;                /* Keep evicted lines in segment files (NULL = drop) */
+    const char* tee_file;                 /* Append every line to this log file (NULL = off) */
+    smartterm_export_format_t tee_format; /* Tee line format: PLAIN, ANSI or JSONL */
+    bool tee_include_meta;                /* Timestamps in PLAIN/ANSI tee lines (default: false) */
+    int tee_sync_ms;                      /* fsync tee log within this many ms (default: 1000) */
+    size_t tee_sync_bytes;                /* fsync tee log after this many bytes (0 = no limit) */
+    int tty_fd;                           /* Terminal to run on (0 = stdin/stdout) */
+    const char* term_type;                /* Terminal type of tty_fd (NULL = $TERM) */
+    int output_height;                    /* Output window height (0 = auto) */
+    bool status_bar_enabled;              /* Show status bar (default: true) */
+    const char* prompt;                   /* Default prompt (default: "> ") */
+    bool bracketed_paste;                 /* Insert pastes in one step (default: true) */
+    bool history_enabled;                 /* Enable input history (default: true) */
+    const char* history_file;             /* History file path (NULL = no file, "~/" = $HOME) */
+    int history_size;                     /* Max history entries (default: 1000, -1 = unlimited) */
+    smartterm_theme* theme;               /* Theme (NULL = default) */
+    bool multiline_enabled;               /* Enable multi-line input (default: false) */
+    int multiline_height;                 /* Max multi-line input rows (0 = half the screen) */
+    bool thread_safe;                     /* Enable thread safety (default: true) */
 } smartterm_config_t;
 
 /* Output line metadata */
@@ -80,6 +123,22 @@ typedef struct {
     const char* tag;             /* Optional tag */
 } smartterm_line_meta_t;
 
+/* Scrollback memory usage */
+typedef struct {
+    size_t text_bytes;            /* Uncompressed line text, including terminators */
+    size_t meta_bytes;            /* Context/timestamp/tag columns and tag table */
+    size_t index_bytes;           /* Line slot index (text pointers) */
+    size_t cold_bytes;            /* Compressed older lines and their block cache */
+    size_t total_bytes;           /* Sum of the above */
+    size_t max_bytes;             /* Configured budget (0 = unlimited) */
+    int line_count;               /* Lines reachable, in memory or spilled */
+    int cold_line_count;          /* Lines held compressed */
+    size_t spill_bytes;           /* Segment files on disk (not in total_bytes) */
+    int spill_line_count;         /* Evicted lines reachable from disk */
+    unsigned long untagged_lines; /* Lines stored without their tag (65535 tags in use) */
+    unsigned long spill_dropped;  /* Evicted lines lost because spill_dir was unwritable */
+} smartterm_memory_usage_t;
+
 /* Search results */
 typedef struct {
     int line_index; /* Line number in buffer */
@@ -97,13 +156,23 @@ typedef enum {
     SYM_COUNT             /* Total number of symbols (keep last) */
 } smartterm_symbol_t;
 
-/* Export formats */
-typedef enum {
-    EXPORT_PLAIN,    /* Plain text */
-    EXPORT_ANSI,     /* With ANSI color codes */
-    EXPORT_MARKDOWN, /* Markdown format */
-    EXPORT_HTML      /* HTML format */
-} smartterm_export_format_t;
+/* Background export progress */
+typedef struct {
+    int lines_done;  /* Lines formatted and written so far */
+    int lines_total; /* Lines in the exported range */
+    bool finished;   /* Last report for the job */
+    int result;      /* Final result (valid when finished) */
+} smartterm_export_progress_t;
+
+/* Tee log state */
+typedef struct {
+    unsigned long lines_written;      /* Lines written to the log */
+    unsigned long lines_dropped;      /* Lines lost to a full queue or a failed write */
+    unsigned long long bytes_written; /* Bytes written to the log */
+    int lines_queued;                 /* Lines waiting for the writer */
+    int error;                        /* Last write/fsync: SMARTTERM_OK or SMARTTERM_IOERROR */
+    int sys_errno;                    /* errno of the last failure (ENOSPC = disk full) */
+} smartterm_tee_status_t;
 
 /*
  * ============================================================================
@@ -150,7 +219,7 @@ smartterm_config_t smartterm_default_config(void);
  *
  * ctx: Context handle
  * text: Text to write (null-terminated)
- * context: Context type for coloring
+ * context: Context type for coloring (0-255)
  * Returns: SMARTTERM_OK on success, error code on failure
  *
  * Note: Thread-safe. Automatically triggers render.
@@ -178,6 +247,40 @@ int smartterm_write_fmt(smartterm_ctx* ctx, smartterm_context_t context, const c
  */
 int smartterm_write_meta(smartterm_ctx* ctx, const char* text, const smartterm_line_meta_t* meta);
 
+/* Line written by smartterm_write_live() */
+typedef struct {
+    smartterm_ctx* ctx; /* NULL if the write failed */
+    unsigned long seq;  /* Line sequence number */
+} smartterm_line_handle_t;
+
+/*
+ * Write line that can be updated in place.
+ *
+ * ctx: Context handle
+ * text: Text to write
+ * context: Context type for coloring
+ * Returns: Handle for smartterm_line_update() (handle.ctx is NULL on failure)
+ *
+ * Note: For progress and live status rows: updates replace the line
+ *       instead of appending new ones, so they do not flood scrollback.
+ */
+smartterm_line_handle_t smartterm_write_live(smartterm_ctx* ctx, const char* text,
+                                             smartterm_context_t context);
+
+/*
+ * Replace text of line written by smartterm_write_live().
+ *
+ * handle: Handle of the line
+ * text: New text
+ * Returns: SMARTTERM_OK on success, SMARTTERM_INVALID once the line has
+ *          left memory (evicted, compressed or spilled), error code on failure
+ *
+ * Note: Only the line's row is redrawn, and only if it is on screen.
+ *       Context, tag and timestamp stay as written. The tee log keeps
+ *       the text the line was written with.
+ */
+int smartterm_line_update(smartterm_line_handle_t handle, const char* text);
+
 /*
  * Clear output buffer.
  *
@@ -211,8 +314,14 @@ int smartterm_render(smartterm_ctx* ctx);
  * Returns: Allocated string with input, or NULL on EOF/error
  *
  * Note: Caller must free() returned string.
- *       Not thread-safe (call from main thread only).
+ *       Call from one thread at a time. Other threads may keep writing
+ *       output while a line is edited; it renders immediately.
  *       Adds to history if enabled.
+ *       Keys: emacs bindings (Ctrl-A/E/B/F, Meta-B/F, Ctrl-K/U/W/Y, Meta-D),
+ *       Up/Down or Ctrl-P/N for history, Ctrl-R to search history
+ *       (indexed, ranked by recent and frequent use), Tab to complete,
+ *       Page Up/Down to scroll output, Ctrl-D on an empty line for EOF.
+ *       Registered key handlers take precedence.
  */
 char* smartterm_read_line(smartterm_ctx* ctx, const char* prompt);
 
@@ -223,9 +332,11 @@ char* smartterm_read_line(smartterm_ctx* ctx, const char* prompt);
  * prompt: Prompt string
  * Returns: Allocated string with input, or NULL on EOF/error
  *
- * Note: Caller must free() returned string.
- *       Submit with double-newline or Ctrl+D.
- *       Requires multiline_enabled in config.
+ * Note: Caller must free() returned string. Lines are separated by '\n'.
+ *       Enter starts a new line; Enter on an empty last line, Ctrl-D or
+ *       Meta-Enter submits. The input area grows with the text up to
+ *       multiline_height rows, then scrolls. Pastes are inserted whole.
+ *       Without multiline_enabled, reads a single line.
  */
 char* smartterm_read_multiline(smartterm_ctx* ctx, const char* prompt);
 
@@ -238,6 +349,35 @@ char* smartterm_read_multiline(smartterm_ctx* ctx, const char* prompt);
  */
 int smartterm_set_prompt(smartterm_ctx* ctx, const char* prompt);
 
+/*
+ * Paste handler callback function type.
+ *
+ * ctx: Context handle
+ * text: Pasted lines separated by '\n' (no trailing newline)
+ * line_count: Number of lines in text
+ * data: User data passed to smartterm_set_paste_handler()
+ */
+typedef void (*smartterm_paste_handler_fn)(smartterm_ctx* ctx, const char* text, int line_count,
+                                           void* data);
+
+/*
+ * Set handler for multi-line pastes.
+ *
+ * ctx: Context handle
+ * handler: Receives each multi-line paste as one batch (NULL = none)
+ * data: User data passed to handler
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Needs bracketed_paste. Without a handler, pasted lines are
+ *       returned one by one as if typed, and text after the last newline
+ *       stays on the input line. A single line ending in a newline is
+ *       submitted as if typed, even with a handler. Single-line pastes,
+ *       and all pastes into smartterm_read_multiline(), are otherwise
+ *       inserted as they are.
+ */
+int smartterm_set_paste_handler(smartterm_ctx* ctx, smartterm_paste_handler_fn handler,
+                                void* data);
+
 /*
  * ============================================================================
  * STATUS BAR
@@ -376,6 +516,90 @@ int smartterm_search_prev(smartterm_ctx* ctx);
  */
 int smartterm_search_clear(smartterm_ctx* ctx);
 
+/*
+ * ============================================================================
+ * FILTERED VIEWS
+ * ============================================================================
+ */
+
+/*
+ * Create filtered view of the output buffer.
+ *
+ * ctx: Context handle
+ * Returns: View handle (matches every line), or NULL on failure
+ *
+ * Note: Views stay in sync as lines are appended or evicted.
+ *       Free with smartterm_view_free() before smartterm_cleanup().
+ */
+smartterm_view* smartterm_view_create(smartterm_ctx* ctx);
+
+/*
+ * Free filtered view.
+ *
+ * view: View handle
+ *
+ * Note: Deactivates the view if it is currently displayed.
+ */
+void smartterm_view_free(smartterm_view* view);
+
+/*
+ * Show or hide lines of a context in view.
+ *
+ * view: View handle
+ * context: Context type
+ * visible: true to show, false to hide
+ * Returns: SMARTTERM_OK on success, error code on failure
+ */
+int smartterm_view_set_context_visible(smartterm_view* view, smartterm_context_t context,
+                                       bool visible);
+
+/*
+ * Restrict view to lines with tag.
+ *
+ * view: View handle
+ * tag: Required tag (NULL = any tag)
+ * Returns: SMARTTERM_OK on success, error code on failure
+ */
+int smartterm_view_set_tag(smartterm_view* view, const char* tag);
+
+/*
+ * Restrict view to lines containing text.
+ *
+ * view: View handle
+ * substring: Required substring (NULL or "" = any text)
+ * Returns: SMARTTERM_OK on success, error code on failure
+ */
+int smartterm_view_set_substring(smartterm_view* view, const char* substring);
+
+/*
+ * Remove all filters from view.
+ *
+ * view: View handle
+ * Returns: SMARTTERM_OK on success, error code on failure
+ */
+int smartterm_view_reset(smartterm_view* view);
+
+/*
+ * Get number of buffer lines matching view.
+ *
+ * view: View handle
+ * Returns: Number of matching lines
+ *
+ * Note: First call after a filter change scans the buffer once.
+ */
+int smartterm_view_get_line_count(smartterm_view* view);
+
+/*
+ * Display view in output window.
+ *
+ * ctx: Context handle
+ * view: View handle (NULL = raw buffer)
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Scrolling and search navigation act on the active view.
+ */
+int smartterm_set_view(smartterm_ctx* ctx, smartterm_view* view);
+
 /*
  * ============================================================================
  * EXPORT
@@ -405,12 +629,151 @@ int smartterm_export(smartterm_ctx* ctx, const char* filename, smartterm_export_
  * end_line: Last line to export (-1 = last)
  * include_meta: Include metadata
  * Returns: Allocated string with exported content, or NULL on error
+ *          (always NULL for EXPORT_BINARY)
  *
  * Note: Caller must free() returned string.
  */
 char* smartterm_export_string(smartterm_ctx* ctx, smartterm_export_format_t format, int start_line,
                               int end_line, bool include_meta);
 
+/*
+ * Export to file descriptor.
+ *
+ * ctx: Context handle
+ * fd: Open file descriptor (left open)
+ * format: Export format
+ * start_line: First line to export (0 = first)
+ * end_line: Last line to export (-1 = last)
+ * include_meta: Include metadata
+ * Returns: SMARTTERM_OK on success, SMARTTERM_IOERROR if a write fails
+ *
+ * Note: Output is formatted and written in fixed-size chunks, so memory
+ * use does not depend on the size of the range.
+ */
+int smartterm_export_fd(smartterm_ctx* ctx, int fd, smartterm_export_format_t format,
+                        int start_line, int end_line, bool include_meta);
+
+/*
+ * Export to stdio stream.
+ *
+ * Same as smartterm_export_fd() on fileno(file); the stream is flushed
+ * first so earlier buffered output comes before the export.
+ */
+int smartterm_export_file(smartterm_ctx* ctx, FILE* file, smartterm_export_format_t format,
+                          int start_line, int end_line, bool include_meta);
+
+/* Background export job (opaque) */
+typedef struct smartterm_export_job smartterm_export_job;
+
+/* Progress callback, called on the export thread without library locks held */
+typedef void (*smartterm_export_progress_fn)(smartterm_ctx* ctx,
+                                             const smartterm_export_progress_t* progress,
+                                             void* data);
+
+/*
+ * Export to file on a background thread.
+ *
+ * ctx: Context handle
+ * filename: Output file path (opened before returning)
+ * format: Export format (not EXPORT_BINARY)
+ * start_line: First line to export (0 = first)
+ * end_line: Last line to export (-1 = last)
+ * include_meta: Include metadata
+ * progress: Progress callback (can be NULL)
+ * data: User data for callback
+ * Returns: Job handle, or NULL if the file cannot be created or the range is empty
+ *
+ * Note: The range is fixed when the job starts; lines written afterwards
+ * are not exported, and lines evicted before the job reaches them are
+ * skipped. The buffer is locked only while each chunk is formatted, so
+ * output and rendering continue during the export. The job must be
+ * released with smartterm_export_wait(), or is cancelled and released by
+ * smartterm_cleanup().
+ */
+smartterm_export_job* smartterm_export_async(smartterm_ctx* ctx, const char* filename,
+                                             smartterm_export_format_t format, int start_line,
+                                             int end_line, bool include_meta,
+                                             smartterm_export_progress_fn progress, void* data);
+
+/*
+ * Ask background export to stop.
+ *
+ * job: Job handle
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Returns immediately; the job finishes with SMARTTERM_CANCELLED
+ * after its current chunk, leaving a partial file.
+ */
+int smartterm_export_cancel(smartterm_export_job* job);
+
+/*
+ * Wait for background export to finish and release the job.
+ *
+ * job: Job handle (invalid afterwards)
+ * Returns: Export result (SMARTTERM_CANCELLED if cancelled)
+ *
+ * Note: Must not be called from the job's own progress callback.
+ */
+int smartterm_export_wait(smartterm_export_job* job);
+
+/*
+ * Get tee log state.
+ *
+ * ctx: Context handle
+ * status: Receives counters and the last write error
+ * Returns: SMARTTERM_OK on success, SMARTTERM_ERROR if config.tee_file is not set
+ *
+ * Note: Lines are queued by the write functions and written by a
+ * background thread, so a failing disk never blocks output. Failures
+ * (ENOSPC when the disk is full) show up here; writing resumes with the
+ * next batch once the disk accepts data again.
+ */
+int smartterm_tee_get_status(smartterm_ctx* ctx, smartterm_tee_status_t* status);
+
+/*
+ * Write queued tee lines and fsync the log.
+ *
+ * ctx: Context handle
+ * Returns: SMARTTERM_OK, SMARTTERM_IOERROR if the write or fsync failed,
+ *          SMARTTERM_ERROR if config.tee_file is not set
+ *
+ * Note: Blocks until lines written before the call are on disk.
+ */
+int smartterm_tee_flush(smartterm_ctx* ctx);
+
+/*
+ * ============================================================================
+ * SESSIONS
+ * ============================================================================
+ */
+
+/*
+ * Save scrollback to session file.
+ *
+ * ctx: Context handle
+ * filename: Session file path
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Saves every reachable line with its metadata in a compact binary
+ *       format. The file is written beside the target and renamed into
+ *       place, so an interrupted save keeps the previous session.
+ */
+int smartterm_save_session(smartterm_ctx* ctx, const char* filename);
+
+/*
+ * Replace scrollback with session file.
+ *
+ * ctx: Context handle
+ * filename: Session file from smartterm_save_session()
+ * Returns: SMARTTERM_OK on success, SMARTTERM_IOERROR if the file is
+ *          missing or invalid (scrollback is then left unchanged)
+ *
+ * Note: The file is memory-mapped and used in place as the oldest lines;
+ *       new output is appended after it. Lines are not copied, so loading
+ *       is fast regardless of size. Do not modify the file while loaded.
+ */
+int smartterm_load_session(smartterm_ctx* ctx, const char* filename);
+
 /*
  * ============================================================================
  * TAB COMPLETION
@@ -438,6 +801,75 @@ typedef char** (*smartterm_completer_fn)(const char* text, int start, int end, v
  */
 int smartterm_set_completer(smartterm_ctx* ctx, smartterm_completer_fn completer, void* data);
 
+/*
+ * Dynamic completion source function type.
+ *
+ * line: Whole input line (a copy for SOURCE_ASYNC sources)
+ * start: Start of the word being completed
+ * end: End of the word (cursor position)
+ * data: User data passed to smartterm_completion_add_source()
+ * Returns: NULL-terminated array of candidates (library frees), or NULL
+ *
+ * Note: SOURCE_ASYNC sources are called on a background thread.
+ */
+typedef char** (*smartterm_completion_source_fn)(const char* line, int start, int end,
+                                                 void* data);
+
+/*
+ * Add static completion vocabulary.
+ *
+ * ctx: Context handle
+ * words: Words to offer (copied)
+ * count: Number of words (-1 = words is NULL-terminated)
+ * scope: Words of the line the vocabulary completes
+ * Returns: Completion ID (> 0), or error code
+ *
+ * Note: Words are stored in a radix trie; Tab lists those starting with
+ *       the word before the cursor.
+ */
+int smartterm_completion_add_words(smartterm_ctx* ctx, const char* const* words, int count,
+                                   smartterm_complete_scope_t scope);
+
+/*
+ * Add dynamic completion source.
+ *
+ * ctx: Context handle
+ * fn: Source function
+ * data: User data passed to fn
+ * scope: Words of the line the source completes
+ * flags: SOURCE_* options
+ * Returns: Completion ID (> 0), or error code
+ *
+ * Note: SOURCE_CACHED requires that candidates for a longer word are
+ *       among those for a shorter one (every candidate starting with the
+ *       word is returned), as for a plain list of names. Tab waits for
+ *       SOURCE_ASYNC sources without blocking input; typing on cancels
+ *       the wait and the results are kept for the next Tab.
+ */
+int smartterm_completion_add_source(smartterm_ctx* ctx, smartterm_completion_source_fn fn,
+                                    void* data, smartterm_complete_scope_t scope, int flags);
+
+/*
+ * Remove completion vocabulary or source.
+ *
+ * ctx: Context handle
+ * id: Completion ID
+ * Returns: SMARTTERM_OK on success, SMARTTERM_INVALID for an unknown ID
+ *
+ * Note: Waits for a lookup of the source in progress, so its data may be
+ *       freed afterwards.
+ */
+int smartterm_completion_remove(smartterm_ctx* ctx, int id);
+
+/*
+ * Drop cached results of a source.
+ *
+ * ctx: Context handle
+ * id: Completion ID (0 = all sources)
+ * Returns: SMARTTERM_OK on success, error code on failure
+ */
+int smartterm_completion_invalidate(smartterm_ctx* ctx, int id);
+
 /*
  * ============================================================================
  * THEMES
@@ -547,6 +979,130 @@ int smartterm_register_key_handler(smartterm_ctx* ctx, int key, smartterm_key_ha
  */
 int smartterm_unregister_key_handler(smartterm_ctx* ctx, int key);
 
+/*
+ * Create keymap.
+ *
+ * ctx: Context handle
+ * Returns: Keymap, or NULL on failure
+ *
+ * Note: Keymaps not freed are released by smartterm_cleanup().
+ */
+smartterm_keymap* smartterm_keymap_create(smartterm_ctx* ctx);
+
+/*
+ * Free keymap.
+ *
+ * map: Keymap (deactivated first if active; not the global keymap)
+ */
+void smartterm_keymap_free(smartterm_keymap* map);
+
+/*
+ * Bind key sequence.
+ *
+ * map: Keymap
+ * keys: Space-separated keys, e.g. "C-x C-s", "M-f", "F5", "Up", "q"
+ * handler: Handler callback, called with the last key of the sequence
+ * data: User data passed to callback
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Key names: C-<key> (control), M-<key> (Esc prefix), Esc, Tab,
+ *       Enter, Space, Backspace, Delete, Insert, Home, End, PageUp,
+ *       PageDown, Up, Down, Left, Right, F1-F12, or a single character.
+ *       Rebinding replaces the handler. A sequence cannot extend a bound
+ *       sequence, nor end where longer ones continue (SMARTTERM_INVALID).
+ */
+int smartterm_keymap_bind(smartterm_keymap* map, const char* keys,
+                          smartterm_key_handler_fn handler, void* data);
+
+/*
+ * Remove key sequence binding.
+ *
+ * map: Keymap
+ * keys: Sequence as given to smartterm_keymap_bind()
+ * Returns: SMARTTERM_OK, or SMARTTERM_ERROR if not bound
+ */
+int smartterm_keymap_unbind(smartterm_keymap* map, const char* keys);
+
+/*
+ * Get global keymap.
+ *
+ * ctx: Context handle
+ * Returns: Keymap holding smartterm_register_key_handler() bindings
+ */
+smartterm_keymap* smartterm_get_global_keymap(smartterm_ctx* ctx);
+
+/*
+ * Switch modal keymap.
+ *
+ * ctx: Context handle
+ * map: Keymap looked up before the global one (NULL = global only)
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Keys bound in neither keymap go to the line editor. A partly
+ *       typed sequence that matches no binding is passed on to the
+ *       editor key by key.
+ */
+int smartterm_set_keymap(smartterm_ctx* ctx, smartterm_keymap* map);
+
+/*
+ * ============================================================================
+ * EVENT LOOP
+ * ============================================================================
+ */
+
+/*
+ * Line handler callback function type.
+ *
+ * ctx: Context handle
+ * line: Accepted line (caller must free()), or NULL on EOF
+ * data: User data passed to smartterm_set_line_handler()
+ */
+typedef void (*smartterm_line_handler_fn)(smartterm_ctx* ctx, char* line, void* data);
+
+/*
+ * Get file descriptor for an external event loop.
+ *
+ * ctx: Context handle
+ * Returns: Descriptor that polls readable when smartterm_step() has work,
+ *          or -1 on error
+ *
+ * Note: The descriptor is an epoll set watching stdin (while a line
+ *       handler is installed), a wakeup eventfd and a frame timerfd.
+ *       Once it exists, smartterm_write() and friends queue output and
+ *       wake the loop instead of drawing; smartterm_step() renders it.
+ *       Linux only. The descriptor is closed by smartterm_cleanup().
+ */
+int smartterm_get_fd(smartterm_ctx* ctx);
+
+/*
+ * Process pending input and output without blocking.
+ *
+ * ctx: Context handle
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Call when the smartterm_get_fd() descriptor is readable, from the
+ *       thread that owns the loop. Reads the keys that have arrived,
+ *       passes accepted lines to the line handler and renders queued
+ *       output, at most once per frame (16 ms); a later frame is
+ *       scheduled on the timer.
+ */
+int smartterm_step(smartterm_ctx* ctx);
+
+/*
+ * Install line handler for event loop input.
+ *
+ * ctx: Context handle
+ * handler: Called from smartterm_step() with each line (NULL = stop input)
+ * data: User data passed to callback
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Editing starts immediately with the default prompt and restarts
+ *       after each line. Remove the handler on EOF. Do not mix with
+ *       smartterm_read_line().
+ */
+int smartterm_set_line_handler(smartterm_ctx* ctx, smartterm_line_handler_fn handler,
+                               void* data);
+
 /*
  * ============================================================================
  * ERROR HANDLING
@@ -590,6 +1146,26 @@ const char* smartterm_version(void);
  */
 int smartterm_get_line_count(smartterm_ctx* ctx);
 
+/*
+ * Get number of lines with context.
+ *
+ * ctx: Context handle
+ * context: Context type
+ * Returns: Number of lines in buffer with context
+ */
+int smartterm_get_context_count(smartterm_ctx* ctx, smartterm_context_t context);
+
+/*
+ * Get scrollback memory usage.
+ *
+ * ctx: Context handle
+ * usage: Output usage structure
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Counts requested bytes; allocator overhead is not included.
+ */
+int smartterm_get_memory_usage(smartterm_ctx* ctx, smartterm_memory_usage_t* usage);
+
 /*
  * Get line from buffer.
  *
@@ -597,11 +1173,27 @@ int smartterm_get_line_count(smartterm_ctx* ctx);
  * index: Line index (0 = oldest)
  * Returns: Line text, or NULL if invalid index
  *
- * Note: Returned string is valid until next write/clear operation.
- *       Do not free.
+ * Note: The text is not copied. It is valid only until the next call that
+ *       writes, updates, clears or loads output, or reads another line,
+ *       on any thread: older lines share a small decompression cache, and
+ *       live lines are reallocated by smartterm_line_update(). Use
+ *       smartterm_copy_line() when other threads write output or the text
+ *       must be kept. Do not free.
  */
 const char* smartterm_get_line(smartterm_ctx* ctx, int index);
 
+/*
+ * Copy line from buffer.
+ *
+ * ctx: Context handle
+ * index: Line index (0 = oldest)
+ * Returns: Allocated copy of line text, or NULL if invalid index
+ *
+ * Note: Caller must free() returned string. Safe while other threads
+ *       write output.
+ */
+char* smartterm_copy_line(smartterm_ctx* ctx, int index);
+
 /*
  * Get line metadata.
  *
@@ -609,9 +1201,24 @@ const char* smartterm_get_line(smartterm_ctx* ctx, int index);
  * index: Line index
  * meta: Output metadata structure
  * Returns: SMARTTERM_OK on success, error code if invalid index
+ *
+ * Note: Tags are interned; meta->tag stays valid until smartterm_cleanup().
  */
 int smartterm_get_line_meta(smartterm_ctx* ctx, int index, smartterm_line_meta_t* meta);
 
+/*
+ * Get indices of lines with tag.
+ *
+ * ctx: Context handle
+ * tag: Tag to look up
+ * lines: Output array of line indices (allocated by function)
+ * count: Output number of lines
+ * Returns: SMARTTERM_OK on success, error code on failure
+ *
+ * Note: Caller must free() lines array.
+ */
+int smartterm_get_tag_lines(smartterm_ctx* ctx, const char* tag, int** lines, int* count);
+
 /*
  * Get terminal size.
  *
@@ -628,7 +1235,8 @@ int smartterm_get_terminal_size(smartterm_ctx* ctx, int* rows, int* cols);
  * ctx: Context handle
  * Returns: SMARTTERM_OK on success, error code on failure
  *
- * Note: Usually called from SIGWINCH handler.
+ * Note: Usually called from SIGWINCH handler. Contexts on tty_fd read
+ *       the size of that terminal; call this after it changes.
  */
 int smartterm_handle_resize(smartterm_ctx* ctx);
 
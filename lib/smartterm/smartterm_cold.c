@@ -0,0 +1,343 @@
+/*
+ * SmartTerm Library - Compressed Cold Tier
+ *
+ * Keeps deep scrollback as LZ-compressed blocks of COLD_BLOCK_LINES
+ * lines. Only the newest hot_lines lines stay as individual strings;
+ * older ones are decompressed on demand into a small LRU block cache.
+ *
+ * All functions expect the buffer mutex to be held.
+ */
+
+#include "smartterm_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Get block by ring position (0 = oldest)
+ */
+static cold_block_t* cold_block(const cold_tier_t* cold, int position)
+{
+    int index = cold->head + position;
+    if (index >= cold->capacity) {
+        index -= cold->capacity;
+    }
+    return &cold->blocks[index];
+}
+
+/*
+ * Forget cached copy of block
+ */
+static void cold_cache_invalidate(cold_tier_t* cold, unsigned long first_seq)
+{
+    for (int i = 0; i < COLD_CACHE_BLOCKS; i++) {
+        if (cold->cache[i].valid && cold->cache[i].first_seq == first_seq) {
+            cold->cache[i].valid = false;
+        }
+    }
+}
+
+/*
+ * Free all blocks and cached text
+ */
+void cold_tier_cleanup(cold_tier_t* cold)
+{
+    if (!cold) {
+        return;
+    }
+
+    for (int i = 0; i < cold->count; i++) {
+        free(cold_block(cold, i)->data);
+    }
+    free(cold->blocks);
+
+    for (int i = 0; i < COLD_CACHE_BLOCKS; i++) {
+        free(cold->cache[i].text);
+    }
+
+    int hot_lines = cold->hot_lines;
+    memset(cold, 0, sizeof(*cold));
+    cold->hot_lines = hot_lines;
+}
+
+/*
+ * Drop all blocks; next cold line will have sequence number seq
+ */
+void cold_tier_clear(cold_tier_t* cold, unsigned long seq)
+{
+    for (int i = 0; i < cold->count; i++) {
+        free(cold_block(cold, i)->data);
+    }
+    for (int i = 0; i < COLD_CACHE_BLOCKS; i++) {
+        cold->cache[i].valid = false;
+    }
+
+    cold->head = 0;
+    cold->count = 0;
+    cold->bytes = 0;
+    cold->end_seq = seq;
+}
+
+/*
+ * Get number of cold lines (always the oldest lines in memory)
+ */
+int cold_tier_lines(const output_buffer_t* buf)
+{
+    unsigned long ring_seq = buffer_ring_seq(buf);
+    if (buf->cold.end_seq <= ring_seq) {
+        return 0;
+    }
+    return (int)(buf->cold.end_seq - ring_seq);
+}
+
+/*
+ * Make room for one more block in the ring
+ */
+static int cold_reserve(cold_tier_t* cold)
+{
+    if (cold->count < cold->capacity) {
+        return SMARTTERM_OK;
+    }
+
+    int new_capacity = cold->capacity ? cold->capacity * 2 : 16;
+    cold_block_t* blocks = malloc(new_capacity * sizeof(cold_block_t));
+    if (!blocks) {
+        return SMARTTERM_NOMEM;
+    }
+
+    for (int i = 0; i < cold->count; i++) {
+        blocks[i] = *cold_block(cold, i);
+    }
+
+    free(cold->blocks);
+    cold->blocks = blocks;
+    cold->capacity = new_capacity;
+    cold->head = 0;
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Pack oldest hot lines into a block once more than hot_lines are hot
+ *
+ * Failure leaves the lines hot, so it never loses output.
+ */
+int cold_tier_compress(output_buffer_t* buf)
+{
+    cold_tier_t* cold = &buf->cold;
+    if (cold->hot_lines <= 0) {
+        return SMARTTERM_OK;
+    }
+
+    int first = cold_tier_lines(buf);
+    if (buffer_ring_count(buf) - first < cold->hot_lines + COLD_BLOCK_LINES) {
+        return SMARTTERM_OK;
+    }
+
+    /* Join lines; terminators double as separators */
+    size_t raw_size = 0;
+    for (int i = first; i < first + COLD_BLOCK_LINES; i++) {
+        raw_size += strlen(buf->text[buffer_ring_slot(buf, i)]) + 1;
+    }
+
+    char* raw = malloc(raw_size);
+    unsigned char* packed = malloc(lz_compress_bound(raw_size));
+    if (!raw || !packed || cold_reserve(cold) != SMARTTERM_OK) {
+        free(raw);
+        free(packed);
+        return SMARTTERM_NOMEM;
+    }
+
+    size_t pos = 0;
+    for (int i = first; i < first + COLD_BLOCK_LINES; i++) {
+        const char* text = buf->text[buffer_ring_slot(buf, i)];
+        size_t len = strlen(text) + 1;
+        memcpy(raw + pos, text, len);
+        pos += len;
+    }
+
+    size_t size = lz_compress(raw, raw_size, packed, lz_compress_bound(raw_size));
+    free(raw);
+    if (size == 0) {
+        free(packed);
+        return SMARTTERM_ERROR;
+    }
+
+    /* Give back the worst-case slack */
+    unsigned char* shrunk = realloc(packed, size);
+    if (shrunk) {
+        packed = shrunk;
+    }
+
+    cold_block_t* block = cold_block(cold, cold->count++);
+    block->data = packed;
+    block->size = size;
+    block->raw_size = raw_size;
+    block->first_seq = buffer_ring_seq(buf) + first;
+
+    for (int i = first; i < first + COLD_BLOCK_LINES; i++) {
+        int slot = buffer_ring_slot(buf, i);
+        free(buf->text[slot]);
+        buf->text[slot] = NULL;
+    }
+
+    buf->text_bytes -= raw_size;
+    cold->bytes += size;
+    cold->end_seq = block->first_seq + COLD_BLOCK_LINES;
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Free blocks whose lines have all been evicted
+ */
+void cold_tier_evict(output_buffer_t* buf)
+{
+    cold_tier_t* cold = &buf->cold;
+
+    while (cold->count > 0) {
+        cold_block_t* block = cold_block(cold, 0);
+        if (buffer_ring_seq(buf) < block->first_seq + COLD_BLOCK_LINES) {
+            break;
+        }
+
+        cold_cache_invalidate(cold, block->first_seq);
+        cold->bytes -= block->size;
+        free(block->data);
+        block->data = NULL;
+
+        cold->head = (cold->head + 1 == cold->capacity) ? 0 : cold->head + 1;
+        cold->count--;
+    }
+}
+
+/*
+ * Decompress block into entry and index its line starts
+ */
+static bool cold_entry_load(cold_cache_entry_t* entry, const cold_block_t* block)
+{
+    entry->valid = false;
+    if (entry->capacity < block->raw_size) {
+        char* text = realloc(entry->text, block->raw_size);
+        if (!text) {
+            return false;
+        }
+        entry->text = text;
+        entry->capacity = block->raw_size;
+    }
+
+    size_t size;
+    if (lz_decompress(block->data, block->size, entry->text, block->raw_size, &size) !=
+            SMARTTERM_OK ||
+        size != block->raw_size) {
+        return false;
+    }
+
+    /* Index line starts */
+    const char* p = entry->text;
+    for (int i = 0; i < COLD_BLOCK_LINES; i++) {
+        entry->offsets[i] = (unsigned int)(p - entry->text);
+        p += strlen(p) + 1;
+    }
+
+    entry->first_seq = block->first_seq;
+    entry->valid = true;
+    return true;
+}
+
+/*
+ * Decompress block into least recently used cache entry
+ */
+static cold_cache_entry_t* cold_cache_load(cold_tier_t* cold, const cold_block_t* block)
+{
+    cold_cache_entry_t* entry = &cold->cache[0];
+    for (int i = 0; i < COLD_CACHE_BLOCKS; i++) {
+        if (!cold->cache[i].valid) {
+            entry = &cold->cache[i];
+            break;
+        }
+        if (cold->cache[i].last_used < entry->last_used) {
+            entry = &cold->cache[i];
+        }
+    }
+
+    return cold_entry_load(entry, block) ? entry : NULL;
+}
+
+/*
+ * Find block holding cold line (NULL if index is not cold)
+ */
+static const cold_block_t* cold_find(const output_buffer_t* buf, int index)
+{
+    const cold_tier_t* cold = &buf->cold;
+    if (cold->count == 0 || index - buf->spill.count >= cold_tier_lines(buf)) {
+        return NULL;
+    }
+
+    unsigned long seq = buf->base_seq + index;
+    unsigned long first_seq = cold_block(cold, 0)->first_seq;
+    return cold_block(cold, (int)((seq - first_seq) / COLD_BLOCK_LINES));
+}
+
+/*
+ * Get text of cold line ("" if the block cannot be decompressed)
+ */
+const char* cold_tier_line(output_buffer_t* buf, int index)
+{
+    cold_tier_t* cold = &buf->cold;
+    const cold_block_t* block = cold_find(buf, index);
+    if (!block) {
+        return "";
+    }
+
+    cold_cache_entry_t* entry = NULL;
+    for (int i = 0; i < COLD_CACHE_BLOCKS; i++) {
+        if (cold->cache[i].valid && cold->cache[i].first_seq == block->first_seq) {
+            entry = &cold->cache[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        entry = cold_cache_load(cold, block);
+        if (!entry) {
+            return "";
+        }
+    }
+
+    entry->last_used = ++cold->cache_clock;
+    return entry->text + entry->offsets[buf->base_seq + index - block->first_seq];
+}
+
+/*
+ * Get text of cold line through a caller-owned entry
+ *
+ * Leaves the shared cache untouched, so threads with their own entries
+ * can read concurrently while the buffer mutex is held for them.
+ */
+const char* cold_tier_line_private(const output_buffer_t* buf, int index,
+                                   cold_cache_entry_t* entry)
+{
+    const cold_block_t* block = cold_find(buf, index);
+    if (!block) {
+        return "";
+    }
+
+    if (!(entry->valid && entry->first_seq == block->first_seq) &&
+        !cold_entry_load(entry, block)) {
+        return "";
+    }
+
+    return entry->text + entry->offsets[buf->base_seq + index - block->first_seq];
+}
+
+/*
+ * Get memory held by blocks, block ring and cache
+ */
+size_t cold_tier_bytes(const cold_tier_t* cold)
+{
+    size_t bytes = cold->bytes + (size_t)cold->capacity * sizeof(cold_block_t);
+    for (int i = 0; i < COLD_CACHE_BLOCKS; i++) {
+        bytes += cold->cache[i].capacity;
+    }
+    return bytes;
+}
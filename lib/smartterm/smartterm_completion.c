@@ -0,0 +1,803 @@
+/*
+ * SmartTerm Library - Completion Engine
+ *
+ * Gathers Tab candidates for the word before the cursor from:
+ *
+ *   - vocabularies: static word lists kept in radix tries, so the words
+ *     under a prefix are found by walking its path and listing the subtree
+ *   - dynamic sources: application callbacks. With SOURCE_CACHED their
+ *     results are kept per word, and a longer word filters the results of
+ *     a shorter one instead of calling again. SOURCE_ASYNC sources run on
+ *     a worker thread: Tab returns at once and is retried when the results
+ *     arrive, unless the user has typed on
+ *   - the smartterm_set_completer() callback, called on every Tab
+ *
+ * Candidates from all of them are merged, sorted and deduplicated.
+ */
+
+#include "smartterm_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* First allocation of trie nodes and label bytes */
+#define TRIE_INITIAL_NODES 64
+#define TRIE_INITIAL_CHARS 1024
+
+/* Candidates being gathered */
+typedef struct {
+    char** items;                   /* NULL-terminated once finished */
+    int count;
+    int capacity;
+} candidates_t;
+
+/*
+ * Append copy of len bytes of s
+ */
+static bool candidates_add(candidates_t* list, const char* s, size_t len)
+{
+    /* One slot stays free for the terminator */
+    if (list->count + 1 >= list->capacity) {
+        int new_capacity = list->capacity ? list->capacity * 2 : 16;
+        char** items = realloc(list->items, new_capacity * sizeof(char*));
+        if (!items) {
+            return false;
+        }
+        list->items = items;
+        list->capacity = new_capacity;
+    }
+
+    char* copy = strndup(s, len);
+    if (!copy) {
+        return false;
+    }
+    list->items[list->count++] = copy;
+    list->items[list->count] = NULL;
+    return true;
+}
+
+/*
+ * Append results starting with filter (NULL = all)
+ */
+static bool candidates_add_results(candidates_t* list, char* const* results, const char* filter,
+                                   size_t filter_len)
+{
+    for (int i = 0; results && results[i]; i++) {
+        if ((!filter || strncmp(results[i], filter, filter_len) == 0) &&
+            !candidates_add(list, results[i], strlen(results[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Compare candidates for qsort
+ */
+static int candidates_compare(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+ * Free NULL-terminated result array from a source
+ */
+static void results_free(char** results)
+{
+    for (int i = 0; results && results[i]; i++) {
+        free(results[i]);
+    }
+    free(results);
+}
+
+/*
+ * Free candidates from completion_collect()
+ */
+void completion_free(char** candidates, int count)
+{
+    for (int i = 0; i < count; i++) {
+        free(candidates[i]);
+    }
+    free(candidates);
+}
+
+/*
+ * Add trie node; returns its index (-1 = no memory)
+ */
+static int trie_add_node(completion_trie_t* trie, int label, int length, int child, int sibling,
+                         bool terminal)
+{
+    if (trie->node_count >= trie->node_capacity) {
+        int new_capacity = trie->node_capacity ? trie->node_capacity * 2 : TRIE_INITIAL_NODES;
+        trie_node_t* nodes = realloc(trie->nodes, new_capacity * sizeof(trie_node_t));
+        if (!nodes) {
+            return -1;
+        }
+        trie->nodes = nodes;
+        trie->node_capacity = new_capacity;
+    }
+
+    trie->nodes[trie->node_count] = (trie_node_t){label, length, child, sibling, terminal};
+    return trie->node_count++;
+}
+
+/*
+ * Store label bytes; returns their offset (-1 = no memory)
+ */
+static int trie_add_chars(completion_trie_t* trie, const char* s, size_t len)
+{
+    if (trie->chars_used + len > trie->chars_capacity) {
+        size_t new_capacity = trie->chars_capacity ? trie->chars_capacity : TRIE_INITIAL_CHARS;
+        while (new_capacity < trie->chars_used + len) {
+            new_capacity *= 2;
+        }
+        char* chars = realloc(trie->chars, new_capacity);
+        if (!chars) {
+            return -1;
+        }
+        trie->chars = chars;
+        trie->chars_capacity = new_capacity;
+    }
+
+    memcpy(trie->chars + trie->chars_used, s, len);
+    trie->chars_used += len;
+    return (int)(trie->chars_used - len);
+}
+
+/*
+ * Get first label byte of node
+ */
+static unsigned char trie_first(const completion_trie_t* trie, int node)
+{
+    return (unsigned char)trie->chars[trie->nodes[node].label];
+}
+
+/*
+ * Insert word, splitting the edge where it leaves an existing path
+ */
+static bool trie_insert(completion_trie_t* trie, const char* word)
+{
+    size_t len = strlen(word);
+    size_t pos = 0;
+    int node = 0;
+
+    while (pos < len) {
+        unsigned char c = (unsigned char)word[pos];
+        int prev = -1;
+        int child = trie->nodes[node].child;
+        while (child >= 0 && trie_first(trie, child) < c) {
+            prev = child;
+            child = trie->nodes[child].sibling;
+        }
+
+        /* No edge starts with c: the rest of the word is a new leaf */
+        if (child < 0 || trie_first(trie, child) != c) {
+            int label = trie_add_chars(trie, word + pos, len - pos);
+            int leaf = -1;
+            if (label >= 0) {
+                leaf = trie_add_node(trie, label, (int)(len - pos), -1, child, true);
+            }
+            if (leaf < 0) {
+                return false;
+            }
+            if (prev < 0) {
+                trie->nodes[node].child = leaf;
+            } else {
+                trie->nodes[prev].sibling = leaf;
+            }
+            return true;
+        }
+
+        trie_node_t edge = trie->nodes[child];
+        int k = 1;
+        while (k < edge.length && pos + k < len && trie->chars[edge.label + k] == word[pos + k]) {
+            k++;
+        }
+
+        /* The word leaves the edge midway: the rest of the label moves down */
+        if (k < edge.length) {
+            int rest = trie_add_node(trie, edge.label + k, edge.length - k, edge.child, -1,
+                                     edge.terminal);
+            if (rest < 0) {
+                return false;
+            }
+            trie->nodes[child].length = k;
+            trie->nodes[child].child = rest;
+            trie->nodes[child].terminal = false;
+        }
+
+        node = child;
+        pos += k;
+    }
+
+    trie->nodes[node].terminal = true;
+    return true;
+}
+
+/*
+ * Find node whose path covers prefix
+ *
+ * Returns the node (-1 = no word has the prefix); *before is the length
+ * of its path above its own label.
+ */
+static int trie_find(const completion_trie_t* trie, const char* prefix, size_t len, size_t* before)
+{
+    int node = 0;
+    size_t pos = 0;
+    *before = 0;
+
+    while (pos < len) {
+        int child = trie->nodes[node].child;
+        while (child >= 0 && trie_first(trie, child) != (unsigned char)prefix[pos]) {
+            child = trie->nodes[child].sibling;
+        }
+        if (child < 0) {
+            return -1;
+        }
+
+        const trie_node_t* edge = &trie->nodes[child];
+        int k = 0;
+        for (; k < edge->length && pos + k < len; k++) {
+            if (trie->chars[edge->label + k] != prefix[pos + k]) {
+                return -1;
+            }
+        }
+        *before = pos;
+        node = child;
+        pos += k;
+    }
+    return node;
+}
+
+/*
+ * List words below node in byte order; path holds the path above it
+ */
+static bool trie_collect(const completion_trie_t* trie, int node, char** path,
+                         size_t* path_capacity, size_t path_len, candidates_t* out)
+{
+    const trie_node_t* n = &trie->nodes[node];
+    size_t len = path_len + n->length;
+
+    if (len >= *path_capacity) {
+        size_t new_capacity = *path_capacity * 2 > len ? *path_capacity * 2 : len + 1;
+        char* grown = realloc(*path, new_capacity);
+        if (!grown) {
+            return false;
+        }
+        *path = grown;
+        *path_capacity = new_capacity;
+    }
+    memcpy(*path + path_len, trie->chars + n->label, n->length);
+
+    if (n->terminal && !candidates_add(out, *path, len)) {
+        return false;
+    }
+    for (int child = n->child; child >= 0; child = trie->nodes[child].sibling) {
+        if (!trie_collect(trie, child, path, path_capacity, len, out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Add words of trie starting with word
+ */
+static bool trie_complete(const completion_trie_t* trie, const char* word, size_t len,
+                          candidates_t* out)
+{
+    size_t before;
+    int node = trie_find(trie, word, len, &before);
+    if (node < 0) {
+        return true;
+    }
+
+    size_t capacity = len + 64;
+    char* path = malloc(capacity);
+    if (!path) {
+        return false;
+    }
+    memcpy(path, word, before);
+    bool ok = trie_collect(trie, node, &path, &capacity, before, out);
+    free(path);
+    return ok;
+}
+
+/*
+ * Release trie
+ */
+static void trie_free(completion_trie_t* trie)
+{
+    free(trie->nodes);
+    free(trie->chars);
+    memset(trie, 0, sizeof(*trie));
+}
+
+/*
+ * Check whether source completes the word starting at start
+ */
+static bool scope_applies(smartterm_complete_scope_t scope, const char* line, int start)
+{
+    bool first = true;
+    for (int i = 0; i < start; i++) {
+        if (line[i] != ' ') {
+            first = false;
+            break;
+        }
+    }
+    return scope == COMPLETE_ANY || (scope == COMPLETE_COMMAND) == first;
+}
+
+/*
+ * Get registered source (NULL = removed)
+ */
+static completion_source_t* source_find(completion_state_t* completion, int id)
+{
+    for (int i = 0; i < completion->source_count; i++) {
+        if (completion->sources[i].id == id) {
+            return &completion->sources[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Find cached results for the word [start, end) of line
+ *
+ * With refine, results for a shorter word with the same context also
+ * qualify; the longest such word is used.
+ */
+static completion_cache_t* cache_find(completion_state_t* completion, int source,
+                                      const char* line, int start, int end, bool refine)
+{
+    completion_cache_t* best = NULL;
+    size_t best_len = 0;
+    size_t word_len = end - start;
+
+    for (int i = 0; i < COMPLETION_CACHE_SIZE; i++) {
+        completion_cache_t* slot = &completion->cache[i];
+        if (slot->source != source || strlen(slot->context) != (size_t)start ||
+            memcmp(slot->context, line, start) != 0) {
+            continue;
+        }
+
+        size_t len = strlen(slot->word);
+        if (len > word_len || memcmp(slot->word, line + start, len) != 0) {
+            continue;
+        }
+        if (len == word_len) {
+            return slot;
+        }
+        if (refine && (!best || len > best_len)) {
+            best = slot;
+            best_len = len;
+        }
+    }
+    return best;
+}
+
+/*
+ * Release cache slot
+ */
+static void cache_clear(completion_cache_t* slot)
+{
+    free(slot->context);
+    free(slot->word);
+    results_free(slot->results);
+    memset(slot, 0, sizeof(*slot));
+}
+
+/*
+ * Keep results for the word [start, end) of line, replacing the least recently used
+ */
+static void cache_store(completion_state_t* completion, int source, const char* line, int start,
+                        int end, char** results)
+{
+    completion_cache_t* slot = &completion->cache[0];
+    for (int i = 0; i < COMPLETION_CACHE_SIZE && slot->source; i++) {
+        if (!completion->cache[i].source || completion->cache[i].used < slot->used) {
+            slot = &completion->cache[i];
+        }
+    }
+    cache_clear(slot);
+
+    slot->context = strndup(line, start);
+    slot->word = strndup(line + start, end - start);
+    if (!slot->context || !slot->word) {
+        results_free(results);
+        cache_clear(slot);
+        return;
+    }
+    slot->source = source;
+    slot->results = results;
+    slot->used = ++completion->cache_clock;
+}
+
+/*
+ * Async worker: run queued lookups and store their results
+ */
+static void* completion_worker_run(void* arg)
+{
+    smartterm_ctx* ctx = arg;
+    completion_state_t* completion = &ctx->completion;
+
+    pthread_mutex_lock(&completion->job_mutex);
+    for (;;) {
+        while (!completion->stop && !completion->jobs) {
+            pthread_cond_wait(&completion->job_cond, &completion->job_mutex);
+        }
+        if (completion->stop) {
+            break;
+        }
+
+        completion_job_t* job = completion->jobs;
+        completion->jobs = job->next;
+        completion->running = job;
+        pthread_mutex_unlock(&completion->job_mutex);
+
+        char** results = job->fn(job->line, job->start, job->end, job->data);
+
+        pthread_mutex_lock(&completion->job_mutex);
+        completion->running = NULL;
+        pthread_cond_broadcast(&completion->job_cond);
+        pthread_mutex_unlock(&completion->job_mutex);
+
+        /* Store, then retry the Tab still waiting for it */
+        screen_lock(ctx);
+        if (source_find(completion, job->source)) {
+            cache_store(completion, job->source, job->line, job->start, job->end, results);
+            editor_completion_ready(ctx);
+        } else {
+            results_free(results);
+        }
+        screen_unlock(ctx);
+
+        free(job->line);
+        free(job);
+        pthread_mutex_lock(&completion->job_mutex);
+    }
+    pthread_mutex_unlock(&completion->job_mutex);
+
+    return NULL;
+}
+
+/*
+ * Free queued jobs of source (0 = all) (job mutex held)
+ */
+static void jobs_drop(completion_state_t* completion, int source)
+{
+    completion_job_t** link = &completion->jobs;
+    while (*link) {
+        completion_job_t* job = *link;
+        if (source == 0 || job->source == source) {
+            *link = job->next;
+            free(job->line);
+            free(job);
+        } else {
+            link = &job->next;
+        }
+    }
+}
+
+/*
+ * Check for a queued or running lookup of the same word (job mutex held)
+ */
+static bool job_in_flight(const completion_job_t* job, int source, const char* line, int end)
+{
+    return job && job->source == source && job->end == end && strcmp(job->line, line) == 0;
+}
+
+/*
+ * Queue background lookup; false = it cannot run
+ */
+static bool completion_enqueue(smartterm_ctx* ctx, const completion_source_t* source,
+                               const char* line, int start, int end)
+{
+    completion_state_t* completion = &ctx->completion;
+    bool queued = true;
+
+    pthread_mutex_lock(&completion->job_mutex);
+    bool in_flight = job_in_flight(completion->running, source->id, line, end);
+    for (const completion_job_t* job = completion->jobs; job && !in_flight; job = job->next) {
+        in_flight = job_in_flight(job, source->id, line, end);
+    }
+
+    if (!in_flight) {
+        /* Lookups for words the user has moved past are not needed */
+        jobs_drop(completion, source->id);
+
+        completion_job_t* job = calloc(1, sizeof(completion_job_t));
+        if (job) {
+            job->line = strdup_safe(line);
+        }
+        if (!completion->worker_started) {
+            completion->worker_started =
+                pthread_create(&completion->worker, NULL, completion_worker_run, ctx) == 0;
+        }
+
+        if (!job || !job->line || !completion->worker_started) {
+            if (job) {
+                free(job->line);
+            }
+            free(job);
+            queued = false;
+        } else {
+            *job = (completion_job_t){source->id, source->fn, source->data, job->line, start, end,
+                                      NULL};
+            completion_job_t** tail = &completion->jobs;
+            while (*tail) {
+                tail = &(*tail)->next;
+            }
+            *tail = job;
+            pthread_cond_broadcast(&completion->job_cond);
+        }
+    }
+    pthread_mutex_unlock(&completion->job_mutex);
+
+    return queued;
+}
+
+/*
+ * Gather candidates for the word [start, end) of line (screen mutex held)
+ *
+ * Returns sorted unique candidates (NULL when there are none) and sets
+ * *pending when an async source is still looking the word up.
+ */
+char** completion_collect(smartterm_ctx* ctx, const char* line, int start, int end, int* count,
+                          bool* pending)
+{
+    completion_state_t* completion = &ctx->completion;
+    candidates_t list = {0};
+    const char* word = line + start;
+    size_t word_len = end - start;
+    bool ok = true;
+
+    *pending = false;
+    for (int i = 0; ok && i < completion->source_count; i++) {
+        completion_source_t* source = &completion->sources[i];
+        if (!scope_applies(source->scope, line, start)) {
+            continue;
+        }
+        if (!source->fn) {
+            ok = trie_complete(&source->trie, word, word_len, &list);
+            continue;
+        }
+
+        bool cached = source->flags & (SOURCE_CACHED | SOURCE_ASYNC);
+        completion_cache_t* hit = NULL;
+        if (cached) {
+            hit = cache_find(completion, source->id, line, start, end,
+                             source->flags & SOURCE_CACHED);
+        }
+
+        if (hit) {
+            hit->used = ++completion->cache_clock;
+            bool refined = strlen(hit->word) < word_len;
+            ok = candidates_add_results(&list, hit->results, refined ? word : NULL, word_len);
+        } else if (source->flags & SOURCE_ASYNC) {
+            *pending = completion_enqueue(ctx, source, line, start, end) || *pending;
+        } else {
+            char** results = source->fn(line, start, end, source->data);
+            ok = candidates_add_results(&list, results, NULL, 0);
+            if (cached) {
+                cache_store(completion, source->id, line, start, end, results);
+            } else {
+                results_free(results);
+            }
+        }
+    }
+
+    if (ok && completion->completer) {
+        char* text = strndup(word, word_len);
+        char** results = text ? completion->completer(text, start, end, completion->user_data)
+                              : NULL;
+        free(text);
+        ok = candidates_add_results(&list, results, NULL, 0);
+        results_free(results);
+    }
+
+    if (!ok) {
+        completion_free(list.items, list.count);
+        *count = 0;
+        return NULL;
+    }
+
+    /* Sorted, so equal candidates from several sources are adjacent */
+    if (list.count > 1) {
+        qsort(list.items, list.count, sizeof(char*), candidates_compare);
+    }
+    int unique = 0;
+    for (int i = 0; i < list.count; i++) {
+        if (unique > 0 && strcmp(list.items[unique - 1], list.items[i]) == 0) {
+            free(list.items[i]);
+        } else {
+            list.items[unique++] = list.items[i];
+        }
+    }
+    if (list.items) {
+        list.items[unique] = NULL;
+    }
+
+    *count = unique;
+    return list.items;
+}
+
+/*
+ * Add source, assigning its ID (screen mutex held)
+ */
+static int completion_add(completion_state_t* completion, completion_source_t source)
+{
+    if (completion->source_count >= completion->source_capacity) {
+        int new_capacity = completion->source_capacity ? completion->source_capacity * 2 : 4;
+        completion_source_t* sources =
+            realloc(completion->sources, new_capacity * sizeof(completion_source_t));
+        if (!sources) {
+            return SMARTTERM_NOMEM;
+        }
+        completion->sources = sources;
+        completion->source_capacity = new_capacity;
+    }
+
+    source.id = ++completion->next_id;
+    completion->sources[completion->source_count++] = source;
+    return source.id;
+}
+
+/*
+ * Set up completion state
+ */
+void completion_init(smartterm_ctx* ctx)
+{
+    pthread_mutex_init(&ctx->completion.job_mutex, NULL);
+    pthread_cond_init(&ctx->completion.job_cond, NULL);
+}
+
+/*
+ * Stop the worker and release sources (screen mutex not held)
+ *
+ * A lookup in progress is waited for.
+ */
+void completion_cleanup(smartterm_ctx* ctx)
+{
+    completion_state_t* completion = &ctx->completion;
+
+    pthread_mutex_lock(&completion->job_mutex);
+    completion->stop = true;
+    jobs_drop(completion, 0);
+    pthread_cond_broadcast(&completion->job_cond);
+    pthread_mutex_unlock(&completion->job_mutex);
+    if (completion->worker_started) {
+        pthread_join(completion->worker, NULL);
+    }
+
+    for (int i = 0; i < completion->source_count; i++) {
+        trie_free(&completion->sources[i].trie);
+    }
+    free(completion->sources);
+    for (int i = 0; i < COMPLETION_CACHE_SIZE; i++) {
+        cache_clear(&completion->cache[i]);
+    }
+    pthread_cond_destroy(&completion->job_cond);
+    pthread_mutex_destroy(&completion->job_mutex);
+}
+
+/*
+ * Add static completion vocabulary
+ */
+int smartterm_completion_add_words(smartterm_ctx* ctx, const char* const* words, int count,
+                                   smartterm_complete_scope_t scope)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+    if (!words) {
+        return SMARTTERM_INVALID;
+    }
+
+    completion_source_t source = {.scope = scope};
+    bool ok = trie_add_node(&source.trie, 0, 0, -1, -1, false) == 0;
+    for (int i = 0; ok && (count < 0 ? words[i] != NULL : i < count); i++) {
+        if (words[i] && words[i][0]) {
+            ok = trie_insert(&source.trie, words[i]);
+        }
+    }
+    if (!ok) {
+        trie_free(&source.trie);
+        return SMARTTERM_NOMEM;
+    }
+
+    pthread_mutex_lock(&ctx->screen_mutex);
+    int id = completion_add(&ctx->completion, source);
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    if (id < 0) {
+        trie_free(&source.trie);
+    }
+    return id;
+}
+
+/*
+ * Add dynamic completion source
+ */
+int smartterm_completion_add_source(smartterm_ctx* ctx, smartterm_completion_source_fn fn,
+                                    void* data, smartterm_complete_scope_t scope, int flags)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+    if (!fn) {
+        return SMARTTERM_INVALID;
+    }
+
+    completion_source_t source = {.scope = scope, .flags = flags, .fn = fn, .data = data};
+
+    pthread_mutex_lock(&ctx->screen_mutex);
+    int id = completion_add(&ctx->completion, source);
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return id;
+}
+
+/*
+ * Remove completion vocabulary or source
+ */
+int smartterm_completion_remove(smartterm_ctx* ctx, int id)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    pthread_mutex_lock(&ctx->screen_mutex);
+    completion_state_t* completion = &ctx->completion;
+    completion_source_t* source = source_find(completion, id);
+    if (!source) {
+        pthread_mutex_unlock(&ctx->screen_mutex);
+        return SMARTTERM_INVALID;
+    }
+
+    /*
+     * The worker finishes a lookup without the screen mutex. Nothing here
+     * draws, so the curses lock is not taken and other sessions keep
+     * drawing while this waits.
+     */
+    pthread_mutex_lock(&completion->job_mutex);
+    jobs_drop(completion, id);
+    while (completion->running && completion->running->source == id) {
+        pthread_cond_wait(&completion->job_cond, &completion->job_mutex);
+    }
+    pthread_mutex_unlock(&completion->job_mutex);
+
+    for (int i = 0; i < COMPLETION_CACHE_SIZE; i++) {
+        if (completion->cache[i].source == id) {
+            cache_clear(&completion->cache[i]);
+        }
+    }
+
+    trie_free(&source->trie);
+    int index = (int)(source - completion->sources);
+    memmove(source, source + 1, (completion->source_count - index - 1) * sizeof(*source));
+    completion->source_count--;
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Drop cached results of a source
+ */
+int smartterm_completion_invalidate(smartterm_ctx* ctx, int id)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    pthread_mutex_lock(&ctx->screen_mutex);
+    for (int i = 0; i < COMPLETION_CACHE_SIZE; i++) {
+        completion_cache_t* slot = &ctx->completion.cache[i];
+        if (slot->source && (id == 0 || slot->source == id)) {
+            cache_clear(slot);
+        }
+    }
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return SMARTTERM_OK;
+}
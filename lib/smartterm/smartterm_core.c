@@ -8,34 +8,147 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 /* Library version */
 #define SMARTTERM_VERSION "1.0.0"
 
+/* ncurses keeps the current screen in globals, so sessions draw in turn */
+static pthread_mutex_t curses_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Get default configuration
  */
 smartterm_config_t smartterm_default_config(void)
 {
     smartterm_config_t config = {.max_lines = 1000,
+                                 .max_bytes = 0, /* Unlimited */
+                                 .hot_lines = 10000,
+                                 .spill_dir = NULL, /* Discard evicted lines */
+                                 .tee_file = NULL, /* No tee log */
+                                 .tee_format = EXPORT_PLAIN,
+                                 .tee_include_meta = false,
+                                 .tee_sync_ms = 1000,
+                                 .tee_sync_bytes = 0, /* No byte limit */
+                                 .tty_fd = 0, /* stdin/stdout */
+                                 .term_type = NULL, /* $TERM */
                                  .output_height = 0, /* Auto */
                                  .status_bar_enabled = true,
                                  .prompt = "> ",
+                                 .bracketed_paste = true,
                                  .history_enabled = true,
                                  .history_file = NULL,
                                  .history_size = 1000,
                                  .theme = NULL, /* Default theme */
                                  .multiline_enabled = false,
+                                 .multiline_height = 0, /* Half the screen */
                                  .thread_safe = true};
     return config;
 }
 
 /*
- * Initialize ncurses
+ * Lock session's screen and make it ncurses' current screen
+ *
+ * Recursive like the screen mutex; the curses lock is held from the
+ * outermost lock to the matching unlock.
+ */
+void screen_lock(smartterm_ctx* ctx)
+{
+    pthread_mutex_lock(&ctx->screen_mutex);
+    if (ctx->screen_depth++ == 0) {
+        pthread_mutex_lock(&curses_mutex);
+        if (ctx->screen) {
+            set_term(ctx->screen);
+        }
+    }
+}
+
+/*
+ * Unlock session's screen
+ */
+void screen_unlock(smartterm_ctx* ctx)
+{
+    if (--ctx->screen_depth == 0) {
+        pthread_mutex_unlock(&curses_mutex);
+    }
+    pthread_mutex_unlock(&ctx->screen_mutex);
+}
+
+/*
+ * Release session's ncurses screen and terminal streams
+ */
+static void close_terminal(smartterm_ctx* ctx)
+{
+    if (ctx->screen) {
+        delscreen(ctx->screen);
+        ctx->screen = NULL;
+    }
+    if (ctx->tty_in) {
+        fclose(ctx->tty_in);
+        ctx->tty_in = NULL;
+    }
+    if (ctx->tty_out) {
+        fclose(ctx->tty_out);
+        ctx->tty_out = NULL;
+    }
+}
+
+/*
+ * Open session's terminal: stdin/stdout, or config.tty_fd
+ *
+ * Every session gets its own SCREEN from newterm(). Streams on tty_fd use
+ * duplicates, so closing them leaves the application's descriptor open.
+ */
+static SCREEN* open_terminal(smartterm_ctx* ctx)
+{
+    int fd = ctx->config.tty_fd;
+    if (fd <= 0) {
+        ctx->input_fd = STDIN_FILENO;
+        return newterm(ctx->config.term_type, stdout, stdin);
+    }
+
+    int in = dup(fd);
+    int out = dup(fd);
+    ctx->tty_in = in >= 0 ? fdopen(in, "r") : NULL;
+    ctx->tty_out = out >= 0 ? fdopen(out, "w") : NULL;
+    if (!ctx->tty_in || !ctx->tty_out) {
+        if (in >= 0 && !ctx->tty_in) {
+            close(in);
+        }
+        if (out >= 0 && !ctx->tty_out) {
+            close(out);
+        }
+        return NULL;
+    }
+
+    ctx->input_fd = in;
+    return newterm(ctx->config.term_type, ctx->tty_out, ctx->tty_in);
+}
+
+/*
+ * Switch terminal's bracketed paste mode (screen locked)
+ *
+ * The terminal then wraps pastes in ESC [200~ ... ESC [201~, which
+ * define_key() turns into KEY_PASTE_START and KEY_PASTE_END.
+ */
+static void set_bracketed_paste(smartterm_ctx* ctx, bool enable)
+{
+    FILE* out = ctx->tty_out ? ctx->tty_out : stdout;
+    fputs(enable ? "\033[?2004h" : "\033[?2004l", out);
+    fflush(out);
+}
+
+/*
+ * Initialize ncurses (screen locked)
  */
 static int init_ncurses(smartterm_ctx* ctx)
 {
-    initscr();
+    ctx->screen = open_terminal(ctx);
+    if (!ctx->screen) {
+        close_terminal(ctx);
+        return SMARTTERM_ERROR;
+    }
     cbreak();
     noecho();
     keypad(stdscr, TRUE);
@@ -51,7 +164,7 @@ static int init_ncurses(smartterm_ctx* ctx)
 
     /* Calculate window heights */
     int status_height = ctx->config.status_bar_enabled ? 1 : 0;
-    int input_height = 2; /* Space for readline */
+    int input_height = ctx->input_height = INPUT_HEIGHT;
     int output_height = ctx->term_rows - status_height - input_height;
 
     if (ctx->config.output_height > 0 && ctx->config.output_height < output_height) {
@@ -62,20 +175,44 @@ static int init_ncurses(smartterm_ctx* ctx)
     ctx->output_win = newwin(output_height, ctx->term_cols, 0, 0);
     if (!ctx->output_win) {
         endwin();
+        close_terminal(ctx);
         return SMARTTERM_ERROR;
     }
     scrollok(ctx->output_win, TRUE);
+    leaveok(ctx->output_win, TRUE);
 
     if (ctx->config.status_bar_enabled) {
         ctx->status_win = newwin(1, ctx->term_cols, output_height, 0);
         if (!ctx->status_win) {
             delwin(ctx->output_win);
             endwin();
+            close_terminal(ctx);
             return SMARTTERM_ERROR;
         }
+        leaveok(ctx->status_win, TRUE);
+    }
+
+    /* Input line below the status bar; keys are read without blocking */
+    ctx->input_win = newwin(input_height, ctx->term_cols, output_height + status_height, 0);
+    if (!ctx->input_win) {
+        if (ctx->status_win) {
+            delwin(ctx->status_win);
+        }
+        delwin(ctx->output_win);
+        endwin();
+        close_terminal(ctx);
+        return SMARTTERM_ERROR;
     }
+    keypad(ctx->input_win, TRUE);
+    nodelay(ctx->input_win, TRUE);
+    set_escdelay(INPUT_ESCAPE_DELAY_MS);
 
     refresh();
+    if (ctx->config.bracketed_paste) {
+        define_key("\033[200~", KEY_PASTE_START);
+        define_key("\033[201~", KEY_PASTE_END);
+        set_bracketed_paste(ctx, true);
+    }
     ctx->ncurses_active = true;
 
     return SMARTTERM_OK;
@@ -98,15 +235,33 @@ smartterm_ctx* smartterm_init(const smartterm_config_t* config)
         ctx->config = smartterm_default_config();
     }
 
+    /* Event loop descriptors are created by smartterm_get_fd() */
+    loop_init(ctx);
+
+    /* Load input history */
+    history_open(&ctx->editor.history, &ctx->config);
+
     /* Initialize output buffer */
-    if (output_buffer_init(&ctx->buffer, ctx->config.max_lines, ctx->config.thread_safe) !=
-        SMARTTERM_OK) {
+    if (output_buffer_init(&ctx->buffer, &ctx->config) != SMARTTERM_OK) {
+        history_close(&ctx->editor.history);
         free(ctx);
         return NULL;
     }
 
+    /* Recursive: rendering nests inside status and theme updates */
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ctx->screen_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
     /* Initialize ncurses */
-    if (init_ncurses(ctx) != SMARTTERM_OK) {
+    screen_lock(ctx);
+    int result = init_ncurses(ctx);
+    screen_unlock(ctx);
+    if (result != SMARTTERM_OK) {
+        pthread_mutex_destroy(&ctx->screen_mutex);
+        history_close(&ctx->editor.history);
         output_buffer_cleanup(&ctx->buffer);
         free(ctx);
         return NULL;
@@ -120,7 +275,9 @@ smartterm_ctx* smartterm_init(const smartterm_config_t* config)
         ctx->theme = theme_get_default();
         ctx->owns_theme = false;
     }
+    screen_lock(ctx);
     theme_apply_colors(ctx);
+    screen_unlock(ctx);
 
     /* Set prompt */
     if (ctx->config.prompt) {
@@ -141,10 +298,11 @@ smartterm_ctx* smartterm_init(const smartterm_config_t* config)
     ctx->search.result_count = 0;
     ctx->search.current_result = -1;
 
+    /* Completion worker starts with the first async lookup */
+    completion_init(ctx);
+
     /* Initialize key handlers */
-    ctx->key_handler_capacity = 10;
-    ctx->key_handlers = calloc(ctx->key_handler_capacity, sizeof(key_handler_entry_t));
-    ctx->key_handler_count = 0;
+    keymap_init(ctx);
 
     ctx->initialized = true;
     ctx->last_error = SMARTTERM_OK;
@@ -169,12 +327,24 @@ void smartterm_cleanup(smartterm_ctx* ctx)
         return;
     }
 
+    /* Stop background exports before the buffer goes away */
+    export_jobs_cleanup(ctx);
+
+    /* Lookups store results under the screen mutex and redraw */
+    completion_cleanup(ctx);
+
     /* Cleanup search */
     free(ctx->search.pattern);
     free(ctx->search.results);
 
     /* Cleanup key handlers */
-    free(ctx->key_handlers);
+    keymap_cleanup(ctx);
+
+    /* Free views the application did not release */
+    ctx->active_view = NULL;
+    while (ctx->buffer.view_count > 0) {
+        smartterm_view_free(ctx->buffer.views[0]);
+    }
 
     /* Cleanup theme if owned */
     if (ctx->owns_theme && ctx->theme) {
@@ -182,6 +352,7 @@ void smartterm_cleanup(smartterm_ctx* ctx)
     }
 
     /* Cleanup ncurses */
+    screen_lock(ctx);
     if (ctx->ncurses_active) {
         if (ctx->output_win) {
             delwin(ctx->output_win);
@@ -189,8 +360,20 @@ void smartterm_cleanup(smartterm_ctx* ctx)
         if (ctx->status_win) {
             delwin(ctx->status_win);
         }
+        if (ctx->input_win) {
+            delwin(ctx->input_win);
+        }
+        if (ctx->config.bracketed_paste) {
+            set_bracketed_paste(ctx, false);
+        }
         endwin();
+        close_terminal(ctx);
     }
+    screen_unlock(ctx);
+    history_close(&ctx->editor.history);
+    editor_cleanup(&ctx->editor);
+    loop_cleanup(ctx);
+    pthread_mutex_destroy(&ctx->screen_mutex);
 
     /* Cleanup output buffer */
     output_buffer_cleanup(&ctx->buffer);
@@ -250,6 +433,8 @@ const char* smartterm_error_string(int code)
         return "Not initialized";
     case SMARTTERM_IOERROR:
         return "I/O error";
+    case SMARTTERM_CANCELLED:
+        return "Cancelled";
     default:
         return "Unknown error";
     }
@@ -288,6 +473,17 @@ const char* smartterm_get_line(smartterm_ctx* ctx, int index)
     return output_buffer_get_line(&ctx->buffer, index);
 }
 
+/*
+ * Copy line from buffer
+ */
+char* smartterm_copy_line(smartterm_ctx* ctx, int index)
+{
+    if (!ctx || !ctx->initialized) {
+        return NULL;
+    }
+    return output_buffer_copy_line(&ctx->buffer, index);
+}
+
 /*
  * Get line metadata
  */
@@ -312,6 +508,34 @@ int smartterm_get_terminal_size(smartterm_ctx* ctx, int* rows, int* cols)
     return SMARTTERM_OK;
 }
 
+/*
+ * Place windows for the terminal size and input height (screen locked)
+ *
+ * The input window sits at the bottom with the status bar above it; the
+ * output window takes the rest.
+ */
+void layout_windows(smartterm_ctx* ctx)
+{
+    int status_height = ctx->status_visible ? 1 : 0;
+    int output_height = ctx->term_rows - status_height - ctx->input_height;
+    int input_y = output_height + status_height;
+
+    wresize(ctx->output_win, output_height, ctx->term_cols);
+    if (ctx->status_win) {
+        mvwin(ctx->status_win, output_height, 0);
+        wresize(ctx->status_win, 1, ctx->term_cols);
+    }
+
+    /* mvwin() fails for a window that would leave the screen */
+    if (input_y < getbegy(ctx->input_win)) {
+        mvwin(ctx->input_win, input_y, 0);
+        wresize(ctx->input_win, ctx->input_height, ctx->term_cols);
+    } else {
+        wresize(ctx->input_win, ctx->input_height, ctx->term_cols);
+        mvwin(ctx->input_win, input_y, 0);
+    }
+}
+
 /*
  * Handle terminal resize
  */
@@ -321,24 +545,26 @@ int smartterm_handle_resize(smartterm_ctx* ctx)
         return SMARTTERM_NOTINIT;
     }
 
-    /* Get new terminal size */
-    endwin();
-    refresh();
-    getmaxyx(stdscr, ctx->term_rows, ctx->term_cols);
+    screen_lock(ctx);
 
-    /* Resize windows */
-    int status_height = ctx->status_visible ? 1 : 0;
-    int input_height = 2;
-    int output_height = ctx->term_rows - status_height - input_height;
-
-    wresize(ctx->output_win, output_height, ctx->term_cols);
-    if (ctx->status_win) {
-        mvwin(ctx->status_win, output_height, 0);
-        wresize(ctx->status_win, 1, ctx->term_cols);
+    /* Get new terminal size; SIGWINCH only covers the controlling terminal */
+    struct winsize size;
+    if (ctx->tty_out) {
+        if (ioctl(fileno(ctx->tty_out), TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+            resize_term(size.ws_row, size.ws_col);
+        }
+    } else {
+        endwin();
+        refresh();
     }
+    getmaxyx(stdscr, ctx->term_rows, ctx->term_cols);
+
+    layout_windows(ctx);
 
     /* Re-render */
-    return render_all(ctx);
+    int result = render_all(ctx);
+    screen_unlock(ctx);
+    return result;
 }
 
 /*
@@ -0,0 +1,922 @@
+/*
+ * SmartTerm Library - Input Line Editor
+ *
+ * Edits the input line inside the ncurses layout, one key at a time.
+ * Bindings follow readline's emacs mode: cursor motion, kill and yank,
+ * history browsing and search, and tab completion. All functions run with
+ * the screen mutex held.
+ */
+
+#include "smartterm_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial line allocation */
+#define EDITOR_INITIAL_CAPACITY 128
+
+/*
+ * Check for UTF-8 continuation byte
+ */
+static bool is_continuation(char c)
+{
+    return ((unsigned char)c & 0xc0) == 0x80;
+}
+
+/*
+ * Check for word byte (letters, digits and non-ASCII text)
+ */
+static bool is_word(char c)
+{
+    unsigned char u = (unsigned char)c;
+    return u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') ||
+           (u >= 'A' && u <= 'Z') || u == '_';
+}
+
+/*
+ * Count display columns (one per character)
+ */
+static int text_columns(const char* s, size_t len)
+{
+    int columns = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!is_continuation(s[i])) {
+            columns++;
+        }
+    }
+    return columns;
+}
+
+/*
+ * Get offset of character before pos
+ */
+static size_t prev_char(const line_editor_t* editor, size_t pos)
+{
+    while (pos > 0) {
+        pos--;
+        if (!is_continuation(editor->text[pos])) {
+            break;
+        }
+    }
+    return pos;
+}
+
+/*
+ * Get offset of character after pos
+ */
+static size_t next_char(const line_editor_t* editor, size_t pos)
+{
+    if (pos < editor->length) {
+        pos++;
+    }
+    while (pos < editor->length && is_continuation(editor->text[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+/*
+ * Get start of word before pos (Meta-b)
+ */
+static size_t prev_word(const line_editor_t* editor, size_t pos)
+{
+    while (pos > 0 && !is_word(editor->text[pos - 1])) {
+        pos--;
+    }
+    while (pos > 0 && is_word(editor->text[pos - 1])) {
+        pos--;
+    }
+    return pos;
+}
+
+/*
+ * Get end of word after pos (Meta-f)
+ */
+static size_t next_word(const line_editor_t* editor, size_t pos)
+{
+    while (pos < editor->length && !is_word(editor->text[pos])) {
+        pos++;
+    }
+    while (pos < editor->length && is_word(editor->text[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+/*
+ * Make room for extra bytes and a terminator
+ */
+static bool editor_reserve(line_editor_t* editor, size_t extra)
+{
+    if (editor->length + extra < editor->capacity) {
+        return true;
+    }
+
+    size_t new_capacity = editor->capacity ? editor->capacity : EDITOR_INITIAL_CAPACITY;
+    while (new_capacity <= editor->length + extra) {
+        new_capacity *= 2;
+    }
+
+    char* text = realloc(editor->text, new_capacity);
+    if (!text) {
+        return false;
+    }
+    editor->text = text;
+    editor->capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Insert bytes at cursor
+ */
+static void editor_insert(line_editor_t* editor, const char* s, size_t len)
+{
+    if (!editor_reserve(editor, len)) {
+        return;
+    }
+
+    memmove(editor->text + editor->cursor + len, editor->text + editor->cursor,
+            editor->length - editor->cursor + 1);
+    memcpy(editor->text + editor->cursor, s, len);
+    editor->length += len;
+    editor->cursor += len;
+}
+
+/*
+ * Remove bytes [from, to) and put the cursor at from
+ */
+static void editor_delete(line_editor_t* editor, size_t from, size_t to)
+{
+    if (from >= to) {
+        return;
+    }
+
+    memmove(editor->text + from, editor->text + to, editor->length - to + 1);
+    editor->length -= to - from;
+    editor->cursor = from;
+}
+
+/*
+ * Remove bytes [from, to), keeping them for yank
+ */
+static void editor_kill(line_editor_t* editor, size_t from, size_t to)
+{
+    if (from >= to) {
+        return;
+    }
+
+    char* kill = malloc(to - from + 1);
+    if (kill) {
+        memcpy(kill, editor->text + from, to - from);
+        kill[to - from] = '\0';
+        free(editor->kill);
+        editor->kill = kill;
+    }
+    editor_delete(editor, from, to);
+}
+
+/*
+ * Replace whole line, cursor at end
+ */
+static void editor_set_text(line_editor_t* editor, const char* s)
+{
+    editor->length = 0;
+    editor->cursor = 0;
+    editor->scroll = 0;
+    editor->text[0] = '\0';
+    editor_insert(editor, s, strlen(s));
+}
+
+/*
+ * Accept the line as Enter does
+ */
+static void editor_accept(smartterm_ctx* ctx)
+{
+    if (ctx->config.history_enabled) {
+        history_add(&ctx->editor.history, ctx->editor.text);
+    }
+    ctx->editor.state = EDITOR_ACCEPTED;
+}
+
+/*
+ * Show older (-1) or newer (+1) history entry
+ */
+static void history_move(line_editor_t* editor, int direction)
+{
+    input_history_t* history = &editor->history;
+    int pos = editor->history_pos + direction;
+    if (pos < 0 || pos > history->count) {
+        beep();
+        return;
+    }
+
+    /* Keep the line being typed to come back to */
+    if (editor->history_pos == history->count) {
+        free(editor->saved);
+        editor->saved = strdup_safe(editor->text);
+    }
+
+    editor->history_pos = pos;
+    if (pos == history->count) {
+        editor_set_text(editor, editor->saved ? editor->saved : "");
+    } else {
+        editor_set_text(editor, history->entries[pos].text);
+    }
+}
+
+/*
+ * Set second-row hint text (NULL = none)
+ */
+static void editor_set_hint(line_editor_t* editor, char* hint)
+{
+    free(editor->hint);
+    editor->hint = hint;
+}
+
+/*
+ * Show the current search result, cursor on the match
+ */
+static void editor_search_show(line_editor_t* editor)
+{
+    history_search_t* search = &editor->search;
+    int pos = history_search_result(search, &editor->history, search->rank);
+
+    /* No match keeps the last one shown, as readline does */
+    if (pos >= 0) {
+        const char* text = editor->history.entries[pos].text;
+        editor_set_text(editor, text);
+        editor->cursor = strstr(text, search->query) - text;
+    }
+}
+
+/*
+ * Start reverse incremental search (Ctrl-R)
+ */
+static void editor_search_begin(line_editor_t* editor)
+{
+    history_search_t* search = &editor->search;
+    if (!history_search_start(search, &editor->history)) {
+        beep();
+        return;
+    }
+
+    search->original = strdup_safe(editor->text);
+    search->original_cursor = editor->cursor;
+    editor_search_show(editor);
+}
+
+/*
+ * Leave search, keeping the line shown
+ */
+static void editor_search_finish(line_editor_t* editor)
+{
+    history_search_end(&editor->search);
+    editor_set_hint(editor, NULL);
+}
+
+/*
+ * Handle key during search; false = search ended, handle key as usual
+ */
+static bool editor_search_key(line_editor_t* editor, int key)
+{
+    history_search_t* search = &editor->search;
+
+    switch (key) {
+    case CTRL_KEY('r'):
+        /* Empty query: search again for the previous one */
+        if (search->length == 0 && search->last_query) {
+            for (const char* c = search->last_query; *c; c++) {
+                history_search_push(search, &editor->history, *c);
+            }
+        } else if (history_search_result(search, &editor->history, search->rank + 1) >= 0) {
+            search->rank++;
+        } else {
+            beep();
+        }
+        break;
+    case CTRL_KEY('s'):
+        if (search->rank > 0) {
+            search->rank--;
+        } else {
+            beep();
+        }
+        break;
+    case KEY_BACKSPACE:
+    case 127:
+    case CTRL_KEY('h'):
+        /* A whole UTF-8 character */
+        while (search->length > 0) {
+            char removed = search->query[search->length - 1];
+            history_search_pop(search);
+            if (!is_continuation(removed)) {
+                break;
+            }
+        }
+        break;
+    case CTRL_KEY('g'):
+        /* Cancel: back to the line as it was */
+        editor_set_text(editor, search->original ? search->original : "");
+        editor->cursor = search->original_cursor;
+        editor_search_finish(editor);
+        return true;
+    case KEY_ESCAPE:
+        editor_search_finish(editor);
+        return true;
+    default:
+        if (key < ' ' || key >= 256 || key == 127) {
+            editor_search_finish(editor);
+            return false;
+        }
+        if (!history_search_push(search, &editor->history, (char)key) ||
+            history_search_result(search, &editor->history, 0) < 0) {
+            beep();
+        }
+        break;
+    }
+
+    editor_search_show(editor);
+    return true;
+}
+
+/*
+ * Set candidates listed in the hint (NULL = none), taking ownership
+ */
+static void editor_set_candidates(line_editor_t* editor, char** candidates, int count)
+{
+    completion_free(editor->candidates, editor->candidate_count);
+    editor->candidates = candidates;
+    editor->candidate_count = count;
+
+    size_t hint_size = 0;
+    for (int i = 0; i < count; i++) {
+        hint_size += strlen(candidates[i]) + 2;
+    }
+    char* hint = count > 0 ? malloc(hint_size + 1) : NULL;
+    if (hint) {
+        hint[0] = '\0';
+        for (int i = 0; i < count; i++) {
+            strcat(hint, candidates[i]);
+            strcat(hint, "  ");
+        }
+    }
+    editor_set_hint(editor, hint);
+}
+
+/*
+ * Get start of the word before cursor
+ */
+static size_t editor_word_start(const line_editor_t* editor)
+{
+    size_t start = editor->cursor;
+    while (start > 0 && editor->text[start - 1] != ' ') {
+        start--;
+    }
+    return start;
+}
+
+/*
+ * Drop listed candidates the word typed so far no longer matches
+ */
+static void editor_narrow_candidates(line_editor_t* editor)
+{
+    size_t start = editor_word_start(editor);
+    size_t length = editor->cursor - start;
+
+    /* A space ends the word being completed */
+    if (length == 0) {
+        editor_set_candidates(editor, NULL, 0);
+        return;
+    }
+
+    char** candidates = editor->candidates;
+    int count = 0;
+    for (int i = 0; i < editor->candidate_count; i++) {
+        if (strncmp(candidates[i], editor->text + start, length) == 0) {
+            candidates[count++] = candidates[i];
+        } else {
+            free(candidates[i]);
+        }
+    }
+    editor->candidates = NULL;
+    editor->candidate_count = 0;
+    if (count == 0) {
+        free(candidates);
+        candidates = NULL;
+    }
+    editor_set_candidates(editor, candidates, count);
+}
+
+/*
+ * Complete word before cursor from the completion sources
+ *
+ * The word is extended to the candidates' common prefix; a single
+ * candidate is completed and followed by a space, several are listed on
+ * the second input row. While async sources are still looking the word
+ * up, "completing..." is shown and editor_completion_ready() retries.
+ */
+static void editor_complete(smartterm_ctx* ctx)
+{
+    line_editor_t* editor = &ctx->editor;
+    size_t start = editor_word_start(editor);
+    int count = 0;
+    bool pending = false;
+    char** matches = completion_collect(ctx, editor->text, (int)start, (int)editor->cursor,
+                                        &count, &pending);
+
+    editor->completion_waiting = pending;
+    if (pending) {
+        completion_free(matches, count);
+        editor_set_candidates(editor, NULL, 0);
+        editor_set_hint(editor, strdup_safe("completing..."));
+        return;
+    }
+    if (count == 0) {
+        free(matches);
+        editor_set_candidates(editor, NULL, 0);
+        beep();
+        return;
+    }
+
+    /* Common prefix of all candidates */
+    size_t prefix = strlen(matches[0]);
+    for (int i = 1; i < count; i++) {
+        size_t j = 0;
+        while (j < prefix && matches[i][j] == matches[0][j]) {
+            j++;
+        }
+        prefix = j;
+    }
+
+    editor_delete(editor, start, editor->cursor);
+    editor_insert(editor, matches[0], prefix);
+    if (count == 1) {
+        editor_insert(editor, " ", 1);
+        completion_free(matches, count);
+        editor_set_candidates(editor, NULL, 0);
+    } else {
+        editor_set_candidates(editor, matches, count);
+    }
+}
+
+/*
+ * Retry Tab waiting for async completion results (screen mutex held)
+ */
+void editor_completion_ready(smartterm_ctx* ctx)
+{
+    if (ctx->editor.state != EDITOR_EDITING || !ctx->editor.completion_waiting) {
+        return;
+    }
+    editor_complete(ctx);
+    editor_draw(ctx);
+    render_update(ctx);
+}
+
+/*
+ * Handle key after ESC
+ */
+static void editor_meta_key(line_editor_t* editor, int key)
+{
+    switch (key) {
+    case 'b':
+        editor->cursor = prev_word(editor, editor->cursor);
+        break;
+    case 'f':
+        editor->cursor = next_word(editor, editor->cursor);
+        break;
+    case 'd':
+        editor_kill(editor, editor->cursor, next_word(editor, editor->cursor));
+        break;
+    case KEY_BACKSPACE:
+    case 127:
+        editor_kill(editor, prev_word(editor, editor->cursor), editor->cursor);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Enter next line left from a multi-line paste
+ */
+static void editor_take_queued(smartterm_ctx* ctx)
+{
+    line_editor_t* editor = &ctx->editor;
+    const char* line = editor->queued + editor->queued_pos;
+    const char* newline = strchr(line, '\n');
+    size_t length = newline ? (size_t)(newline - line) : strlen(line);
+
+    editor_insert(editor, line, length);
+    if (newline) {
+        editor->queued_pos += length + 1;
+        editor_accept(ctx);
+    }
+    if (!newline || editor->queued[editor->queued_pos] == '\0') {
+        free(editor->queued);
+        editor->queued = NULL;
+        editor->queued_pos = 0;
+    }
+}
+
+/*
+ * Insert finished paste in one step
+ *
+ * Without a line break the text goes into the line at the cursor. A
+ * multi-line paste goes to the paste handler as one batch, or else its
+ * lines are entered one by one as if typed.
+ */
+static void editor_paste_done(smartterm_ctx* ctx)
+{
+    line_editor_t* editor = &ctx->editor;
+    char* text = editor->paste;
+    size_t length = 0;
+    if (!text) {
+        return;
+    }
+
+    /* Line breaks become \n and tabs spaces; other control characters are dropped */
+    for (size_t i = 0; i < editor->paste_length; i++) {
+        char c = text[i];
+        if (c == '\r') {
+            if (i + 1 < editor->paste_length && text[i + 1] == '\n') {
+                continue;
+            }
+            c = '\n';
+        } else if (c == '\t') {
+            c = ' ';
+        }
+        if (((unsigned char)c < ' ' && c != '\n') || c == 127) {
+            continue;
+        }
+        text[length++] = c;
+    }
+    text[length] = '\0';
+    editor->paste_length = 0;
+
+    /* The multi-line editor takes the text as it is */
+    if (editor->multiline.active) {
+        multiline_insert(ctx, text, length);
+        return;
+    }
+
+    char* newline = memchr(text, '\n', length);
+    if (!newline) {
+        editor_insert(editor, text, length);
+        return;
+    }
+
+    /* A trailing line break ends the last line rather than starting another */
+    char* end = text + length;
+    if (end[-1] == '\n') {
+        end--;
+    }
+    int lines = 1;
+    for (char* c = newline; c && c < end; c = memchr(c + 1, '\n', (size_t)(end - c - 1))) {
+        lines++;
+    }
+
+    /* A single line with its line break goes through the queue path like typed input */
+    if (editor->paste_handler && lines > 1) {
+        *end = '\0';
+        editor->paste_handler(ctx, text, lines, editor->paste_data);
+        return;
+    }
+
+    free(editor->queued);
+    editor->queued = newline[1] ? strdup_safe(newline + 1) : NULL;
+    editor->queued_pos = 0;
+    editor_insert(editor, text, newline - text);
+    editor_accept(ctx);
+}
+
+/*
+ * Handle key between bracketed paste markers
+ *
+ * Pasted bytes are collected without key handlers, completion or
+ * redrawing, then inserted when the end marker arrives.
+ */
+void editor_paste(smartterm_ctx* ctx, int key)
+{
+    line_editor_t* editor = &ctx->editor;
+
+    if (key == KEY_PASTE_START) {
+        if (editor->search.active) {
+            editor_search_finish(editor);
+        }
+        editor_set_candidates(editor, NULL, 0);
+        editor->completion_waiting = false;
+        editor->meta = false;
+        editor->pasting = true;
+        editor->paste_length = 0;
+        return;
+    }
+    if (key == KEY_PASTE_END) {
+        editor->pasting = false;
+        editor_paste_done(ctx);
+        return;
+    }
+
+    /* Key codes come from escape sequences inside the paste */
+    if (key < 0 || key > 255) {
+        return;
+    }
+
+    /* One byte stays free for the terminator */
+    if (editor->paste_length + 1 >= editor->paste_capacity) {
+        size_t new_capacity = editor->paste_capacity ? editor->paste_capacity * 2 : 4096;
+        char* paste = realloc(editor->paste, new_capacity);
+        if (!paste) {
+            return;
+        }
+        editor->paste = paste;
+        editor->paste_capacity = new_capacity;
+    }
+    editor->paste[editor->paste_length++] = (char)key;
+}
+
+/*
+ * Release editor storage (after history_close())
+ */
+void editor_cleanup(line_editor_t* editor)
+{
+    history_search_end(&editor->search);
+    free(editor->search.last_query);
+    free(editor->text);
+    free(editor->kill);
+    free(editor->saved);
+    free(editor->hint);
+    completion_free(editor->candidates, editor->candidate_count);
+    free(editor->paste);
+    free(editor->queued);
+    multiline_cleanup(&editor->multiline);
+    memset(editor, 0, sizeof(*editor));
+}
+
+/*
+ * Start editing a new line
+ */
+void editor_begin(smartterm_ctx* ctx, const char* prompt)
+{
+    line_editor_t* editor = &ctx->editor;
+
+    strncpy(editor->prompt, prompt, MAX_PROMPT_LENGTH - 1);
+    editor->prompt[MAX_PROMPT_LENGTH - 1] = '\0';
+
+    editor->state = editor_reserve(editor, 0) ? EDITOR_EDITING : EDITOR_EOF;
+    if (editor->state == EDITOR_EDITING) {
+        editor_set_text(editor, "");
+    }
+    editor->meta = false;
+    if (editor->search.active) {
+        editor_search_finish(editor);
+    }
+    editor->history_pos = editor->history.count;
+    free(editor->saved);
+    editor->saved = NULL;
+    editor_set_candidates(editor, NULL, 0);
+    editor->completion_waiting = false;
+
+    /* Lines left from a multi-line paste come first */
+    if (editor->queued && editor->state == EDITOR_EDITING) {
+        editor_take_queued(ctx);
+    }
+
+    editor_draw(ctx);
+    render_update(ctx);
+}
+
+/*
+ * Apply one key to the line being edited
+ */
+void editor_key(smartterm_ctx* ctx, int key)
+{
+    line_editor_t* editor = &ctx->editor;
+    if (editor->state != EDITOR_EDITING) {
+        return;
+    }
+    if (editor->multiline.active) {
+        multiline_key(ctx, key);
+        return;
+    }
+
+    if (editor->search.active && editor_search_key(editor, key)) {
+        return;
+    }
+    if (editor->meta) {
+        editor->meta = false;
+        editor_meta_key(editor, key);
+        return;
+    }
+
+    /* Typing narrows listed candidates; other keys but Tab drop them */
+    bool narrowing = editor->candidates && key >= ' ' && key < 256 && key != 127;
+    if (key != '\t') {
+        editor->completion_waiting = false;
+        if (!narrowing) {
+            editor_set_candidates(editor, NULL, 0);
+        }
+    }
+
+    switch (key) {
+    case KEY_ESCAPE:
+        editor->meta = true;
+        break;
+    case '\n':
+    case '\r':
+    case KEY_ENTER:
+        editor_accept(ctx);
+        break;
+    case CTRL_KEY('a'):
+    case KEY_HOME:
+        editor->cursor = 0;
+        break;
+    case CTRL_KEY('e'):
+    case KEY_END:
+        editor->cursor = editor->length;
+        break;
+    case CTRL_KEY('b'):
+    case KEY_LEFT:
+        editor->cursor = prev_char(editor, editor->cursor);
+        break;
+    case CTRL_KEY('f'):
+    case KEY_RIGHT:
+        editor->cursor = next_char(editor, editor->cursor);
+        break;
+    case KEY_BACKSPACE:
+    case 127:
+    case CTRL_KEY('h'):
+        editor_delete(editor, prev_char(editor, editor->cursor), editor->cursor);
+        break;
+    case CTRL_KEY('d'):
+        if (editor->length == 0) {
+            editor->state = EDITOR_EOF;
+            break;
+        }
+        editor_delete(editor, editor->cursor, next_char(editor, editor->cursor));
+        break;
+    case KEY_DC:
+        editor_delete(editor, editor->cursor, next_char(editor, editor->cursor));
+        break;
+    case CTRL_KEY('k'):
+        editor_kill(editor, editor->cursor, editor->length);
+        break;
+    case CTRL_KEY('u'):
+        editor_kill(editor, 0, editor->cursor);
+        break;
+    case CTRL_KEY('w'): {
+        /* Whitespace-delimited, as in readline */
+        size_t start = editor->cursor;
+        while (start > 0 && editor->text[start - 1] == ' ') {
+            start--;
+        }
+        while (start > 0 && editor->text[start - 1] != ' ') {
+            start--;
+        }
+        editor_kill(editor, start, editor->cursor);
+        break;
+    }
+    case CTRL_KEY('y'):
+        if (editor->kill) {
+            editor_insert(editor, editor->kill, strlen(editor->kill));
+        }
+        break;
+    case CTRL_KEY('p'):
+    case KEY_UP:
+        history_move(editor, -1);
+        break;
+    case CTRL_KEY('n'):
+    case KEY_DOWN:
+        history_move(editor, 1);
+        break;
+    case CTRL_KEY('r'):
+        editor_search_begin(editor);
+        break;
+    case '\t':
+        editor_complete(ctx);
+        break;
+    case CTRL_KEY('l'):
+        clearok(curscr, TRUE);
+        render_all(ctx);
+        break;
+    case KEY_PPAGE:
+        smartterm_scroll(ctx, render_page_rows(ctx));
+        break;
+    case KEY_NPAGE:
+        smartterm_scroll(ctx, -render_page_rows(ctx));
+        break;
+    case KEY_RESIZE:
+        smartterm_handle_resize(ctx);
+        break;
+    default:
+        /* Printable ASCII, and UTF-8 bytes as they arrive */
+        if (key >= ' ' && key < 256 && key != 127) {
+            char c = (char)key;
+            editor_insert(editor, &c, 1);
+        }
+        if (narrowing) {
+            editor_narrow_candidates(editor);
+        }
+        break;
+    }
+}
+
+/*
+ * Hand over accepted line (NULL on EOF) and clear the input row
+ */
+char* editor_take_line(smartterm_ctx* ctx)
+{
+    line_editor_t* editor = &ctx->editor;
+    char* line = NULL;
+    if (editor->state == EDITOR_ACCEPTED) {
+        line = editor->multiline.active ? multiline_text(&editor->multiline)
+                                        : strdup_safe(editor->text);
+    }
+
+    if (editor->multiline.active) {
+        multiline_end(ctx);
+    }
+    if (editor->search.active) {
+        editor_search_finish(editor);
+    }
+    editor->state = EDITOR_IDLE;
+    editor_set_candidates(editor, NULL, 0);
+    editor->completion_waiting = false;
+    editor_draw(ctx);
+    render_update(ctx);
+
+    return line;
+}
+
+/*
+ * Draw prompt, visible part of the line and hint into the input window
+ */
+void editor_draw(smartterm_ctx* ctx)
+{
+    WINDOW* win = ctx->input_win;
+    line_editor_t* editor = &ctx->editor;
+    if (!win) {
+        return;
+    }
+    if (editor->multiline.active && editor->state == EDITOR_EDITING) {
+        multiline_draw(ctx);
+        return;
+    }
+
+    werase(win);
+    if (editor->state != EDITOR_EDITING) {
+        wnoutrefresh(win);
+        return;
+    }
+
+    /* Searching replaces the prompt with the query */
+    const char* prompt = editor->prompt;
+    char search_prompt[MAX_PROMPT_LENGTH];
+    if (editor->search.active) {
+        bool failed = editor->search.length > 0 &&
+                      history_search_result(&editor->search, &editor->history, 0) < 0;
+        snprintf(search_prompt, sizeof(search_prompt), "(%sreverse-i-search)`%s': ",
+                 failed ? "failed " : "", editor->search.query);
+        prompt = search_prompt;
+    }
+
+    int width = getmaxx(win);
+    int prompt_columns = text_columns(prompt, strlen(prompt));
+    if (prompt_columns > width / 2) {
+        prompt_columns = width / 2;
+    }
+    int room = width - prompt_columns - 1;
+    if (room < 1) {
+        room = 1;
+    }
+
+    /* Scroll horizontally so the cursor stays visible */
+    if (editor->cursor < editor->scroll) {
+        editor->scroll = editor->cursor;
+    }
+    if (text_columns(editor->text + editor->scroll, editor->cursor - editor->scroll) > room) {
+        /* Step back from the cursor; stepping the start forward is quadratic on long pastes */
+        size_t start = editor->cursor;
+        for (int columns = 0; columns < room; columns++) {
+            start = prev_char(editor, start);
+        }
+        editor->scroll = start;
+    }
+
+    size_t end = editor->scroll;
+    for (int columns = 0; end < editor->length && columns < room; columns++) {
+        end = next_char(editor, end);
+    }
+
+    mvwaddnstr(win, 0, 0, prompt, -1);
+    mvwaddnstr(win, 0, prompt_columns, editor->text + editor->scroll,
+               (int)(end - editor->scroll));
+    if (editor->hint) {
+        wattron(win, A_DIM);
+        mvwaddnstr(win, 1, 0, editor->hint, width);
+        wattroff(win, A_DIM);
+    }
+
+    wmove(win, 0,
+          prompt_columns + text_columns(editor->text + editor->scroll,
+                                        editor->cursor - editor->scroll));
+    wnoutrefresh(win);
+}
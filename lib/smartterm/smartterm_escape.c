@@ -0,0 +1,259 @@
+/*
+ * SmartTerm Library - Export Escaping
+ *
+ * Finds the bytes each export format must replace and supplies their
+ * replacements. Most lines contain none, so the scan is the hot path: it
+ * tests 16 bytes per step with SSE2 where available and falls back to a
+ * byte loop elsewhere. Callers copy the clean runs in one piece.
+ *
+ *   ESCAPE_HTML  & < > "                entities
+ *   ESCAPE_JSON  " \ and 0x00-0x1f      \" \\ \n ... \u00XX
+ *                invalid UTF-8 bytes    \ufffd (one per byte)
+ *   ESCAPE_ANSI  0x00-0x1f but TAB, 0x7f caret notation (^[), as on screen
+ *
+ * For JSON the scan also stops at bytes from 0x80 up; a valid UTF-8
+ * sequence is then stepped over and the scan goes on, so only bytes that
+ * would make the output invalid JSON end the run.
+ */
+
+#include "smartterm_internal.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Check one byte (scalar path)
+ */
+static bool escape_special(escape_kind_t kind, unsigned char c)
+{
+    switch (kind) {
+    case ESCAPE_HTML:
+        return c == '&' || c == '<' || c == '>' || c == '"';
+    case ESCAPE_JSON:
+        return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+    case ESCAPE_ANSI:
+        return (c < 0x20 && c != '\t') || c == 0x7f;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Get length of valid UTF-8 sequence at s (0 if invalid or cut off)
+ *
+ * Rejects overlong forms, surrogates and code points above U+10FFFF.
+ */
+static size_t utf8_sequence(const unsigned char* s, size_t len)
+{
+    unsigned char c = s[0];
+    size_t n;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+
+    if (c >= 0xc2 && c <= 0xdf) {
+        n = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        n = 3;
+        low = c == 0xe0 ? 0xa0 : 0x80;
+        high = c == 0xed ? 0x9f : 0xbf;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        n = 4;
+        low = c == 0xf0 ? 0x90 : 0x80;
+        high = c == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+
+    if (len < n || s[1] < low || s[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < n; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+#ifdef __SSE2__
+/*
+ * Flag bytes 0x00-0x1f (unsigned v <= 0x1f, as max(v, 0x1f) == 0x1f)
+ */
+static __m128i escape_control16(__m128i v)
+{
+    __m128i limit = _mm_set1_epi8(0x1f);
+    return _mm_cmpeq_epi8(_mm_max_epu8(v, limit), limit);
+}
+
+/*
+ * Get mask of bytes needing escape in 16-byte block
+ */
+static int escape_mask16(escape_kind_t kind, __m128i v)
+{
+    __m128i hit;
+
+    switch (kind) {
+    case ESCAPE_HTML:
+        hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                                        _mm_cmpeq_epi8(v, _mm_set1_epi8('<'))),
+                           _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('>')),
+                                        _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))));
+        break;
+    case ESCAPE_JSON:
+        /* v itself flags bytes from 0x80 up, as movemask takes the top bit */
+        hit = _mm_or_si128(_mm_or_si128(escape_control16(v), v),
+                           _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+        break;
+    case ESCAPE_ANSI:
+        hit = _mm_or_si128(
+            _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), escape_control16(v)),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+        break;
+    default:
+        return 0;
+    }
+
+    return _mm_movemask_epi8(hit);
+}
+#endif
+
+/*
+ * Find first byte from i on that kind treats as special
+ */
+static size_t escape_scan(escape_kind_t kind, const char* s, size_t i, size_t len)
+{
+#ifdef __SSE2__
+    for (; i + 16 <= len; i += 16) {
+        int mask = escape_mask16(kind, _mm_loadu_si128((const __m128i*)(s + i)));
+        if (mask) {
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (escape_special(kind, (unsigned char)s[i])) {
+            return i;
+        }
+    }
+    return len;
+}
+
+/*
+ * Get length of leading run that needs no escaping
+ */
+size_t escape_span(escape_kind_t kind, const char* s, size_t len)
+{
+    size_t i = 0;
+    for (;;) {
+        i = escape_scan(kind, s, i, len);
+        if (i == len || kind != ESCAPE_JSON || (unsigned char)s[i] < 0x80) {
+            return i;
+        }
+
+        size_t n = utf8_sequence((const unsigned char*)s + i, len - i);
+        if (n == 0) {
+            return i;
+        }
+        i += n;
+    }
+}
+
+/*
+ * Copy replacement text
+ */
+static size_t escape_copy(char* out, const char* text)
+{
+    size_t len = strlen(text);
+    memcpy(out, text, len);
+    return len;
+}
+
+/*
+ * Get JSON replacement
+ */
+static size_t escape_json(unsigned char c, char* out)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    switch (c) {
+    case '"':
+        return escape_copy(out, "\\\"");
+    case '\\':
+        return escape_copy(out, "\\\\");
+    case '\b':
+        return escape_copy(out, "\\b");
+    case '\t':
+        return escape_copy(out, "\\t");
+    case '\n':
+        return escape_copy(out, "\\n");
+    case '\f':
+        return escape_copy(out, "\\f");
+    case '\r':
+        return escape_copy(out, "\\r");
+    default:
+        if (c >= 0x80) {
+            /* Byte of invalid UTF-8: U+FFFD REPLACEMENT CHARACTER */
+            return escape_copy(out, "\\ufffd");
+        }
+        memcpy(out, "\\u00", 4);
+        out[4] = hex[c >> 4];
+        out[5] = hex[c & 15];
+        return 6;
+    }
+}
+
+/*
+ * Get replacement for byte found by escape_span()
+ */
+size_t escape_sequence(escape_kind_t kind, unsigned char c, char out[ESCAPE_MAX_SEQUENCE])
+{
+    switch (kind) {
+    case ESCAPE_HTML:
+        switch (c) {
+        case '&':
+            return escape_copy(out, "&amp;");
+        case '<':
+            return escape_copy(out, "&lt;");
+        case '>':
+            return escape_copy(out, "&gt;");
+        default:
+            return escape_copy(out, "&quot;");
+        }
+    case ESCAPE_JSON:
+        return escape_json(c, out);
+    case ESCAPE_ANSI:
+        /* ^@ .. ^_, and ^? for DEL */
+        out[0] = '^';
+        out[1] = (char)(c ^ 0x40);
+        return 2;
+    default:
+        out[0] = (char)c;
+        return 1;
+    }
+}
+
+/*
+ * Get exact length of s once escaped
+ */
+size_t escape_length(escape_kind_t kind, const char* s, size_t len)
+{
+    char sequence[ESCAPE_MAX_SEQUENCE];
+    size_t total = 0;
+
+    while (len > 0) {
+        size_t run = escape_span(kind, s, len);
+        total += run;
+        if (run == len) {
+            break;
+        }
+        total += escape_sequence(kind, (unsigned char)s[run], sequence);
+        s += run + 1;
+        len -= run + 1;
+    }
+
+    return total;
+}
@@ -2,13 +2,236 @@
  * SmartTerm Library - Export Implementation
  *
  * Export output buffer to various formats.
+ *
+ * Every format is produced by one emitter that appends to an export
+ * writer. A writer either streams fixed-size chunks to a file descriptor
+ * (memory stays constant regardless of range size) or grows a string for
+ * smartterm_export_string().
  */
 
 #include "smartterm_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
+
+/* Bytes formatted before each write to the file descriptor */
+#define EXPORT_CHUNK_SIZE (64 * 1024)
+
+/* Lines per parallel chunk (a whole number of cold blocks) */
+#define EXPORT_PARALLEL_LINES (64 * COLD_BLOCK_LINES)
+
+/* Upper bound on formatting threads */
+#define EXPORT_MAX_WORKERS 8
+
+/*
+ * Export writer
+ */
+typedef struct {
+    char* data;                /* Chunk, or whole output for string export */
+    size_t used;               /* Bytes pending in data */
+    size_t capacity;           /* Size of data */
+    int fd;                    /* Destination (-1 = grow data into a string) */
+    int result;                /* First error, sticky */
+    time_format_cache_t clock; /* Timestamp formatter */
+    cold_cache_entry_t* cold;  /* Private cold block (NULL = shared cache) */
+    bool measure;              /* Only count bytes into used */
+    int fence;                 /* Markdown code fence length */
+} export_writer_t;
+
+/*
+ * Write all bytes of iovec array, retrying short writes
+ */
+static int export_writev(int fd, struct iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return SMARTTERM_IOERROR;
+        }
+
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Write pending chunk, followed by extra bytes that bypass the chunk
+ */
+static void writer_flush(export_writer_t* w, const char* extra, size_t extra_len)
+{
+    struct iovec iov[] = {
+        {.iov_base = w->data, .iov_len = w->used},
+        {.iov_base = (void*)extra, .iov_len = extra_len},
+    };
+
+    if (w->result == SMARTTERM_OK) {
+        w->result = export_writev(w->fd, iov, extra_len > 0 ? 2 : 1);
+    }
+    w->used = 0;
+}
+
+/*
+ * Grow string output to hold len more bytes and a terminator
+ */
+static bool writer_grow(export_writer_t* w, size_t len)
+{
+    if (w->used + len < w->capacity) {
+        return true;
+    }
+
+    size_t new_capacity = w->capacity;
+    while (new_capacity < w->used + len + 1) {
+        new_capacity = new_capacity ? new_capacity * 2 : EXPORT_CHUNK_SIZE;
+    }
+
+    char* data = realloc(w->data, new_capacity);
+    if (!data) {
+        w->result = SMARTTERM_NOMEM;
+        return false;
+    }
+
+    w->data = data;
+    w->capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Append bytes to writer
+ */
+static void writer_put(export_writer_t* w, const char* data, size_t len)
+{
+    if (w->result != SMARTTERM_OK) {
+        return;
+    }
+    if (w->measure) {
+        w->used += len;
+        return;
+    }
+
+    if (w->used + len > w->capacity) {
+        if (w->fd < 0) {
+            if (!writer_grow(w, len)) {
+                return;
+            }
+        } else if (len >= w->capacity) {
+            /* Long line: write it straight from the buffer */
+            writer_flush(w, data, len);
+            return;
+        } else {
+            writer_flush(w, NULL, 0);
+        }
+    }
+
+    memcpy(w->data + w->used, data, len);
+    w->used += len;
+}
+
+/*
+ * Append string to writer
+ */
+static void writer_puts(export_writer_t* w, const char* s)
+{
+    writer_put(w, s, strlen(s));
+}
+
+/*
+ * Append zero bytes (binary alignment padding)
+ */
+static void writer_pad(export_writer_t* w, uint64_t len)
+{
+    static const char zeros[8];
+    while (len > 0) {
+        size_t n = len < sizeof(zeros) ? (size_t)len : sizeof(zeros);
+        writer_put(w, zeros, n);
+        len -= n;
+    }
+}
+
+/*
+ * Append decimal integer
+ */
+static void writer_int(export_writer_t* w, long value)
+{
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+
+    do {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+
+    writer_put(w, p, digits + sizeof(digits) - p);
+}
+
+/*
+ * Append string with the bytes special to kind escaped
+ */
+static void writer_escaped(export_writer_t* w, escape_kind_t kind, const char* s)
+{
+    size_t len = strlen(s);
+    if (w->measure) {
+        w->used += escape_length(kind, s, len);
+        return;
+    }
+
+    while (len > 0) {
+        size_t run = escape_span(kind, s, len);
+        writer_put(w, s, run);
+        if (run == len) {
+            break;
+        }
+
+        char sequence[ESCAPE_MAX_SEQUENCE];
+        writer_put(w, sequence, escape_sequence(kind, (unsigned char)s[run], sequence));
+        s += run + 1;
+        len -= run + 1;
+    }
+}
+
+/*
+ * Append markdown code fence line
+ */
+static void writer_fence(export_writer_t* w)
+{
+    static const char backticks[] = "````````````````";
+    int fence = w->fence > 3 ? w->fence : 3;
+
+    for (int left = fence; left > 0; left -= (int)sizeof(backticks) - 1) {
+        int n = left < (int)sizeof(backticks) - 1 ? left : (int)sizeof(backticks) - 1;
+        writer_put(w, backticks, n);
+    }
+    writer_puts(w, "\n");
+}
+
+/*
+ * Append formatted time ("YYYY-MM-DD HH:MM:SS")
+ */
+static void writer_time(export_writer_t* w, long timestamp)
+{
+    writer_puts(w, time_format(&w->clock, timestamp));
+}
 
 /*
  * Get ANSI color code for context
@@ -40,233 +263,560 @@ static const char* get_ansi_color(smartterm_context_t context)
 }
 
 /*
- * Export to plain text format
+ * Get HTML class for context ("" = unstyled)
  */
-static char* export_plain(smartterm_ctx* ctx, int start_line, int end_line, bool include_meta)
+static const char* get_css_class(smartterm_context_t context)
 {
-    pthread_mutex_lock(&ctx->buffer.mutex);
+    switch (context) {
+    case CTX_ERROR:
+        return "error";
+    case CTX_WARNING:
+        return "warning";
+    case CTX_SUCCESS:
+        return "success";
+    case CTX_INFO:
+        return "info";
+    default:
+        return "";
+    }
+}
+
+/*
+ * Emit document prologue (markdown and HTML)
+ */
+static void export_header(export_writer_t* w, smartterm_export_format_t format, int start_line,
+                          int end_line, bool include_meta)
+{
+    switch (format) {
+    case EXPORT_MARKDOWN:
+        writer_puts(w, "# SmartTerm Export\n\n");
 
-    /* Calculate buffer size */
-    size_t buffer_size = 0;
-    for (int i = start_line; i <= end_line; i++) {
-        buffer_size += strlen(ctx->buffer.lines[i].text) + 1; /* Text + newline */
         if (include_meta) {
-            /* Timestamp format: "[YYYY-MM-DD HH:MM:SS] " = 23 chars */
-            buffer_size += 25; /* Timestamp with some margin */
+            char range[64];
+            int len =
+                snprintf(range, sizeof(range), "\n\n**Lines**: %d-%d\n\n", start_line, end_line);
+            writer_puts(w, "**Export Date**: ");
+            writer_time(w, time(NULL));
+            writer_put(w, range, len);
         }
-    }
-    buffer_size += 1; /* Null terminator */
 
-    char* output = malloc(buffer_size);
-    if (!output) {
-        pthread_mutex_unlock(&ctx->buffer.mutex);
-        return NULL;
+        writer_puts(w, "## Output\n\n");
+        writer_fence(w);
+        break;
+    case EXPORT_HTML:
+        writer_puts(w, "<!DOCTYPE html>\n<html>\n<head>\n"
+                       "<title>SmartTerm Export</title>\n"
+                       "<style>\n"
+                       "body { background: #000; color: #fff; font-family: monospace; }\n"
+                       ".error { color: #f00; font-weight: bold; }\n"
+                       ".warning { color: #ff0; font-weight: bold; }\n"
+                       ".success { color: #0f0; font-weight: bold; }\n"
+                       ".info { color: #0ff; font-weight: bold; }\n"
+                       ".meta { color: #888; font-size: 0.9em; }\n"
+                       "</style>\n</head>\n<body>\n<pre>\n");
+        break;
+    default:
+        break;
     }
+}
 
-    char* ptr = output;
-    for (int i = start_line; i <= end_line; i++) {
+/*
+ * Emit one line from its fields (tag NULL = untagged)
+ */
+static void export_fields(export_writer_t* w, smartterm_export_format_t format, const char* text,
+                          smartterm_context_t context, long timestamp, const char* tag,
+                          bool include_meta)
+{
+    switch (format) {
+    case EXPORT_PLAIN:
         if (include_meta) {
-            struct tm* tm_info = localtime(&ctx->buffer.lines[i].meta.timestamp);
-            char time_str[20];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-            ptr += sprintf(ptr, "[%s] ", time_str);
+            writer_puts(w, "[");
+            writer_time(w, timestamp);
+            writer_puts(w, "] ");
+        }
+        writer_puts(w, text);
+        writer_puts(w, "\n");
+        break;
+    case EXPORT_ANSI:
+        if (include_meta) {
+            writer_puts(w, "\033[2m[");
+            writer_time(w, timestamp);
+            writer_puts(w, "]\033[0m ");
+        }
+        writer_puts(w, get_ansi_color(context));
+        writer_escaped(w, ESCAPE_ANSI, text);
+        writer_puts(w, "\033[0m\n");
+        break;
+    case EXPORT_MARKDOWN:
+        writer_puts(w, text);
+        writer_puts(w, "\n");
+        break;
+    case EXPORT_JSONL:
+        writer_puts(w, "{\"context\":");
+        writer_int(w, context);
+        writer_puts(w, ",\"timestamp\":");
+        writer_int(w, timestamp);
+        if (tag) {
+            writer_puts(w, ",\"tag\":\"");
+            writer_escaped(w, ESCAPE_JSON, tag);
+            writer_puts(w, "\",\"text\":\"");
+        } else {
+            writer_puts(w, ",\"tag\":null,\"text\":\"");
+        }
+        writer_escaped(w, ESCAPE_JSON, text);
+        writer_puts(w, "\"}\n");
+        break;
+    case EXPORT_HTML: {
+        const char* css_class = get_css_class(context);
+
+        if (include_meta) {
+            writer_puts(w, "<span class=\"meta\">[");
+            writer_time(w, timestamp);
+            writer_puts(w, "]</span> ");
         }
 
-        ptr += sprintf(ptr, "%s\n", ctx->buffer.lines[i].text);
+        if (css_class[0]) {
+            writer_puts(w, "<span class=\"");
+            writer_puts(w, css_class);
+            writer_puts(w, "\">");
+            writer_escaped(w, ESCAPE_HTML, text);
+            writer_puts(w, "</span>\n");
+        } else {
+            writer_escaped(w, ESCAPE_HTML, text);
+            writer_puts(w, "\n");
+        }
+        break;
     }
+    default:
+        break;
+    }
+}
 
-    pthread_mutex_unlock(&ctx->buffer.mutex);
-    return output;
+/*
+ * Emit one line (buffer mutex held)
+ */
+static void export_line(output_buffer_t* buf, export_writer_t* w, smartterm_export_format_t format,
+                        int index, bool include_meta)
+{
+    const char* text = w->cold ? buffer_text_private(buf, index, w->cold) : buffer_text(buf, index);
+    int tag_id = buffer_tag_id(buf, index);
+
+    export_fields(w, format, text, buffer_context(buf, index), buffer_timestamp(buf, index),
+                  tag_id ? tag_table_name(&buf->tags, tag_id) : NULL, include_meta);
 }
 
 /*
- * Export to ANSI format
+ * Emit document epilogue (markdown and HTML)
  */
-static char* export_ansi(smartterm_ctx* ctx, int start_line, int end_line, bool include_meta)
+static void export_footer(export_writer_t* w, smartterm_export_format_t format)
 {
-    pthread_mutex_lock(&ctx->buffer.mutex);
+    switch (format) {
+    case EXPORT_MARKDOWN:
+        writer_fence(w);
+        break;
+    case EXPORT_HTML:
+        writer_puts(w, "</pre>\n</body>\n</html>\n");
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Emit lines as a session file image (buffer mutex held)
+ *
+ * Sections go out in file order with their alignment padding, so the
+ * image streams to pipes as well as files.
+ */
+static void export_binary(output_buffer_t* buf, export_writer_t* w, int start_line, int end_line)
+{
+    session_columns_t columns;
+    int count = end_line - start_line + 1;
+    int result = session_columns_build(&columns, buf, start_line, count);
+    if (result != SMARTTERM_OK) {
+        w->result = result;
+        return;
+    }
+
+    const segment_header_t* header = &columns.header;
+    writer_put(w, (const char*)header, sizeof(*header));
+    writer_pad(w, header->offsets_at - sizeof(*header));
+    writer_put(w, (const char*)columns.offsets, count * sizeof(uint64_t));
+    writer_put(w, (const char*)columns.ts_deltas, count * sizeof(int32_t));
+    writer_put(w, (const char*)columns.tag_ids, count * sizeof(uint16_t));
+    writer_put(w, (const char*)columns.contexts, count * sizeof(uint8_t));
+    writer_pad(w, header->text_at - (header->contexts_at + count));
 
-    /* Calculate buffer size (ANSI codes add ~10-20 chars per line) */
-    size_t buffer_size = 0;
     for (int i = start_line; i <= end_line; i++) {
-        buffer_size += strlen(ctx->buffer.lines[i].text) + 50;
-        if (include_meta) {
-            buffer_size += 50;
-        }
+        const char* text = buffer_text(buf, i);
+        writer_put(w, text, strlen(text) + 1);
     }
-    buffer_size += 1;
+    writer_pad(w, header->tags_at - (header->text_at + header->text_size));
 
-    char* output = malloc(buffer_size);
-    if (!output) {
-        pthread_mutex_unlock(&ctx->buffer.mutex);
-        return NULL;
+    for (uint32_t id = 1; id <= header->tag_count; id++) {
+        const char* name = tag_table_name(&buf->tags, (int)id);
+        writer_put(w, name, strlen(name) + 1);
     }
 
-    char* ptr = output;
-    for (int i = start_line; i <= end_line; i++) {
-        if (include_meta) {
-            struct tm* tm_info = localtime(&ctx->buffer.lines[i].meta.timestamp);
-            char time_str[20];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-            ptr += sprintf(ptr, "\033[2m[%s]\033[0m ", time_str);
+    session_columns_free(&columns);
+}
+
+/*
+ * Check export format
+ */
+static bool export_format_valid(smartterm_export_format_t format)
+{
+    return format >= EXPORT_PLAIN && format <= EXPORT_BINARY;
+}
+
+/*
+ * Clamp line range to buffer (false if empty)
+ */
+static bool export_range(const output_buffer_t* buf, int* start_line, int* end_line)
+{
+    if (*start_line < 0) {
+        *start_line = 0;
+    }
+    if (*end_line < 0 || *end_line >= buf->count) {
+        *end_line = buf->count - 1;
+    }
+    return *start_line <= *end_line;
+}
+
+/*
+ * Chunk of a parallel export
+ */
+typedef struct {
+    export_writer_t w; /* Formatted chunk */
+    bool done;         /* Ready to be written */
+} export_slot_t;
+
+/*
+ * Parallel export state
+ *
+ * Workers claim chunks in order and format them into slots; the calling
+ * thread writes finished slots in order. A chunk is only claimed while
+ * it is fewer than slot_count chunks ahead of the writer, which bounds
+ * memory to slot_count formatted chunks.
+ */
+typedef struct {
+    output_buffer_t* buf;
+    smartterm_export_format_t format;
+    bool include_meta;
+    int start_line;
+    int end_line;
+    int chunk_count;
+    export_slot_t* slots;
+    int slot_count;
+    int next_chunk; /* Next chunk to claim */
+    int written;    /* Chunks written so far */
+    bool stop;      /* Writer failed */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} export_pool_t;
+
+/*
+ * Worker: format claimed chunks until none are left
+ */
+static void* export_worker(void* arg)
+{
+    export_pool_t* pool = arg;
+    cold_cache_entry_t cold = {0};
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->next_chunk < pool->chunk_count &&
+               pool->next_chunk >= pool->written + pool->slot_count) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if (pool->stop || pool->next_chunk >= pool->chunk_count) {
+            break;
+        }
+
+        int chunk = pool->next_chunk++;
+        export_slot_t* slot = &pool->slots[chunk % pool->slot_count];
+        pthread_mutex_unlock(&pool->lock);
+
+        int first = pool->start_line + chunk * EXPORT_PARALLEL_LINES;
+        int last = first + EXPORT_PARALLEL_LINES - 1;
+        if (last > pool->end_line) {
+            last = pool->end_line;
+        }
+
+        slot->w.cold = &cold;
+        for (int i = first; i <= last; i++) {
+            export_line(pool->buf, &slot->w, pool->format, i, pool->include_meta);
         }
 
-        const char* color = get_ansi_color(ctx->buffer.lines[i].meta.context);
-        ptr += sprintf(ptr, "%s%s\033[0m\n", color, ctx->buffer.lines[i].text);
+        pthread_mutex_lock(&pool->lock);
+        slot->done = true;
+        pthread_cond_broadcast(&pool->cond);
     }
+    pthread_mutex_unlock(&pool->lock);
 
-    pthread_mutex_unlock(&ctx->buffer.mutex);
-    return output;
+    free(cold.text);
+    return NULL;
 }
 
 /*
- * Export to markdown format
+ * Format lines on worker threads and write them in order (buffer mutex held)
+ *
+ * Returns false, having written nothing, if no worker could be started.
  */
-static char* export_markdown(smartterm_ctx* ctx, int start_line, int end_line, bool include_meta)
+static bool export_parallel(output_buffer_t* buf, export_writer_t* w,
+                            smartterm_export_format_t format, int start_line, int end_line,
+                            bool include_meta)
 {
-    pthread_mutex_lock(&ctx->buffer.mutex);
-
-    /* Calculate buffer size */
-    size_t buffer_size = 500; /* Header */
-    for (int i = start_line; i <= end_line; i++) {
-        buffer_size += strlen(ctx->buffer.lines[i].text) + 100;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int worker_count = cpus > EXPORT_MAX_WORKERS ? EXPORT_MAX_WORKERS : (int)cpus;
+    int lines = end_line - start_line + 1;
+    if (worker_count < 2 || lines < 2 * EXPORT_PARALLEL_LINES) {
+        return false;
     }
 
-    char* output = malloc(buffer_size);
-    if (!output) {
-        pthread_mutex_unlock(&ctx->buffer.mutex);
-        return NULL;
+    export_pool_t pool = {
+        .buf = buf,
+        .format = format,
+        .include_meta = include_meta,
+        .start_line = start_line,
+        .end_line = end_line,
+        .chunk_count = (lines + EXPORT_PARALLEL_LINES - 1) / EXPORT_PARALLEL_LINES,
+        .slot_count = 2 * worker_count,
+    };
+    pthread_t workers[EXPORT_MAX_WORKERS];
+
+    pool.slots = calloc(pool.slot_count, sizeof(export_slot_t));
+    if (!pool.slots) {
+        return false;
+    }
+    for (int i = 0; i < pool.slot_count; i++) {
+        pool.slots[i].w.fd = -1;
+        pool.slots[i].w.result = SMARTTERM_OK;
+        time_format_init(&pool.slots[i].w.clock);
     }
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
 
-    char* ptr = output;
-    ptr += sprintf(ptr, "# SmartTerm Export\n\n");
+    int started = 0;
+    while (started < worker_count &&
+           pthread_create(&workers[started], NULL, export_worker, &pool) == 0) {
+        started++;
+    }
 
-    if (include_meta) {
-        time_t now = time(NULL);
-        struct tm* tm_info = localtime(&now);
-        char time_str[20];
-        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-        ptr += sprintf(ptr, "**Export Date**: %s\n\n", time_str);
-        ptr += sprintf(ptr, "**Lines**: %d-%d\n\n", start_line, end_line);
+    /* Header goes out before the first chunk */
+    if (started > 0) {
+        writer_flush(w, NULL, 0);
     }
 
-    ptr += sprintf(ptr, "## Output\n\n```\n");
+    for (int chunk = 0; started > 0 && chunk < pool.chunk_count; chunk++) {
+        export_slot_t* slot = &pool.slots[chunk % pool.slot_count];
 
-    for (int i = start_line; i <= end_line; i++) {
-        ptr += sprintf(ptr, "%s\n", ctx->buffer.lines[i].text);
+        pthread_mutex_lock(&pool.lock);
+        while (!slot->done) {
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+
+        /* Write while the workers format the chunks after this one */
+        if (w->result == SMARTTERM_OK) {
+            w->result = slot->w.result;
+        }
+        if (w->result == SMARTTERM_OK) {
+            struct iovec iov = {.iov_base = slot->w.data, .iov_len = slot->w.used};
+            w->result = export_writev(w->fd, &iov, 1);
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        slot->done = false;
+        slot->w.used = 0;
+        pool.written++;
+        pool.stop = w->result != SMARTTERM_OK;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.lock);
+
+        if (pool.stop) {
+            break;
+        }
     }
 
-    ptr += sprintf(ptr, "```\n");
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    for (int i = 0; i < pool.slot_count; i++) {
+        free(pool.slots[i].w.data);
+    }
+    free(pool.slots);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
 
-    pthread_mutex_unlock(&ctx->buffer.mutex);
-    return output;
+    return started > 0;
 }
 
 /*
- * Export to HTML format
+ * Get code fence length that no line in range can close (buffer mutex held)
+ *
+ * Markdown has no escapes inside a fenced block, but a fence is only
+ * closed by a line of at least as many backticks (after up to 3 spaces),
+ * so the fence is made one longer than the longest such run.
  */
-static char* export_html(smartterm_ctx* ctx, int start_line, int end_line, bool include_meta)
+static int export_fence(output_buffer_t* buf, int start_line, int end_line)
 {
-    pthread_mutex_lock(&ctx->buffer.mutex);
+    int fence = 3;
 
-    /* Calculate buffer size */
-    size_t buffer_size = 1000; /* HTML wrapper */
     for (int i = start_line; i <= end_line; i++) {
-        buffer_size += strlen(ctx->buffer.lines[i].text) + 200;
-    }
+        const char* p = buffer_text(buf, i);
+        for (int spaces = 0; spaces < 3 && *p == ' '; spaces++) {
+            p++;
+        }
 
-    char* output = malloc(buffer_size);
-    if (!output) {
-        pthread_mutex_unlock(&ctx->buffer.mutex);
-        return NULL;
+        int run = 0;
+        while (p[run] == '`') {
+            run++;
+        }
+        if (run >= fence) {
+            fence = run + 1;
+        }
     }
 
-    char* ptr = output;
-    ptr += sprintf(ptr, "<!DOCTYPE html>\n<html>\n<head>\n");
-    ptr += sprintf(ptr, "<title>SmartTerm Export</title>\n");
-    ptr += sprintf(ptr, "<style>\n");
-    ptr += sprintf(ptr, "body { background: #000; color: #fff; font-family: monospace; }\n");
-    ptr += sprintf(ptr, ".error { color: #f00; font-weight: bold; }\n");
-    ptr += sprintf(ptr, ".warning { color: #ff0; font-weight: bold; }\n");
-    ptr += sprintf(ptr, ".success { color: #0f0; font-weight: bold; }\n");
-    ptr += sprintf(ptr, ".info { color: #0ff; font-weight: bold; }\n");
-    ptr += sprintf(ptr, ".meta { color: #888; font-size: 0.9em; }\n");
-    ptr += sprintf(ptr, "</style>\n</head>\n<body>\n<pre>\n");
+    return fence;
+}
 
-    for (int i = start_line; i <= end_line; i++) {
-        const char* css_class = "";
-        switch (ctx->buffer.lines[i].meta.context) {
-        case CTX_ERROR:
-            css_class = "error";
-            break;
-        case CTX_WARNING:
-            css_class = "warning";
-            break;
-        case CTX_SUCCESS:
-            css_class = "success";
-            break;
-        case CTX_INFO:
-            css_class = "info";
-            break;
-        default:
-            break;
-        }
+/*
+ * Emit normalized range in format (buffer mutex held)
+ */
+static int export_emit_locked(output_buffer_t* buf, export_writer_t* w,
+                              smartterm_export_format_t format, int start_line, int end_line,
+                              bool include_meta)
+{
+    if (format == EXPORT_BINARY) {
+        export_binary(buf, w, start_line, end_line);
+        return w->result;
+    }
+    if (format == EXPORT_MARKDOWN) {
+        w->fence = export_fence(buf, start_line, end_line);
+    }
 
-        if (include_meta) {
-            struct tm* tm_info = localtime(&ctx->buffer.lines[i].meta.timestamp);
-            char time_str[20];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-            ptr += sprintf(ptr, "<span class=\"meta\">[%s]</span> ", time_str);
+    export_header(w, format, start_line, end_line, include_meta);
+    if (w->fd < 0 || !export_parallel(buf, w, format, start_line, end_line, include_meta)) {
+        for (int i = start_line; i <= end_line; i++) {
+            export_line(buf, w, format, i, include_meta);
         }
+    }
+    export_footer(w, format);
 
-        if (css_class[0]) {
-            ptr += sprintf(ptr, "<span class=\"%s\">%s</span>\n", css_class,
-                           ctx->buffer.lines[i].text);
-        } else {
-            ptr += sprintf(ptr, "%s\n", ctx->buffer.lines[i].text);
-        }
+    return w->result;
+}
+
+/*
+ * Normalize range and emit it in format (takes the buffer mutex)
+ */
+static int export_emit(smartterm_ctx* ctx, export_writer_t* w, smartterm_export_format_t format,
+                       int start_line, int end_line, bool include_meta)
+{
+    if (!export_format_valid(format)) {
+        return SMARTTERM_INVALID;
     }
 
-    ptr += sprintf(ptr, "</pre>\n</body>\n</html>\n");
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
 
-    pthread_mutex_unlock(&ctx->buffer.mutex);
-    return output;
+    int result = SMARTTERM_ERROR;
+    if (export_range(buf, &start_line, &end_line)) {
+        result = export_emit_locked(buf, w, format, start_line, end_line, include_meta);
+    }
+
+    pthread_mutex_unlock(&buf->mutex);
+    return result;
 }
 
 /*
  * Export output buffer to string
+ *
+ * A measuring pass sizes the output exactly, so the string is allocated
+ * once and never copied.
  */
 char* smartterm_export_string(smartterm_ctx* ctx, smartterm_export_format_t format, int start_line,
                               int end_line, bool include_meta)
 {
-    if (!ctx || !ctx->initialized) {
+    /* Binary images contain NUL bytes */
+    if (!ctx || !ctx->initialized || !export_format_valid(format) || format == EXPORT_BINARY) {
         return NULL;
     }
 
-    /* Normalize line range */
-    if (start_line < 0) {
-        start_line = 0;
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    if (!export_range(buf, &start_line, &end_line)) {
+        pthread_mutex_unlock(&buf->mutex);
+        return NULL;
     }
-    if (end_line < 0 || end_line >= ctx->buffer.count) {
-        end_line = ctx->buffer.count - 1;
+
+    export_writer_t w = {.fd = -1, .result = SMARTTERM_OK, .measure = true};
+    char* output = NULL;
+    if (export_emit_locked(buf, &w, format, start_line, end_line, include_meta) == SMARTTERM_OK) {
+        output = malloc(w.used + 1);
     }
-    if (start_line > end_line) {
-        return NULL;
+
+    if (output) {
+        w = (export_writer_t){.data = output, .capacity = w.used + 1, .fd = -1};
+        if (export_emit_locked(buf, &w, format, start_line, end_line, include_meta) !=
+            SMARTTERM_OK) {
+            free(w.data);
+            output = NULL;
+        } else {
+            output = w.data;
+            output[w.used] = '\0';
+        }
     }
 
-    /* Export based on format */
-    switch (format) {
-    case EXPORT_PLAIN:
-        return export_plain(ctx, start_line, end_line, include_meta);
-    case EXPORT_ANSI:
-        return export_ansi(ctx, start_line, end_line, include_meta);
-    case EXPORT_MARKDOWN:
-        return export_markdown(ctx, start_line, end_line, include_meta);
-    case EXPORT_HTML:
-        return export_html(ctx, start_line, end_line, include_meta);
-    default:
-        return NULL;
+    pthread_mutex_unlock(&buf->mutex);
+    return output;
+}
+
+/*
+ * Export output buffer to file descriptor
+ */
+int smartterm_export_fd(smartterm_ctx* ctx, int fd, smartterm_export_format_t format,
+                        int start_line, int end_line, bool include_meta)
+{
+    if (!ctx || !ctx->initialized || fd < 0) {
+        return SMARTTERM_INVALID;
+    }
+
+    export_writer_t w = {.fd = fd, .result = SMARTTERM_OK};
+    w.data = malloc(EXPORT_CHUNK_SIZE);
+    if (!w.data) {
+        return SMARTTERM_NOMEM;
+    }
+    w.capacity = EXPORT_CHUNK_SIZE;
+
+    int result = export_emit(ctx, &w, format, start_line, end_line, include_meta);
+    if (result == SMARTTERM_OK && w.used > 0) {
+        writer_flush(&w, NULL, 0);
+        result = w.result;
     }
+
+    free(w.data);
+    return result;
+}
+
+/*
+ * Export output buffer to stdio stream
+ */
+int smartterm_export_file(smartterm_ctx* ctx, FILE* file, smartterm_export_format_t format,
+                          int start_line, int end_line, bool include_meta)
+{
+    if (!file) {
+        return SMARTTERM_INVALID;
+    }
+
+    /* Keep earlier buffered output ahead of the export */
+    int fd = fileno(file);
+    if (fd < 0 || fflush(file) != 0) {
+        return SMARTTERM_IOERROR;
+    }
+
+    return smartterm_export_fd(ctx, fd, format, start_line, end_line, include_meta);
 }
 
 /*
@@ -279,22 +829,378 @@ int smartterm_export(smartterm_ctx* ctx, const char* filename, smartterm_export_
         return SMARTTERM_INVALID;
     }
 
-    /* Export to string */
-    char* content = smartterm_export_string(ctx, format, start_line, end_line, include_meta);
-    if (!content) {
-        return SMARTTERM_ERROR;
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return SMARTTERM_IOERROR;
     }
 
-    /* Write to file */
-    FILE* f = fopen(filename, "w");
-    if (!f) {
-        free(content);
-        return SMARTTERM_IOERROR;
+    int result = smartterm_export_fd(ctx, fd, format, start_line, end_line, include_meta);
+    if (close(fd) != 0 && result == SMARTTERM_OK) {
+        result = SMARTTERM_IOERROR;
+    }
+
+    return result;
+}
+
+/*
+ * Background export job
+ */
+struct smartterm_export_job {
+    smartterm_ctx* ctx;                    /* Owning context */
+    pthread_t thread;                      /* Export thread */
+    int fd;                                /* Output file */
+    smartterm_export_format_t format;      /* Export format */
+    bool include_meta;                     /* Include metadata */
+    int start_line;                        /* Range as numbered at start */
+    int end_line;                          /* (markdown header) */
+    unsigned long start_seq;               /* First line to export */
+    unsigned long end_seq;                 /* Line after the last one */
+    smartterm_export_progress_fn progress; /* Progress callback */
+    void* data;                            /* User data for callback */
+    bool cancelled;                        /* Set under buffer mutex */
+    struct smartterm_export_job* next;     /* Context job list */
+};
+
+/*
+ * Report progress to the application (buffer mutex not held)
+ */
+static void export_job_report(smartterm_export_job* job, unsigned long seq, bool finished,
+                              int result)
+{
+    if (!job->progress) {
+        return;
+    }
+
+    smartterm_export_progress_t progress = {
+        .lines_done = (int)(seq - job->start_seq),
+        .lines_total = (int)(job->end_seq - job->start_seq),
+        .finished = finished,
+        .result = result,
+    };
+    job->progress(job->ctx, &progress, job->data);
+}
+
+/*
+ * Format batch of lines starting at *seq (buffer mutex held)
+ *
+ * Lines evicted since the job started are skipped. Batches end at the
+ * chunk size or after one cold block, so the mutex is held briefly.
+ */
+static void export_job_batch(smartterm_export_job* job, export_writer_t* w, unsigned long* seq)
+{
+    output_buffer_t* buf = &job->ctx->buffer;
+
+    if (*seq < buf->base_seq) {
+        *seq = buf->base_seq;
+    }
+
+    unsigned long end_seq = buf->base_seq + buf->count;
+    if (end_seq > job->end_seq) {
+        end_seq = job->end_seq;
+    }
+
+    for (int n = 0; *seq < end_seq && n < COLD_BLOCK_LINES && w->used < EXPORT_CHUNK_SIZE; n++) {
+        export_line(buf, w, job->format, (int)(*seq - buf->base_seq), job->include_meta);
+        (*seq)++;
+    }
+
+    /* Nothing left in the buffer to export */
+    if (*seq < job->end_seq && *seq >= buf->base_seq + buf->count) {
+        *seq = job->end_seq;
+    }
+}
+
+/*
+ * Scan job range for the markdown fence, one batch per lock hold
+ */
+static int export_job_fence(smartterm_export_job* job)
+{
+    output_buffer_t* buf = &job->ctx->buffer;
+    unsigned long seq = job->start_seq;
+    int fence = 3;
+
+    while (seq < job->end_seq) {
+        pthread_mutex_lock(&buf->mutex);
+        if (seq < buf->base_seq) {
+            seq = buf->base_seq;
+        }
+
+        unsigned long end_seq = buf->base_seq + buf->count;
+        if (end_seq > job->end_seq) {
+            end_seq = job->end_seq;
+        }
+        if (end_seq > seq + EXPORT_PARALLEL_LINES) {
+            end_seq = seq + EXPORT_PARALLEL_LINES;
+        }
+
+        /* Cancelled, or the rest of the range has been evicted */
+        bool done = job->cancelled || seq >= end_seq;
+        if (!done) {
+            int start = (int)(seq - buf->base_seq);
+            int batch_fence = export_fence(buf, start, start + (int)(end_seq - seq) - 1);
+            fence = batch_fence > fence ? batch_fence : fence;
+            seq = end_seq;
+        }
+        pthread_mutex_unlock(&buf->mutex);
+
+        if (done) {
+            break;
+        }
+    }
+
+    return fence;
+}
+
+/*
+ * Write formatted bytes outside the lock
+ */
+static void export_job_write(smartterm_export_job* job, export_writer_t* w)
+{
+    struct iovec iov = {.iov_base = w->data, .iov_len = w->used};
+    if (w->result == SMARTTERM_OK && w->used > 0) {
+        w->result = export_writev(job->fd, &iov, 1);
+    }
+    w->used = 0;
+}
+
+/*
+ * Export thread: format under short lock holds, write without the lock
+ */
+static void* export_job_run(void* arg)
+{
+    smartterm_export_job* job = arg;
+    output_buffer_t* buf = &job->ctx->buffer;
+    export_writer_t w = {.fd = -1, .result = SMARTTERM_OK};
+    unsigned long seq = job->start_seq;
+    bool cancelled = false;
+
+    if (job->format == EXPORT_MARKDOWN) {
+        w.fence = export_job_fence(job);
+    }
+    export_header(&w, job->format, job->start_line, job->end_line, job->include_meta);
+
+    while (w.result == SMARTTERM_OK) {
+        pthread_mutex_lock(&buf->mutex);
+        cancelled = job->cancelled;
+        if (!cancelled) {
+            export_job_batch(job, &w, &seq);
+        }
+        pthread_mutex_unlock(&buf->mutex);
+
+        if (cancelled || seq == job->end_seq) {
+            break;
+        }
+
+        export_job_write(job, &w);
+        export_job_report(job, seq, false, SMARTTERM_OK);
+    }
+
+    if (!cancelled) {
+        export_footer(&w, job->format);
+        export_job_write(job, &w);
+    }
+
+    int result = cancelled ? SMARTTERM_CANCELLED : w.result;
+    if (close(job->fd) != 0 && result == SMARTTERM_OK) {
+        result = SMARTTERM_IOERROR;
+    }
+    free(w.data);
+
+    export_job_report(job, seq, true, result);
+    return (void*)(intptr_t)result;
+}
+
+/*
+ * Start exporting output buffer to file in the background
+ */
+smartterm_export_job* smartterm_export_async(smartterm_ctx* ctx, const char* filename,
+                                             smartterm_export_format_t format, int start_line,
+                                             int end_line, bool include_meta,
+                                             smartterm_export_progress_fn progress, void* data)
+{
+    /* Binary images need every line's offset before the first line is written */
+    if (!ctx || !ctx->initialized || !filename || !export_format_valid(format) ||
+        format == EXPORT_BINARY) {
+        return NULL;
+    }
+
+    smartterm_export_job* job = calloc(1, sizeof(smartterm_export_job));
+    if (!job) {
+        return NULL;
+    }
+
+    job->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (job->fd < 0) {
+        free(job);
+        return NULL;
+    }
+
+    job->ctx = ctx;
+    job->format = format;
+    job->include_meta = include_meta;
+    job->progress = progress;
+    job->data = data;
+
+    /* Snapshot: pin the range by sequence number; later output is not exported */
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    bool valid = export_range(buf, &start_line, &end_line);
+    job->start_line = start_line;
+    job->end_line = end_line;
+    job->start_seq = buf->base_seq + start_line;
+    job->end_seq = buf->base_seq + end_line + 1;
+
+    if (valid && pthread_create(&job->thread, NULL, export_job_run, job) == 0) {
+        job->next = ctx->export_jobs;
+        ctx->export_jobs = job;
+    } else {
+        valid = false;
+    }
+
+    pthread_mutex_unlock(&buf->mutex);
+
+    if (!valid) {
+        close(job->fd);
+        free(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+/*
+ * Ask background export to stop
+ */
+int smartterm_export_cancel(smartterm_export_job* job)
+{
+    if (!job) {
+        return SMARTTERM_INVALID;
     }
 
-    fprintf(f, "%s", content);
-    fclose(f);
-    free(content);
+    pthread_mutex_lock(&job->ctx->buffer.mutex);
+    job->cancelled = true;
+    pthread_mutex_unlock(&job->ctx->buffer.mutex);
 
     return SMARTTERM_OK;
 }
+
+/*
+ * Wait for background export to finish and release it
+ */
+int smartterm_export_wait(smartterm_export_job* job)
+{
+    if (!job) {
+        return SMARTTERM_INVALID;
+    }
+
+    void* result;
+    pthread_join(job->thread, &result);
+
+    smartterm_ctx* ctx = job->ctx;
+    pthread_mutex_lock(&ctx->buffer.mutex);
+    for (smartterm_export_job** link = &ctx->export_jobs; *link; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctx->buffer.mutex);
+
+    free(job);
+    return (int)(intptr_t)result;
+}
+
+/*
+ * Cancel and reap all background exports
+ */
+void export_jobs_cleanup(smartterm_ctx* ctx)
+{
+    for (smartterm_export_job* job = ctx->export_jobs; job; job = job->next) {
+        smartterm_export_cancel(job);
+    }
+    while (ctx->export_jobs) {
+        smartterm_export_wait(ctx->export_jobs);
+    }
+}
+
+/*
+ * Remove torn last line after a partial tee write
+ *
+ * Without this the next batch would be appended to the fragment. If the
+ * file cannot be truncated, the fragment is ended before the next batch.
+ */
+static void tee_drop_fragment(tee_log_t* tee, size_t fragment)
+{
+    int saved = errno;
+    off_t end = lseek(tee->fd, 0, SEEK_END);
+    tee->torn = end < (off_t)fragment || ftruncate(tee->fd, end - (off_t)fragment) != 0;
+    errno = saved;
+}
+
+/*
+ * Format tee batch and write it with one call (tee writer thread)
+ *
+ * The formatted batch is kept in tee->out, which only grows, so steady
+ * logging does not allocate. *written and *lines report the complete lines
+ * that reached the file; the log always ends on a line boundary. On
+ * failure errno is left from the write.
+ */
+int export_tee_write(tee_log_t* tee, size_t* written, int* lines)
+{
+    tee_queue_t* batch = &tee->batch;
+    export_writer_t w = {.data = tee->out, .capacity = tee->out_capacity, .fd = -1};
+
+    w.clock = tee->clock;
+    for (int i = 0; i < batch->count; i++) {
+        tee_record_t* record = &batch->records[i];
+        const char* tag = record->tag_at == SIZE_MAX ? NULL : batch->arena + record->tag_at;
+        export_fields(&w, tee->format, batch->arena + record->text_at,
+                      (smartterm_context_t)record->context, record->timestamp, tag,
+                      tee->include_meta);
+        record->out_end = w.used;
+    }
+    tee->clock = w.clock;
+    tee->out = w.data;
+    tee->out_capacity = w.capacity;
+
+    *written = 0;
+    *lines = 0;
+    if (w.result != SMARTTERM_OK) {
+        return w.result;
+    }
+
+    if (tee->torn) {
+        struct iovec end_line = {.iov_base = "\n", .iov_len = 1};
+        if (export_writev(tee->fd, &end_line, 1) != SMARTTERM_OK) {
+            return SMARTTERM_IOERROR;
+        }
+        tee->torn = false;
+    }
+
+    int result = SMARTTERM_OK;
+    size_t done = 0;
+    while (done < w.used) {
+        ssize_t n = write(tee->fd, w.data + done, w.used - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = SMARTTERM_IOERROR;
+            break;
+        }
+        done += (size_t)n;
+    }
+
+    /* Only whole lines count; a torn last line is taken back out */
+    int complete = 0;
+    while (complete < batch->count && batch->records[complete].out_end <= done) {
+        complete++;
+    }
+    *lines = complete;
+    *written = complete > 0 ? batch->records[complete - 1].out_end : 0;
+    if (done > *written) {
+        tee_drop_fragment(tee, done - *written);
+    }
+    return result;
+}
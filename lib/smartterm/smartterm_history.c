@@ -0,0 +1,684 @@
+/*
+ * SmartTerm Library - Input History
+ *
+ * Keeps unique input lines, newest last, capped at history_size. With a
+ * history file:
+ *
+ *   - each new entry is appended with a single write() on an O_APPEND
+ *     descriptor, so concurrent sessions interleave whole lines
+ *   - loading maps the file and walks it backwards from the newest line,
+ *     keeping the first (newest) copy of each entry until history_size
+ *     entries are found; a long file costs a scan of its tail only, and
+ *     lines are split and hashed 8 bytes at a time
+ *   - once the file holds HISTORY_COMPACT_SLACK more lines than twice the
+ *     live entries, a background thread rewrites it with its newest
+ *     unique lines and renames it into place; lines entered meanwhile are
+ *     carried over
+ *   - compaction holds an exclusive flock() on the file and appends a
+ *     shared one, and an appender whose file was renamed away reopens
+ *     the path, so sessions sharing the file lose no lines
+ *
+ * One entry per line. Backslash and newline are stored as \\ and \n.
+ * Entries count their uses (copies found when loading included) to rank
+ * search results; see smartterm_history_search.c.
+ */
+
+#include "smartterm_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Entry found while loading (points into the mapped file) */
+typedef struct {
+    const char* text;
+    size_t len;
+    unsigned int hash;
+    unsigned int uses;              /* Copies seen */
+} history_span_t;
+
+/* Entries found while loading, with a hash set of them for deduplication */
+typedef struct {
+    history_span_t* found;          /* Newest first */
+    int count;
+    int capacity;
+    int* slots;                     /* Index into found + 1 (0 = empty) */
+    unsigned int slot_count;        /* Power of two, at least twice count */
+} history_set_t;
+
+/*
+ * Hash stored entry, 8 bytes per step
+ */
+static unsigned int history_hash(const char* s, size_t len)
+{
+    uint64_t hash = len;
+    uint64_t word;
+
+    for (; len >= 8; s += 8, len -= 8) {
+        memcpy(&word, s, 8);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    word = 0;
+    memcpy(&word, s, len);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    return (unsigned int)(hash ^ (hash >> 32));
+}
+
+/*
+ * Find start of line ending at end, testing 8 bytes per step
+ */
+static size_t history_line_start(const char* map, size_t end)
+{
+    const uint64_t ones = 0x0101010101010101ull;
+
+    while (end >= 8) {
+        uint64_t word;
+        memcpy(&word, map + end - 8, 8);
+        word ^= ones * '\n';
+        if ((word - ones) & ~word & (ones << 7)) {
+            break; /* A newline is among these bytes */
+        }
+        end -= 8;
+    }
+    while (end > 0 && map[end - 1] != '\n') {
+        end--;
+    }
+    return end;
+}
+
+/*
+ * Double hash set slots and re-insert entries
+ */
+static bool history_set_grow(history_set_t* set)
+{
+    unsigned int slot_count = set->slot_count * 2;
+    int* slots = calloc(slot_count, sizeof(int));
+    if (!slots) {
+        return false;
+    }
+
+    for (int i = 0; i < set->count; i++) {
+        unsigned int slot = set->found[i].hash & (slot_count - 1);
+        while (slots[slot]) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->slot_count = slot_count;
+    return true;
+}
+
+/*
+ * Add entry unless an equal one is already in the set
+ */
+static bool history_set_add(history_set_t* set, history_span_t span)
+{
+    unsigned int mask = set->slot_count - 1;
+    unsigned int slot = span.hash & mask;
+    for (; set->slots[slot]; slot = (slot + 1) & mask) {
+        history_span_t* other = &set->found[set->slots[slot] - 1];
+        if (other->hash == span.hash && other->len == span.len &&
+            memcmp(other->text, span.text, span.len) == 0) {
+            other->uses++;
+            return true;
+        }
+    }
+
+    if (set->count >= set->capacity) {
+        int new_capacity = set->capacity * 2;
+        history_span_t* found = realloc(set->found, new_capacity * sizeof(history_span_t));
+        if (!found) {
+            return false;
+        }
+        set->found = found;
+        set->capacity = new_capacity;
+    }
+    set->found[set->count] = span;
+    set->slots[slot] = ++set->count;
+
+    return (unsigned int)set->count * 2 < set->slot_count || history_set_grow(set);
+}
+
+/*
+ * Allocate set sized for limit entries (unlimited starts small and grows)
+ */
+static bool history_set_init(history_set_t* set, int limit)
+{
+    memset(set, 0, sizeof(*set));
+    set->capacity = limit > 0 ? limit : 1024;
+    set->slot_count = 16;
+    while (set->slot_count < 2u * (unsigned int)set->capacity) {
+        set->slot_count *= 2;
+    }
+    set->found = malloc(set->capacity * sizeof(history_span_t));
+    set->slots = calloc(set->slot_count, sizeof(int));
+    return set->found && set->slots;
+}
+
+/*
+ * Collect newest unique lines of mapped file into set
+ *
+ * Walks backwards from the end until limit entries are found (< 0 = all).
+ * Leaves *end at the start of the oldest line read and counts the lines
+ * read in *scanned. Returns false if out of memory.
+ */
+static bool history_scan(history_set_t* set, const char* map, size_t size, int limit,
+                         size_t* end, int* scanned)
+{
+    /* Walking backwards, the first copy seen of an entry is the newest */
+    *end = size;
+    *scanned = 0;
+    while (*end > 0 && (limit < 0 || set->count < limit)) {
+        size_t line_end = map[*end - 1] == '\n' ? *end - 1 : *end;
+        *end = history_line_start(map, line_end);
+        (*scanned)++;
+
+        size_t len = line_end - *end;
+        if (len > 0 && !history_set_add(set, (history_span_t){map + *end, len,
+                                                              history_hash(map + *end, len), 1})) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Append entry in file form (escaped, newline-terminated) to buffer
+ */
+static bool history_put(char** data, size_t* used, size_t* capacity, const char* line)
+{
+    size_t len = strlen(line);
+    size_t needed = *used + len * 2 + 1;
+
+    if (needed > *capacity) {
+        size_t new_capacity = *capacity ? *capacity : 4096;
+        while (new_capacity < needed) {
+            new_capacity *= 2;
+        }
+        char* grown = realloc(*data, new_capacity);
+        if (!grown) {
+            return false;
+        }
+        *data = grown;
+        *capacity = new_capacity;
+    }
+
+    char* out = *data + *used;
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] == '\\' || line[i] == '\n') {
+            *out++ = '\\';
+            *out++ = line[i] == '\n' ? 'n' : '\\';
+        } else {
+            *out++ = line[i];
+        }
+    }
+    *out++ = '\n';
+    *used = out - *data;
+    return true;
+}
+
+/*
+ * Decode stored entry
+ */
+static char* history_unescape(const char* s, size_t len)
+{
+    char* line = malloc(len + 1);
+    if (!line) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\\' && i + 1 < len && (s[i + 1] == 'n' || s[i + 1] == '\\')) {
+            line[n++] = s[++i] == 'n' ? '\n' : '\\';
+        } else {
+            line[n++] = s[i];
+        }
+    }
+    line[n] = '\0';
+    return line;
+}
+
+/*
+ * Write whole buffer
+ */
+static bool history_write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/*
+ * Make room for one more entry
+ */
+static bool history_reserve(input_history_t* history, int extra)
+{
+    if (history->count + extra <= history->capacity) {
+        return true;
+    }
+
+    int new_capacity = history->capacity ? history->capacity : 64;
+    while (new_capacity < history->count + extra) {
+        new_capacity *= 2;
+    }
+    history_entry_t* entries = realloc(history->entries, new_capacity * sizeof(history_entry_t));
+    if (!entries) {
+        return false;
+    }
+    history->entries = entries;
+    history->capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Load newest unique entries from the history file
+ */
+static void history_load(input_history_t* history)
+{
+    int fd = open(history->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    size_t size = st.st_size;
+    const char* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+
+    /* Sized for history_size up front; unlimited history grows the set */
+    history_set_t set;
+    size_t end = size;
+    int scanned = 0;
+    bool ok = history_set_init(&set, history->limit) &&
+              history_scan(&set, map, size, history->limit, &end, &scanned);
+
+    if (ok && history_reserve(history, set.count)) {
+        for (int i = set.count - 1; i >= 0; i--) {
+            char* line = history_unescape(set.found[i].text, set.found[i].len);
+            if (line) {
+                history->entries[history->count++] =
+                    (history_entry_t){line, history->next_seq++, set.found[i].uses};
+            }
+        }
+    }
+
+    /* Older lines were not read; estimate them for the compaction check */
+    history->file_lines = scanned;
+    if (end > 0 && end < size) {
+        history->file_lines += (int)((double)end * scanned / (size - end)) + 1;
+    }
+
+    free(set.found);
+    free(set.slots);
+    munmap((void*)map, size);
+}
+
+/*
+ * Check whether descriptor is open on the file path names
+ */
+static bool history_is_current(int fd, const char* path)
+{
+    struct stat fd_st;
+    struct stat path_st;
+    return fstat(fd, &fd_st) == 0 && stat(path, &path_st) == 0 &&
+           fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino;
+}
+
+/*
+ * Take flock() on descriptor, retrying when interrupted
+ */
+static bool history_flock(int fd, int operation)
+{
+    while (flock(fd, operation) != 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Open history file and lock it against appends from every session
+ *
+ * Another session may have compacted and renamed a new file into place
+ * while this one waited; the lock only counts on the file the path names.
+ */
+static int history_lock_exclusive(const char* path)
+{
+    for (;;) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        if (!history_flock(fd, LOCK_EX)) {
+            close(fd);
+            return -1;
+        }
+        if (history_is_current(fd, path)) {
+            return fd;
+        }
+        close(fd);
+    }
+}
+
+/*
+ * Write lines to the history file under a shared lock (file mutex held)
+ *
+ * If another session compacted the file, the descriptor still points at
+ * the old one, which is no longer reachable; reopen the path first.
+ */
+static void history_write_shared(input_history_t* history, const char* data, size_t len)
+{
+    bool locked = history_flock(history->fd, LOCK_SH);
+    while (locked && !history_is_current(history->fd, history->path)) {
+        int fd = open(history->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            break;
+        }
+        close(history->fd);
+        history->fd = fd;
+        locked = history_flock(fd, LOCK_SH);
+    }
+
+    history_write_all(history->fd, data, len);
+    if (locked) {
+        flock(history->fd, LOCK_UN);
+    }
+}
+
+/*
+ * Build compacted file content: newest unique lines of the file, oldest first
+ */
+static char* history_compact_content(int fd, int limit, size_t* used, int* lines)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    const char* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    history_set_t set;
+    size_t end;
+    int scanned;
+    char* data = NULL;
+    if (history_set_init(&set, limit) && history_scan(&set, map, size, limit, &end, &scanned)) {
+        /* Lines are copied as stored, so they need no escaping again */
+        data = malloc(size - end + 1);
+        *used = 0;
+        for (int i = set.count - 1; data && i >= 0; i--) {
+            memcpy(data + *used, set.found[i].text, set.found[i].len);
+            *used += set.found[i].len;
+            data[(*used)++] = '\n';
+        }
+        *lines = set.count;
+    }
+
+    free(set.found);
+    free(set.slots);
+    munmap((void*)map, size);
+    return data;
+}
+
+/*
+ * Rewrite history file with its newest unique lines (compactor thread)
+ *
+ * The file is read again under the lock, so lines other sessions
+ * appended are kept too.
+ */
+static void* history_compact_run(void* arg)
+{
+    input_history_t* history = arg;
+
+    int lock_fd = history_lock_exclusive(history->path);
+    size_t used = 0;
+    int lines = 0;
+    char* data = lock_fd >= 0 ? history_compact_content(lock_fd, history->limit, &used, &lines)
+                              : NULL;
+
+    char tmp_path[PATH_MAX];
+    int fd = -1;
+    if (data && snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", history->path) <
+                    (int)sizeof(tmp_path)) {
+        fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    }
+    bool ok = fd >= 0 && history_write_all(fd, data, used) && fsync(fd) == 0;
+
+    /* Appends from this session wait only for the carried-over lines and the rename */
+    pthread_mutex_lock(&history->file_mutex);
+    ok = ok && history_write_all(fd, history->tail, history->tail_used) &&
+         rename(tmp_path, history->path) == 0;
+    if (ok) {
+        if (history->fd >= 0) {
+            close(history->fd);
+        }
+        history->fd = fd;
+    } else if (fd >= 0) {
+        close(fd);
+        unlink(tmp_path);
+    }
+
+    /* Sessions waiting to append find the file renamed and reopen it */
+    if (lock_fd >= 0) {
+        close(lock_fd);
+    }
+    if (!ok && history->fd >= 0) {
+        /* Lines carried over were not written anywhere yet */
+        history_write_shared(history, history->tail, history->tail_used);
+    }
+    history->file_lines += lines;
+    history->tail_used = 0;
+    history->compacting = false;
+    pthread_mutex_unlock(&history->file_mutex);
+
+    free(data);
+    return NULL;
+}
+
+/*
+ * Start rewriting the history file in the background
+ */
+static void history_compact(input_history_t* history)
+{
+    if (history->compactor_started) {
+        pthread_join(history->compactor, NULL);
+        history->compactor_started = false;
+    }
+
+    /* Lines entered from now on are counted into the new file */
+    pthread_mutex_lock(&history->file_mutex);
+    history->file_lines = 0;
+    history->compacting = true;
+    pthread_mutex_unlock(&history->file_mutex);
+
+    if (pthread_create(&history->compactor, NULL, history_compact_run, history) != 0) {
+        pthread_mutex_lock(&history->file_mutex);
+        history->file_lines = history->count;
+        history->compacting = false;
+        pthread_mutex_unlock(&history->file_mutex);
+        return;
+    }
+    history->compactor_started = true;
+}
+
+/*
+ * Append entry to the history file with one write
+ */
+static void history_append(input_history_t* history, const char* line)
+{
+    char* data = NULL;
+    size_t used = 0;
+    size_t capacity = 0;
+    if (!history_put(&data, &used, &capacity, line)) {
+        return;
+    }
+
+    pthread_mutex_lock(&history->file_mutex);
+    if (history->compacting) {
+        history_put(&history->tail, &history->tail_used, &history->tail_capacity, line);
+        history->file_lines++;
+    } else if (history->fd >= 0) {
+        history_write_shared(history, data, used);
+        history->file_lines++;
+    }
+    bool due = history->fd >= 0 && !history->compacting &&
+               history->file_lines >= 2 * history->count + HISTORY_COMPACT_SLACK;
+    pthread_mutex_unlock(&history->file_mutex);
+
+    free(data);
+    if (due) {
+        history_compact(history);
+    }
+}
+
+/*
+ * Set up history and load the history file
+ *
+ * A history file that cannot be opened leaves history in memory only.
+ */
+void history_open(input_history_t* history, const smartterm_config_t* config)
+{
+    history->fd = -1;
+    history->limit = config->history_size;
+    pthread_mutex_init(&history->file_mutex, NULL);
+
+    if (!config->history_enabled || !config->history_file || history->limit == 0) {
+        return;
+    }
+
+    /* "~/" is relative to $HOME, as in the shell */
+    const char* home = getenv("HOME");
+    if (strncmp(config->history_file, "~/", 2) == 0 && home) {
+        size_t len = strlen(home) + strlen(config->history_file);
+        history->path = malloc(len);
+        if (history->path) {
+            snprintf(history->path, len, "%s%s", home, config->history_file + 1);
+        }
+    } else {
+        history->path = strdup_safe(config->history_file);
+    }
+    if (!history->path) {
+        return;
+    }
+
+    history_load(history);
+    if (history->count > 0) {
+        history_index_start(history);
+    }
+    history->fd = open(history->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+
+    if (history->fd >= 0 &&
+        history->file_lines >= 2 * history->count + HISTORY_COMPACT_SLACK) {
+        history_compact(history);
+    }
+}
+
+/*
+ * Wait for compaction and release history
+ */
+void history_close(input_history_t* history)
+{
+    if (history->compactor_started) {
+        pthread_join(history->compactor, NULL);
+    }
+    history_index_wait(history);
+    if (history->fd >= 0) {
+        close(history->fd);
+    }
+    pthread_mutex_destroy(&history->file_mutex);
+
+    for (int i = 0; i < history->count; i++) {
+        free(history->entries[i].text);
+    }
+    free(history->entries);
+    history_index_free(&history->index);
+    free(history->path);
+    free(history->tail);
+    memset(history, 0, sizeof(*history));
+    history->fd = -1;
+}
+
+/*
+ * Add accepted line as newest entry
+ */
+void history_add(input_history_t* history, const char* line)
+{
+    if (!line[0] || history->limit == 0) {
+        return;
+    }
+    history_index_wait(history);
+
+    /* Entered again: move it to the end */
+    int previous = history->count - 1;
+    while (previous >= 0 && strcmp(history->entries[previous].text, line) != 0) {
+        previous--;
+    }
+    if (previous >= 0 && previous == history->count - 1) {
+        history->entries[previous].uses++;
+        return;
+    }
+
+    /* Copy first: line may be an entry about to be freed */
+    char* entry = strdup_safe(line);
+    if (!entry || !history_reserve(history, 1)) {
+        free(entry);
+        return;
+    }
+
+    unsigned int uses = 1;
+    if (previous >= 0) {
+        uses += history->entries[previous].uses;
+        free(history->entries[previous].text);
+        memmove(history->entries + previous, history->entries + previous + 1,
+                (history->count - previous - 1) * sizeof(history_entry_t));
+        history->count--;
+        history->index.dead++;
+    }
+
+    /* Drop the oldest entry at the limit */
+    if (history->limit > 0 && history->count >= history->limit) {
+        free(history->entries[0].text);
+        memmove(history->entries, history->entries + 1,
+                (history->count - 1) * sizeof(history_entry_t));
+        history->count--;
+        history->index.dead++;
+    }
+    history->entries[history->count++] = (history_entry_t){entry, history->next_seq++, uses};
+    history_index_add(history, history->count - 1);
+
+    if (history->path) {
+        history_append(history, entry);
+    }
+}
@@ -0,0 +1,665 @@
+/*
+ * SmartTerm Library - History Search
+ *
+ * Incremental search over input history (Ctrl-R). An n-gram index lists,
+ * for every 1-, 2- and 3-byte substring, the entries containing it, so a
+ * query is answered by intersecting sorted lists instead of scanning
+ * every entry:
+ *
+ *   - up to 3 bytes, the list for the query itself is the exact answer
+ *   - a longer query intersects the list of its last 3 bytes with the
+ *     candidates of the query one byte shorter; only the candidates
+ *     ranking reaches are confirmed with strstr()
+ *
+ * Matches are kept per query length, so backspace costs nothing. Ranking
+ * favours entries used often and recently, and is lazy: matches are
+ * scored newest first only until no older one can beat the best found.
+ *
+ * Lists hold entry sequence numbers, which stay valid when entries move;
+ * removed entries linger in them until the index is rebuilt. The index
+ * is built on a background thread when history is loaded, so the first
+ * Ctrl-R does not wait for it.
+ */
+
+#include "smartterm_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* First allocation of a posting list */
+#define POSTINGS_INITIAL_CAPACITY 4
+
+/* First allocation of the trigram table */
+#define TRIGRAM_INITIAL_SLOTS 1024
+
+/* First allocation of query bytes and levels */
+#define SEARCH_INITIAL_CAPACITY 16
+
+/* Age (entries back from the newest) at which a use counts half in ranking */
+#define SEARCH_RECENCY_HALF 64
+
+/*
+ * Add seq to list unless it is already the last one
+ *
+ * An entry's grams are added together, so a gram repeated within one
+ * entry is listed once.
+ */
+static bool postings_add(history_postings_t* list, unsigned int seq)
+{
+    if (list->count > 0 && list->seqs[list->count - 1] == seq) {
+        return true;
+    }
+
+    if (list->count >= list->capacity) {
+        int new_capacity = list->capacity ? list->capacity * 2 : POSTINGS_INITIAL_CAPACITY;
+        unsigned int* seqs = realloc(list->seqs, new_capacity * sizeof(unsigned int));
+        if (!seqs) {
+            return false;
+        }
+        list->seqs = seqs;
+        list->capacity = new_capacity;
+    }
+    list->seqs[list->count++] = seq;
+    return true;
+}
+
+/*
+ * Get trigram key (never 0)
+ */
+static unsigned int trigram_key(const char* s)
+{
+    const unsigned char* u = (const unsigned char*)s;
+    return ((unsigned int)u[0] << 16 | (unsigned int)u[1] << 8 | u[2]) + (1u << 24);
+}
+
+/*
+ * Find slot holding key, or the empty slot where it belongs
+ */
+static unsigned int trigram_find(const history_index_t* index, unsigned int key)
+{
+    unsigned int mask = index->trigram_slots - 1;
+    unsigned int hash = key * 0x9e3779b1u;
+    unsigned int slot = (hash ^ (hash >> 16)) & mask;
+
+    while (index->trigram_keys[slot] && index->trigram_keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/*
+ * Double trigram slots and re-insert lists
+ */
+static bool trigram_grow(history_index_t* index)
+{
+    unsigned int old_slots = index->trigram_slots;
+    unsigned int* old_keys = index->trigram_keys;
+    history_postings_t* old_lists = index->triples;
+
+    index->trigram_slots = old_slots * 2;
+    index->trigram_keys = calloc(index->trigram_slots, sizeof(unsigned int));
+    index->triples = calloc(index->trigram_slots, sizeof(history_postings_t));
+    if (!index->trigram_keys || !index->triples) {
+        free(index->trigram_keys);
+        free(index->triples);
+        index->trigram_slots = old_slots;
+        index->trigram_keys = old_keys;
+        index->triples = old_lists;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < old_slots; i++) {
+        if (old_keys[i]) {
+            unsigned int slot = trigram_find(index, old_keys[i]);
+            index->trigram_keys[slot] = old_keys[i];
+            index->triples[slot] = old_lists[i];
+        }
+    }
+    free(old_keys);
+    free(old_lists);
+    return true;
+}
+
+/*
+ * Get list for the trigram at s (NULL = none and not created)
+ */
+static history_postings_t* trigram_list(history_index_t* index, const char* s, bool create)
+{
+    unsigned int key = trigram_key(s);
+    unsigned int slot = trigram_find(index, key);
+
+    if (!index->trigram_keys[slot]) {
+        if (!create) {
+            return NULL;
+        }
+        if ((index->trigram_count + 1) * 2 > index->trigram_slots) {
+            if (!trigram_grow(index)) {
+                return NULL;
+            }
+            slot = trigram_find(index, key);
+        }
+        index->trigram_keys[slot] = key;
+        index->trigram_count++;
+    }
+    return &index->triples[slot];
+}
+
+/*
+ * Add every 1-, 2- and 3-byte substring of entry to the index
+ */
+static bool index_entry(history_index_t* index, const history_entry_t* entry)
+{
+    const unsigned char* s = (const unsigned char*)entry->text;
+
+    for (size_t i = 0; s[i]; i++) {
+        bool ok = postings_add(&index->bytes[s[i]], entry->seq);
+        if (ok && s[i + 1]) {
+            ok = postings_add(&index->pairs[s[i] << 8 | s[i + 1]], entry->seq);
+            if (ok && s[i + 2]) {
+                history_postings_t* list = trigram_list(index, entry->text + i, true);
+                ok = list && postings_add(list, entry->seq);
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Release unused list capacity
+ */
+static void postings_trim(history_postings_t* list)
+{
+    if (list->count > 0 && list->count < list->capacity) {
+        unsigned int* seqs = realloc(list->seqs, list->count * sizeof(unsigned int));
+        if (seqs) {
+            list->seqs = seqs;
+            list->capacity = list->count;
+        }
+    }
+}
+
+/*
+ * Index all entries (builder thread, or caller without one)
+ */
+static bool index_build(input_history_t* history)
+{
+    history_index_t* index = &history->index;
+
+    index->dead = 0;
+    index->bytes = calloc(256, sizeof(history_postings_t));
+    index->pairs = calloc(65536, sizeof(history_postings_t));
+    index->trigram_slots = TRIGRAM_INITIAL_SLOTS;
+    index->trigram_keys = calloc(index->trigram_slots, sizeof(unsigned int));
+    index->triples = calloc(index->trigram_slots, sizeof(history_postings_t));
+    bool ok = index->bytes && index->pairs && index->trigram_keys && index->triples;
+
+    for (int i = 0; ok && i < history->count; i++) {
+        ok = index_entry(index, &history->entries[i]);
+    }
+    if (!ok) {
+        history_index_free(index);
+        return false;
+    }
+
+    /* Lists grow by doubling; most will see few further entries */
+    for (int i = 0; i < 256; i++) {
+        postings_trim(&index->bytes[i]);
+    }
+    for (int i = 0; i < 65536; i++) {
+        postings_trim(&index->pairs[i]);
+    }
+    for (unsigned int i = 0; i < index->trigram_slots; i++) {
+        postings_trim(&index->triples[i]);
+    }
+
+    index->built = true;
+    return true;
+}
+
+/*
+ * Builder thread body
+ */
+static void* index_build_run(void* arg)
+{
+    index_build(arg);
+    return NULL;
+}
+
+/*
+ * Renumber entries from 0; removed entries are gone from a new index
+ */
+static void index_renumber(input_history_t* history)
+{
+    for (int i = 0; i < history->count; i++) {
+        history->entries[i].seq = i;
+    }
+    history->next_seq = history->count;
+}
+
+/*
+ * Build the index in the background
+ *
+ * Until history_index_wait(), entries may be read but not changed.
+ */
+void history_index_start(input_history_t* history)
+{
+    history_index_t* index = &history->index;
+    history_index_wait(history);
+    history_index_free(index);
+    index_renumber(history);
+
+    index->builder_started =
+        pthread_create(&index->builder, NULL, index_build_run, history) == 0;
+}
+
+/*
+ * Wait for a background build to finish
+ */
+void history_index_wait(input_history_t* history)
+{
+    history_index_t* index = &history->index;
+    if (index->builder_started) {
+        pthread_join(index->builder, NULL);
+        index->builder_started = false;
+    }
+}
+
+/*
+ * Add new entry to the index, if built
+ *
+ * Once removed entries outnumber live ones, the index is dropped and
+ * rebuilt by the next search.
+ */
+void history_index_add(input_history_t* history, int pos)
+{
+    history_index_t* index = &history->index;
+    if (!index->built) {
+        return;
+    }
+
+    if (index->dead > history->count || !index_entry(index, &history->entries[pos])) {
+        history_index_free(index);
+    }
+}
+
+/*
+ * Release index lists
+ */
+void history_index_free(history_index_t* index)
+{
+    if (index->bytes) {
+        for (int i = 0; i < 256; i++) {
+            free(index->bytes[i].seqs);
+        }
+    }
+    if (index->pairs) {
+        for (int i = 0; i < 65536; i++) {
+            free(index->pairs[i].seqs);
+        }
+    }
+    if (index->triples) {
+        for (unsigned int i = 0; i < index->trigram_slots; i++) {
+            free(index->triples[i].seqs);
+        }
+    }
+    free(index->bytes);
+    free(index->pairs);
+    free(index->triples);
+    free(index->trigram_keys);
+
+    /* The builder thread fields stay: a failed build frees from the thread */
+    index->built = false;
+    index->dead = 0;
+    index->bytes = NULL;
+    index->pairs = NULL;
+    index->triples = NULL;
+    index->trigram_keys = NULL;
+    index->trigram_slots = 0;
+    index->trigram_count = 0;
+}
+
+/*
+ * Get first index from `from` whose seq is at least target
+ *
+ * Steps out exponentially, then bisects, so skipping far costs log time.
+ */
+static int gallop(const unsigned int* seqs, int from, int count, unsigned int target)
+{
+    int low = from;
+    int high = from;
+    for (int step = 1; high < count && seqs[high] < target; step *= 2) {
+        low = high + 1;
+        high += step;
+    }
+    if (high > count) {
+        high = count;
+    }
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (seqs[mid] < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Keep seqs of level that are also in list; returns the number written to out
+ *
+ * Whichever side is behind gallops to the other, so a short side costs
+ * little against a long one.
+ */
+static int intersect(const history_level_t* level, const history_postings_t* list,
+                     unsigned int* out)
+{
+    int kept = 0;
+    int i = 0;
+    int j = 0;
+
+    while (i < level->count && j < list->count) {
+        if (level->seqs[i] == list->seqs[j]) {
+            out[kept++] = level->seqs[i++];
+            j++;
+        } else if (level->seqs[i] < list->seqs[j]) {
+            i = gallop(level->seqs, i + 1, level->count, list->seqs[j]);
+        } else {
+            j = gallop(list->seqs, j + 1, list->count, level->seqs[i]);
+        }
+    }
+    return kept;
+}
+
+/*
+ * Get entry index for seq (-1 = removed)
+ */
+static int search_pos(const history_search_t* search, unsigned int seq)
+{
+    return search->pos_of_seq[seq];
+}
+
+/*
+ * Score entry: its uses count half at SEARCH_RECENCY_HALF entries old,
+ * a third at twice that, and so on
+ */
+static float search_score(const input_history_t* history, int pos, unsigned int uses)
+{
+    int age = history->count - 1 - pos;
+    return uses / (1.0f + (float)age / SEARCH_RECENCY_HALF);
+}
+
+/*
+ * Check ranking order: higher score, then newer
+ */
+static bool match_before(const history_match_t* a, const history_match_t* b)
+{
+    return a->score > b->score || (a->score == b->score && a->pos > b->pos);
+}
+
+/*
+ * Add match to ranking heap
+ */
+static bool heap_push(history_search_t* search, history_match_t match)
+{
+    if (search->heap_count >= search->heap_capacity) {
+        int new_capacity = search->heap_capacity ? search->heap_capacity * 2 : 64;
+        history_match_t* heap = realloc(search->heap, new_capacity * sizeof(history_match_t));
+        if (!heap) {
+            return false;
+        }
+        search->heap = heap;
+        search->heap_capacity = new_capacity;
+    }
+
+    history_match_t* heap = search->heap;
+    int i = search->heap_count++;
+    while (i > 0 && match_before(&match, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = match;
+    return true;
+}
+
+/*
+ * Remove best match from ranking heap
+ */
+static history_match_t heap_pop(history_search_t* search)
+{
+    history_match_t* heap = search->heap;
+    history_match_t best = heap[0];
+    history_match_t last = heap[--search->heap_count];
+    int count = search->heap_count;
+
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && match_before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!match_before(&heap[child], &last)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (count > 0) {
+        heap[i] = last;
+    }
+    return best;
+}
+
+/*
+ * Restart ranking for the current level
+ */
+static void search_reset_rank(history_search_t* search)
+{
+    search->heap_count = 0;
+    search->ranked_count = 0;
+    search->scan = search->levels[search->length].count - 1;
+    search->rank = 0;
+}
+
+/*
+ * Start a search, waiting for or building the index as needed
+ */
+bool history_search_start(history_search_t* search, input_history_t* history)
+{
+    history_search_end(search);
+    history_index_wait(history);
+    if (!history->index.built) {
+        index_renumber(history);
+        if (!index_build(history)) {
+            return false;
+        }
+    }
+
+    int count = history->count > 0 ? history->count : 1;
+    search->capacity = SEARCH_INITIAL_CAPACITY;
+    search->query = calloc(search->capacity, 1);
+    search->levels = calloc(search->capacity, sizeof(history_level_t));
+    search->pos_of_seq = malloc((history->next_seq + 1) * sizeof(int));
+    search->max_uses = malloc(count * sizeof(unsigned int));
+    if (!search->query || !search->levels || !search->pos_of_seq || !search->max_uses) {
+        history_search_end(search);
+        return false;
+    }
+
+    /* History does not change during a search */
+    memset(search->pos_of_seq, 0xff, (history->next_seq + 1) * sizeof(int));
+    unsigned int max_uses = 0;
+    for (int i = 0; i < history->count; i++) {
+        search->pos_of_seq[history->entries[i].seq] = i;
+        if (history->entries[i].uses > max_uses) {
+            max_uses = history->entries[i].uses;
+        }
+        search->max_uses[i] = max_uses;
+    }
+
+    search->active = true;
+    return true;
+}
+
+/*
+ * Extend query by one byte, narrowing the previous matches
+ */
+bool history_search_push(history_search_t* search, input_history_t* history, char c)
+{
+    if (search->length + 1 >= search->capacity) {
+        int new_capacity = search->capacity * 2;
+        char* query = realloc(search->query, new_capacity);
+        if (!query) {
+            return false;
+        }
+        search->query = query;
+        history_level_t* levels = realloc(search->levels, new_capacity * sizeof(history_level_t));
+        if (!levels) {
+            return false;
+        }
+        search->levels = levels;
+        search->capacity = new_capacity;
+    }
+
+    int length = search->length + 1;
+    search->query[length - 1] = c;
+    search->query[length] = '\0';
+
+    /* The list of the last (up to) three bytes */
+    history_index_t* index = &history->index;
+    const unsigned char* tail = (const unsigned char*)search->query + (length > 3 ? length - 3 : 0);
+    const history_postings_t* list;
+    if (length == 1) {
+        list = &index->bytes[tail[0]];
+    } else if (length == 2) {
+        list = &index->pairs[tail[0] << 8 | tail[1]];
+    } else {
+        list = trigram_list(index, (const char*)tail, false);
+    }
+
+    history_level_t level = {0};
+    if (list && length <= 3) {
+        /* The list is the exact answer */
+        level = (history_level_t){list->seqs, list->count, false, false};
+    } else if (list) {
+        /* Entries with the previous query and the last trigram */
+        const history_level_t* previous = &search->levels[length - 1];
+        int size = previous->count < list->count ? previous->count : list->count;
+        unsigned int* seqs = malloc((size > 0 ? size : 1) * sizeof(unsigned int));
+        if (!seqs) {
+            search->query[length - 1] = '\0';
+            return false;
+        }
+        level = (history_level_t){seqs, intersect(previous, list, seqs), true, true};
+    }
+
+    search->levels[length] = level;
+    search->length = length;
+    search_reset_rank(search);
+    return true;
+}
+
+/*
+ * Drop the last query byte, returning to the previous matches
+ */
+void history_search_pop(history_search_t* search)
+{
+    if (search->length == 0) {
+        return;
+    }
+
+    history_level_t* level = &search->levels[search->length];
+    if (level->owned) {
+        free((void*)level->seqs);
+    }
+    search->length--;
+    search->query[search->length] = '\0';
+    search_reset_rank(search);
+}
+
+/*
+ * Get entry index of the match at rank (0 = best, -1 = none)
+ */
+int history_search_result(history_search_t* search, input_history_t* history, int rank)
+{
+    if (!search->active || search->length == 0 || rank < 0) {
+        return -1;
+    }
+
+    const history_level_t* level = &search->levels[search->length];
+    while (search->ranked_count <= rank) {
+        /*
+         * Score matches newest first. Older ones have at most max_uses of
+         * the next candidate and are older still, which bounds their score;
+         * once the best scored beats that bound, it is next in rank.
+         */
+        while (search->scan >= 0) {
+            int pos = search_pos(search, level->seqs[search->scan]);
+            if (pos < 0) {
+                search->scan--;
+                continue;
+            }
+            if (search->heap_count > 0 &&
+                search_score(history, pos, search->max_uses[pos]) <= search->heap[0].score) {
+                break;
+            }
+
+            if (!level->verify || strstr(history->entries[pos].text, search->query)) {
+                unsigned int uses = history->entries[pos].uses;
+                if (!heap_push(search, (history_match_t){pos, search_score(history, pos, uses)})) {
+                    return -1;
+                }
+            }
+            search->scan--;
+        }
+
+        if (search->heap_count == 0) {
+            return -1;
+        }
+        if (search->ranked_count >= search->ranked_capacity) {
+            int new_capacity = search->ranked_capacity ? search->ranked_capacity * 2 : 64;
+            int* ranked = realloc(search->ranked, new_capacity * sizeof(int));
+            if (!ranked) {
+                return -1;
+            }
+            search->ranked = ranked;
+            search->ranked_capacity = new_capacity;
+        }
+        search->ranked[search->ranked_count++] = heap_pop(search).pos;
+    }
+    return search->ranked[rank];
+}
+
+/*
+ * Finish search, keeping its query for the next one
+ */
+void history_search_end(history_search_t* search)
+{
+    char* last_query = search->last_query;
+    if (search->active && search->length > 0) {
+        char* query = strdup_safe(search->query);
+        if (query) {
+            free(last_query);
+            last_query = query;
+        }
+    }
+
+    while (search->levels && search->length > 0) {
+        history_search_pop(search);
+    }
+    free(search->levels);
+    free(search->query);
+    free(search->pos_of_seq);
+    free(search->max_uses);
+    free(search->heap);
+    free(search->ranked);
+    free(search->original);
+    memset(search, 0, sizeof(*search));
+    search->last_query = last_query;
+}
@@ -1,60 +1,78 @@
 /*
  * SmartTerm Library - Input Implementation
  *
- * Input handling with readline integration.
+ * Reads lines with the integrated line editor. The reading thread sleeps
+ * in poll() without holding any lock and takes the screen mutex only to
+ * apply the keys that arrived, so output from other threads keeps
+ * rendering while a line is being typed.
  */
 
 #include "smartterm_internal.h"
-#include <readline/history.h>
-#include <readline/readline.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Global completion state for readline callbacks */
-static smartterm_ctx* g_completion_ctx = NULL;
-
 /*
- * Suspend ncurses for readline
+ * Apply pending keys to the editor (screen mutex held)
+ *
+ * Returns number of keys read. Stops after the key that ends the line so
+ * typeahead stays queued for the next read.
  */
-int input_suspend_ncurses(smartterm_ctx* ctx)
+int input_process_keys(smartterm_ctx* ctx)
 {
-    if (!ctx || !ctx->ncurses_active) {
-        return SMARTTERM_NOTINIT;
+    int count = 0;
+    int key;
+
+    while (ctx->editor.state == EDITOR_EDITING && (key = wgetch(ctx->input_win)) != ERR) {
+        count++;
+        if (key == KEY_PASTE_START || ctx->editor.pasting) {
+            editor_paste(ctx, key);
+        } else {
+            keymap_dispatch(ctx, key);
+        }
     }
 
-    def_prog_mode(); /* Save current mode */
-    endwin();        /* Suspend ncurses */
-
-    return SMARTTERM_OK;
+    editor_draw(ctx);
+    render_update(ctx);
+    return count;
 }
 
 /*
- * Resume ncurses after readline
+ * Read one line, or text of several lines in the growing input area
  */
-int input_resume_ncurses(smartterm_ctx* ctx)
+static char* input_read(smartterm_ctx* ctx, const char* prompt, bool multiline)
 {
-    if (!ctx) {
-        return SMARTTERM_NOTINIT;
+    screen_lock(ctx);
+    editor_begin(ctx, prompt ? prompt : ctx->prompt);
+    if (multiline) {
+        multiline_begin(ctx);
     }
 
-    reset_prog_mode(); /* Restore saved mode */
-    refresh();         /* Refresh screen */
+    /* Keys typed ahead are already buffered */
+    input_process_keys(ctx);
 
-    /* Re-render windows */
-    return render_all(ctx);
-}
+    while (ctx->editor.state == EDITOR_EDITING) {
+        screen_unlock(ctx);
 
-/*
- * Readline completion wrapper
- */
-static char** readline_completion_wrapper(const char* text, int start, int end)
-{
-    if (!g_completion_ctx || !g_completion_ctx->completion.completer) {
-        return NULL;
+        struct pollfd pfd = {.fd = ctx->input_fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, -1);
+        int error = errno;
+
+        screen_lock(ctx);
+        if (ready < 0 && error != EINTR) {
+            ctx->editor.state = EDITOR_EOF;
+        } else if (ready > 0 && input_process_keys(ctx) == 0 &&
+                   (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))) {
+            /* Terminal closed */
+            ctx->editor.state = EDITOR_EOF;
+        }
     }
 
-    return g_completion_ctx->completion.completer(text, start, end,
-                                                  g_completion_ctx->completion.user_data);
+    char* line = editor_take_line(ctx);
+    screen_unlock(ctx);
+
+    return line;
 }
 
 /*
@@ -66,32 +84,11 @@ char* input_read_line(smartterm_ctx* ctx, const char* prompt)
         return NULL;
     }
 
-    /* Set up completion if configured */
-    if (ctx->completion.completer) {
-        g_completion_ctx = ctx;
-        rl_attempted_completion_function = readline_completion_wrapper;
-    }
-
-    /* Suspend ncurses */
-    input_suspend_ncurses(ctx);
-
-    /* Use readline */
-    const char* actual_prompt = prompt ? prompt : ctx->prompt;
-    char* input = readline(actual_prompt);
-
-    /* Resume ncurses */
-    input_resume_ncurses(ctx);
-
-    /* Add to history if enabled and non-empty */
-    if (input && ctx->config.history_enabled && strlen(input) > 0) {
-        add_history(input);
-    }
-
-    return input;
+    return input_read(ctx, prompt, false);
 }
 
 /*
- * Read multi-line input (simplified version)
+ * Read multi-line input (single line unless multiline_enabled)
  */
 char* input_read_multiline(smartterm_ctx* ctx, const char* prompt)
 {
@@ -99,14 +96,7 @@ char* input_read_multiline(smartterm_ctx* ctx, const char* prompt)
         return NULL;
     }
 
-    if (!ctx->config.multiline_enabled) {
-        return input_read_line(ctx, prompt);
-    }
-
-    /* For now, fall back to single-line
-     * Full multi-line implementation would require custom input handler
-     */
-    return input_read_line(ctx, prompt);
+    return input_read(ctx, prompt, ctx->config.multiline_enabled);
 }
 
 /*
@@ -157,8 +147,28 @@ int smartterm_set_completer(smartterm_ctx* ctx, smartterm_completer_fn completer
         return SMARTTERM_NOTINIT;
     }
 
+    pthread_mutex_lock(&ctx->screen_mutex);
     ctx->completion.completer = completer;
     ctx->completion.user_data = data;
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Set handler for multi-line pastes
+ */
+int smartterm_set_paste_handler(smartterm_ctx* ctx, smartterm_paste_handler_fn handler,
+                                void* data)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    pthread_mutex_lock(&ctx->screen_mutex);
+    ctx->editor.paste_handler = handler;
+    ctx->editor.paste_data = data;
+    pthread_mutex_unlock(&ctx->screen_mutex);
 
     return SMARTTERM_OK;
 }
@@ -11,6 +11,7 @@
 #include "../../include/smartterm.h"
 #include <ncurses.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <time.h>
 
 /* Maximum sizes */
@@ -19,22 +20,299 @@
 #define MAX_PROMPT_LENGTH 64
 #define MAX_THEME_NAME 32
 
-/* Output line structure */
+/* Context slots tracked by view predicates */
+#define VIEW_CONTEXT_SLOTS 256
+
+/* Newest matching lines a view remembers (pages up to this tall need no scan) */
+#define VIEW_RECENT_MATCHES 256
+
+/* Maximum number of distinct interned tags */
+#define MAX_TAGS 65535
+
+/* Interned tag table (ID 0 = no tag) */
 typedef struct {
-    char* text;
-    smartterm_line_meta_t meta;
-} output_line_t;
+    char** names;          /* Tag name by ID */
+    size_t name_bytes;     /* Bytes of interned name strings */
+    int count;             /* IDs in use, including reserved 0 */
+    int capacity;          /* Allocated entries in names */
+    unsigned short* slots; /* Open-addressing hash of IDs (0 = empty) */
+    int slot_count;        /* Hash size (power of two) */
+    unsigned long dropped; /* Lines stored untagged because the table was full */
+} tag_table_t;
 
-/* Output buffer structure */
+/* Lines per compressed cold block */
+#define COLD_BLOCK_LINES 256
+
+/* Decompressed cold blocks cached for scrolling, search and export */
+#define COLD_CACHE_BLOCKS 4
+
+/* Compressed block of consecutive lines */
+typedef struct {
+    unsigned char* data;     /* LZ-compressed text, lines NUL-terminated */
+    size_t size;             /* Compressed bytes */
+    size_t raw_size;         /* Decompressed bytes */
+    unsigned long first_seq; /* Sequence number of first line */
+} cold_block_t;
+
+/* Decompressed copy of a cold block */
+typedef struct {
+    char* text;                              /* Decompressed lines */
+    size_t capacity;                         /* Allocated bytes in text */
+    unsigned int offsets[COLD_BLOCK_LINES];  /* Line start offsets */
+    unsigned long first_seq;                 /* Block held */
+    unsigned long last_used;                 /* LRU clock value */
+    bool valid;
+} cold_cache_entry_t;
+
+/*
+ * Compressed cold tier
+ *
+ * Once more than hot_lines lines are uncompressed, the oldest
+ * COLD_BLOCK_LINES of them are packed into a block and their text
+ * pointers cleared. Cold lines are always the oldest lines in the buffer
+ * and blocks are contiguous, so a line's block is found by division.
+ */
 typedef struct {
-    output_line_t* lines;
+    cold_block_t* blocks; /* Ring of blocks, oldest first */
+    int head;
     int count;
     int capacity;
+    unsigned long end_seq; /* Sequence number after newest cold line */
+    size_t bytes;          /* Compressed bytes held */
+    int hot_lines;         /* Lines kept uncompressed (0 = disabled) */
+    cold_cache_entry_t cache[COLD_CACHE_BLOCKS];
+    unsigned long cache_clock;
+} cold_tier_t;
+
+/* Lines per spill segment file */
+#define SPILL_SEGMENT_LINES 65536
+
+/* Text bytes per spill segment file */
+#define SPILL_SEGMENT_DATA (16 * 1024 * 1024)
+
+/* Reachable line limit; the oldest segment is dropped beyond it */
+#define SPILL_MAX_LINES (1 << 30)
+
+/*
+ * Segment file format, shared by spill segments and saved sessions
+ *
+ * A header, four dense metadata columns (text offset, timestamp delta,
+ * tag ID, context) with room for `capacity` lines, a text blob of
+ * NUL-terminated lines whose length is recorded in the header, and for
+ * sessions the tag names. Section positions are recorded in the header,
+ * so readers never assume a layout. Integers are host byte order.
+ */
+#define SEGMENT_MAGIC "STSEG02"
+#define SEGMENT_VERSION 2
+
+typedef struct {
+    char magic[8];         /* SEGMENT_MAGIC */
+    uint32_t version;      /* SEGMENT_VERSION */
+    uint32_t count;        /* Lines stored */
+    uint32_t capacity;     /* Lines the columns have room for */
+    uint32_t tag_count;    /* Tag names stored (0 = buffer-local tag IDs) */
+    int64_t ts_base;       /* Reference timestamp for ts_deltas */
+    uint64_t offsets_at;   /* uint64_t text offset per line */
+    uint64_t ts_deltas_at; /* int32_t timestamp delta per line */
+    uint64_t tag_ids_at;   /* uint16_t tag ID per line */
+    uint64_t contexts_at;  /* uint8_t context per line */
+    uint64_t text_at;      /* Text blob */
+    uint64_t text_size;    /* Text blob length */
+    uint64_t tags_at;      /* Tag names for IDs 1..tag_count, NUL-terminated */
+    uint64_t tags_size;    /* Tag name bytes */
+} segment_header_t;
+
+/* Mapped segment file */
+typedef struct {
+    unsigned char* map;       /* Whole-file mapping */
+    size_t map_size;
+    segment_header_t* header; /* Start of mapping */
+    uint64_t* offsets;
+    int32_t* ts_deltas;
+    uint16_t* tag_ids;
+    uint8_t* contexts;
+    char* text;
+    size_t text_used;         /* Text bytes written */
+    size_t text_capacity;     /* Text bytes available */
+    int count;                /* Lines stored */
+    int capacity;             /* Lines the columns have room for */
+    long ts_base;             /* Reference timestamp for ts_deltas */
+    bool writable;            /* Spill segment still being appended to */
+    uint16_t* tag_map;        /* File tag ID to buffer tag ID (NULL = same) */
+    unsigned long first_seq;  /* Sequence number of first line */
+} spill_segment_t;
+
+/* Lines evicted from memory (or loaded from a session) kept on disk */
+typedef struct {
+    char* dir;                 /* Segment directory (NULL = disabled) */
+    spill_segment_t* segments; /* Oldest first */
+    int segment_count;
+    int segment_capacity;
+    int count;             /* Lines on disk (the oldest reachable lines) */
+    size_t bytes;          /* Bytes of segment files */
+    unsigned long dropped; /* Evicted lines lost because no segment could be created */
+} spill_t;
+
+/* Header and columns of a session image, before the text is written */
+typedef struct {
+    segment_header_t header; /* Complete layout, count and sizes */
+    uint64_t* offsets;
+    int32_t* ts_deltas;
+    uint16_t* tag_ids;
+    uint8_t* contexts;
+} session_columns_t;
+
+/* Tee log writer (smartterm_tee.c) */
+typedef struct tee_log tee_log_t;
+
+/*
+ * Output buffer structure
+ *
+ * Lines are stored column-wise in a ring of slots: ring position p lives
+ * in slot (head + p) % capacity of every column. Metadata columns are
+ * dense, so scans over context, tag or timestamp never pull in line text.
+ *
+ * With spilling enabled the oldest spill.count lines live in segment
+ * files instead; line index i is on disk for i < spill.count and at ring
+ * position i - spill.count otherwise.
+ */
+typedef struct {
+    char** text;             /* Line text */
+    unsigned char* contexts; /* Context type (0-255) */
+    int* ts_deltas;          /* Timestamp relative to ts_base (clamped) */
+    unsigned short* tag_ids; /* Interned tag (0 = none) */
+    long ts_base;            /* Reference timestamp for ts_deltas */
+    int head;                /* Slot of ring position 0 */
+    int count;               /* Reachable lines (spilled + in memory) */
+    int capacity;      /* Allocated slots (grows up to max_lines) */
+    int max_lines;     /* Line limit */
+    size_t max_bytes;  /* Memory budget (0 = unlimited) */
+    size_t text_bytes; /* Bytes of line text, including terminators */
     int scroll_offset;
     bool auto_scroll;
+    unsigned long base_seq; /* Sequence number of line 0 */
+    tag_table_t tags;       /* Interned line tags */
+    cold_tier_t cold;       /* Compressed older lines */
+    spill_t spill;          /* Evicted lines on disk */
+    tee_log_t* tee;         /* Copy of every added line to a log (NULL = off) */
+    smartterm_view** views; /* Views kept in sync with this buffer */
+    int view_count;
+    int view_capacity;
     pthread_mutex_t mutex;
 } output_buffer_t;
 
+/* Tier lookups used by the accessors (smartterm_cold.c, smartterm_spill.c) */
+const char* cold_tier_line(output_buffer_t* buf, int index);
+const char* cold_tier_line_private(const output_buffer_t* buf, int index,
+                                   cold_cache_entry_t* entry);
+const char* spill_text(const output_buffer_t* buf, int index);
+int spill_context(const output_buffer_t* buf, int index);
+long spill_timestamp(const output_buffer_t* buf, int index);
+int spill_tag_id(const output_buffer_t* buf, int index);
+
+/*
+ * Ring accessors (buffer mutex held, position in [0, ring count))
+ */
+static inline int buffer_ring_count(const output_buffer_t* buf)
+{
+    return buf->count - buf->spill.count;
+}
+
+static inline unsigned long buffer_ring_seq(const output_buffer_t* buf)
+{
+    return buf->base_seq + buf->spill.count;
+}
+
+static inline int buffer_ring_slot(const output_buffer_t* buf, int position)
+{
+    int slot = buf->head + position;
+    return slot >= buf->capacity ? slot - buf->capacity : slot;
+}
+
+/*
+ * Line accessors (buffer mutex held, index in [0, count))
+ */
+static inline int buffer_slot(const output_buffer_t* buf, int index)
+{
+    return buffer_ring_slot(buf, index - buf->spill.count);
+}
+
+/*
+ * Cold lines are decompressed into the block cache; the pointer stays
+ * valid until COLD_CACHE_BLOCKS other blocks have been read.
+ */
+static inline const char* buffer_text(output_buffer_t* buf, int index)
+{
+    if (index < buf->spill.count) {
+        return spill_text(buf, index);
+    }
+    const char* text = buf->text[buffer_slot(buf, index)];
+    return text ? text : cold_tier_line(buf, index);
+}
+
+/*
+ * Same as buffer_text(), but cold lines are decompressed into a
+ * caller-owned entry instead of the shared cache. Safe for several
+ * threads at once while the mutex is held on their behalf.
+ */
+static inline const char* buffer_text_private(const output_buffer_t* buf, int index,
+                                              cold_cache_entry_t* entry)
+{
+    if (index < buf->spill.count) {
+        return spill_text(buf, index);
+    }
+    const char* text = buf->text[buffer_slot(buf, index)];
+    return text ? text : cold_tier_line_private(buf, index, entry);
+}
+
+static inline smartterm_context_t buffer_context(const output_buffer_t* buf, int index)
+{
+    if (index < buf->spill.count) {
+        return (smartterm_context_t)spill_context(buf, index);
+    }
+    return (smartterm_context_t)buf->contexts[buffer_slot(buf, index)];
+}
+
+static inline long buffer_timestamp(const output_buffer_t* buf, int index)
+{
+    if (index < buf->spill.count) {
+        return spill_timestamp(buf, index);
+    }
+    return buf->ts_base + buf->ts_deltas[buffer_slot(buf, index)];
+}
+
+static inline int buffer_tag_id(const output_buffer_t* buf, int index)
+{
+    if (index < buf->spill.count) {
+        return spill_tag_id(buf, index);
+    }
+    return buf->tag_ids[buffer_slot(buf, index)];
+}
+
+/* Filtered view over the output buffer */
+struct smartterm_view {
+    smartterm_ctx* ctx;
+
+    /* Predicate */
+    bool hidden[VIEW_CONTEXT_SLOTS]; /* Contexts filtered out */
+    int tag_id;                      /* Required tag ID (-1 = any) */
+    char* substring;                 /* Required substring (NULL = any) */
+
+    /* Viewport */
+    unsigned long top_seq; /* Sequence number of top visible line */
+    bool follow;           /* Stick to the newest matching lines */
+
+    /* Matching line count, maintained on append/evict (-1 = unknown) */
+    int match_count;
+
+    /* Newest matches, oldest first, maintained on append/evict for follow mode */
+    unsigned long recent[VIEW_RECENT_MATCHES]; /* Ring of sequence numbers */
+    int recent_head;
+    int recent_count;
+    bool recent_valid; /* Ring holds the newest recent_count matches */
+    bool recent_all;   /* No older line matches */
+};
+
 /* Theme structure */
 struct smartterm_theme {
     char name[MAX_THEME_NAME];
@@ -53,18 +331,444 @@ typedef struct {
     int current_result;
 } search_state_t;
 
-/* Completion state */
+/* Results cached for each dynamic source and word */
+#define COMPLETION_CACHE_SIZE 32
+
+/* Radix trie node; labels point into the trie's chars */
+typedef struct {
+    int label;                      /* Offset of edge label */
+    int length;                     /* Label bytes */
+    int child;                      /* First child (-1 = none); children sorted by byte */
+    int sibling;                    /* Next sibling (-1 = none) */
+    bool terminal;                  /* A word ends here */
+} trie_node_t;
+
+/* Vocabulary as a radix trie (node 0 = root) */
+typedef struct {
+    trie_node_t* nodes;
+    int node_count;
+    int node_capacity;
+    char* chars;                    /* Word tails the labels point into */
+    size_t chars_used;
+    size_t chars_capacity;
+} completion_trie_t;
+
+/* Registered vocabulary or dynamic source */
+typedef struct {
+    int id;
+    smartterm_complete_scope_t scope;
+    int flags;                      /* SOURCE_* */
+    completion_trie_t trie;         /* Vocabulary (fn == NULL) */
+    smartterm_completion_source_fn fn;
+    void* data;
+} completion_source_t;
+
+/* Results of a dynamic source for one word */
+typedef struct {
+    int source;                     /* Source id (0 = empty slot) */
+    char* context;                  /* Line before the word */
+    char* word;
+    char** results;                 /* NULL-terminated, as returned by the source */
+    unsigned long used;             /* For least recently used replacement */
+} completion_cache_t;
+
+/* Lookup for the async worker */
+typedef struct completion_job {
+    int source;
+    smartterm_completion_source_fn fn;
+    void* data;
+    char* line;                     /* Line copy; the word is [start, end) */
+    int start;
+    int end;
+    struct completion_job* next;
+} completion_job_t;
+
+/*
+ * Completion state (smartterm_completion.c)
+ *
+ * Sources and cache are guarded by the screen mutex, the job queue by
+ * job_mutex. The worker runs one lookup at a time without locks, then
+ * stores the results under the screen mutex. Lock order: screen, job.
+ */
 typedef struct {
-    smartterm_completer_fn completer;
+    smartterm_completer_fn completer; /* Legacy callback (smartterm_set_completer) */
     void* user_data;
+    completion_source_t* sources;
+    int source_count;
+    int source_capacity;
+    int next_id;
+    completion_cache_t cache[COMPLETION_CACHE_SIZE];
+    unsigned long cache_clock;
+
+    /* Async worker */
+    pthread_mutex_t job_mutex;
+    pthread_cond_t job_cond;        /* Jobs queued, stop, or running lookup finished */
+    completion_job_t* jobs;         /* Queued, oldest first */
+    completion_job_t* running;      /* Lookup in progress (owned by worker) */
+    bool stop;
+    bool worker_started;
+    pthread_t worker;
 } completion_state_t;
 
-/* Key handler entry */
+/* Length of formatted timestamp ("YYYY-MM-DD HH:MM:SS") */
+#define TIME_FORMAT_LENGTH 19
+
+/* Timestamp formatter cache (zero-initialize before use) */
+typedef struct {
+    bool valid;     /* text holds a formatted minute */
+    bool tz_loaded; /* time_format_init() called */
+    long minute;    /* Timestamp at second 0 of cached minute */
+    char text[32];  /* Formatted time, seconds patched per call */
+} time_format_cache_t;
+
+/* Export escaping rules */
+typedef enum {
+    ESCAPE_HTML, /* HTML entities */
+    ESCAPE_JSON, /* JSON string escapes */
+    ESCAPE_ANSI  /* Caret notation for control characters */
+} escape_kind_t;
+
+/* Longest replacement for one byte ("\u001f") */
+#define ESCAPE_MAX_SEQUENCE 8
+
+/* Lines queued for the tee log before producers are refused one */
+#define TEE_QUEUE_BYTES (4 * 1024 * 1024)
+
+/* Queued tee line; text and tag name are NUL-terminated in the arena */
+typedef struct {
+    size_t text_at;        /* Arena offset of text */
+    size_t tag_at;         /* Arena offset of tag name (SIZE_MAX = none) */
+    size_t out_end;        /* End of formatted line in the writer's output */
+    long timestamp;        /* Line timestamp */
+    unsigned char context; /* Context type */
+} tee_record_t;
+
+/* Tee lines in arrival order */
+typedef struct {
+    tee_record_t* records;
+    int count;
+    int capacity;
+    char* arena;
+    size_t arena_used;
+    size_t arena_capacity;
+} tee_queue_t;
+
+/*
+ * Tee log
+ *
+ * Producers append to pending under the tee mutex and never touch the
+ * file. The writer thread swaps pending with batch and writes the whole
+ * batch with one call, so lines that arrive during a write or fsync are
+ * committed together with the next batch.
+ */
+struct tee_log {
+    int fd;                           /* Log file, opened for appending */
+    smartterm_export_format_t format; /* PLAIN, ANSI or JSONL */
+    bool include_meta;                /* Timestamps in PLAIN/ANSI lines */
+    int sync_ms;                      /* fsync deadline after first unsynced write (0 = none) */
+    size_t sync_bytes;                /* fsync after this many unsynced bytes (0 = none) */
+    pthread_t thread;
+
+    /* Shared with producers (tee mutex) */
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;           /* Writer: lines queued, flush or stop requested */
+    pthread_cond_t flushed;        /* Flushers: flush_done advanced */
+    tee_queue_t pending;           /* Lines not yet taken by the writer */
+    unsigned long flush_requested; /* Flush generation asked for */
+    unsigned long flush_done;      /* Flush generation on disk */
+    bool stop;                     /* Drain pending and exit */
+    smartterm_tee_status_t status; /* Counters and last error */
+
+    /* Writer thread only */
+    tee_queue_t batch;           /* Lines being written */
+    char* out;                   /* Formatted batch */
+    size_t out_capacity;
+    time_format_cache_t clock;   /* Timestamp formatter */
+    size_t unsynced;             /* Bytes written since the last fsync */
+    struct timespec dirty_since; /* First write since the last fsync (monotonic) */
+    bool torn;                   /* Log ends inside a line that could not be removed */
+};
+
+/* Rows below the status bar: input line and completion hints */
+#define INPUT_HEIGHT 2
+
+/* Output rows kept when multi-line input grows (border and one line) */
+#define MULTILINE_MIN_OUTPUT 3
+
+/* Wait after ESC for the rest of a key sequence (ncurses default is 1s) */
+#define INPUT_ESCAPE_DELAY_MS 25
+
+/* Extra history file lines (beyond twice the live entries) before compaction */
+#define HISTORY_COMPACT_SLACK 256
+
+/* History entry */
+typedef struct {
+    char* text;
+    unsigned int seq;               /* Increases with each entry added */
+    unsigned int uses;              /* Times entered (copies in the loaded file included) */
+} history_entry_t;
+
+/* Entries containing one n-gram, ascending seq (removed entries included) */
+typedef struct {
+    unsigned int* seqs;
+    int count;
+    int capacity;
+} history_postings_t;
+
+/*
+ * N-gram index over history entries (smartterm_history_search.c)
+ *
+ * Exact posting lists for every 1-, 2- and 3-byte substring. Built in
+ * the background when history is loaded (or by the first search) and
+ * extended as entries are added; removed entries stay in the lists until
+ * there are more of them than live entries.
+ */
+typedef struct {
+    bool built;
+    bool builder_started;           /* builder needs joining */
+    pthread_t builder;
+    int dead;                       /* Removed entries still in the lists */
+    history_postings_t* bytes;      /* 1-grams, by byte */
+    history_postings_t* pairs;      /* 2-grams, by byte pair */
+    history_postings_t* triples;    /* 3-grams, open addressing by trigram_keys */
+    unsigned int* trigram_keys;     /* Trigram + (1 << 24) (0 = empty slot) */
+    unsigned int trigram_slots;     /* Power of two, at least twice trigram_count */
+    unsigned int trigram_count;
+} history_index_t;
+
+/*
+ * Input history, oldest first (smartterm_history.c)
+ *
+ * Entries are unique; re-entering a line moves it to the end. With a
+ * history file, each new entry is appended with one write and the file is
+ * rewritten in the background once stale lines pile up.
+ */
+typedef struct {
+    history_entry_t* entries;
+    int count;
+    int capacity;
+    int limit;                      /* Max entries (history_size, < 0 = unlimited) */
+    unsigned int next_seq;
+    history_index_t index;
+    char* path;                     /* History file (NULL = memory only) */
+    bool compactor_started;         /* compactor needs joining */
+    pthread_t compactor;
+
+    /* Shared with the compactor thread */
+    pthread_mutex_t file_mutex;
+    int fd;                         /* Append descriptor (-1 = none) */
+    int file_lines;                 /* Lines in the file, stale ones included */
+    bool compacting;                /* Compactor running; appends go to tail */
+    char* tail;                     /* Lines appended while compacting */
+    size_t tail_used;
+    size_t tail_capacity;
+} input_history_t;
+
+/* Search candidates for one query length (removed entries included) */
+typedef struct {
+    const unsigned int* seqs;       /* Candidate seqs, ascending */
+    int count;
+    bool owned;                     /* seqs allocated for this level, not an index list */
+    bool verify;                    /* Candidates may not match; check before ranking */
+} history_level_t;
+
+/* Match being ranked */
+typedef struct {
+    int pos;                        /* Entry index */
+    float score;
+} history_match_t;
+
+/*
+ * Incremental history search (Ctrl-R)
+ *
+ * levels[n] holds the candidates for the first n query bytes, so a
+ * longer query narrows the previous level and backspace returns to it
+ * without searching again. Ranking scans the last level from its newest
+ * candidate and stops once no older one can beat the best found.
+ */
+typedef struct {
+    bool active;
+    char* query;                    /* NUL-terminated */
+    int length;
+    history_level_t* levels;        /* levels[1..length] (level 0 = empty query) */
+    int capacity;                   /* Allocated query bytes and levels */
+    int* pos_of_seq;                /* Entry index by seq (-1 = removed) */
+    unsigned int* max_uses;         /* Highest uses among entries[0..i] */
+    history_match_t* heap;          /* Scanned matches not yet ranked */
+    int heap_count;
+    int heap_capacity;
+    int* ranked;                    /* Entry indexes, best first */
+    int ranked_count;
+    int ranked_capacity;
+    int scan;                       /* Next candidate to score, counting down */
+    int rank;                       /* Result shown */
+    char* original;                 /* Line before the search, for Ctrl-G */
+    size_t original_cursor;
+    char* last_query;               /* Previous search, for Ctrl-R on an empty query */
+} history_search_t;
+
+/*
+ * Gap buffer: text before the gap, free space, then the text after it
+ *
+ * The gap sits at the cursor, so typing and deleting there move no text;
+ * moving the cursor moves only the bytes it passes over.
+ */
+typedef struct {
+    char* data;
+    size_t capacity;                /* Allocated bytes, gap included */
+    size_t gap_start;               /* Offset of the gap, i.e. the cursor */
+    size_t gap_end;                 /* First byte after the gap */
+} gap_buffer_t;
+
+/*
+ * Multi-line input editor (smartterm_multiline.c)
+ *
+ * Used by smartterm_read_multiline(). Lines are counted around the cursor
+ * instead of indexed. The input window grows one row per line up to a
+ * limit, and only rows whose lines changed are redrawn.
+ */
+typedef struct {
+    bool active;
+    gap_buffer_t text;
+    int line_count;                 /* Line breaks + 1 */
+    int cursor_line;                /* Line the cursor is on */
+    int goal_column;                /* Column Up/Down keep to (-1 = the cursor's) */
+    int top_line;                   /* First line shown */
+    size_t top_offset;              /* Offset where top_line starts */
+    int column_scroll;              /* First column shown on every line */
+    int dirty_from;                 /* Lines to redraw (none when dirty_from > dirty_to) */
+    int dirty_to;
+    int drawn_rows;                 /* Window size of the last draw, to catch resizes */
+    int drawn_cols;
+} multiline_editor_t;
+
+/* Line editor state */
+typedef enum {
+    EDITOR_IDLE,     /* No line requested */
+    EDITOR_EDITING,  /* Line in progress */
+    EDITOR_ACCEPTED, /* Enter pressed; line ready */
+    EDITOR_EOF       /* Ctrl-D on empty line, or input closed */
+} editor_state_t;
+
+/*
+ * Input line editor
+ *
+ * Keys are fed one at a time from the input window, so a line can be
+ * edited while other threads keep writing output. Positions are byte
+ * offsets; motion and deletion step over whole UTF-8 sequences.
+ */
+typedef struct {
+    char* text;                     /* Line being edited (NUL-terminated) */
+    size_t length;                  /* Bytes in text */
+    size_t capacity;                /* Allocated bytes */
+    size_t cursor;                  /* Byte offset of cursor */
+    size_t scroll;                  /* First byte shown (horizontal scroll) */
+    char prompt[MAX_PROMPT_LENGTH]; /* Prompt for this line */
+    editor_state_t state;
+    bool meta;                      /* ESC pressed: next key is Meta-key */
+    char* kill;                     /* Last killed text, for yank */
+    input_history_t history;
+    int history_pos;                /* Entry shown (history.count = the new line) */
+    char* saved;                    /* New line kept while browsing history */
+    history_search_t search;
+    char* hint;                     /* Second input row text (completion candidates) */
+    char** candidates;              /* Completions listed in hint, narrowed while typing */
+    int candidate_count;
+    bool completion_waiting;        /* Tab waits for async sources; cleared by other keys */
+
+    /* Bracketed paste */
+    bool pasting;                   /* Between paste start and end markers */
+    char* paste;                    /* Bytes pasted so far */
+    size_t paste_length;
+    size_t paste_capacity;
+    char* queued;                   /* Pasted lines not yet returned (NULL = none) */
+    size_t queued_pos;              /* Start of the next one */
+    smartterm_paste_handler_fn paste_handler;
+    void* paste_data;
+
+    multiline_editor_t multiline;   /* Takes keys and drawing while active */
+} line_editor_t;
+
+/* Minimum time between output frames in event loop mode */
+#define LOOP_FRAME_MS 16
+
+/*
+ * Event loop integration (smartterm_loop.c, screen mutex)
+ *
+ * Created by smartterm_get_fd(). While active, output is not drawn by the
+ * writing thread; it bumps wake_fd and smartterm_step() renders it.
+ */
+typedef struct {
+    int poll_fd;                          /* epoll set for the application (-1 = off) */
+    int wake_fd;                          /* eventfd: output waiting to be rendered */
+    int timer_fd;                         /* timerfd: deferred frame due */
+    bool watching_input;                  /* Terminal input is in the epoll set */
+    bool render_pending;                  /* Output waiting for the next frame */
+    struct timespec last_frame;           /* Last output frame (monotonic) */
+    smartterm_line_handler_fn line_handler;
+    void* line_data;
+} event_loop_t;
+
+/* Escape key (prefix for Meta bindings) */
+#define KEY_ESCAPE 27
+
+/* Control key code */
+#define CTRL_KEY(c) ((c) & 0x1f)
+
+/* Bracketed paste markers, bound with define_key() past the KEY_* range */
+#define KEY_PASTE_START (KEY_MAX + 1)
+#define KEY_PASTE_END (KEY_MAX + 2)
+
+/* Key codes from wgetch(): bytes and KEY_* (direct-indexed in keymaps) */
+#define KEYMAP_KEYS (KEY_MAX + 1)
+
+/* Longest key sequence a keymap binds */
+#define KEYMAP_MAX_SEQUENCE 8
+
+/* What a key does at one point of a sequence */
+typedef struct {
+    smartterm_key_handler_fn handler; /* Complete binding (NULL = none) */
+    void* data;
+    int next;                       /* Node of following keys (-1 = not a prefix) */
+} key_binding_t;
+
+/* Key after a prefix */
 typedef struct {
     int key;
-    smartterm_key_handler_fn handler;
-    void* user_data;
-} key_handler_entry_t;
+    key_binding_t binding;
+} key_edge_t;
+
+/* Keys that may follow a prefix, sorted by key */
+typedef struct {
+    key_edge_t* edges;
+    int count;
+    int capacity;
+} key_node_t;
+
+/*
+ * Keymap: first keys are direct-indexed, later keys of sequences live in
+ * a trie of sorted edge arrays
+ */
+struct smartterm_keymap {
+    smartterm_ctx* ctx;
+    key_binding_t keys[KEYMAP_KEYS];
+    key_node_t* nodes;
+    int node_count;
+    int node_capacity;
+};
+
+/* Key dispatch state (screen mutex) */
+typedef struct {
+    smartterm_keymap* global;       /* smartterm_register_key_handler() bindings */
+    smartterm_keymap* active;       /* Modal keymap looked up first (NULL = none) */
+    smartterm_keymap** maps;        /* All keymaps, freed with the context */
+    int map_count;
+    int map_capacity;
+    const smartterm_keymap* pending_map; /* Keymap of the sequence being typed */
+    int pending_node;
+    int pending[KEYMAP_MAX_SEQUENCE]; /* Keys of the sequence so far */
+    int pending_count;
+} key_dispatch_t;
 
 /* SmartTerm context structure */
 struct smartterm_ctx {
@@ -77,6 +781,17 @@ struct smartterm_ctx {
     /* ncurses windows */
     WINDOW* output_win;
     WINDOW* status_win;
+    WINDOW* input_win;
+
+    /* ncurses screen of this session; tty streams are NULL on stdin/stdout */
+    SCREEN* screen;
+    FILE* tty_in;
+    FILE* tty_out;
+    int input_fd;                   /* Descriptor keys arrive on */
+
+    /* Serializes this session's curses calls and status text (recursive) */
+    pthread_mutex_t screen_mutex;
+    int screen_depth;               /* screen_lock() nesting of the owning thread */
 
     /* Status bar text */
     char status_left[MAX_STATUS_TEXT];
@@ -93,6 +808,10 @@ struct smartterm_ctx {
     /* Terminal size */
     int term_rows;
     int term_cols;
+    int input_height;               /* Input window rows (grows for multi-line input) */
+
+    /* Active filtered view (NULL = raw buffer) */
+    smartterm_view* active_view;
 
     /* Search state */
     search_state_t search;
@@ -100,10 +819,17 @@ struct smartterm_ctx {
     /* Completion */
     completion_state_t completion;
 
-    /* Key handlers */
-    key_handler_entry_t* key_handlers;
-    int key_handler_count;
-    int key_handler_capacity;
+    /* Input line editor (screen mutex) */
+    line_editor_t editor;
+
+    /* Event loop integration */
+    event_loop_t loop;
+
+    /* Keymaps */
+    key_dispatch_t keys;
+
+    /* Background exports not yet waited for (guarded by buffer mutex) */
+    smartterm_export_job* export_jobs;
 
     /* Error state */
     int last_error;
@@ -118,28 +844,161 @@ struct smartterm_ctx {
  */
 
 /* Output buffer functions (smartterm_output.c) */
-int output_buffer_init(output_buffer_t* buf, int capacity, bool thread_safe);
+int output_buffer_init(output_buffer_t* buf, const smartterm_config_t* config);
 void output_buffer_cleanup(output_buffer_t* buf);
-int output_buffer_add(output_buffer_t* buf, const char* text, const smartterm_line_meta_t* meta);
+int output_buffer_add(output_buffer_t* buf, const char* text, const smartterm_line_meta_t* meta,
+                      unsigned long* seq);
+int output_buffer_update(output_buffer_t* buf, unsigned long seq, const char* text);
 void output_buffer_clear(output_buffer_t* buf);
+void output_buffer_clear_locked(output_buffer_t* buf);
 const char* output_buffer_get_line(output_buffer_t* buf, int index);
+char* output_buffer_copy_line(output_buffer_t* buf, int index);
 int output_buffer_get_line_meta(output_buffer_t* buf, int index, smartterm_line_meta_t* meta);
 
+/* Tag table functions (smartterm_tags.c) */
+void tag_table_cleanup(tag_table_t* table);
+int tag_table_find(const tag_table_t* table, const char* name);
+int tag_table_intern(tag_table_t* table, const char* name);
+const char* tag_table_name(const tag_table_t* table, int id);
+size_t tag_table_bytes(const tag_table_t* table);
+
+/* Cold tier functions (smartterm_cold.c) */
+void cold_tier_cleanup(cold_tier_t* cold);
+void cold_tier_clear(cold_tier_t* cold, unsigned long seq);
+int cold_tier_lines(const output_buffer_t* buf);
+int cold_tier_compress(output_buffer_t* buf);
+void cold_tier_evict(output_buffer_t* buf);
+size_t cold_tier_bytes(const cold_tier_t* cold);
+
+/* Spill functions (smartterm_spill.c) */
+int spill_init(spill_t* spill, const char* dir);
+void spill_cleanup(spill_t* spill);
+void spill_clear(spill_t* spill);
+int spill_append(output_buffer_t* buf);
+void spill_drop_oldest(output_buffer_t* buf);
+void spill_drop_line(output_buffer_t* buf);
+void spill_renumber(output_buffer_t* buf);
+int spill_context_count(const output_buffer_t* buf, unsigned char context);
+spill_segment_t* spill_reserve_segment(spill_t* spill);
+uint64_t segment_layout(segment_header_t* header, uint32_t capacity, long ts_base);
+int32_t segment_delta(long timestamp, long ts_base);
+int segment_map(spill_segment_t* segment, int fd, size_t size, bool writable);
+
+/* Session images (smartterm_session.c) */
+int session_columns_build(session_columns_t* columns, output_buffer_t* buf, int start, int count);
+void session_columns_free(session_columns_t* columns);
+
+/* LZ block codec (smartterm_lz.c) */
+size_t lz_compress_bound(size_t size);
+size_t lz_compress(const void* src, size_t size, void* dst, size_t cap);
+int lz_decompress(const void* src, size_t size, void* dst, size_t cap, size_t* out_size);
+
+/* View functions (smartterm_view.c) */
+bool view_matches(const smartterm_view* view, output_buffer_t* buf, int index);
+void view_on_append(output_buffer_t* buf, int index);
+void view_on_evict(output_buffer_t* buf, int index);
+void view_on_renumber(output_buffer_t* buf, unsigned long seq);
+void view_on_clear(output_buffer_t* buf);
+void view_invalidate_counts(output_buffer_t* buf);
+int view_collect(smartterm_view* view, int rows, int* indices);
+int view_top_index(smartterm_view* view, int rows);
+void view_scroll(smartterm_view* view, int lines, int rows);
+void view_scroll_to(smartterm_view* view, int index);
+void view_follow(smartterm_view* view);
+
+/* Screen lock (smartterm_core.c): session's screen mutex, then the process-wide curses lock */
+void screen_lock(smartterm_ctx* ctx);
+void screen_unlock(smartterm_ctx* ctx);
+void layout_windows(smartterm_ctx* ctx);
+
 /* Rendering functions (smartterm_render.c) */
 int render_output(smartterm_ctx* ctx);
+int render_output_frame(smartterm_ctx* ctx);
+int render_output_line(smartterm_ctx* ctx, unsigned long seq);
+int render_page_rows(smartterm_ctx* ctx);
 int render_status(smartterm_ctx* ctx);
 int render_all(smartterm_ctx* ctx);
+void render_update(smartterm_ctx* ctx);
 
 /* Input functions (smartterm_input.c) */
 char* input_read_line(smartterm_ctx* ctx, const char* prompt);
 char* input_read_multiline(smartterm_ctx* ctx, const char* prompt);
-int input_suspend_ncurses(smartterm_ctx* ctx);
-int input_resume_ncurses(smartterm_ctx* ctx);
+int input_process_keys(smartterm_ctx* ctx);
+
+/* Event loop functions (smartterm_loop.c) */
+void loop_init(smartterm_ctx* ctx);
+void loop_cleanup(smartterm_ctx* ctx);
+void loop_request_frame(smartterm_ctx* ctx);
+
+/* History functions (smartterm_history.c, screen mutex held) */
+void history_open(input_history_t* history, const smartterm_config_t* config);
+void history_close(input_history_t* history);
+void history_add(input_history_t* history, const char* line);
+
+/* Completion functions (smartterm_completion.c) */
+void completion_init(smartterm_ctx* ctx);
+void completion_cleanup(smartterm_ctx* ctx);
+char** completion_collect(smartterm_ctx* ctx, const char* line, int start, int end, int* count,
+                          bool* pending);
+void completion_free(char** candidates, int count);
+
+/* History search functions (smartterm_history_search.c, screen mutex held) */
+void history_index_start(input_history_t* history);
+void history_index_wait(input_history_t* history);
+void history_index_add(input_history_t* history, int pos);
+void history_index_free(history_index_t* index);
+bool history_search_start(history_search_t* search, input_history_t* history);
+bool history_search_push(history_search_t* search, input_history_t* history, char c);
+void history_search_pop(history_search_t* search);
+int history_search_result(history_search_t* search, input_history_t* history, int rank);
+void history_search_end(history_search_t* search);
+
+/* Line editor functions (smartterm_editor.c, screen mutex held) */
+void editor_cleanup(line_editor_t* editor);
+void editor_begin(smartterm_ctx* ctx, const char* prompt);
+void editor_key(smartterm_ctx* ctx, int key);
+void editor_paste(smartterm_ctx* ctx, int key);
+char* editor_take_line(smartterm_ctx* ctx);
+void editor_draw(smartterm_ctx* ctx);
+void editor_completion_ready(smartterm_ctx* ctx);
+
+/* Multi-line editor functions (smartterm_multiline.c, screen mutex held) */
+void multiline_begin(smartterm_ctx* ctx);
+void multiline_end(smartterm_ctx* ctx);
+void multiline_key(smartterm_ctx* ctx, int key);
+void multiline_insert(smartterm_ctx* ctx, const char* s, size_t len);
+char* multiline_text(const multiline_editor_t* ml);
+void multiline_draw(smartterm_ctx* ctx);
+void multiline_cleanup(multiline_editor_t* ml);
+
+/* Key handler functions (smartterm_keyhandler.c) */
+int keymap_init(smartterm_ctx* ctx);
+void keymap_cleanup(smartterm_ctx* ctx);
+void keymap_dispatch(smartterm_ctx* ctx, int key);
+
+/* Export functions (smartterm_export.c) */
+void export_jobs_cleanup(smartterm_ctx* ctx);
+int export_tee_write(tee_log_t* tee, size_t* written, int* lines);
+
+/* Tee log (smartterm_tee.c) */
+int tee_log_open(tee_log_t** tee_out, const smartterm_config_t* config);
+void tee_log_close(tee_log_t* tee);
+void tee_log_append(tee_log_t* tee, const char* text, size_t len, smartterm_context_t context,
+                    long timestamp, const char* tag);
 
 /* Theme functions (smartterm_theme.c) */
 const smartterm_theme* theme_get_default(void);
 int theme_apply_colors(smartterm_ctx* ctx);
 
+/* Export escaping (smartterm_escape.c) */
+size_t escape_span(escape_kind_t kind, const char* s, size_t len);
+size_t escape_sequence(escape_kind_t kind, unsigned char c, char out[ESCAPE_MAX_SEQUENCE]);
+size_t escape_length(escape_kind_t kind, const char* s, size_t len);
+
+/* Timestamp formatting (smartterm_time.c) */
+void time_format_init(time_format_cache_t* cache);
+const char* time_format(time_format_cache_t* cache, long timestamp);
+
 /* Utility functions */
 long get_timestamp(void);
 char* strdup_safe(const char* s);
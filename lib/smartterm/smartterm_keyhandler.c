@@ -1,52 +1,438 @@
 /*
  * SmartTerm Library - Key Handler Implementation
  *
- * Custom key handler registration and management.
+ * Keymaps bind keys and key sequences ("C-x C-s") to handlers. The first
+ * key indexes a table of every wgetch() code directly; the keys after a
+ * prefix are found by binary search in the prefix's trie node. A modal
+ * keymap is looked up before the global one, and switching it only
+ * swaps a pointer. Dispatch never allocates.
  */
 
 #include "smartterm_internal.h"
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Key names for smartterm_keymap_bind() */
+static const struct {
+    const char* name;
+    int key;
+} key_names[] = {
+    {"Esc", KEY_ESCAPE},
+    {"Tab", '\t'},
+    {"Enter", '\n'},
+    {"Space", ' '},
+    {"Backspace", KEY_BACKSPACE},
+    {"Delete", KEY_DC},
+    {"Insert", KEY_IC},
+    {"Home", KEY_HOME},
+    {"End", KEY_END},
+    {"PageUp", KEY_PPAGE},
+    {"PageDown", KEY_NPAGE},
+    {"Up", KEY_UP},
+    {"Down", KEY_DOWN},
+    {"Left", KEY_LEFT},
+    {"Right", KEY_RIGHT},
+};
 
 /*
- * Register key handler
+ * Get key code of one key name (-1 = unknown)
  */
-int smartterm_register_key_handler(smartterm_ctx* ctx, int key, smartterm_key_handler_fn handler,
-                                   void* data)
+static int key_from_name(const char* name, size_t len)
+{
+    if (len == 1) {
+        return (unsigned char)name[0];
+    }
+    if ((name[0] == 'F' || name[0] == 'f') && (len == 2 || len == 3)) {
+        int n = atoi(name + 1);
+        if (n >= 1 && n <= 12 && name[1] != '0' && (len == 2 || n >= 10)) {
+            return KEY_F(n);
+        }
+    }
+    for (size_t i = 0; i < sizeof(key_names) / sizeof(key_names[0]); i++) {
+        if (strlen(key_names[i].name) == len && strncasecmp(key_names[i].name, name, len) == 0) {
+            return key_names[i].key;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Parse key sequence into codes; returns key count (-1 = invalid)
+ */
+static int keymap_parse(const char* spec, int keys[KEYMAP_MAX_SEQUENCE])
+{
+    int count = 0;
+    const char* p = spec;
+
+    while (*p) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        const char* end = strchr(p, ' ');
+        if (!end) {
+            end = p + strlen(p);
+        }
+
+        bool ctrl = false;
+        bool meta = false;
+        while (end - p > 2 && p[1] == '-' && (p[0] == 'C' || p[0] == 'M')) {
+            ctrl = ctrl || p[0] == 'C';
+            meta = meta || p[0] == 'M';
+            p += 2;
+        }
+
+        /* Meta arrives as Esc followed by the key */
+        if (meta) {
+            if (count == KEYMAP_MAX_SEQUENCE) {
+                return -1;
+            }
+            keys[count++] = KEY_ESCAPE;
+        }
+
+        /* UTF-8 characters arrive byte by byte */
+        if ((unsigned char)*p >= 0x80 && !ctrl) {
+            for (; p < end; p++) {
+                if (count == KEYMAP_MAX_SEQUENCE) {
+                    return -1;
+                }
+                keys[count++] = (unsigned char)*p;
+            }
+            continue;
+        }
+
+        int key = key_from_name(p, end - p);
+        if (ctrl) {
+            if (key == ' ') {
+                key = 0;
+            } else if (key == '?') {
+                key = 127;
+            } else if ((key >= '@' && key <= '_') || (key >= 'a' && key <= 'z')) {
+                key &= 0x1f;
+            } else {
+                key = -1;
+            }
+        }
+        if (key < 0 || count == KEYMAP_MAX_SEQUENCE) {
+            return -1;
+        }
+        keys[count++] = key;
+        p = end;
+    }
+
+    return count > 0 ? count : -1;
+}
+
+/*
+ * Check whether binding does anything
+ */
+static bool binding_used(const key_binding_t* binding)
+{
+    return binding && (binding->handler || binding->next >= 0);
+}
+
+/*
+ * Get position of key in node's edges, or where it would be inserted
+ */
+static int keymap_edge_pos(const key_node_t* node, int key)
+{
+    int low = 0;
+    int high = node->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (node->edges[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Find key after a prefix (NULL = none)
+ */
+static key_binding_t* keymap_find(const smartterm_keymap* map, int node, int key)
+{
+    const key_node_t* n = &map->nodes[node];
+    int pos = keymap_edge_pos(n, key);
+    return pos < n->count && n->edges[pos].key == key ? &n->edges[pos].binding : NULL;
+}
+
+/*
+ * Add trie node; returns its index (-1 = no memory)
+ */
+static int keymap_add_node(smartterm_keymap* map)
+{
+    if (map->node_count >= map->node_capacity) {
+        int new_capacity = map->node_capacity ? map->node_capacity * 2 : 4;
+        key_node_t* nodes = realloc(map->nodes, new_capacity * sizeof(key_node_t));
+        if (!nodes) {
+            return -1;
+        }
+        map->nodes = nodes;
+        map->node_capacity = new_capacity;
+    }
+
+    map->nodes[map->node_count] = (key_node_t){NULL, 0, 0};
+    return map->node_count++;
+}
+
+/*
+ * Find or add key after a prefix (NULL = no memory)
+ */
+static key_binding_t* keymap_add_edge(smartterm_keymap* map, int node, int key)
+{
+    key_binding_t* binding = keymap_find(map, node, key);
+    if (binding) {
+        return binding;
+    }
+
+    key_node_t* n = &map->nodes[node];
+    if (n->count >= n->capacity) {
+        int new_capacity = n->capacity ? n->capacity * 2 : 4;
+        key_edge_t* edges = realloc(n->edges, new_capacity * sizeof(key_edge_t));
+        if (!edges) {
+            return NULL;
+        }
+        n->edges = edges;
+        n->capacity = new_capacity;
+    }
+
+    int pos = keymap_edge_pos(n, key);
+    memmove(&n->edges[pos + 1], &n->edges[pos], (n->count - pos) * sizeof(key_edge_t));
+    n->edges[pos] = (key_edge_t){key, {NULL, NULL, -1}};
+    n->count++;
+    return &n->edges[pos].binding;
+}
+
+/*
+ * Remove key after a prefix
+ */
+static void keymap_remove_edge(smartterm_keymap* map, int node, int key)
+{
+    key_node_t* n = &map->nodes[node];
+    int pos = keymap_edge_pos(n, key);
+
+    memmove(&n->edges[pos], &n->edges[pos + 1], (n->count - pos - 1) * sizeof(key_edge_t));
+    if (--n->count == 0) {
+        free(n->edges);
+        *n = (key_node_t){NULL, 0, 0};
+    }
+}
+
+/*
+ * Forget partly typed sequence of map (NULL = any) (screen mutex held)
+ */
+static void keymap_reset_pending(smartterm_ctx* ctx, const smartterm_keymap* map)
 {
-    if (!ctx || !ctx->initialized || !handler) {
+    if (!map || ctx->keys.pending_map == map) {
+        ctx->keys.pending_count = 0;
+        ctx->keys.pending_map = NULL;
+    }
+}
+
+/*
+ * Bind parsed sequence (screen mutex held)
+ */
+static int keymap_bind(smartterm_keymap* map, const int* keys, int count,
+                       smartterm_key_handler_fn handler, void* data)
+{
+    /* Check for conflicts before changing anything */
+    const key_binding_t* existing = &map->keys[keys[0]];
+    for (int i = 1; i < count && existing; i++) {
+        if (existing->handler) {
+            return SMARTTERM_INVALID;
+        }
+        existing = existing->next >= 0 ? keymap_find(map, existing->next, keys[i]) : NULL;
+    }
+    if (existing && existing->next >= 0) {
         return SMARTTERM_INVALID;
     }
 
-    /* Check if we need to expand array */
-    if (ctx->key_handler_count >= ctx->key_handler_capacity) {
-        int new_capacity = ctx->key_handler_capacity * 2;
-        key_handler_entry_t* new_handlers =
-            realloc(ctx->key_handlers, new_capacity * sizeof(key_handler_entry_t));
-        if (!new_handlers) {
+    /* Edge arrays are separate allocations, so bindings survive node growth */
+    key_binding_t* binding = &map->keys[keys[0]];
+    for (int i = 1; i < count; i++) {
+        if (binding->next < 0) {
+            int node = keymap_add_node(map);
+            if (node < 0) {
+                return SMARTTERM_NOMEM;
+            }
+            binding->next = node;
+        }
+        binding = keymap_add_edge(map, binding->next, keys[i]);
+        if (!binding) {
             return SMARTTERM_NOMEM;
         }
-        ctx->key_handlers = new_handlers;
-        ctx->key_handler_capacity = new_capacity;
     }
 
-    /* Check if key already registered (update handler) */
-    for (int i = 0; i < ctx->key_handler_count; i++) {
-        if (ctx->key_handlers[i].key == key) {
-            ctx->key_handlers[i].handler = handler;
-            ctx->key_handlers[i].user_data = data;
-            return SMARTTERM_OK;
+    binding->handler = handler;
+    binding->data = data;
+    return SMARTTERM_OK;
+}
+
+/*
+ * Unbind parsed sequence, pruning prefixes left empty (screen mutex held)
+ */
+static int keymap_unbind(smartterm_keymap* map, const int* keys, int count)
+{
+    key_binding_t* path[KEYMAP_MAX_SEQUENCE];
+    path[0] = &map->keys[keys[0]];
+    for (int i = 1; i < count; i++) {
+        path[i] = path[i - 1]->next >= 0 ? keymap_find(map, path[i - 1]->next, keys[i]) : NULL;
+        if (!path[i]) {
+            return SMARTTERM_ERROR;
         }
     }
+    if (!path[count - 1]->handler) {
+        return SMARTTERM_ERROR;
+    }
 
-    /* Add new handler */
-    ctx->key_handlers[ctx->key_handler_count].key = key;
-    ctx->key_handlers[ctx->key_handler_count].handler = handler;
-    ctx->key_handlers[ctx->key_handler_count].user_data = data;
-    ctx->key_handler_count++;
+    path[count - 1]->handler = NULL;
+    path[count - 1]->data = NULL;
+    for (int i = count - 1; i > 0 && !binding_used(path[i]); i--) {
+        int node = path[i - 1]->next;
+        keymap_remove_edge(map, node, keys[i]);
+        if (map->nodes[node].count > 0) {
+            break;
+        }
+        path[i - 1]->next = -1;
+    }
 
+    keymap_reset_pending(map->ctx, map);
     return SMARTTERM_OK;
 }
 
+/*
+ * Allocate keymap and attach it to the context
+ */
+static smartterm_keymap* keymap_new(smartterm_ctx* ctx)
+{
+    smartterm_keymap* map = calloc(1, sizeof(smartterm_keymap));
+    if (!map) {
+        return NULL;
+    }
+    map->ctx = ctx;
+    for (int i = 0; i < KEYMAP_KEYS; i++) {
+        map->keys[i].next = -1;
+    }
+
+    key_dispatch_t* keys = &ctx->keys;
+    pthread_mutex_lock(&ctx->screen_mutex);
+    if (keys->map_count >= keys->map_capacity) {
+        int new_capacity = keys->map_capacity ? keys->map_capacity * 2 : 4;
+        smartterm_keymap** maps = realloc(keys->maps, new_capacity * sizeof(smartterm_keymap*));
+        if (!maps) {
+            pthread_mutex_unlock(&ctx->screen_mutex);
+            free(map);
+            return NULL;
+        }
+        keys->maps = maps;
+        keys->map_capacity = new_capacity;
+    }
+    keys->maps[keys->map_count++] = map;
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return map;
+}
+
+/*
+ * Release keymap storage
+ */
+static void keymap_release(smartterm_keymap* map)
+{
+    for (int i = 0; i < map->node_count; i++) {
+        free(map->nodes[i].edges);
+    }
+    free(map->nodes);
+    free(map);
+}
+
+/*
+ * Create global keymap
+ */
+int keymap_init(smartterm_ctx* ctx)
+{
+    ctx->keys.global = keymap_new(ctx);
+    return ctx->keys.global ? SMARTTERM_OK : SMARTTERM_NOMEM;
+}
+
+/*
+ * Free all keymaps
+ */
+void keymap_cleanup(smartterm_ctx* ctx)
+{
+    for (int i = 0; i < ctx->keys.map_count; i++) {
+        keymap_release(ctx->keys.maps[i]);
+    }
+    free(ctx->keys.maps);
+    memset(&ctx->keys, 0, sizeof(ctx->keys));
+}
+
+/*
+ * Run the handler bound to key, or pass key to the editor (screen mutex held)
+ */
+void keymap_dispatch(smartterm_ctx* ctx, int key)
+{
+    key_dispatch_t* keys = &ctx->keys;
+    const smartterm_keymap* map = NULL;
+    const key_binding_t* binding = NULL;
+
+    if (key >= 0 && key < KEYMAP_KEYS) {
+        if (keys->pending_count > 0) {
+            map = keys->pending_map;
+            binding = keymap_find(map, keys->pending_node, key);
+        } else {
+            map = keys->active;
+            binding = map ? &map->keys[key] : NULL;
+            if (!binding_used(binding)) {
+                map = keys->global;
+                binding = &map->keys[key];
+            }
+        }
+    }
+
+    /* Unbound: the editor gets the sequence typed so far */
+    if (!binding_used(binding)) {
+        int count = keys->pending_count;
+        keymap_reset_pending(ctx, NULL);
+        for (int i = 0; i < count; i++) {
+            editor_key(ctx, keys->pending[i]);
+        }
+        editor_key(ctx, key);
+        return;
+    }
+
+    if (binding->handler) {
+        keymap_reset_pending(ctx, NULL);
+        binding->handler(ctx, key, binding->data);
+        return;
+    }
+
+    /* Prefix: wait for the next key */
+    keys->pending[keys->pending_count++] = key;
+    keys->pending_map = map;
+    keys->pending_node = binding->next;
+}
+
+/*
+ * Register key handler
+ */
+int smartterm_register_key_handler(smartterm_ctx* ctx, int key, smartterm_key_handler_fn handler,
+                                   void* data)
+{
+    if (!ctx || !ctx->initialized || !handler || key < 0 || key >= KEYMAP_KEYS) {
+        return SMARTTERM_INVALID;
+    }
+
+    pthread_mutex_lock(&ctx->screen_mutex);
+    int result = keymap_bind(ctx->keys.global, &key, 1, handler, data);
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return result;
+}
+
 /*
  * Unregister key handler
  */
@@ -55,38 +441,121 @@ int smartterm_unregister_key_handler(smartterm_ctx* ctx, int key)
     if (!ctx || !ctx->initialized) {
         return SMARTTERM_NOTINIT;
     }
+    if (key < 0 || key >= KEYMAP_KEYS) {
+        return SMARTTERM_ERROR; /* Key not found */
+    }
 
-    /* Find and remove handler */
-    for (int i = 0; i < ctx->key_handler_count; i++) {
-        if (ctx->key_handlers[i].key == key) {
-            /* Shift remaining handlers down */
-            for (int j = i; j < ctx->key_handler_count - 1; j++) {
-                ctx->key_handlers[j] = ctx->key_handlers[j + 1];
-            }
-            ctx->key_handler_count--;
-            return SMARTTERM_OK;
+    pthread_mutex_lock(&ctx->screen_mutex);
+    int result = keymap_unbind(ctx->keys.global, &key, 1);
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return result;
+}
+
+/*
+ * Create keymap
+ */
+smartterm_keymap* smartterm_keymap_create(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->initialized) {
+        return NULL;
+    }
+    return keymap_new(ctx);
+}
+
+/*
+ * Free keymap
+ */
+void smartterm_keymap_free(smartterm_keymap* map)
+{
+    if (!map || map == map->ctx->keys.global) {
+        return;
+    }
+
+    smartterm_ctx* ctx = map->ctx;
+    key_dispatch_t* keys = &ctx->keys;
+    pthread_mutex_lock(&ctx->screen_mutex);
+    for (int i = 0; i < keys->map_count; i++) {
+        if (keys->maps[i] == map) {
+            memmove(&keys->maps[i], &keys->maps[i + 1],
+                    (keys->map_count - i - 1) * sizeof(smartterm_keymap*));
+            keys->map_count--;
+            break;
         }
     }
+    if (keys->active == map) {
+        keys->active = NULL;
+    }
+    keymap_reset_pending(ctx, map);
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    keymap_release(map);
+}
+
+/*
+ * Bind key sequence
+ */
+int smartterm_keymap_bind(smartterm_keymap* map, const char* keys,
+                          smartterm_key_handler_fn handler, void* data)
+{
+    int sequence[KEYMAP_MAX_SEQUENCE];
+    int count = map && keys && handler ? keymap_parse(keys, sequence) : -1;
+    if (count < 0) {
+        return SMARTTERM_INVALID;
+    }
+
+    pthread_mutex_lock(&map->ctx->screen_mutex);
+    int result = keymap_bind(map, sequence, count, handler, data);
+    pthread_mutex_unlock(&map->ctx->screen_mutex);
+
+    return result;
+}
+
+/*
+ * Remove key sequence binding
+ */
+int smartterm_keymap_unbind(smartterm_keymap* map, const char* keys)
+{
+    int sequence[KEYMAP_MAX_SEQUENCE];
+    int count = map && keys ? keymap_parse(keys, sequence) : -1;
+    if (count < 0) {
+        return SMARTTERM_INVALID;
+    }
+
+    pthread_mutex_lock(&map->ctx->screen_mutex);
+    int result = keymap_unbind(map, sequence, count);
+    pthread_mutex_unlock(&map->ctx->screen_mutex);
 
-    return SMARTTERM_ERROR; /* Key not found */
+    return result;
 }
 
 /*
- * Dispatch key event to registered handler (internal use)
+ * Get global keymap
  */
-int smartterm_dispatch_key(smartterm_ctx* ctx, int key)
+smartterm_keymap* smartterm_get_global_keymap(smartterm_ctx* ctx)
 {
     if (!ctx || !ctx->initialized) {
-        return SMARTTERM_NOTINIT;
+        return NULL;
     }
+    return ctx->keys.global;
+}
 
-    /* Find handler for key */
-    for (int i = 0; i < ctx->key_handler_count; i++) {
-        if (ctx->key_handlers[i].key == key) {
-            ctx->key_handlers[i].handler(ctx, key, ctx->key_handlers[i].user_data);
-            return SMARTTERM_OK;
-        }
+/*
+ * Switch modal keymap
+ */
+int smartterm_set_keymap(smartterm_ctx* ctx, smartterm_keymap* map)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+    if (map && map->ctx != ctx) {
+        return SMARTTERM_INVALID;
     }
 
-    return SMARTTERM_ERROR; /* No handler */
+    pthread_mutex_lock(&ctx->screen_mutex);
+    ctx->keys.active = map;
+    keymap_reset_pending(ctx, NULL);
+    pthread_mutex_unlock(&ctx->screen_mutex);
+
+    return SMARTTERM_OK;
 }
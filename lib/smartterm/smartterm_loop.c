@@ -0,0 +1,240 @@
+/*
+ * SmartTerm Library - Event Loop Integration
+ *
+ * Lets an application drive SmartTerm from its own poll/epoll loop
+ * instead of a thread blocked in smartterm_read_line(). One epoll
+ * descriptor covers terminal input, a wakeup eventfd bumped when output
+ * is queued and a timerfd for frames deferred by the frame rate limit.
+ * smartterm_step() does whatever is ready and never blocks.
+ *
+ * Linux only (epoll, eventfd, timerfd).
+ */
+
+#include "smartterm_internal.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/*
+ * Close descriptor if open
+ */
+static void loop_close(int* fd)
+{
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+/*
+ * Add descriptor to epoll set
+ */
+static int loop_watch(int poll_fd, int fd)
+{
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = fd};
+    return epoll_ctl(poll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/*
+ * Consume readiness of eventfd or timerfd
+ */
+static void loop_drain(int fd)
+{
+    uint64_t value;
+    if (fd >= 0) {
+        ssize_t n = read(fd, &value, sizeof(value)); /* EAGAIN = not ready */
+        (void)n;
+    }
+}
+
+/*
+ * Schedule deferred frame in ms milliseconds
+ */
+static void loop_arm_timer(event_loop_t* loop, long ms)
+{
+    struct itimerspec spec = {0};
+    spec.it_value.tv_sec = ms / 1000;
+    spec.it_value.tv_nsec = (ms % 1000) * 1000000;
+    timerfd_settime(loop->timer_fd, 0, &spec, NULL);
+}
+
+/*
+ * Watch the terminal only while a line handler wants input (screen mutex held)
+ *
+ * Otherwise typed keys would keep the descriptor readable and spin the
+ * application's loop.
+ */
+static void loop_update_input(smartterm_ctx* ctx)
+{
+    event_loop_t* loop = &ctx->loop;
+    bool want = loop->poll_fd >= 0 && loop->line_handler != NULL;
+
+    if (want && !loop->watching_input) {
+        loop->watching_input = loop_watch(loop->poll_fd, ctx->input_fd) == 0;
+    } else if (!want && loop->watching_input) {
+        epoll_ctl(loop->poll_fd, EPOLL_CTL_DEL, ctx->input_fd, NULL);
+        loop->watching_input = false;
+    }
+}
+
+/*
+ * Set initial state (loop inactive)
+ */
+void loop_init(smartterm_ctx* ctx)
+{
+    ctx->loop.poll_fd = -1;
+    ctx->loop.wake_fd = -1;
+    ctx->loop.timer_fd = -1;
+}
+
+/*
+ * Close loop descriptors
+ */
+void loop_cleanup(smartterm_ctx* ctx)
+{
+    loop_close(&ctx->loop.poll_fd);
+    loop_close(&ctx->loop.wake_fd);
+    loop_close(&ctx->loop.timer_fd);
+}
+
+/*
+ * Note that output changed and wake the loop (screen mutex held)
+ *
+ * Only the first request per frame touches the eventfd.
+ */
+void loop_request_frame(smartterm_ctx* ctx)
+{
+    event_loop_t* loop = &ctx->loop;
+    if (loop->render_pending) {
+        return;
+    }
+
+    loop->render_pending = true;
+    /* Fails only when the counter is saturated, i.e. the loop is awake */
+    uint64_t one = 1;
+    ssize_t n = write(loop->wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+/*
+ * Get descriptor for an external event loop
+ */
+int smartterm_get_fd(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->initialized) {
+        return -1;
+    }
+
+    screen_lock(ctx);
+    event_loop_t* loop = &ctx->loop;
+
+    if (loop->poll_fd < 0) {
+        loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        int poll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (loop->wake_fd < 0 || loop->timer_fd < 0 || poll_fd < 0 ||
+            loop_watch(poll_fd, loop->wake_fd) != 0 || loop_watch(poll_fd, loop->timer_fd) != 0) {
+            loop_close(&poll_fd);
+            loop_cleanup(ctx);
+            screen_unlock(ctx);
+            return -1;
+        }
+
+        loop->poll_fd = poll_fd;
+        loop_update_input(ctx);
+    }
+
+    int fd = loop->poll_fd;
+    screen_unlock(ctx);
+
+    return fd;
+}
+
+/*
+ * Process pending input and output without blocking
+ */
+int smartterm_step(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    screen_lock(ctx);
+    event_loop_t* loop = &ctx->loop;
+
+    /* Readiness only; the work to do is in the editor and render_pending */
+    loop_drain(loop->wake_fd);
+    loop_drain(loop->timer_fd);
+
+    /* Input: keys that have arrived, then the finished lines */
+    if (loop->line_handler && ctx->editor.state == EDITOR_EDITING) {
+        input_process_keys(ctx);
+    }
+
+    /* The next line can be finished at once when it comes from a paste */
+    while (loop->line_handler && ctx->editor.state != EDITOR_EDITING &&
+           ctx->editor.state != EDITOR_IDLE) {
+        char* line = editor_take_line(ctx);
+        smartterm_line_handler_fn handler = loop->line_handler;
+        void* data = loop->line_data;
+
+        screen_unlock(ctx);
+        handler(ctx, line, data);
+        screen_lock(ctx);
+
+        /* Next line, unless the handler removed itself */
+        if (loop->line_handler && ctx->editor.state == EDITOR_IDLE) {
+            editor_begin(ctx, ctx->prompt);
+        }
+    }
+
+    /* Output, at most once per frame; the timer brings the loop back */
+    int result = SMARTTERM_OK;
+    if (loop->render_pending) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (now.tv_sec - loop->last_frame.tv_sec) * 1000 +
+                       (now.tv_nsec - loop->last_frame.tv_nsec) / 1000000;
+
+        if (elapsed >= LOOP_FRAME_MS) {
+            loop->render_pending = false;
+            loop->last_frame = now;
+            result = render_output_frame(ctx);
+        } else {
+            loop_arm_timer(loop, LOOP_FRAME_MS - elapsed);
+        }
+    }
+
+    screen_unlock(ctx);
+    return result;
+}
+
+/*
+ * Install line handler for event loop input
+ */
+int smartterm_set_line_handler(smartterm_ctx* ctx, smartterm_line_handler_fn handler,
+                               void* data)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    screen_lock(ctx);
+    ctx->loop.line_handler = handler;
+    ctx->loop.line_data = data;
+
+    if (handler && ctx->editor.state == EDITOR_IDLE) {
+        editor_begin(ctx, ctx->prompt);
+    } else if (!handler && ctx->editor.state != EDITOR_IDLE) {
+        /* Abandon the line being typed */
+        free(editor_take_line(ctx));
+    }
+    loop_update_input(ctx);
+
+    screen_unlock(ctx);
+    return SMARTTERM_OK;
+}
@@ -0,0 +1,213 @@
+/*
+ * SmartTerm Library - LZ Block Codec
+ *
+ * Small LZ77 codec used for compressed scrollback blocks. The stream is a
+ * sequence of (literals, match) pairs in the LZ4 block layout:
+ *
+ *   token         high nibble = literal length, low nibble = match length - 4
+ *   [length ext]  extra literal length bytes when nibble is 15
+ *   literals
+ *   offset        2 bytes, little endian (absent after the final literals)
+ *   [length ext]  extra match length bytes when nibble is 15
+ *
+ * Length extensions add bytes until one is below 255. The decoder checks
+ * every read and write against the buffer bounds.
+ */
+
+#include "smartterm_internal.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+/*
+ * Read 4 bytes for hashing and match checks
+ */
+static unsigned int lz_read32(const unsigned char* p)
+{
+    unsigned int value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/*
+ * Hash 4-byte sequence into match table
+ */
+static unsigned int lz_hash(unsigned int sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/*
+ * Write length extension bytes
+ */
+static size_t lz_put_length(unsigned char* dst, size_t length)
+{
+    size_t n = 0;
+    while (length >= 255) {
+        dst[n++] = 255;
+        length -= 255;
+    }
+    dst[n++] = (unsigned char)length;
+    return n;
+}
+
+/*
+ * Emit one sequence (match_len 0 = final literals only)
+ */
+static size_t lz_emit(unsigned char* dst, size_t op, size_t cap, const unsigned char* literals,
+                      size_t literal_len, size_t offset, size_t match_len)
+{
+    /* Worst case: token, extensions, literals, offset */
+    size_t need = 1 + literal_len / 255 + 1 + literal_len + 2 + match_len / 255 + 1;
+    if (need > cap - op) {
+        return 0;
+    }
+
+    unsigned char* token = &dst[op++];
+    *token = (unsigned char)((literal_len < 15 ? literal_len : 15) << 4);
+    if (literal_len >= 15) {
+        op += lz_put_length(&dst[op], literal_len - 15);
+    }
+    memcpy(&dst[op], literals, literal_len);
+    op += literal_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+
+    dst[op++] = (unsigned char)(offset & 0xff);
+    dst[op++] = (unsigned char)(offset >> 8);
+
+    size_t code = match_len - LZ_MIN_MATCH;
+    *token |= (unsigned char)(code < 15 ? code : 15);
+    if (code >= 15) {
+        op += lz_put_length(&dst[op], code - 15);
+    }
+
+    return op;
+}
+
+/*
+ * Get worst-case compressed size
+ */
+size_t lz_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/*
+ * Compress block (returns compressed size, 0 if dst is too small)
+ */
+size_t lz_compress(const void* src, size_t size, void* dst, size_t cap)
+{
+    const unsigned char* in = src;
+    unsigned char* out = dst;
+    unsigned int table[1 << LZ_HASH_BITS];
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+
+    memset(table, 0, sizeof(table));
+
+    while (ip + LZ_MIN_MATCH <= size) {
+        unsigned int sequence = lz_read32(&in[ip]);
+        unsigned int h = lz_hash(sequence);
+        size_t candidate = table[h];
+        table[h] = (unsigned int)ip;
+
+        if (candidate >= ip || ip - candidate > LZ_MAX_OFFSET ||
+            lz_read32(&in[candidate]) != sequence) {
+            ip++;
+            continue;
+        }
+
+        size_t match_len = LZ_MIN_MATCH;
+        while (ip + match_len < size && in[candidate + match_len] == in[ip + match_len]) {
+            match_len++;
+        }
+
+        op = lz_emit(out, op, cap, &in[anchor], ip - anchor, ip - candidate, match_len);
+        if (op == 0) {
+            return 0;
+        }
+
+        ip += match_len;
+        anchor = ip;
+    }
+
+    return lz_emit(out, op, cap, &in[anchor], size - anchor, 0, 0);
+}
+
+/*
+ * Read length extension bytes
+ */
+static int lz_get_length(const unsigned char* src, size_t size, size_t* ip, size_t* length)
+{
+    unsigned char byte;
+    do {
+        if (*ip >= size) {
+            return SMARTTERM_ERROR;
+        }
+        byte = src[(*ip)++];
+        *length += byte;
+    } while (byte == 255);
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Decompress block into dst (fails on corrupt input or overflow)
+ */
+int lz_decompress(const void* src, size_t size, void* dst, size_t cap, size_t* out_size)
+{
+    const unsigned char* in = src;
+    unsigned char* out = dst;
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < size) {
+        unsigned char token = in[ip++];
+
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && lz_get_length(in, size, &ip, &literal_len) != SMARTTERM_OK) {
+            return SMARTTERM_ERROR;
+        }
+        if (literal_len > size - ip || literal_len > cap - op) {
+            return SMARTTERM_ERROR;
+        }
+        memcpy(&out[op], &in[ip], literal_len);
+        ip += literal_len;
+        op += literal_len;
+
+        if (ip == size) {
+            break;
+        }
+
+        if (size - ip < 2) {
+            return SMARTTERM_ERROR;
+        }
+        size_t offset = in[ip] | ((size_t)in[ip + 1] << 8);
+        ip += 2;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && lz_get_length(in, size, &ip, &match_len) != SMARTTERM_OK) {
+            return SMARTTERM_ERROR;
+        }
+        match_len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > op || match_len > cap - op) {
+            return SMARTTERM_ERROR;
+        }
+
+        /* Byte copy: matches may overlap their own output */
+        for (size_t i = 0; i < match_len; i++) {
+            out[op + i] = out[op - offset + i];
+        }
+        op += match_len;
+    }
+
+    *out_size = op;
+    return SMARTTERM_OK;
+}
@@ -0,0 +1,641 @@
+/*
+ * SmartTerm Library - Multi-line Input Editor
+ *
+ * Edits text of any number of lines for smartterm_read_multiline(). The
+ * text lives in a gap buffer kept at the cursor, so typing and pasting
+ * anywhere cost amortized O(1) per byte. The input window grows one row
+ * per line up to a limit, taking rows from the output window, and a
+ * redraw repaints only the rows whose lines changed. All functions run
+ * with the screen mutex held.
+ */
+
+#include "smartterm_internal.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial gap buffer allocation */
+#define MULTILINE_INITIAL_CAPACITY 256
+
+/* Tab inserts spaces up to the next multiple of this */
+#define MULTILINE_TAB_WIDTH 4
+
+/*
+ * Check for UTF-8 continuation byte
+ */
+static bool is_continuation(char c)
+{
+    return ((unsigned char)c & 0xc0) == 0x80;
+}
+
+/*
+ * Get number of text bytes
+ */
+static size_t gap_length(const gap_buffer_t* gap)
+{
+    return gap->capacity - (gap->gap_end - gap->gap_start);
+}
+
+/*
+ * Get byte at text offset pos
+ */
+static char gap_at(const gap_buffer_t* gap, size_t pos)
+{
+    return pos < gap->gap_start ? gap->data[pos] : gap->data[pos + gap->gap_end - gap->gap_start];
+}
+
+/*
+ * Move gap (cursor) to text offset pos
+ */
+static void gap_move(gap_buffer_t* gap, size_t pos)
+{
+    if (pos < gap->gap_start) {
+        size_t n = gap->gap_start - pos;
+        memmove(gap->data + gap->gap_end - n, gap->data + pos, n);
+        gap->gap_start -= n;
+        gap->gap_end -= n;
+    } else if (pos > gap->gap_start) {
+        size_t n = pos - gap->gap_start;
+        memmove(gap->data + gap->gap_start, gap->data + gap->gap_end, n);
+        gap->gap_start += n;
+        gap->gap_end += n;
+    }
+}
+
+/*
+ * Widen gap to at least extra bytes
+ */
+static bool gap_reserve(gap_buffer_t* gap, size_t extra)
+{
+    if (gap->gap_end - gap->gap_start >= extra) {
+        return true;
+    }
+
+    size_t length = gap_length(gap);
+    size_t new_capacity = gap->capacity ? gap->capacity : MULTILINE_INITIAL_CAPACITY;
+    while (new_capacity - length < extra) {
+        new_capacity *= 2;
+    }
+
+    char* data = realloc(gap->data, new_capacity);
+    if (!data) {
+        return false;
+    }
+
+    /* Text after the gap goes to the end of the new allocation */
+    size_t after = gap->capacity - gap->gap_end;
+    memmove(data + new_capacity - after, data + gap->gap_end, after);
+    gap->data = data;
+    gap->gap_end = new_capacity - after;
+    gap->capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Get start of the line containing pos
+ */
+static size_t line_start(const gap_buffer_t* gap, size_t pos)
+{
+    while (pos > 0 && gap_at(gap, pos - 1) != '\n') {
+        pos--;
+    }
+    return pos;
+}
+
+/*
+ * Get end of the line containing pos (its line break or the text end)
+ */
+static size_t line_end(const gap_buffer_t* gap, size_t pos)
+{
+    size_t length = gap_length(gap);
+    while (pos < length && gap_at(gap, pos) != '\n') {
+        pos++;
+    }
+    return pos;
+}
+
+/*
+ * Count display columns (one per character) in [from, to)
+ */
+static int text_columns(const gap_buffer_t* gap, size_t from, size_t to)
+{
+    int columns = 0;
+    for (size_t pos = from; pos < to; pos++) {
+        if (!is_continuation(gap_at(gap, pos))) {
+            columns++;
+        }
+    }
+    return columns;
+}
+
+/*
+ * Get offset of column on the line starting at start, or the line end
+ */
+static size_t column_offset(const gap_buffer_t* gap, size_t start, int column)
+{
+    size_t length = gap_length(gap);
+    size_t pos = start;
+    for (int i = 0; pos < length && gap_at(gap, pos) != '\n'; pos++) {
+        if (!is_continuation(gap_at(gap, pos)) && i++ == column) {
+            break;
+        }
+    }
+    return pos;
+}
+
+/*
+ * Count line breaks in [from, to)
+ */
+static int count_breaks(const gap_buffer_t* gap, size_t from, size_t to)
+{
+    int breaks = 0;
+    for (size_t pos = from; pos < to; pos++) {
+        breaks += gap_at(gap, pos) == '\n';
+    }
+    return breaks;
+}
+
+/*
+ * Mark lines [from, to] for redraw (INT_MAX = to the last row)
+ */
+static void multiline_dirty(multiline_editor_t* ml, int from, int to)
+{
+    if (ml->dirty_from > ml->dirty_to) {
+        ml->dirty_from = from;
+        ml->dirty_to = to;
+        return;
+    }
+    if (from < ml->dirty_from) {
+        ml->dirty_from = from;
+    }
+    if (to > ml->dirty_to) {
+        ml->dirty_to = to;
+    }
+}
+
+/*
+ * Move cursor to text offset pos
+ */
+static void multiline_move(multiline_editor_t* ml, size_t pos)
+{
+    gap_buffer_t* gap = &ml->text;
+    if (pos < gap->gap_start) {
+        ml->cursor_line -= count_breaks(gap, pos, gap->gap_start);
+    } else {
+        ml->cursor_line += count_breaks(gap, gap->gap_start, pos);
+    }
+    gap_move(gap, pos);
+}
+
+/*
+ * Remove [from, to) around the cursor; the cursor ends up at from
+ */
+static void multiline_delete(multiline_editor_t* ml, size_t from, size_t to)
+{
+    gap_buffer_t* gap = &ml->text;
+    if (from >= to) {
+        return;
+    }
+
+    int breaks = count_breaks(gap, from, to);
+    multiline_move(ml, from);
+    gap->gap_end += to - from;
+    ml->line_count -= breaks;
+    multiline_dirty(ml, ml->cursor_line, breaks > 0 ? INT_MAX : ml->cursor_line);
+}
+
+/*
+ * Insert bytes at cursor (pastes arrive here in one piece)
+ */
+void multiline_insert(smartterm_ctx* ctx, const char* s, size_t len)
+{
+    multiline_editor_t* ml = &ctx->editor.multiline;
+    gap_buffer_t* gap = &ml->text;
+    if (len == 0 || !gap_reserve(gap, len)) {
+        return;
+    }
+
+    memcpy(gap->data + gap->gap_start, s, len);
+    gap->gap_start += len;
+
+    int breaks = 0;
+    for (const char* c = memchr(s, '\n', len); c; c = memchr(c + 1, '\n', len - (c + 1 - s))) {
+        breaks++;
+    }
+    multiline_dirty(ml, ml->cursor_line, breaks > 0 ? INT_MAX : ml->cursor_line);
+    ml->line_count += breaks;
+    ml->cursor_line += breaks;
+}
+
+/*
+ * Get copy of the text (NULL on allocation failure)
+ */
+char* multiline_text(const multiline_editor_t* ml)
+{
+    const gap_buffer_t* gap = &ml->text;
+    size_t after = gap->capacity - gap->gap_end;
+    char* text = malloc(gap_length(gap) + 1);
+    if (text) {
+        memcpy(text, gap->data, gap->gap_start);
+        memcpy(text + gap->gap_start, gap->data + gap->gap_end, after);
+        text[gap->gap_start + after] = '\0';
+    }
+    return text;
+}
+
+/*
+ * Start editing multi-line text, taking over the line begun by editor_begin()
+ */
+void multiline_begin(smartterm_ctx* ctx)
+{
+    line_editor_t* editor = &ctx->editor;
+    multiline_editor_t* ml = &editor->multiline;
+    if (editor->state != EDITOR_EDITING) {
+        return;
+    }
+
+    ml->text.gap_start = 0;
+    ml->text.gap_end = ml->text.capacity;
+    if (!gap_reserve(&ml->text, 1)) {
+        editor->state = EDITOR_EOF;
+        return;
+    }
+    ml->line_count = 1;
+    ml->cursor_line = 0;
+    ml->goal_column = -1;
+    ml->top_line = 0;
+    ml->top_offset = 0;
+    ml->column_scroll = 0;
+    ml->dirty_from = 0;
+    ml->dirty_to = INT_MAX;
+    ml->drawn_rows = 0;
+    ml->drawn_cols = 0;
+    ml->active = true;
+
+    /* A line left from a paste carries over */
+    multiline_insert(ctx, editor->text, editor->length);
+}
+
+/*
+ * Stop editing; the input window shrinks back to its usual rows
+ */
+void multiline_end(smartterm_ctx* ctx)
+{
+    ctx->editor.multiline.active = false;
+    if (ctx->input_height != INPUT_HEIGHT) {
+        ctx->input_height = INPUT_HEIGHT;
+        layout_windows(ctx);
+        render_output_frame(ctx);
+        render_status(ctx);
+    }
+}
+
+/*
+ * Release editor storage
+ */
+void multiline_cleanup(multiline_editor_t* ml)
+{
+    free(ml->text.data);
+    memset(ml, 0, sizeof(*ml));
+}
+
+/*
+ * Move cursor to the line above (-1) or below (+1), keeping the column
+ */
+static void multiline_vertical(multiline_editor_t* ml, int direction)
+{
+    gap_buffer_t* gap = &ml->text;
+    size_t start = line_start(gap, gap->gap_start);
+    if ((direction < 0 && ml->cursor_line == 0) ||
+        (direction > 0 && ml->cursor_line == ml->line_count - 1)) {
+        beep();
+        return;
+    }
+
+    if (ml->goal_column < 0) {
+        ml->goal_column = text_columns(gap, start, gap->gap_start);
+    }
+    size_t target = direction < 0 ? line_start(gap, start - 1)
+                                  : line_end(gap, gap->gap_start) + 1;
+    multiline_move(ml, column_offset(gap, target, ml->goal_column));
+}
+
+/*
+ * Handle key after ESC
+ */
+static void multiline_meta_key(smartterm_ctx* ctx, int key)
+{
+    multiline_editor_t* ml = &ctx->editor.multiline;
+    switch (key) {
+    case '\n':
+    case '\r':
+    case KEY_ENTER:
+        ctx->editor.state = EDITOR_ACCEPTED;
+        break;
+    case '<':
+        multiline_move(ml, 0);
+        break;
+    case '>':
+        multiline_move(ml, gap_length(&ml->text));
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Apply one key to the text being edited
+ *
+ * Enter starts a new line; Enter on an empty last line, Meta-Enter or
+ * Ctrl-D submit. Accepted text is not added to history, whose file holds
+ * one entry per line.
+ */
+void multiline_key(smartterm_ctx* ctx, int key)
+{
+    line_editor_t* editor = &ctx->editor;
+    multiline_editor_t* ml = &editor->multiline;
+    gap_buffer_t* gap = &ml->text;
+    size_t cursor = gap->gap_start;
+    size_t length = gap_length(gap);
+
+    /* Only vertical motion keeps the goal column */
+    if (key != KEY_UP && key != KEY_DOWN && key != CTRL_KEY('p') && key != CTRL_KEY('n')) {
+        ml->goal_column = -1;
+    }
+    if (editor->meta) {
+        editor->meta = false;
+        multiline_meta_key(ctx, key);
+        return;
+    }
+
+    switch (key) {
+    case KEY_ESCAPE:
+        editor->meta = true;
+        break;
+    case '\n':
+    case '\r':
+    case KEY_ENTER:
+        if (cursor == length && line_start(gap, cursor) == cursor) {
+            /* Drop the line break that opened the empty line */
+            multiline_delete(ml, cursor > 0 ? cursor - 1 : cursor, cursor);
+            editor->state = EDITOR_ACCEPTED;
+        } else {
+            multiline_insert(ctx, "\n", 1);
+        }
+        break;
+    case CTRL_KEY('d'):
+        editor->state = length == 0 ? EDITOR_EOF : EDITOR_ACCEPTED;
+        break;
+    case KEY_BACKSPACE:
+    case 127:
+    case CTRL_KEY('h'):
+        if (cursor > 0) {
+            size_t from = cursor - 1;
+            while (from > 0 && is_continuation(gap_at(gap, from))) {
+                from--;
+            }
+            multiline_delete(ml, from, cursor);
+        }
+        break;
+    case KEY_DC:
+        if (cursor < length) {
+            size_t to = cursor + 1;
+            while (to < length && is_continuation(gap_at(gap, to))) {
+                to++;
+            }
+            multiline_delete(ml, cursor, to);
+        }
+        break;
+    case CTRL_KEY('b'):
+    case KEY_LEFT:
+        if (cursor > 0) {
+            do {
+                cursor--;
+            } while (cursor > 0 && is_continuation(gap_at(gap, cursor)));
+            multiline_move(ml, cursor);
+        }
+        break;
+    case CTRL_KEY('f'):
+    case KEY_RIGHT:
+        if (cursor < length) {
+            do {
+                cursor++;
+            } while (cursor < length && is_continuation(gap_at(gap, cursor)));
+            multiline_move(ml, cursor);
+        }
+        break;
+    case CTRL_KEY('p'):
+    case KEY_UP:
+        multiline_vertical(ml, -1);
+        break;
+    case CTRL_KEY('n'):
+    case KEY_DOWN:
+        multiline_vertical(ml, 1);
+        break;
+    case CTRL_KEY('a'):
+    case KEY_HOME:
+        multiline_move(ml, line_start(gap, cursor));
+        break;
+    case CTRL_KEY('e'):
+    case KEY_END:
+        multiline_move(ml, line_end(gap, cursor));
+        break;
+    case CTRL_KEY('k'): {
+        /* At the line end, join the next line */
+        size_t end = line_end(gap, cursor);
+        multiline_delete(ml, cursor, end > cursor ? end : end + (end < length));
+        break;
+    }
+    case CTRL_KEY('u'):
+        multiline_delete(ml, line_start(gap, cursor), cursor);
+        break;
+    case '\t': {
+        int column = text_columns(gap, line_start(gap, cursor), cursor);
+        int spaces = MULTILINE_TAB_WIDTH - column % MULTILINE_TAB_WIDTH;
+        multiline_insert(ctx, "    ", (size_t)spaces);
+        break;
+    }
+    case CTRL_KEY('l'):
+        clearok(curscr, TRUE);
+        render_all(ctx);
+        break;
+    case KEY_PPAGE:
+        smartterm_scroll(ctx, render_page_rows(ctx));
+        break;
+    case KEY_NPAGE:
+        smartterm_scroll(ctx, -render_page_rows(ctx));
+        break;
+    case KEY_RESIZE:
+        smartterm_handle_resize(ctx);
+        break;
+    default:
+        /* Printable ASCII, and UTF-8 bytes as they arrive */
+        if (key >= ' ' && key < 256 && key != 127) {
+            char c = (char)key;
+            multiline_insert(ctx, &c, 1);
+        }
+        break;
+    }
+}
+
+/*
+ * Get input window rows for the text: one per line plus the hint row
+ */
+static int multiline_height(smartterm_ctx* ctx)
+{
+    int status_height = ctx->status_visible ? 1 : 0;
+    int limit = ctx->config.multiline_height > 0 ? ctx->config.multiline_height
+                                                 : (ctx->term_rows - status_height) / 2;
+    if (limit > ctx->term_rows - status_height - MULTILINE_MIN_OUTPUT) {
+        limit = ctx->term_rows - status_height - MULTILINE_MIN_OUTPUT;
+    }
+
+    int height = ctx->editor.multiline.line_count + 1;
+    if (height > limit) {
+        height = limit;
+    }
+    return height < INPUT_HEIGHT ? INPUT_HEIGHT : height;
+}
+
+/*
+ * Scroll so the cursor line is shown and no rows are left blank above it
+ */
+static void multiline_scroll(multiline_editor_t* ml, int rows)
+{
+    int top = ml->top_line;
+    if (ml->cursor_line < top) {
+        top = ml->cursor_line;
+    } else if (ml->cursor_line >= top + rows) {
+        top = ml->cursor_line - rows + 1;
+    }
+    if (top > 0 && top + rows > ml->line_count) {
+        top = ml->line_count > rows ? ml->line_count - rows : 0;
+    }
+    if (top == ml->top_line) {
+        return;
+    }
+
+    /* Walk back from the cursor line to the new top */
+    size_t pos = line_start(&ml->text, ml->text.gap_start);
+    for (int line = ml->cursor_line; line > top; line--) {
+        pos = line_start(&ml->text, pos - 1);
+    }
+    ml->top_line = top;
+    ml->top_offset = pos;
+    multiline_dirty(ml, 0, INT_MAX);
+}
+
+/*
+ * Draw the part of line [start, end) that fits at window row
+ */
+static void multiline_draw_line(WINDOW* win, const multiline_editor_t* ml, int row, int x,
+                                int room, size_t start, size_t end)
+{
+    const gap_buffer_t* gap = &ml->text;
+    size_t from = column_offset(gap, start, ml->column_scroll);
+    size_t to = column_offset(gap, from, room);
+    if (to > end) {
+        to = end;
+    }
+
+    /* The gap sits on a character boundary, so each side is whole characters */
+    wmove(win, row, x);
+    if (from < gap->gap_start) {
+        size_t before = to < gap->gap_start ? to : gap->gap_start;
+        waddnstr(win, gap->data + from, (int)(before - from));
+        from = before;
+    }
+    if (from < to) {
+        size_t shift = gap->gap_end - gap->gap_start;
+        waddnstr(win, gap->data + from + shift, (int)(to - from));
+    }
+}
+
+/*
+ * Draw changed rows, the hint row and the cursor into the input window
+ */
+void multiline_draw(smartterm_ctx* ctx)
+{
+    WINDOW* win = ctx->input_win;
+    line_editor_t* editor = &ctx->editor;
+    multiline_editor_t* ml = &editor->multiline;
+    gap_buffer_t* gap = &ml->text;
+
+    /* Grow or shrink the input area with the text */
+    bool moved = false;
+    int height = multiline_height(ctx);
+    if (height != ctx->input_height) {
+        ctx->input_height = height;
+        layout_windows(ctx);
+        moved = true;
+    }
+
+    int rows = getmaxy(win) - 1;
+    int width = getmaxx(win);
+    if (moved || rows != ml->drawn_rows || width != ml->drawn_cols) {
+        ml->drawn_rows = rows;
+        ml->drawn_cols = width;
+        multiline_dirty(ml, 0, INT_MAX);
+    }
+
+    /* Continuation lines are indented to the prompt */
+    int prompt_columns = (int)strlen(editor->prompt);
+    for (const char* c = editor->prompt; *c; c++) {
+        prompt_columns -= is_continuation(*c);
+    }
+    if (prompt_columns > width / 2) {
+        prompt_columns = width / 2;
+    }
+    int room = width - prompt_columns - 1;
+    if (room < 1) {
+        room = 1;
+    }
+
+    /* Keep the cursor in view */
+    multiline_scroll(ml, rows);
+    size_t cursor_start = line_start(gap, gap->gap_start);
+    int column = text_columns(gap, cursor_start, gap->gap_start);
+    if (column < ml->column_scroll || column >= ml->column_scroll + room) {
+        ml->column_scroll = column < room ? 0 : column - room + 1;
+        multiline_dirty(ml, 0, INT_MAX);
+    }
+
+    /* Changed rows only; rows above them are skipped line by line */
+    size_t pos = ml->top_offset;
+    for (int row = 0; row < rows && ml->top_line + row <= ml->dirty_to; row++) {
+        int line = ml->top_line + row;
+        size_t end = line < ml->line_count ? line_end(gap, pos) : pos;
+        if (line >= ml->dirty_from) {
+            wmove(win, row, 0);
+            wclrtoeol(win);
+            if (line == 0) {
+                mvwaddnstr(win, row, 0, editor->prompt, -1);
+            }
+            if (line < ml->line_count) {
+                multiline_draw_line(win, ml, row, prompt_columns, room, pos, end);
+            }
+        }
+        pos = line < ml->line_count - 1 ? end + 1 : end;
+    }
+    ml->dirty_from = INT_MAX;
+    ml->dirty_to = 0;
+
+    char hint[64];
+    snprintf(hint, sizeof(hint), "line %d/%d  (Ctrl-D to submit)", ml->cursor_line + 1,
+             ml->line_count);
+    wmove(win, rows, 0);
+    wclrtoeol(win);
+    wattron(win, A_DIM);
+    mvwaddnstr(win, rows, 0, hint, width);
+    wattroff(win, A_DIM);
+
+    wmove(win, ml->cursor_line - ml->top_line, prompt_columns + column - ml->column_scroll);
+    wnoutrefresh(win);
+
+    /* Output lost or gained rows; redraw it with the status bar in their new places */
+    if (moved) {
+        render_output_frame(ctx);
+        render_status(ctx);
+    }
+}
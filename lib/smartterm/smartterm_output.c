@@ -5,33 +5,238 @@
  */
 
 #include "smartterm_internal.h"
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Initial slot allocation; columns double on demand up to max_lines */
+#define BUFFER_INITIAL_SLOTS 256
+
+/* Bytes per slot of the metadata and index columns */
+#define META_SLOT_BYTES (sizeof(unsigned char) + sizeof(int) + sizeof(unsigned short))
+#define INDEX_SLOT_BYTES (sizeof(char*))
+
 /*
- * Initialize output buffer
+ * Allocate empty columns with given slot count
  */
-int output_buffer_init(output_buffer_t* buf, int capacity, bool thread_safe)
+static int columns_alloc(output_buffer_t* buf, int capacity)
 {
-    buf->lines = calloc(capacity, sizeof(output_line_t));
-    if (!buf->lines) {
+    buf->text = calloc(capacity, sizeof(char*));
+    buf->contexts = calloc(capacity, sizeof(unsigned char));
+    buf->ts_deltas = calloc(capacity, sizeof(int));
+    buf->tag_ids = calloc(capacity, sizeof(unsigned short));
+
+    if (!buf->text || !buf->contexts || !buf->ts_deltas || !buf->tag_ids) {
+        free(buf->text);
+        free(buf->contexts);
+        free(buf->ts_deltas);
+        free(buf->tag_ids);
         return SMARTTERM_NOMEM;
     }
 
     buf->capacity = capacity;
-    buf->count = 0;
-    buf->scroll_offset = 0;
+    return SMARTTERM_OK;
+}
+
+/*
+ * Copy ring-ordered column into linear order
+ */
+static void column_unroll(void* dst, const void* src, size_t elem_size, int head, int count,
+                          int capacity)
+{
+    int first = (count < capacity - head) ? count : capacity - head;
+    memcpy(dst, (const char*)src + (size_t)head * elem_size, (size_t)first * elem_size);
+    memcpy((char*)dst + (size_t)first * elem_size, src, (size_t)(count - first) * elem_size);
+}
+
+/*
+ * Grow columns (doubling, capped at max_lines) and unroll the ring
+ */
+static int buffer_grow(output_buffer_t* buf)
+{
+    int new_capacity = buf->capacity * 2;
+    if (new_capacity > buf->max_lines || new_capacity <= 0) {
+        new_capacity = buf->max_lines;
+    }
+
+    char** text = calloc(new_capacity, sizeof(char*));
+    unsigned char* contexts = malloc(new_capacity * sizeof(unsigned char));
+    int* ts_deltas = malloc(new_capacity * sizeof(int));
+    unsigned short* tag_ids = malloc(new_capacity * sizeof(unsigned short));
+
+    if (!text || !contexts || !ts_deltas || !tag_ids) {
+        free(text);
+        free(contexts);
+        free(ts_deltas);
+        free(tag_ids);
+        return SMARTTERM_NOMEM;
+    }
+
+    int count = buffer_ring_count(buf);
+    column_unroll(text, buf->text, sizeof(char*), buf->head, count, buf->capacity);
+    column_unroll(contexts, buf->contexts, sizeof(unsigned char), buf->head, count,
+                  buf->capacity);
+    column_unroll(ts_deltas, buf->ts_deltas, sizeof(int), buf->head, count, buf->capacity);
+    column_unroll(tag_ids, buf->tag_ids, sizeof(unsigned short), buf->head, count,
+                  buf->capacity);
+
+    free(buf->text);
+    free(buf->contexts);
+    free(buf->ts_deltas);
+    free(buf->tag_ids);
+
+    buf->text = text;
+    buf->contexts = contexts;
+    buf->ts_deltas = ts_deltas;
+    buf->tag_ids = tag_ids;
+    buf->capacity = new_capacity;
+    buf->head = 0;
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Encode timestamp as delta from buffer reference (clamped to int range)
+ */
+static int timestamp_delta(const output_buffer_t* buf, long timestamp)
+{
+    if (timestamp >= buf->ts_base + (long)INT_MAX) {
+        return INT_MAX;
+    }
+    if (timestamp <= buf->ts_base + (long)INT_MIN) {
+        return INT_MIN;
+    }
+    return (int)(timestamp - buf->ts_base);
+}
+
+/*
+ * Get memory held by metadata columns and tag table
+ */
+static size_t buffer_meta_bytes(const output_buffer_t* buf)
+{
+    return (size_t)buf->capacity * META_SLOT_BYTES + tag_table_bytes(&buf->tags);
+}
+
+/*
+ * Get memory held by the slot index
+ */
+static size_t buffer_index_bytes(const output_buffer_t* buf)
+{
+    return (size_t)buf->capacity * INDEX_SLOT_BYTES;
+}
+
+/*
+ * Get total accounted memory
+ */
+static size_t buffer_total_bytes(const output_buffer_t* buf)
+{
+    return buf->text_bytes + cold_tier_bytes(&buf->cold) + buffer_meta_bytes(buf) +
+           buffer_index_bytes(buf);
+}
+
+/*
+ * Check whether growing the columns keeps the buffer within budget
+ */
+static bool buffer_can_grow(const output_buffer_t* buf, size_t incoming)
+{
+    if (buf->max_bytes == 0) {
+        return true;
+    }
+
+    int new_capacity = buf->capacity * 2;
+    if (new_capacity > buf->max_lines || new_capacity <= 0) {
+        new_capacity = buf->max_lines;
+    }
+
+    size_t growth = (size_t)(new_capacity - buf->capacity) * (META_SLOT_BYTES + INDEX_SLOT_BYTES);
+    return buffer_total_bytes(buf) + growth + incoming <= buf->max_bytes;
+}
+
+/*
+ * Move oldest in-memory line to disk, or drop it (buffer mutex held)
+ */
+static void buffer_evict_oldest(output_buffer_t* buf)
+{
+    /* Spilled lines stay reachable, so indices, views and scroll hold */
+    bool spilled = buf->spill.dir && spill_append(buf) == SMARTTERM_OK;
+    if (!spilled && buf->spill.dir) {
+        /* No segment for it: lines already on disk stay, only this one is lost */
+        view_on_evict(buf, buf->spill.count);
+        spill_renumber(buf);
+        buf->spill.dropped++;
+    } else if (!spilled) {
+        /* Loaded session lines are older and must go first */
+        while (buf->spill.count > 0) {
+            spill_drop_oldest(buf);
+        }
+        view_on_evict(buf, 0);
+    }
+
+    /* Cold lines have no text of their own; their block goes when emptied */
+    if (buf->text[buf->head]) {
+        buf->text_bytes -= strlen(buf->text[buf->head]) + 1;
+        free(buf->text[buf->head]);
+        buf->text[buf->head] = NULL;
+    }
+
+    buf->head = buffer_ring_slot(buf, 1);
+    if (!spilled) {
+        buf->count--;
+        buf->base_seq++;
+    }
+    cold_tier_evict(buf);
+
+    /* Adjust scroll offset */
+    if (!spilled && buf->scroll_offset > 0) {
+        buf->scroll_offset--;
+    }
+}
+
+/*
+ * Initialize output buffer
+ */
+int output_buffer_init(output_buffer_t* buf, const smartterm_config_t* config)
+{
+    int capacity = config->max_lines;
+    if (capacity < 1) {
+        return SMARTTERM_INVALID;
+    }
+
+    memset(buf, 0, sizeof(*buf));
+    buf->max_lines = capacity;
+    buf->max_bytes = config->max_bytes;
+    buf->cold.hot_lines = config->hot_lines > 0 ? config->hot_lines : 0;
+    if (spill_init(&buf->spill, config->spill_dir) != SMARTTERM_OK) {
+        return SMARTTERM_NOMEM;
+    }
+    if (columns_alloc(buf, capacity < BUFFER_INITIAL_SLOTS ? capacity : BUFFER_INITIAL_SLOTS) !=
+        SMARTTERM_OK) {
+        spill_cleanup(&buf->spill);
+        return SMARTTERM_NOMEM;
+    }
+
+    buf->ts_base = get_timestamp();
     buf->auto_scroll = true;
 
-    if (thread_safe) {
+    if (config->thread_safe) {
         if (pthread_mutex_init(&buf->mutex, NULL) != 0) {
-            free(buf->lines);
+            free(buf->text);
+            free(buf->contexts);
+            free(buf->ts_deltas);
+            free(buf->tag_ids);
+            spill_cleanup(&buf->spill);
             return SMARTTERM_ERROR;
         }
     }
 
+    int result = tee_log_open(&buf->tee, config);
+    if (result != SMARTTERM_OK) {
+        output_buffer_cleanup(buf);
+        return result;
+    }
+
     return SMARTTERM_OK;
 }
 
@@ -40,74 +245,113 @@ int output_buffer_init(output_buffer_t* buf, int capacity, bool thread_safe)
  */
 void output_buffer_cleanup(output_buffer_t* buf)
 {
-    if (!buf || !buf->lines) {
+    if (!buf || !buf->text) {
         return;
     }
 
+    /* Lines queued for the tee log are written before it closes */
+    tee_log_close(buf->tee);
+    buf->tee = NULL;
+
     /* Free all lines */
-    for (int i = 0; i < buf->count; i++) {
-        free(buf->lines[i].text);
-        free((void*)buf->lines[i].meta.tag);
+    for (int i = 0; i < buffer_ring_count(buf); i++) {
+        free(buf->text[buffer_ring_slot(buf, i)]);
     }
 
-    free(buf->lines);
+    free(buf->text);
+    free(buf->contexts);
+    free(buf->ts_deltas);
+    free(buf->tag_ids);
+    buf->text = NULL;
+    cold_tier_cleanup(&buf->cold);
+    spill_cleanup(&buf->spill);
+    tag_table_cleanup(&buf->tags);
+    free(buf->views);
     pthread_mutex_destroy(&buf->mutex);
 }
 
 /*
  * Add line to output buffer
  */
-int output_buffer_add(output_buffer_t* buf, const char* text, const smartterm_line_meta_t* meta)
+int output_buffer_add(output_buffer_t* buf, const char* text, const smartterm_line_meta_t* meta,
+                      unsigned long* seq)
 {
     if (!buf || !text) {
         return SMARTTERM_INVALID;
     }
 
+    /* Context column is one byte per line */
+    smartterm_context_t context = meta ? meta->context : CTX_NORMAL;
+    long timestamp = meta ? meta->timestamp : get_timestamp();
+    if (context < 0 || context >= VIEW_CONTEXT_SLOTS) {
+        return SMARTTERM_INVALID;
+    }
+
+    size_t len = strlen(text) + 1;
+    char* copy = malloc(len);
+    if (!copy) {
+        return SMARTTERM_NOMEM;
+    }
+    memcpy(copy, text, len);
+
     pthread_mutex_lock(&buf->mutex);
 
-    /* If buffer is full, drop oldest line */
-    if (buf->count >= buf->capacity) {
-        free(buf->lines[0].text);
-        free((void*)buf->lines[0].meta.tag);
+    /* Intern tag before touching the columns */
+    int tag_id = tag_table_intern(&buf->tags, meta ? meta->tag : NULL);
+    if (tag_id < 0) {
+        pthread_mutex_unlock(&buf->mutex);
+        free(copy);
+        return tag_id;
+    }
+    if (tag_id == 0 && meta && meta->tag) {
+        buf->tags.dropped++;
+    }
 
-        /* Shift all lines down */
-        memmove(&buf->lines[0], &buf->lines[1], sizeof(output_line_t) * (buf->capacity - 1));
-        buf->count--;
+    /* Without a spill directory, loaded session lines count toward max_lines */
+    while (!buf->spill.dir && buf->spill.count > 0 && buf->count >= buf->max_lines) {
+        spill_drop_line(buf);
+    }
 
-        /* Adjust scroll offset */
-        if (buf->scroll_offset > 0) {
-            buf->scroll_offset--;
+    /* Make room: grow columns, or drop oldest line once at a limit */
+    if (buffer_ring_count(buf) >= buf->capacity && buf->capacity < buf->max_lines &&
+        buffer_can_grow(buf, len)) {
+        if (buffer_grow(buf) != SMARTTERM_OK) {
+            pthread_mutex_unlock(&buf->mutex);
+            free(copy);
+            return SMARTTERM_NOMEM;
         }
     }
+    if (buffer_ring_count(buf) >= buf->capacity) {
+        buffer_evict_oldest(buf);
+    }
 
     /* Add new line */
-    buf->lines[buf->count].text = strdup_safe(text);
-    if (!buf->lines[buf->count].text) {
-        pthread_mutex_unlock(&buf->mutex);
-        return SMARTTERM_NOMEM;
+    int slot = buffer_ring_slot(buf, buffer_ring_count(buf));
+    buf->text[slot] = copy;
+    buf->contexts[slot] = (unsigned char)context;
+    buf->ts_deltas[slot] = timestamp_delta(buf, timestamp);
+    buf->tag_ids[slot] = (unsigned short)tag_id;
+    buf->text_bytes += len;
+
+    buf->count++;
+    view_on_append(buf, buf->count - 1);
+    if (seq) {
+        *seq = buf->base_seq + buf->count - 1;
     }
 
-    /* Set metadata */
-    if (meta) {
-        buf->lines[buf->count].meta = *meta;
-        if (meta->tag) {
-            buf->lines[buf->count].meta.tag = strdup_safe(meta->tag);
-            /* Check for allocation failure */
-            if (!buf->lines[buf->count].meta.tag) {
-                free(buf->lines[buf->count].text);
-                pthread_mutex_unlock(&buf->mutex);
-                return SMARTTERM_NOMEM;
-            }
-        } else {
-            buf->lines[buf->count].meta.tag = NULL;
-        }
-    } else {
-        buf->lines[buf->count].meta.context = CTX_NORMAL;
-        buf->lines[buf->count].meta.timestamp = get_timestamp();
-        buf->lines[buf->count].meta.tag = NULL;
+    /* Queued under the buffer mutex so the log keeps buffer order */
+    if (buf->tee) {
+        tee_log_append(buf->tee, copy, len, context, timestamp, meta ? meta->tag : NULL);
     }
 
-    buf->count++;
+    /* Best effort: lines simply stay hot if packing fails */
+    cold_tier_compress(buf);
+
+    /* Enforce memory budget, always keeping the newest line */
+    while (buf->max_bytes > 0 && buffer_ring_count(buf) > 1 &&
+           buffer_total_bytes(buf) > buf->max_bytes) {
+        buffer_evict_oldest(buf);
+    }
 
     /* Auto-scroll to bottom if enabled */
     if (buf->auto_scroll) {
@@ -119,43 +363,126 @@ int output_buffer_add(output_buffer_t* buf, const char* text, const smartterm_li
 }
 
 /*
- * Clear output buffer
+ * Replace text of line seq in place
+ *
+ * Only lines still held uncompressed in memory have text of their own to
+ * replace; SMARTTERM_INVALID once the line was evicted, packed into the
+ * cold tier or spilled. Context, tag and timestamp stay as written.
  */
-void output_buffer_clear(output_buffer_t* buf)
+int output_buffer_update(output_buffer_t* buf, unsigned long seq, const char* text)
 {
-    if (!buf) {
-        return;
+    size_t len = strlen(text) + 1;
+    pthread_mutex_lock(&buf->mutex);
+
+    if (seq < buffer_ring_seq(buf) || seq - buf->base_seq >= (unsigned long)buf->count) {
+        pthread_mutex_unlock(&buf->mutex);
+        return SMARTTERM_INVALID;
+    }
+    int index = (int)(seq - buf->base_seq);
+    int slot = buffer_slot(buf, index);
+    if (!buf->text[slot]) {
+        pthread_mutex_unlock(&buf->mutex);
+        return SMARTTERM_INVALID;
     }
 
-    pthread_mutex_lock(&buf->mutex);
+    /* Substring views may stop or start matching: old text out, new text in */
+    view_on_evict(buf, index);
+
+    /* Same-length updates (a changing percentage) keep the allocation */
+    size_t old_len = strlen(buf->text[slot]) + 1;
+    if (len != old_len) {
+        char* copy = realloc(buf->text[slot], len);
+        if (!copy) {
+            view_on_append(buf, index);
+            pthread_mutex_unlock(&buf->mutex);
+            return SMARTTERM_NOMEM;
+        }
+        buf->text[slot] = copy;
+        buf->text_bytes = buf->text_bytes - old_len + len;
+    }
+    memcpy(buf->text[slot], text, len);
+    view_on_append(buf, index);
 
-    for (int i = 0; i < buf->count; i++) {
-        free(buf->lines[i].text);
-        free((void*)buf->lines[i].meta.tag);
+    while (buf->max_bytes > 0 && buffer_ring_count(buf) > 1 &&
+           buffer_total_bytes(buf) > buf->max_bytes) {
+        buffer_evict_oldest(buf);
     }
 
+    pthread_mutex_unlock(&buf->mutex);
+    return SMARTTERM_OK;
+}
+
+/*
+ * Clear output buffer (buffer mutex held)
+ */
+void output_buffer_clear_locked(output_buffer_t* buf)
+{
+    for (int i = 0; i < buffer_ring_count(buf); i++) {
+        int slot = buffer_ring_slot(buf, i);
+        free(buf->text[slot]);
+        buf->text[slot] = NULL;
+    }
+
+    buf->base_seq += buf->count;
+    spill_clear(&buf->spill);
+    cold_tier_clear(&buf->cold, buf->base_seq);
+    buf->head = 0;
     buf->count = 0;
+    buf->text_bytes = 0;
     buf->scroll_offset = 0;
+    view_on_clear(buf);
+}
 
+/*
+ * Clear output buffer
+ */
+void output_buffer_clear(output_buffer_t* buf)
+{
+    if (!buf) {
+        return;
+    }
+
+    pthread_mutex_lock(&buf->mutex);
+    output_buffer_clear_locked(buf);
     pthread_mutex_unlock(&buf->mutex);
 }
 
 /*
  * Get line from buffer
+ *
+ * The text is not copied: it may sit in the cold block cache or be a live
+ * line's allocation, so it is only good until the buffer is next used.
  */
 const char* output_buffer_get_line(output_buffer_t* buf, int index)
 {
-    if (!buf || index < 0 || index >= buf->count) {
+    if (!buf || index < 0) {
         return NULL;
     }
 
     pthread_mutex_lock(&buf->mutex);
-    const char* text = buf->lines[index].text;
+    const char* text = (index < buf->count) ? buffer_text(buf, index) : NULL;
     pthread_mutex_unlock(&buf->mutex);
 
     return text;
 }
 
+/*
+ * Copy line from buffer (NULL if invalid index or out of memory)
+ */
+char* output_buffer_copy_line(output_buffer_t* buf, int index)
+{
+    if (!buf || index < 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&buf->mutex);
+    const char* text = (index < buf->count) ? buffer_text(buf, index) : NULL;
+    char* copy = text ? strdup_safe(text) : NULL;
+    pthread_mutex_unlock(&buf->mutex);
+
+    return copy;
+}
+
 /*
  * Get line metadata
  */
@@ -166,12 +493,81 @@ int output_buffer_get_line_meta(output_buffer_t* buf, int index, smartterm_line_
     }
 
     pthread_mutex_lock(&buf->mutex);
-    *meta = buf->lines[index].meta;
+    meta->context = buffer_context(buf, index);
+    meta->timestamp = buffer_timestamp(buf, index);
+    meta->tag = tag_table_name(&buf->tags, buffer_tag_id(buf, index));
     pthread_mutex_unlock(&buf->mutex);
 
     return SMARTTERM_OK;
 }
 
+/*
+ * Get scrollback memory usage
+ */
+int smartterm_get_memory_usage(smartterm_ctx* ctx, smartterm_memory_usage_t* usage)
+{
+    if (!ctx || !ctx->initialized || !usage) {
+        return SMARTTERM_INVALID;
+    }
+
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    usage->text_bytes = buf->text_bytes;
+    usage->meta_bytes = buffer_meta_bytes(buf);
+    usage->index_bytes = buffer_index_bytes(buf);
+    usage->cold_bytes = cold_tier_bytes(&buf->cold);
+    usage->total_bytes = buffer_total_bytes(buf);
+    usage->max_bytes = buf->max_bytes;
+    usage->line_count = buf->count;
+    usage->cold_line_count = cold_tier_lines(buf);
+    usage->spill_bytes = buf->spill.bytes;
+    usage->spill_line_count = buf->spill.count;
+    usage->spill_dropped = buf->spill.dropped;
+    usage->untagged_lines = buf->tags.dropped;
+
+    pthread_mutex_unlock(&buf->mutex);
+    return SMARTTERM_OK;
+}
+
+/*
+ * Count matching bytes in a dense run (auto-vectorizes)
+ */
+static int count_byte(const unsigned char* values, int n, unsigned char value)
+{
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        count += (values[i] == value);
+    }
+    return count;
+}
+
+/*
+ * Count lines with context
+ */
+int smartterm_get_context_count(smartterm_ctx* ctx, smartterm_context_t context)
+{
+    if (!ctx || !ctx->initialized || context < 0 || context >= VIEW_CONTEXT_SLOTS) {
+        return 0;
+    }
+
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    /* The ring is at most two contiguous runs of the context column */
+    int ring_count = buffer_ring_count(buf);
+    int first = buf->capacity - buf->head;
+    if (first > ring_count) {
+        first = ring_count;
+    }
+    int count = count_byte(buf->contexts + buf->head, first, (unsigned char)context) +
+                count_byte(buf->contexts, ring_count - first, (unsigned char)context) +
+                spill_context_count(buf, (unsigned char)context);
+
+    pthread_mutex_unlock(&buf->mutex);
+    return count;
+}
+
 /*
  * Write line to output
  */
@@ -183,7 +579,7 @@ int smartterm_write(smartterm_ctx* ctx, const char* text, smartterm_context_t co
 
     smartterm_line_meta_t meta = {.context = context, .timestamp = get_timestamp(), .tag = NULL};
 
-    int result = output_buffer_add(&ctx->buffer, text, &meta);
+    int result = output_buffer_add(&ctx->buffer, text, &meta, NULL);
     if (result == SMARTTERM_OK) {
         result = render_output(ctx);
     }
@@ -219,7 +615,7 @@ int smartterm_write_meta(smartterm_ctx* ctx, const char* text, const smartterm_l
         return SMARTTERM_INVALID;
     }
 
-    int result = output_buffer_add(&ctx->buffer, text, meta);
+    int result = output_buffer_add(&ctx->buffer, text, meta, NULL);
     if (result == SMARTTERM_OK) {
         result = render_output(ctx);
     }
@@ -227,3 +623,45 @@ int smartterm_write_meta(smartterm_ctx* ctx, const char* text, const smartterm_l
     ctx->last_error = result;
     return result;
 }
+
+/*
+ * Write line that can be updated in place
+ */
+smartterm_line_handle_t smartterm_write_live(smartterm_ctx* ctx, const char* text,
+                                             smartterm_context_t context)
+{
+    smartterm_line_handle_t handle = {.ctx = NULL, .seq = 0};
+    if (!ctx || !ctx->initialized || !text) {
+        return handle;
+    }
+
+    smartterm_line_meta_t meta = {.context = context, .timestamp = get_timestamp(), .tag = NULL};
+
+    int result = output_buffer_add(&ctx->buffer, text, &meta, &handle.seq);
+    if (result == SMARTTERM_OK) {
+        handle.ctx = ctx;
+        result = render_output(ctx);
+    }
+
+    ctx->last_error = result;
+    return handle;
+}
+
+/*
+ * Replace text of live line, redrawing only its row
+ */
+int smartterm_line_update(smartterm_line_handle_t handle, const char* text)
+{
+    smartterm_ctx* ctx = handle.ctx;
+    if (!ctx || !ctx->initialized || !text) {
+        return SMARTTERM_INVALID;
+    }
+
+    int result = output_buffer_update(&ctx->buffer, handle.seq, text);
+    if (result == SMARTTERM_OK) {
+        result = render_output_line(ctx, handle.seq);
+    }
+
+    ctx->last_error = result;
+    return result;
+}
@@ -38,7 +38,122 @@ static int get_attribute_for_context(smartterm_ctx* ctx, smartterm_context_t con
 }
 
 /*
- * Render output buffer to window
+ * Get number of text rows in output window (inside border)
+ */
+int render_page_rows(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->output_win) {
+        return 0;
+    }
+
+    int win_height = getmaxy(ctx->output_win);
+    return win_height > 2 ? win_height - 2 : 0;
+}
+
+/*
+ * Draw one buffer line at window row
+ */
+static void render_line(smartterm_ctx* ctx, int display_row, int win_width, int index)
+{
+    const char* text = buffer_text(&ctx->buffer, index);
+    smartterm_context_t context = buffer_context(&ctx->buffer, index);
+
+    /* Apply color and attributes for context */
+    int color = get_color_for_context(ctx, context);
+    int attr = get_attribute_for_context(ctx, context);
+
+    wattron(ctx->output_win, color | attr);
+
+    /* Truncate line if too long for window */
+    int max_width = win_width - 4; /* Account for border and padding */
+    if (max_width < 4)
+        max_width = 4; /* Minimum width */
+
+    if (strlen(text) > (size_t)max_width) {
+        /* Use dynamic allocation to avoid stack overflow on very wide terminals */
+        char* truncated = malloc(max_width + 1);
+        if (truncated) {
+            strncpy(truncated, text, max_width - 3);
+            truncated[max_width - 3] = '\0';
+            strcat(truncated, "...");
+            mvwprintw(ctx->output_win, display_row, 2, "%s", truncated);
+            free(truncated);
+        } else {
+            /* Fallback: print what we can without truncation marker */
+            mvwprintw(ctx->output_win, display_row, 2, "%.*s", max_width, text);
+        }
+    } else {
+        mvwprintw(ctx->output_win, display_row, 2, "%s", text);
+    }
+
+    wattroff(ctx->output_win, color | attr);
+}
+
+/*
+ * Render active filtered view (buffer mutex held)
+ */
+static void render_view(smartterm_ctx* ctx, int max_visible, int win_width)
+{
+    int* indices = malloc(max_visible * sizeof(int));
+    if (!indices) {
+        return;
+    }
+
+    int visible = view_collect(ctx->active_view, max_visible, indices);
+    for (int row = 0; row < visible; row++) {
+        render_line(ctx, row + 1, win_width, indices[row]);
+    }
+
+    free(indices);
+}
+
+/*
+ * Get index of the top line shown without a view (buffer mutex held)
+ */
+static int render_top_line(smartterm_ctx* ctx, int max_visible)
+{
+    int start_line;
+    if (ctx->buffer.scroll_offset == 0) {
+        /* At bottom - show most recent lines */
+        start_line = (ctx->buffer.count > max_visible) ? (ctx->buffer.count - max_visible) : 0;
+    } else {
+        /* Scrolled up */
+        start_line = ctx->buffer.count - ctx->buffer.scroll_offset - max_visible;
+        if (start_line < 0) {
+            start_line = 0;
+        }
+    }
+    return start_line;
+}
+
+/*
+ * Get window row showing buffer line (buffer mutex held, 0 = not shown)
+ */
+static int render_line_row(smartterm_ctx* ctx, int max_visible, int index)
+{
+    if (max_visible <= 0) {
+        return 0;
+    }
+    if (!ctx->active_view) {
+        int start_line = render_top_line(ctx, max_visible);
+        return index >= start_line && index < start_line + max_visible ? index - start_line + 1
+                                                                        : 0;
+    }
+
+    int* indices = malloc(max_visible * sizeof(int));
+    int row = 0;
+    if (indices) {
+        int visible = view_collect(ctx->active_view, max_visible, indices);
+        for (int i = 0; i < visible && row == 0; i++) {
+            row = indices[i] == index ? i + 1 : 0;
+        }
+        free(indices);
+    }
+    return row;
+}
+
+/*
+ * Render output buffer, or queue a frame in event loop mode
  */
 int render_output(smartterm_ctx* ctx)
 {
@@ -46,6 +161,29 @@ int render_output(smartterm_ctx* ctx)
         return SMARTTERM_NOTINIT;
     }
 
+    screen_lock(ctx);
+    int result = SMARTTERM_OK;
+    if (ctx->loop.poll_fd >= 0) {
+        /* smartterm_step() draws it on the loop thread */
+        loop_request_frame(ctx);
+    } else {
+        result = render_output_frame(ctx);
+    }
+    screen_unlock(ctx);
+
+    return result;
+}
+
+/*
+ * Render output buffer to window now
+ */
+int render_output_frame(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->initialized || !ctx->output_win) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    screen_lock(ctx);
     pthread_mutex_lock(&ctx->buffer.mutex);
 
     werase(ctx->output_win);
@@ -58,63 +196,79 @@ int render_output(smartterm_ctx* ctx)
     int max_visible = win_height - 2;
     if (max_visible <= 0) {
         pthread_mutex_unlock(&ctx->buffer.mutex);
-        wrefresh(ctx->output_win);
+        render_update(ctx);
+        screen_unlock(ctx);
         return SMARTTERM_OK;
     }
 
-    /* Calculate which lines to display */
-    int start_line;
-    if (ctx->buffer.scroll_offset == 0) {
-        /* At bottom - show most recent lines */
-        start_line = (ctx->buffer.count > max_visible) ? (ctx->buffer.count - max_visible) : 0;
-    } else {
-        /* Scrolled up */
-        start_line = ctx->buffer.count - ctx->buffer.scroll_offset - max_visible;
-        if (start_line < 0) {
-            start_line = 0;
-        }
+    if (ctx->active_view) {
+        render_view(ctx, max_visible, win_width);
+        pthread_mutex_unlock(&ctx->buffer.mutex);
+        render_update(ctx);
+        screen_unlock(ctx);
+        return SMARTTERM_OK;
     }
 
+    /* Calculate which lines to display */
+    int start_line = render_top_line(ctx, max_visible);
+
     /* Render visible lines */
     int display_row = 1; /* Start after border */
     for (int i = start_line; i < ctx->buffer.count && display_row <= max_visible; i++) {
-        output_line_t* line = &ctx->buffer.lines[i];
-
-        /* Apply color and attributes for context */
-        int color = get_color_for_context(ctx, line->meta.context);
-        int attr = get_attribute_for_context(ctx, line->meta.context);
-
-        wattron(ctx->output_win, color | attr);
-
-        /* Truncate line if too long for window */
-        int max_width = win_width - 4; /* Account for border and padding */
-        if (max_width < 4)
-            max_width = 4; /* Minimum width */
-
-        if (strlen(line->text) > (size_t)max_width) {
-            /* Use dynamic allocation to avoid stack overflow on very wide terminals */
-            char* truncated = malloc(max_width + 1);
-            if (truncated) {
-                strncpy(truncated, line->text, max_width - 3);
-                truncated[max_width - 3] = '\0';
-                strcat(truncated, "...");
-                mvwprintw(ctx->output_win, display_row, 2, "%s", truncated);
-                free(truncated);
-            } else {
-                /* Fallback: print what we can without truncation marker */
-                mvwprintw(ctx->output_win, display_row, 2, "%.*s", max_width, line->text);
-            }
-        } else {
-            mvwprintw(ctx->output_win, display_row, 2, "%s", line->text);
-        }
-
-        wattroff(ctx->output_win, color | attr);
+        render_line(ctx, display_row, win_width, i);
         display_row++;
     }
 
     pthread_mutex_unlock(&ctx->buffer.mutex);
 
-    wrefresh(ctx->output_win);
+    render_update(ctx);
+    screen_unlock(ctx);
+    return SMARTTERM_OK;
+}
+
+/*
+ * Redraw the row of line seq, if it is on screen
+ *
+ * Lines scrolled out of view or filtered out are not drawn at all. In
+ * event loop mode a visible line queues a frame instead. A substring
+ * view may gain or lose the line, so it gets a whole frame.
+ */
+int render_output_line(smartterm_ctx* ctx, unsigned long seq)
+{
+    if (!ctx || !ctx->initialized || !ctx->output_win) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    screen_lock(ctx);
+    pthread_mutex_lock(&ctx->buffer.mutex);
+    if (ctx->active_view && ctx->active_view->substring) {
+        pthread_mutex_unlock(&ctx->buffer.mutex);
+        screen_unlock(ctx);
+        return render_output(ctx);
+    }
+
+    int win_height, win_width;
+    getmaxyx(ctx->output_win, win_height, win_width);
+
+    int row = 0;
+    output_buffer_t* buf = &ctx->buffer;
+    if (seq >= buf->base_seq && seq - buf->base_seq < (unsigned long)buf->count) {
+        row = render_line_row(ctx, win_height - 2, (int)(seq - buf->base_seq));
+    }
+
+    if (row > 0 && ctx->loop.poll_fd >= 0) {
+        loop_request_frame(ctx);
+    } else if (row > 0) {
+        /* Clear inside the border, then draw the new text */
+        mvwhline(ctx->output_win, row, 1, ' ', win_width - 2);
+        render_line(ctx, row, win_width, (int)(seq - buf->base_seq));
+    }
+
+    pthread_mutex_unlock(&ctx->buffer.mutex);
+    if (row > 0 && ctx->loop.poll_fd < 0) {
+        render_update(ctx);
+    }
+    screen_unlock(ctx);
     return SMARTTERM_OK;
 }
 
@@ -127,6 +281,7 @@ int render_status(smartterm_ctx* ctx)
         return SMARTTERM_OK;
     }
 
+    screen_lock(ctx);
     werase(ctx->status_win);
 
     /* Render with reverse video for status bar effect */
@@ -149,10 +304,32 @@ int render_status(smartterm_ctx* ctx)
 
     wattroff(ctx->status_win, A_REVERSE);
 
-    wrefresh(ctx->status_win);
+    render_update(ctx);
+    screen_unlock(ctx);
     return SMARTTERM_OK;
 }
 
+/*
+ * Copy drawn windows to the terminal, cursor left on the input line
+ *
+ * Called with the screen mutex held after drawing. Output and status
+ * windows do not move the cursor (leaveok), so refreshing them never
+ * disturbs the line being edited.
+ */
+void render_update(smartterm_ctx* ctx)
+{
+    if (ctx->output_win) {
+        wnoutrefresh(ctx->output_win);
+    }
+    if (ctx->status_win && ctx->status_visible) {
+        wnoutrefresh(ctx->status_win);
+    }
+    if (ctx->input_win) {
+        wnoutrefresh(ctx->input_win);
+    }
+    doupdate();
+}
+
 /*
  * Render all windows
  */
@@ -162,10 +339,14 @@ int render_all(smartterm_ctx* ctx)
         return SMARTTERM_NOTINIT;
     }
 
-    int result = render_output(ctx);
+    screen_lock(ctx);
+    int result = render_output_frame(ctx);
     if (result == SMARTTERM_OK) {
         result = render_status(ctx);
     }
+    editor_draw(ctx);
+    render_update(ctx);
+    screen_unlock(ctx);
 
     return result;
 }
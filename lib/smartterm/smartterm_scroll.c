@@ -7,6 +7,22 @@
 #include "smartterm_internal.h"
 #include <stdio.h>
 
+/*
+ * Scroll active filtered view
+ */
+static int scroll_view(smartterm_ctx* ctx, int lines)
+{
+    pthread_mutex_lock(&ctx->buffer.mutex);
+    view_scroll(ctx->active_view, lines, render_page_rows(ctx));
+    bool follow = ctx->active_view->follow;
+    pthread_mutex_unlock(&ctx->buffer.mutex);
+
+    /* Update status bar with scroll indicator */
+    smartterm_status_set(ctx, NULL, follow ? "" : "[SCROLL]");
+
+    return render_output(ctx);
+}
+
 /*
  * Scroll output buffer
  */
@@ -16,6 +32,10 @@ int smartterm_scroll(smartterm_ctx* ctx, int lines)
         return SMARTTERM_NOTINIT;
     }
 
+    if (ctx->active_view) {
+        return scroll_view(ctx, lines);
+    }
+
     pthread_mutex_lock(&ctx->buffer.mutex);
 
     /* Calculate new scroll offset */
@@ -62,6 +82,9 @@ int smartterm_scroll_top(smartterm_ctx* ctx)
     }
 
     pthread_mutex_lock(&ctx->buffer.mutex);
+    if (ctx->active_view) {
+        view_scroll_to(ctx->active_view, 0);
+    }
     ctx->buffer.scroll_offset = ctx->buffer.count;
     ctx->buffer.auto_scroll = false;
     pthread_mutex_unlock(&ctx->buffer.mutex);
@@ -79,6 +102,9 @@ int smartterm_scroll_bottom(smartterm_ctx* ctx)
     }
 
     pthread_mutex_lock(&ctx->buffer.mutex);
+    if (ctx->active_view) {
+        view_follow(ctx->active_view);
+    }
     ctx->buffer.scroll_offset = 0;
     ctx->buffer.auto_scroll = true;
     pthread_mutex_unlock(&ctx->buffer.mutex);
@@ -99,7 +125,12 @@ int smartterm_get_scroll_pos(smartterm_ctx* ctx)
     }
 
     pthread_mutex_lock(&ctx->buffer.mutex);
-    int pos = ctx->buffer.count - ctx->buffer.scroll_offset;
+    int pos;
+    if (ctx->active_view) {
+        pos = view_top_index(ctx->active_view, render_page_rows(ctx));
+    } else {
+        pos = ctx->buffer.count - ctx->buffer.scroll_offset;
+    }
     pthread_mutex_unlock(&ctx->buffer.mutex);
 
     return pos;
@@ -121,6 +152,9 @@ int smartterm_set_auto_scroll(smartterm_ctx* ctx, bool enabled)
     if (enabled && ctx->buffer.scroll_offset != 0) {
         ctx->buffer.scroll_offset = 0;
     }
+    if (enabled && ctx->active_view) {
+        view_follow(ctx->active_view);
+    }
     pthread_mutex_unlock(&ctx->buffer.mutex);
 
     return render_output(ctx);
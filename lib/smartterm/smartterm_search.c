@@ -28,7 +28,7 @@ static int search_plain(smartterm_ctx* ctx, const char* pattern,
 
     /* Search each line */
     for (int i = 0; i < ctx->buffer.count; i++) {
-        const char* line = ctx->buffer.lines[i].text;
+        const char* line = buffer_text(&ctx->buffer, i);
         const char* pos = line;
 
         /* Find all occurrences in this line */
@@ -90,7 +90,7 @@ static int search_regex(smartterm_ctx* ctx, const char* pattern,
 
     /* Search each line */
     for (int i = 0; i < ctx->buffer.count; i++) {
-        const char* line = ctx->buffer.lines[i].text;
+        const char* line = buffer_text(&ctx->buffer, i);
         const char* search_pos = line;
         regmatch_t match;
 
@@ -132,6 +132,25 @@ static int search_regex(smartterm_ctx* ctx, const char* pattern,
     return SMARTTERM_OK;
 }
 
+/*
+ * Scroll so that matched line is visible
+ */
+static void search_show_line(smartterm_ctx* ctx, int line)
+{
+    pthread_mutex_lock(&ctx->buffer.mutex);
+
+    if (ctx->active_view) {
+        view_scroll_to(ctx->active_view, line);
+    } else {
+        ctx->buffer.scroll_offset = ctx->buffer.count - line - 1;
+        if (ctx->buffer.scroll_offset < 0) {
+            ctx->buffer.scroll_offset = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->buffer.mutex);
+}
+
 /*
  * Search in output buffer
  */
@@ -192,10 +211,7 @@ int smartterm_search_next(smartterm_ctx* ctx)
 
     /* Scroll to show the match */
     int line = ctx->search.results[ctx->search.current_result].line_index;
-    ctx->buffer.scroll_offset = ctx->buffer.count - line - 1;
-    if (ctx->buffer.scroll_offset < 0) {
-        ctx->buffer.scroll_offset = 0;
-    }
+    search_show_line(ctx, line);
 
     return render_output(ctx);
 }
@@ -221,10 +237,7 @@ int smartterm_search_prev(smartterm_ctx* ctx)
 
     /* Scroll to show the match */
     int line = ctx->search.results[ctx->search.current_result].line_index;
-    ctx->buffer.scroll_offset = ctx->buffer.count - line - 1;
-    if (ctx->buffer.scroll_offset < 0) {
-        ctx->buffer.scroll_offset = 0;
-    }
+    search_show_line(ctx, line);
 
     return render_output(ctx);
 }
@@ -0,0 +1,320 @@
+/*
+ * SmartTerm Library - Session Save/Restore
+ *
+ * Sessions use the segment file format (see smartterm_internal.h) with
+ * columns sized to the line count and the tag names appended. Loading
+ * maps the file and adopts it as a read-only spill segment, so restoring
+ * a million lines costs one mmap and a validation pass over the offset
+ * column, with no per-line copies.
+ */
+
+#include "smartterm_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Lines gathered per pwritev call. A batch spans at most two cold blocks,
+ * so decompressed text stays in the block cache until it is written.
+ */
+#define SESSION_WRITE_BATCH COLD_BLOCK_LINES
+
+/*
+ * Write iovec array at offset, retrying short writes
+ */
+static int session_pwritev(int fd, struct iovec* iov, int iovcnt, off_t offset)
+{
+    while (iovcnt > 0) {
+        ssize_t written = pwritev(fd, iov, iovcnt, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return SMARTTERM_IOERROR;
+        }
+
+        offset += written;
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Write single region at offset
+ */
+static int session_pwrite(int fd, const void* data, size_t size, off_t offset)
+{
+    struct iovec iov = {.iov_base = (void*)data, .iov_len = size};
+    return session_pwritev(fd, &iov, 1, offset);
+}
+
+/*
+ * Build header and columns for lines [start, start + count) (buffer mutex held)
+ *
+ * The header is complete: text offsets follow from the line lengths, and
+ * the tag names for IDs 1..n come after the text, so tag IDs in the file
+ * need no remapping.
+ */
+int session_columns_build(session_columns_t* columns, output_buffer_t* buf, int start, int count)
+{
+    memset(columns, 0, sizeof(*columns));
+    segment_header_t* header = &columns->header;
+    uint64_t text_at = segment_layout(header, (uint32_t)count, buf->ts_base);
+
+    columns->offsets = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    columns->ts_deltas = malloc((count > 0 ? count : 1) * sizeof(int32_t));
+    columns->tag_ids = malloc((count > 0 ? count : 1) * sizeof(uint16_t));
+    columns->contexts = malloc((count > 0 ? count : 1) * sizeof(uint8_t));
+    if (!columns->offsets || !columns->ts_deltas || !columns->tag_ids || !columns->contexts) {
+        session_columns_free(columns);
+        return SMARTTERM_NOMEM;
+    }
+
+    uint64_t text_size = 0;
+    for (int i = 0; i < count; i++) {
+        int index = start + i;
+        columns->offsets[i] = text_size;
+        columns->ts_deltas[i] = segment_delta(buffer_timestamp(buf, index), buf->ts_base);
+        columns->tag_ids[i] = (uint16_t)buffer_tag_id(buf, index);
+        columns->contexts[i] = (uint8_t)buffer_context(buf, index);
+        text_size += strlen(buffer_text(buf, index)) + 1;
+    }
+
+    header->count = (uint32_t)count;
+    header->text_size = text_size;
+    header->tags_at = (text_at + text_size + 7) & ~(uint64_t)7;
+    header->tag_count = buf->tags.count > 1 ? (uint32_t)(buf->tags.count - 1) : 0;
+    for (uint32_t id = 1; id <= header->tag_count; id++) {
+        header->tags_size += strlen(tag_table_name(&buf->tags, (int)id)) + 1;
+    }
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Free columns built by session_columns_build()
+ */
+void session_columns_free(session_columns_t* columns)
+{
+    free(columns->offsets);
+    free(columns->ts_deltas);
+    free(columns->tag_ids);
+    free(columns->contexts);
+    columns->offsets = NULL;
+    columns->ts_deltas = NULL;
+    columns->tag_ids = NULL;
+    columns->contexts = NULL;
+}
+
+/*
+ * Write all lines, columns and tag names of buffer (buffer mutex held)
+ */
+static int session_write(output_buffer_t* buf, int fd)
+{
+    int count = buf->count;
+    session_columns_t columns;
+    int result = session_columns_build(&columns, buf, 0, count);
+    if (result != SMARTTERM_OK) {
+        return result;
+    }
+    segment_header_t* header = &columns.header;
+
+    /* Text blob in batches */
+    struct iovec iov[SESSION_WRITE_BATCH];
+    uint64_t batch_at = header->text_at;
+    int batched = 0;
+
+    for (int i = 0; i < count && result == SMARTTERM_OK; i++) {
+        const char* text = buffer_text(buf, i);
+        size_t len = strlen(text) + 1;
+
+        iov[batched].iov_base = (void*)text;
+        iov[batched].iov_len = len;
+        batched++;
+
+        if (batched == SESSION_WRITE_BATCH || i == count - 1) {
+            result = session_pwritev(fd, iov, batched, (off_t)batch_at);
+            batch_at = header->text_at + (i + 1 < count ? columns.offsets[i + 1] : 0);
+            batched = 0;
+        }
+    }
+
+    uint64_t tags_at = header->tags_at;
+    for (uint32_t id = 1; id <= header->tag_count && result == SMARTTERM_OK; id++) {
+        const char* name = tag_table_name(&buf->tags, (int)id);
+        size_t len = strlen(name) + 1;
+        result = session_pwrite(fd, name, len, (off_t)tags_at);
+        tags_at += len;
+    }
+
+    if (result == SMARTTERM_OK) {
+        struct iovec column_iov[] = {
+            {.iov_base = columns.offsets, .iov_len = count * sizeof(uint64_t)},
+            {.iov_base = columns.ts_deltas, .iov_len = count * sizeof(int32_t)},
+            {.iov_base = columns.tag_ids, .iov_len = count * sizeof(uint16_t)},
+            {.iov_base = columns.contexts, .iov_len = count * sizeof(uint8_t)},
+        };
+        /* Columns are contiguous in the layout */
+        result = session_pwritev(fd, column_iov, 4, (off_t)header->offsets_at);
+    }
+
+    /* Header last: a file cut short never carries a valid one */
+    if (result == SMARTTERM_OK) {
+        result = session_pwrite(fd, header, sizeof(*header), 0);
+    }
+
+    session_columns_free(&columns);
+    return result;
+}
+
+/*
+ * Save scrollback to session file
+ */
+int smartterm_save_session(smartterm_ctx* ctx, const char* filename)
+{
+    if (!ctx || !ctx->initialized || !filename) {
+        return SMARTTERM_INVALID;
+    }
+
+    /* Write beside the target and rename, so a crash keeps the old file */
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", filename) >= (int)sizeof(tmp_path)) {
+        return SMARTTERM_INVALID;
+    }
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return SMARTTERM_IOERROR;
+    }
+
+    pthread_mutex_lock(&ctx->buffer.mutex);
+    int result = session_write(&ctx->buffer, fd);
+    pthread_mutex_unlock(&ctx->buffer.mutex);
+
+    if (result == SMARTTERM_OK && fsync(fd) != 0) {
+        result = SMARTTERM_IOERROR;
+    }
+    if (close(fd) != 0 && result == SMARTTERM_OK) {
+        result = SMARTTERM_IOERROR;
+    }
+    if (result == SMARTTERM_OK && rename(tmp_path, filename) != 0) {
+        result = SMARTTERM_IOERROR;
+    }
+    if (result != SMARTTERM_OK) {
+        unlink(tmp_path);
+    }
+
+    return result;
+}
+
+/*
+ * Map session tag IDs to buffer tag IDs (buffer mutex held)
+ */
+static int session_map_tags(output_buffer_t* buf, spill_segment_t* segment)
+{
+    const segment_header_t* header = segment->header;
+    if (header->tag_count == 0) {
+        return SMARTTERM_OK;
+    }
+
+    /* Full-range table, so out-of-range IDs in the file read as "no tag" */
+    segment->tag_map = calloc(MAX_TAGS + 1, sizeof(uint16_t));
+    if (!segment->tag_map) {
+        return SMARTTERM_NOMEM;
+    }
+
+    const char* name = (const char*)segment->map + header->tags_at;
+    const char* end = name + header->tags_size;
+    for (uint32_t id = 1; id <= header->tag_count && id <= MAX_TAGS; id++) {
+        const char* terminator = memchr(name, '\0', end - name);
+        if (!terminator) {
+            return SMARTTERM_IOERROR;
+        }
+
+        int tag_id = tag_table_intern(&buf->tags, name);
+        if (tag_id < 0) {
+            return tag_id;
+        }
+        segment->tag_map[id] = (uint16_t)tag_id;
+        name = terminator + 1;
+    }
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Replace scrollback with session file
+ */
+int smartterm_load_session(smartterm_ctx* ctx, const char* filename)
+{
+    if (!ctx || !ctx->initialized || !filename) {
+        return SMARTTERM_INVALID;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return SMARTTERM_IOERROR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return SMARTTERM_IOERROR;
+    }
+
+    spill_segment_t segment;
+    int result = segment_map(&segment, fd, (size_t)st.st_size, false);
+    close(fd);
+    if (result != SMARTTERM_OK) {
+        return result;
+    }
+
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    spill_segment_t* slot = NULL;
+    result = session_map_tags(buf, &segment);
+    if (result == SMARTTERM_OK) {
+        output_buffer_clear_locked(buf);
+        slot = spill_reserve_segment(&buf->spill);
+        result = slot ? SMARTTERM_OK : SMARTTERM_NOMEM;
+    }
+
+    if (result == SMARTTERM_OK) {
+        /* Adopt mapping as the oldest lines; new output follows it */
+        segment.first_seq = buf->base_seq;
+        *slot = segment;
+        buf->spill.segment_count++;
+        buf->spill.count = segment.count;
+        buf->spill.bytes += segment.map_size;
+        buf->count = segment.count;
+        buf->auto_scroll = true;
+        view_invalidate_counts(buf);
+    }
+
+    pthread_mutex_unlock(&buf->mutex);
+
+    if (result != SMARTTERM_OK) {
+        free(segment.tag_map);
+        munmap(segment.map, segment.map_size);
+        return result;
+    }
+
+    return render_output(ctx);
+}
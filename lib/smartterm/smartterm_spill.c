@@ -0,0 +1,465 @@
+/*
+ * SmartTerm Library - Disk Spillover
+ *
+ * Lines evicted from the in-memory ring are appended to segment files in
+ * config.spill_dir and stay reachable by index. Each segment is
+ * preallocated and mapped once, so appends are plain memory copies and
+ * lookups return pointers straight into the mapping. Loaded sessions are
+ * adopted as read-only segments in the same list.
+ *
+ * Spill segment files are unlinked as soon as they are created: the
+ * mapping keeps them alive, and the kernel reclaims them when the process
+ * exits, even after a crash.
+ *
+ * All functions expect the buffer mutex to be held.
+ */
+
+#include "smartterm_internal.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Round file offset up to 8-byte alignment
+ */
+static uint64_t align8(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+/*
+ * Fill header and lay out metadata columns for capacity lines
+ *
+ * Returns file offset of the text blob.
+ */
+uint64_t segment_layout(segment_header_t* header, uint32_t capacity, long ts_base)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SEGMENT_MAGIC, sizeof(header->magic));
+    header->version = SEGMENT_VERSION;
+    header->capacity = capacity;
+    header->ts_base = ts_base;
+
+    header->offsets_at = align8(sizeof(segment_header_t));
+    header->ts_deltas_at = header->offsets_at + (uint64_t)capacity * sizeof(uint64_t);
+    header->tag_ids_at = header->ts_deltas_at + (uint64_t)capacity * sizeof(int32_t);
+    header->contexts_at = header->tag_ids_at + (uint64_t)capacity * sizeof(uint16_t);
+    header->text_at = align8(header->contexts_at + (uint64_t)capacity * sizeof(uint8_t));
+
+    return header->text_at;
+}
+
+/*
+ * Encode timestamp relative to segment reference (clamped to int32 range)
+ */
+int32_t segment_delta(long timestamp, long ts_base)
+{
+    long delta = timestamp - ts_base;
+    if (delta > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (delta < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)delta;
+}
+
+/*
+ * Check that a section lies inside the file
+ */
+static bool section_fits(uint64_t at, uint64_t size, size_t file_size)
+{
+    return at <= file_size && size <= file_size - at;
+}
+
+/*
+ * Map segment file and validate its header
+ *
+ * Read-only segments are also checked line by line, so a truncated or
+ * corrupt file is rejected instead of crashing a later lookup.
+ */
+int segment_map(spill_segment_t* segment, int fd, size_t size, bool writable)
+{
+    if (size < sizeof(segment_header_t)) {
+        return SMARTTERM_IOERROR;
+    }
+
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* map = mmap(NULL, size, prot, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return SMARTTERM_IOERROR;
+    }
+
+    const segment_header_t* header = map;
+    uint64_t capacity = header->capacity;
+    bool valid = memcmp(header->magic, SEGMENT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == SEGMENT_VERSION && header->count <= capacity &&
+                 capacity <= INT_MAX && header->offsets_at % 8 == 0 &&
+                 header->ts_deltas_at % 4 == 0 && header->tag_ids_at % 2 == 0 &&
+                 section_fits(header->offsets_at, capacity * sizeof(uint64_t), size) &&
+                 section_fits(header->ts_deltas_at, capacity * sizeof(int32_t), size) &&
+                 section_fits(header->tag_ids_at, capacity * sizeof(uint16_t), size) &&
+                 section_fits(header->contexts_at, capacity * sizeof(uint8_t), size) &&
+                 section_fits(header->text_at, header->text_size, size) &&
+                 section_fits(header->tags_at, header->tags_size, size);
+    if (!valid) {
+        munmap(map, size);
+        return SMARTTERM_IOERROR;
+    }
+
+    unsigned char* base = map;
+    segment->map = base;
+    segment->map_size = size;
+    segment->header = map;
+    segment->offsets = (uint64_t*)(base + header->offsets_at);
+    segment->ts_deltas = (int32_t*)(base + header->ts_deltas_at);
+    segment->tag_ids = (uint16_t*)(base + header->tag_ids_at);
+    segment->contexts = base + header->contexts_at;
+    segment->text = (char*)(base + header->text_at);
+    segment->text_used = header->text_size;
+    segment->text_capacity = writable ? size - header->text_at : header->text_size;
+    segment->count = (int)header->count;
+    segment->capacity = (int)capacity;
+    segment->ts_base = header->ts_base;
+    segment->writable = writable;
+    segment->tag_map = NULL;
+
+    if (!writable) {
+        /* Every line must start inside the blob, and the blob must end a line */
+        bool lines_valid = header->count == 0 ||
+                           (header->text_size > 0 && segment->text[header->text_size - 1] == '\0');
+        for (int i = 0; lines_valid && i < segment->count; i++) {
+            lines_valid = segment->offsets[i] < header->text_size;
+        }
+        if (!lines_valid) {
+            munmap(map, size);
+            return SMARTTERM_IOERROR;
+        }
+    }
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Enable spilling to directory
+ */
+int spill_init(spill_t* spill, const char* dir)
+{
+    memset(spill, 0, sizeof(*spill));
+    if (!dir) {
+        return SMARTTERM_OK;
+    }
+
+    spill->dir = strdup_safe(dir);
+    return spill->dir ? SMARTTERM_OK : SMARTTERM_NOMEM;
+}
+
+/*
+ * Unmap segment
+ */
+static void spill_segment_close(spill_t* spill, spill_segment_t* segment)
+{
+    munmap(segment->map, segment->map_size);
+    free(segment->tag_map);
+    spill->bytes -= segment->map_size;
+}
+
+/*
+ * Drop all segments
+ */
+void spill_clear(spill_t* spill)
+{
+    for (int i = 0; i < spill->segment_count; i++) {
+        spill_segment_close(spill, &spill->segments[i]);
+    }
+    spill->segment_count = 0;
+    spill->count = 0;
+}
+
+/*
+ * Drop all segments and disable spilling
+ */
+void spill_cleanup(spill_t* spill)
+{
+    if (!spill) {
+        return;
+    }
+
+    spill_clear(spill);
+    free(spill->segments);
+    free(spill->dir);
+    memset(spill, 0, sizeof(*spill));
+}
+
+/*
+ * Get zeroed slot for a new newest segment (not yet counted)
+ */
+spill_segment_t* spill_reserve_segment(spill_t* spill)
+{
+    if (spill->segment_count >= spill->segment_capacity) {
+        int new_capacity = spill->segment_capacity ? spill->segment_capacity * 2 : 8;
+        spill_segment_t* segments =
+            realloc(spill->segments, new_capacity * sizeof(spill_segment_t));
+        if (!segments) {
+            return NULL;
+        }
+        spill->segments = segments;
+        spill->segment_capacity = new_capacity;
+    }
+
+    spill_segment_t* segment = &spill->segments[spill->segment_count];
+    memset(segment, 0, sizeof(*segment));
+    return segment;
+}
+
+/*
+ * Create, preallocate and map a new spill segment file
+ */
+static spill_segment_t* spill_next_segment(output_buffer_t* buf)
+{
+    spill_t* spill = &buf->spill;
+    spill_segment_t* segment = spill_reserve_segment(spill);
+    if (!segment) {
+        return NULL;
+    }
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/smartterm-XXXXXX", spill->dir) >= (int)sizeof(path)) {
+        return NULL;
+    }
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+
+    segment_header_t header;
+    size_t size = segment_layout(&header, SPILL_SEGMENT_LINES, buf->ts_base) + SPILL_SEGMENT_DATA;
+
+    /* Reserve blocks up front so a full disk fails here, not as SIGBUS */
+    int result = SMARTTERM_IOERROR;
+    if (posix_fallocate(fd, 0, size) == 0 &&
+        pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)) {
+        result = segment_map(segment, fd, size, true);
+    }
+    close(fd);
+
+    if (result != SMARTTERM_OK) {
+        return NULL;
+    }
+
+    segment->first_seq = buffer_ring_seq(buf);
+    spill->segment_count++;
+    spill->bytes += size;
+    return segment;
+}
+
+/*
+ * Get lines of oldest segment that are still reachable
+ */
+static int spill_first_remaining(const output_buffer_t* buf)
+{
+    const spill_segment_t* segment = &buf->spill.segments[0];
+    return (int)(segment->first_seq + segment->count - buf->base_seq);
+}
+
+/*
+ * Unmap oldest segment once all its lines are gone
+ */
+static void spill_release_first(spill_t* spill)
+{
+    spill_segment_close(spill, &spill->segments[0]);
+    memmove(&spill->segments[0], &spill->segments[1],
+            (spill->segment_count - 1) * sizeof(spill_segment_t));
+    spill->segment_count--;
+}
+
+/*
+ * Drop oldest segment; its lines stop being reachable
+ */
+void spill_drop_oldest(output_buffer_t* buf)
+{
+    spill_t* spill = &buf->spill;
+    if (spill->segment_count == 0) {
+        return;
+    }
+
+    int lines = spill_first_remaining(buf);
+    spill_release_first(spill);
+
+    spill->count -= lines;
+    buf->count -= lines;
+    buf->base_seq += lines;
+    view_invalidate_counts(buf);
+}
+
+/*
+ * Drop oldest spilled line
+ */
+void spill_drop_line(output_buffer_t* buf)
+{
+    spill_t* spill = &buf->spill;
+    if (spill->count == 0) {
+        return;
+    }
+
+    view_on_evict(buf, 0);
+    spill->count--;
+    buf->count--;
+    buf->base_seq++;
+
+    if (spill_first_remaining(buf) == 0) {
+        spill_release_first(spill);
+    }
+}
+
+/*
+ * Renumber spilled lines after the oldest in-memory line was dropped
+ *
+ * The caller advances base_seq past the dropped line. Spilled lines move
+ * one sequence number later so they keep their indices; lines in memory
+ * keep their sequence numbers.
+ */
+void spill_renumber(output_buffer_t* buf)
+{
+    spill_t* spill = &buf->spill;
+    for (int i = 0; i < spill->segment_count; i++) {
+        spill->segments[i].first_seq++;
+    }
+    view_on_renumber(buf, buffer_ring_seq(buf));
+}
+
+/*
+ * Move oldest in-memory line to disk
+ *
+ * On success the line becomes spilled line spill.count - 1; the caller
+ * still owns and frees the ring slot. Fails if no segment can be created.
+ */
+int spill_append(output_buffer_t* buf)
+{
+    spill_t* spill = &buf->spill;
+
+    /* Keep line indices in int range for week-long sessions */
+    if (buf->count >= SPILL_MAX_LINES && spill->segment_count > 1) {
+        spill_drop_oldest(buf);
+    }
+
+    const char* text = buffer_text(buf, spill->count);
+    size_t len = strlen(text) + 1;
+    if (len > SPILL_SEGMENT_DATA) {
+        len = SPILL_SEGMENT_DATA; /* Truncate; terminator is forced below */
+    }
+
+    spill_segment_t* segment =
+        spill->segment_count ? &spill->segments[spill->segment_count - 1] : NULL;
+    if (!segment || !segment->writable || segment->count >= segment->capacity ||
+        len > segment->text_capacity - segment->text_used) {
+        segment = spill_next_segment(buf);
+        if (!segment) {
+            return SMARTTERM_IOERROR;
+        }
+    }
+
+    int slot = buffer_ring_slot(buf, 0);
+    int line = segment->count;
+    segment->offsets[line] = segment->text_used;
+    segment->ts_deltas[line] = segment_delta(buf->ts_base + buf->ts_deltas[slot], segment->ts_base);
+    segment->tag_ids[line] = buf->tag_ids[slot];
+    segment->contexts[line] = buf->contexts[slot];
+
+    memcpy(segment->text + segment->text_used, text, len);
+    segment->text[segment->text_used + len - 1] = '\0';
+    segment->text_used += len;
+    segment->count++;
+    segment->header->count = (uint32_t)segment->count;
+    segment->header->text_size = segment->text_used;
+
+    spill->count++;
+    return SMARTTERM_OK;
+}
+
+/*
+ * Find segment holding spilled line and the line's position in it
+ */
+static const spill_segment_t* spill_find(const output_buffer_t* buf, int index, int* line)
+{
+    const spill_t* spill = &buf->spill;
+    unsigned long seq = buf->base_seq + index;
+
+    /* Last segment starting at or before seq */
+    int lo = 0;
+    int hi = spill->segment_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (spill->segments[mid].first_seq <= seq) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    *line = (int)(seq - spill->segments[lo].first_seq);
+    return &spill->segments[lo];
+}
+
+/*
+ * Get text of spilled line
+ */
+const char* spill_text(const output_buffer_t* buf, int index)
+{
+    int line;
+    const spill_segment_t* segment = spill_find(buf, index, &line);
+    return segment->text + segment->offsets[line];
+}
+
+/*
+ * Get context of spilled line
+ */
+int spill_context(const output_buffer_t* buf, int index)
+{
+    int line;
+    const spill_segment_t* segment = spill_find(buf, index, &line);
+    return segment->contexts[line];
+}
+
+/*
+ * Get timestamp of spilled line
+ */
+long spill_timestamp(const output_buffer_t* buf, int index)
+{
+    int line;
+    const spill_segment_t* segment = spill_find(buf, index, &line);
+    return segment->ts_base + segment->ts_deltas[line];
+}
+
+/*
+ * Get buffer tag ID of spilled line
+ */
+int spill_tag_id(const output_buffer_t* buf, int index)
+{
+    int line;
+    const spill_segment_t* segment = spill_find(buf, index, &line);
+    uint16_t tag_id = segment->tag_ids[line];
+    return segment->tag_map ? segment->tag_map[tag_id] : tag_id;
+}
+
+/*
+ * Count spilled lines with context
+ */
+int spill_context_count(const output_buffer_t* buf, unsigned char context)
+{
+    int count = 0;
+    for (int i = 0; i < buf->spill.segment_count; i++) {
+        const spill_segment_t* segment = &buf->spill.segments[i];
+        int first = (i == 0) ? segment->count - spill_first_remaining(buf) : 0;
+        for (int j = first; j < segment->count; j++) {
+            count += (segment->contexts[j] == context);
+        }
+    }
+    return count;
+}
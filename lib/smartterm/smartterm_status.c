@@ -18,6 +18,7 @@ int smartterm_status_set(smartterm_ctx* ctx, const char* left, const char* right
         return SMARTTERM_NOTINIT;
     }
 
+    screen_lock(ctx);
     if (left) {
         strncpy(ctx->status_left, left, MAX_STATUS_TEXT - 1);
         ctx->status_left[MAX_STATUS_TEXT - 1] = '\0';
@@ -28,7 +29,9 @@ int smartterm_status_set(smartterm_ctx* ctx, const char* left, const char* right
         ctx->status_right[MAX_STATUS_TEXT - 1] = '\0';
     }
 
-    return render_status(ctx);
+    int result = render_status(ctx);
+    screen_unlock(ctx);
+    return result;
 }
 
 /*
@@ -44,6 +47,8 @@ int smartterm_status_update(smartterm_ctx* ctx, const char* left_fmt, const char
         return SMARTTERM_NOTINIT;
     }
 
+    screen_lock(ctx);
+
     va_list args;
     va_start(args, right_fmt);
 
@@ -64,7 +69,9 @@ int smartterm_status_update(smartterm_ctx* ctx, const char* left_fmt, const char
 
     va_end(args);
 
-    return render_status(ctx);
+    int result = render_status(ctx);
+    screen_unlock(ctx);
+    return result;
 }
 
 /*
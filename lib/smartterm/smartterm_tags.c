@@ -0,0 +1,209 @@
+/*
+ * SmartTerm Library - Tag Interning Implementation
+ *
+ * Line tags are interned into a per-buffer table so each line stores a
+ * small integer ID instead of its own copy of the string. Tag comparison
+ * becomes an integer compare. IDs are never recycled, so interned names
+ * stay valid until the buffer is destroyed. Once MAX_TAGS names are
+ * interned the table is full: further names get ID 0 and their lines are
+ * stored untagged.
+ */
+
+#include "smartterm_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * FNV-1a string hash
+ */
+static unsigned int tag_hash(const char* name)
+{
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Find hash slot holding name, or the empty slot where it belongs
+ */
+static int tag_slot(const tag_table_t* table, const char* name)
+{
+    unsigned int mask = table->slot_count - 1;
+    unsigned int slot = tag_hash(name) & mask;
+
+    while (table->slots[slot] != 0 && strcmp(table->names[table->slots[slot]], name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/*
+ * Double hash slot array and re-insert all IDs
+ */
+static int tag_table_rehash(tag_table_t* table)
+{
+    int new_count = table->slot_count ? table->slot_count * 2 : 64;
+    unsigned short* new_slots = calloc(new_count, sizeof(unsigned short));
+    if (!new_slots) {
+        return SMARTTERM_NOMEM;
+    }
+
+    free(table->slots);
+    table->slots = new_slots;
+    table->slot_count = new_count;
+
+    for (int id = 1; id < table->count; id++) {
+        table->slots[tag_slot(table, table->names[id])] = (unsigned short)id;
+    }
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Free tag table
+ */
+void tag_table_cleanup(tag_table_t* table)
+{
+    if (!table) {
+        return;
+    }
+
+    for (int id = 1; id < table->count; id++) {
+        free(table->names[id]);
+    }
+
+    free(table->names);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+/*
+ * Look up tag ID (0 if name is NULL or not interned)
+ */
+int tag_table_find(const tag_table_t* table, const char* name)
+{
+    if (!name || table->slot_count == 0) {
+        return 0;
+    }
+    return table->slots[tag_slot(table, name)];
+}
+
+/*
+ * Intern tag and return its ID (0 for NULL or full table, negative error code on failure)
+ */
+int tag_table_intern(tag_table_t* table, const char* name)
+{
+    if (!name) {
+        return 0;
+    }
+
+    int id = tag_table_find(table, name);
+    if (id != 0) {
+        return id;
+    }
+
+    if (table->count == 0) {
+        table->count = 1; /* ID 0 is reserved for "no tag" */
+    }
+    if (table->count > MAX_TAGS) {
+        return 0;
+    }
+
+    /* Keep load factor below one half */
+    if (table->count * 2 >= table->slot_count) {
+        if (tag_table_rehash(table) != SMARTTERM_OK) {
+            return SMARTTERM_NOMEM;
+        }
+    }
+
+    if (table->count >= table->capacity) {
+        int new_capacity = table->capacity ? table->capacity * 2 : 16;
+        char** new_names = realloc(table->names, new_capacity * sizeof(char*));
+        if (!new_names) {
+            return SMARTTERM_NOMEM;
+        }
+        table->names = new_names;
+        table->capacity = new_capacity;
+    }
+
+    char* copy = strdup_safe(name);
+    if (!copy) {
+        return SMARTTERM_NOMEM;
+    }
+
+    id = table->count++;
+    table->names[id] = copy;
+    table->name_bytes += strlen(copy) + 1;
+    table->slots[tag_slot(table, copy)] = (unsigned short)id;
+
+    return id;
+}
+
+/*
+ * Get interned tag name (NULL for ID 0)
+ */
+const char* tag_table_name(const tag_table_t* table, int id)
+{
+    if (id <= 0 || id >= table->count) {
+        return NULL;
+    }
+    return table->names[id];
+}
+
+/*
+ * Get memory held by tag table
+ */
+size_t tag_table_bytes(const tag_table_t* table)
+{
+    return table->name_bytes + (size_t)table->capacity * sizeof(char*) +
+           (size_t)table->slot_count * sizeof(unsigned short);
+}
+
+/*
+ * Get indices of lines with tag
+ */
+int smartterm_get_tag_lines(smartterm_ctx* ctx, const char* tag, int** lines, int* count)
+{
+    if (!ctx || !ctx->initialized || !tag || !lines || !count) {
+        return SMARTTERM_INVALID;
+    }
+
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    int id = tag_table_find(&buf->tags, tag);
+
+    /* Count first so the result is allocated exactly once */
+    int match_count = 0;
+    if (id != 0) {
+        for (int i = 0; i < buf->count; i++) {
+            if (buffer_tag_id(buf, i) == id) {
+                match_count++;
+            }
+        }
+    }
+
+    int* matches = malloc((match_count > 0 ? match_count : 1) * sizeof(int));
+    if (!matches) {
+        pthread_mutex_unlock(&buf->mutex);
+        return SMARTTERM_NOMEM;
+    }
+
+    int n = 0;
+    for (int i = 0; i < buf->count && n < match_count; i++) {
+        if (buffer_tag_id(buf, i) == id) {
+            matches[n++] = i;
+        }
+    }
+
+    pthread_mutex_unlock(&buf->mutex);
+
+    *lines = matches;
+    *count = match_count;
+
+    return SMARTTERM_OK;
+}
@@ -0,0 +1,368 @@
+/*
+ * SmartTerm Library - Tee Log
+ *
+ * Copies every line added to the output buffer to a log file. Producers
+ * only append the line to an in-memory queue; a writer thread takes the
+ * whole queue at once, formats it with the export emitters and writes it
+ * with a single call (group commit), then runs fsync() by time or byte
+ * policy.
+ *
+ * The queue is bounded. When the disk stalls or fills up, lines beyond
+ * TEE_QUEUE_BYTES are dropped and counted instead of blocking output, and
+ * the failure is reported through smartterm_tee_get_status(). A write
+ * that fails partway keeps its complete lines and removes the torn one.
+ */
+
+#include "smartterm_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Append bytes to queue arena, returning their offset (SIZE_MAX = full)
+ */
+static size_t tee_queue_put(tee_queue_t* queue, const char* data, size_t len)
+{
+    if (queue->arena_used + len > TEE_QUEUE_BYTES) {
+        return SIZE_MAX;
+    }
+
+    if (queue->arena_used + len > queue->arena_capacity) {
+        size_t new_capacity = queue->arena_capacity ? queue->arena_capacity : 64 * 1024;
+        while (new_capacity < queue->arena_used + len) {
+            new_capacity *= 2;
+        }
+
+        char* arena = realloc(queue->arena, new_capacity);
+        if (!arena) {
+            return SIZE_MAX;
+        }
+        queue->arena = arena;
+        queue->arena_capacity = new_capacity;
+    }
+
+    size_t offset = queue->arena_used;
+    memcpy(queue->arena + offset, data, len);
+    queue->arena_used += len;
+    return offset;
+}
+
+/*
+ * Append line to queue
+ */
+static bool tee_queue_add(tee_queue_t* queue, const char* text, size_t len,
+                          smartterm_context_t context, long timestamp, const char* tag)
+{
+    if (queue->count >= queue->capacity) {
+        int new_capacity = queue->capacity ? queue->capacity * 2 : 1024;
+        tee_record_t* records = realloc(queue->records, new_capacity * sizeof(tee_record_t));
+        if (!records) {
+            return false;
+        }
+        queue->records = records;
+        queue->capacity = new_capacity;
+    }
+
+    size_t used = queue->arena_used;
+    size_t text_at = tee_queue_put(queue, text, len);
+    size_t tag_at = tag ? tee_queue_put(queue, tag, strlen(tag) + 1) : SIZE_MAX;
+    if (text_at == SIZE_MAX || (tag && tag_at == SIZE_MAX)) {
+        queue->arena_used = used;
+        return false;
+    }
+
+    queue->records[queue->count++] = (tee_record_t){
+        .text_at = text_at, .tag_at = tag_at, .timestamp = timestamp, .context = context};
+    return true;
+}
+
+/*
+ * Free queue storage
+ */
+static void tee_queue_free(tee_queue_t* queue)
+{
+    free(queue->records);
+    free(queue->arena);
+}
+
+/*
+ * Get milliseconds from a to b
+ */
+static long tee_elapsed_ms(const struct timespec* a, const struct timespec* b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000 + (b->tv_nsec - a->tv_nsec) / 1000000;
+}
+
+/*
+ * Check whether unsynced bytes are due for fsync (writer thread)
+ */
+static bool tee_sync_due(const tee_log_t* tee)
+{
+    if (tee->unsynced == 0) {
+        return false;
+    }
+    if (tee->sync_bytes > 0 && tee->unsynced >= tee->sync_bytes) {
+        return true;
+    }
+    if (tee->sync_ms > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return tee_elapsed_ms(&tee->dirty_since, &now) >= tee->sync_ms;
+    }
+    return false;
+}
+
+/*
+ * Sleep until there is work for the writer (tee mutex held)
+ */
+static void tee_wait(tee_log_t* tee)
+{
+    while (tee->pending.count == 0 && !tee->stop && tee->flush_done == tee->flush_requested &&
+           !tee_sync_due(tee)) {
+        if (tee->unsynced > 0 && tee->sync_ms > 0) {
+            struct timespec deadline = tee->dirty_since;
+            deadline.tv_sec += tee->sync_ms / 1000;
+            deadline.tv_nsec += (long)(tee->sync_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&tee->wake, &tee->mutex, &deadline);
+        } else {
+            pthread_cond_wait(&tee->wake, &tee->mutex);
+        }
+    }
+}
+
+/*
+ * Writer thread
+ */
+static void* tee_log_run(void* arg)
+{
+    tee_log_t* tee = arg;
+
+    pthread_mutex_lock(&tee->mutex);
+    for (;;) {
+        tee_wait(tee);
+
+        /* Take every queued line; producers refill the emptied queue */
+        tee_queue_t batch = tee->pending;
+        tee->pending = tee->batch;
+        tee->batch = batch;
+        unsigned long flush = tee->flush_requested;
+        bool stop = tee->stop;
+        pthread_mutex_unlock(&tee->mutex);
+
+        int lines = tee->batch.count;
+        int lines_written = 0;
+        int result = SMARTTERM_OK;
+        int error = 0;
+        size_t written = 0;
+        bool attempted = lines > 0;
+
+        if (lines > 0) {
+            result = export_tee_write(tee, &written, &lines_written);
+            error = errno;
+            tee->batch.count = 0;
+            tee->batch.arena_used = 0;
+
+            if (written > 0 && tee->unsynced == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &tee->dirty_since);
+            }
+            tee->unsynced += written;
+        }
+
+        if (tee->unsynced > 0 && (flush != tee->flush_done || stop || tee_sync_due(tee))) {
+            attempted = true;
+            if (fsync(tee->fd) != 0 && result == SMARTTERM_OK) {
+                result = SMARTTERM_IOERROR;
+                error = errno;
+            }
+            tee->unsynced = 0;
+        }
+
+        pthread_mutex_lock(&tee->mutex);
+        if (lines > 0) {
+            tee->status.lines_queued -= lines;
+            tee->status.lines_written += lines_written;
+            tee->status.lines_dropped += lines - lines_written;
+            tee->status.bytes_written += written;
+        }
+        if (attempted) {
+            tee->status.error = result;
+            if (result != SMARTTERM_OK) {
+                tee->status.sys_errno = error;
+            }
+        }
+        tee->flush_done = flush;
+        pthread_cond_broadcast(&tee->flushed);
+
+        if (stop && tee->pending.count == 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tee->mutex);
+
+    return NULL;
+}
+
+/*
+ * Release tee log that has no writer thread
+ */
+static void tee_log_free(tee_log_t* tee)
+{
+    tee_queue_free(&tee->pending);
+    tee_queue_free(&tee->batch);
+    free(tee->out);
+    free(tee);
+}
+
+/*
+ * Open tee log from configuration (*tee = NULL when not configured)
+ */
+int tee_log_open(tee_log_t** tee_out, const smartterm_config_t* config)
+{
+    *tee_out = NULL;
+    if (!config->tee_file) {
+        return SMARTTERM_OK;
+    }
+
+    /* Appended lines must stand alone; document formats need a header */
+    if (config->tee_format != EXPORT_PLAIN && config->tee_format != EXPORT_ANSI &&
+        config->tee_format != EXPORT_JSONL) {
+        return SMARTTERM_INVALID;
+    }
+
+    tee_log_t* tee = calloc(1, sizeof(tee_log_t));
+    if (!tee) {
+        return SMARTTERM_NOMEM;
+    }
+    tee->format = config->tee_format;
+    tee->include_meta = config->tee_include_meta;
+    tee->sync_ms = config->tee_sync_ms > 0 ? config->tee_sync_ms : 0;
+    tee->sync_bytes = config->tee_sync_bytes;
+    tee->status.error = SMARTTERM_OK;
+    time_format_init(&tee->clock);
+
+    tee->fd = open(config->tee_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (tee->fd < 0) {
+        free(tee);
+        return SMARTTERM_IOERROR;
+    }
+
+    /* Deadlines are monotonic so clock changes do not delay fsync */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&tee->mutex, NULL);
+    pthread_cond_init(&tee->wake, &attr);
+    pthread_cond_init(&tee->flushed, NULL);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&tee->thread, NULL, tee_log_run, tee) != 0) {
+        pthread_cond_destroy(&tee->flushed);
+        pthread_cond_destroy(&tee->wake);
+        pthread_mutex_destroy(&tee->mutex);
+        close(tee->fd);
+        tee_log_free(tee);
+        return SMARTTERM_ERROR;
+    }
+
+    *tee_out = tee;
+    return SMARTTERM_OK;
+}
+
+/*
+ * Write remaining lines, fsync and close tee log
+ */
+void tee_log_close(tee_log_t* tee)
+{
+    if (!tee) {
+        return;
+    }
+
+    pthread_mutex_lock(&tee->mutex);
+    tee->stop = true;
+    pthread_cond_signal(&tee->wake);
+    pthread_mutex_unlock(&tee->mutex);
+    pthread_join(tee->thread, NULL);
+
+    pthread_cond_destroy(&tee->flushed);
+    pthread_cond_destroy(&tee->wake);
+    pthread_mutex_destroy(&tee->mutex);
+    close(tee->fd);
+    tee_log_free(tee);
+}
+
+/*
+ * Queue line for the tee log (never blocks on I/O)
+ *
+ * Called with the buffer mutex held, so lines are logged in buffer order.
+ */
+void tee_log_append(tee_log_t* tee, const char* text, size_t len, smartterm_context_t context,
+                    long timestamp, const char* tag)
+{
+    pthread_mutex_lock(&tee->mutex);
+
+    /* The writer drains the whole queue, so only the first line wakes it */
+    bool was_empty = tee->pending.count == 0;
+    if (!tee_queue_add(&tee->pending, text, len, context, timestamp, tag)) {
+        tee->status.lines_dropped++;
+    } else {
+        tee->status.lines_queued++;
+        if (was_empty) {
+            pthread_cond_signal(&tee->wake);
+        }
+    }
+
+    pthread_mutex_unlock(&tee->mutex);
+}
+
+/*
+ * Get tee log state
+ */
+int smartterm_tee_get_status(smartterm_ctx* ctx, smartterm_tee_status_t* status)
+{
+    if (!ctx || !ctx->initialized || !status) {
+        return SMARTTERM_INVALID;
+    }
+
+    tee_log_t* tee = ctx->buffer.tee;
+    if (!tee) {
+        return SMARTTERM_ERROR;
+    }
+
+    pthread_mutex_lock(&tee->mutex);
+    *status = tee->status;
+    pthread_mutex_unlock(&tee->mutex);
+
+    return SMARTTERM_OK;
+}
+
+/*
+ * Write queued tee lines and fsync the log
+ */
+int smartterm_tee_flush(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_INVALID;
+    }
+
+    tee_log_t* tee = ctx->buffer.tee;
+    if (!tee) {
+        return SMARTTERM_ERROR;
+    }
+
+    pthread_mutex_lock(&tee->mutex);
+    unsigned long flush = ++tee->flush_requested;
+    pthread_cond_signal(&tee->wake);
+    while (tee->flush_done < flush) {
+        pthread_cond_wait(&tee->flushed, &tee->mutex);
+    }
+    int result = tee->status.error;
+    pthread_mutex_unlock(&tee->mutex);
+
+    return result;
+}
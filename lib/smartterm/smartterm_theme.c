@@ -9,76 +9,33 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Default theme singleton */
-static smartterm_theme g_default_theme = {0};
-static bool g_default_theme_initialized = false;
-
-/*
- * Initialize default theme
- */
-static void init_default_theme(void)
-{
-    if (g_default_theme_initialized) {
-        return;
-    }
-
-    strcpy(g_default_theme.name, "default");
-    g_default_theme.is_builtin = true;
-
-    /* Set default colors (index 0 = fg, 1 = bg) */
-    g_default_theme.colors[CTX_NORMAL][0] = COLOR_WHITE;
-    g_default_theme.colors[CTX_NORMAL][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_ERROR][0] = COLOR_RED;
-    g_default_theme.colors[CTX_ERROR][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_WARNING][0] = COLOR_YELLOW;
-    g_default_theme.colors[CTX_WARNING][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_SUCCESS][0] = COLOR_GREEN;
-    g_default_theme.colors[CTX_SUCCESS][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_INFO][0] = COLOR_CYAN;
-    g_default_theme.colors[CTX_INFO][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_DEBUG][0] = COLOR_MAGENTA;
-    g_default_theme.colors[CTX_DEBUG][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_COMMAND][0] = COLOR_YELLOW;
-    g_default_theme.colors[CTX_COMMAND][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_COMMENT][0] = COLOR_GREEN;
-    g_default_theme.colors[CTX_COMMENT][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_SPECIAL][0] = COLOR_CYAN;
-    g_default_theme.colors[CTX_SPECIAL][1] = COLOR_BLACK;
-
-    g_default_theme.colors[CTX_SEARCH][0] = COLOR_MAGENTA;
-    g_default_theme.colors[CTX_SEARCH][1] = COLOR_BLACK;
-
-    /* Set default attributes */
-    for (int i = 0; i < CTX_USER_START; i++) {
-        g_default_theme.attributes[i] = A_NORMAL;
-    }
-    g_default_theme.attributes[CTX_ERROR] = A_BOLD;
-
-    /* Set default symbols */
-    g_default_theme.symbols[SYM_PROMPT] = strdup_safe("> ");
-    g_default_theme.symbols[SYM_MULTILINE_PROMPT] = strdup_safe("... ");
-    g_default_theme.symbols[SYM_STATUS_SEP] = strdup_safe(" | ");
-    g_default_theme.symbols[SYM_SCROLL_INDICATOR] = strdup_safe(" [SCROLL] ");
-    g_default_theme.symbols[SYM_SEARCH_MATCH] = strdup_safe(">");
-
-    g_default_theme_initialized = true;
-}
+/* Default theme; constant, so sessions in any thread can share it */
+static const smartterm_theme default_theme = {
+    .name = "default",
+    .colors = {[CTX_NORMAL] = {COLOR_WHITE, COLOR_BLACK},
+               [CTX_ERROR] = {COLOR_RED, COLOR_BLACK},
+               [CTX_WARNING] = {COLOR_YELLOW, COLOR_BLACK},
+               [CTX_SUCCESS] = {COLOR_GREEN, COLOR_BLACK},
+               [CTX_INFO] = {COLOR_CYAN, COLOR_BLACK},
+               [CTX_DEBUG] = {COLOR_MAGENTA, COLOR_BLACK},
+               [CTX_COMMAND] = {COLOR_YELLOW, COLOR_BLACK},
+               [CTX_COMMENT] = {COLOR_GREEN, COLOR_BLACK},
+               [CTX_SPECIAL] = {COLOR_CYAN, COLOR_BLACK},
+               [CTX_SEARCH] = {COLOR_MAGENTA, COLOR_BLACK}},
+    .attributes = {[CTX_ERROR] = A_BOLD}, /* Others A_NORMAL (0) */
+    .symbols = {[SYM_PROMPT] = "> ",
+                [SYM_MULTILINE_PROMPT] = "... ",
+                [SYM_STATUS_SEP] = " | ",
+                [SYM_SCROLL_INDICATOR] = " [SCROLL] ",
+                [SYM_SEARCH_MATCH] = ">"},
+    .is_builtin = true};
 
 /*
  * Get default theme
  */
 const smartterm_theme* theme_get_default(void)
 {
-    init_default_theme();
-    return &g_default_theme;
+    return &default_theme;
 }
 
 /*
@@ -122,13 +79,12 @@ smartterm_theme* smartterm_theme_create(const char* name)
     theme->is_builtin = false;
 
     /* Copy default colors */
-    init_default_theme();
-    memcpy(theme->colors, g_default_theme.colors, sizeof(theme->colors));
-    memcpy(theme->attributes, g_default_theme.attributes, sizeof(theme->attributes));
+    memcpy(theme->colors, default_theme.colors, sizeof(theme->colors));
+    memcpy(theme->attributes, default_theme.attributes, sizeof(theme->attributes));
 
     /* Copy default symbols */
     for (int i = 0; i < SYM_COUNT; i++) {
-        theme->symbols[i] = strdup_safe(g_default_theme.symbols[i]);
+        theme->symbols[i] = strdup_safe(default_theme.symbols[i]);
     }
 
     return theme;
@@ -204,10 +160,8 @@ const smartterm_theme* smartterm_theme_get_builtin(const char* name)
         return NULL;
     }
 
-    init_default_theme();
-
     if (strcmp(name, "default") == 0) {
-        return &g_default_theme;
+        return &default_theme;
     }
 
     /* Additional built-in themes can be added here */
@@ -224,6 +178,8 @@ int smartterm_set_theme(smartterm_ctx* ctx, const smartterm_theme* theme)
         return SMARTTERM_NOTINIT;
     }
 
+    screen_lock(ctx);
+
     /* Free old theme if owned */
     if (ctx->owns_theme && ctx->theme) {
         smartterm_theme_free((smartterm_theme*)ctx->theme);
@@ -241,5 +197,7 @@ int smartterm_set_theme(smartterm_ctx* ctx, const smartterm_theme* theme)
     theme_apply_colors(ctx);
 
     /* Re-render */
-    return render_all(ctx);
+    int result = render_all(ctx);
+    screen_unlock(ctx);
+    return result;
 }
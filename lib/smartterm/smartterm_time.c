@@ -0,0 +1,65 @@
+/*
+ * SmartTerm Library - Timestamp Formatting
+ *
+ * Formats line timestamps as "YYYY-MM-DD HH:MM:SS". Consecutive lines
+ * mostly share a minute, so the cache keeps the formatted minute and
+ * patches the two seconds digits; localtime_r() and strftime() run only
+ * when a timestamp falls outside the cached minute.
+ *
+ * A cache belongs to one caller (one export, one window), so no locking
+ * is needed.
+ */
+
+#include "smartterm_internal.h"
+#include <string.h>
+#include <time.h>
+
+/*
+ * Load time zone for cache
+ *
+ * localtime_r() need not read TZ itself. Caches used on worker threads
+ * should be initialized before the threads start, so tzset() does not
+ * run concurrently.
+ */
+void time_format_init(time_format_cache_t* cache)
+{
+    tzset();
+    cache->tz_loaded = true;
+}
+
+/*
+ * Format timestamp (returned text is valid until the next call)
+ */
+const char* time_format(time_format_cache_t* cache, long timestamp)
+{
+    long second = timestamp - cache->minute;
+
+    if (!cache->valid || second < 0 || second >= 60) {
+        time_t t = (time_t)timestamp;
+        struct tm tm_info;
+
+        if (!cache->tz_loaded) {
+            time_format_init(cache);
+        }
+
+        cache->valid = false;
+        if (!localtime_r(&t, &tm_info) ||
+            strftime(cache->text, sizeof(cache->text), "%Y-%m-%d %H:%M:%S", &tm_info) == 0) {
+            cache->text[0] = '\0';
+            return cache->text;
+        }
+
+        /* Only the fixed-width form has the seconds where we patch them */
+        if (strlen(cache->text) != TIME_FORMAT_LENGTH) {
+            return cache->text;
+        }
+
+        cache->minute = timestamp - tm_info.tm_sec;
+        cache->valid = true;
+        second = tm_info.tm_sec;
+    }
+
+    cache->text[TIME_FORMAT_LENGTH - 2] = (char)('0' + second / 10);
+    cache->text[TIME_FORMAT_LENGTH - 1] = (char)('0' + second % 10);
+    return cache->text;
+}
@@ -0,0 +1,614 @@
+/*
+ * SmartTerm Library - Filtered View Implementation
+ *
+ * Views pair a line predicate (context set, tag, substring) with a
+ * viewport. They never copy lines: rendering walks the buffer from the
+ * viewport anchor and tests the predicate, so changing a filter costs
+ * O(visible rows) rather than a rescan of the whole buffer. Following
+ * views take the last page from a ring of their newest matches, kept in
+ * step with appends and evictions, so a filter matching few lines does
+ * not cost a scan of the buffer every frame.
+ *
+ * Internal view functions expect the buffer mutex to be held.
+ */
+
+#include "smartterm_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Test line against view predicate
+ */
+bool view_matches(const smartterm_view* view, output_buffer_t* buf, int index)
+{
+    /* Cheap column checks first; text is only touched for substring filters */
+    if (view->hidden[buffer_context(buf, index)]) {
+        return false;
+    }
+
+    if (view->tag_id >= 0 && buffer_tag_id(buf, index) != view->tag_id) {
+        return false;
+    }
+
+    if (view->substring && !strstr(buffer_text(buf, index), view->substring)) {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Get entry of recent match ring, oldest first
+ */
+static unsigned long* recent_at(smartterm_view* view, int position)
+{
+    return &view->recent[(view->recent_head + position) % VIEW_RECENT_MATCHES];
+}
+
+/*
+ * Add matching line to recent matches, keeping them in order
+ *
+ * Appended lines go at the end; a line updated in place may land anywhere.
+ */
+static void recent_insert(smartterm_view* view, unsigned long seq)
+{
+    int position = view->recent_count;
+    while (position > 0 && *recent_at(view, position - 1) > seq) {
+        position--;
+    }
+
+    /* Older than every remembered match: only kept if nothing older is missing */
+    if (position == 0 && (!view->recent_all || view->recent_count == VIEW_RECENT_MATCHES)) {
+        view->recent_all = false;
+        return;
+    }
+    if (view->recent_count == VIEW_RECENT_MATCHES) {
+        view->recent_head = (view->recent_head + 1) % VIEW_RECENT_MATCHES;
+        view->recent_count--;
+        view->recent_all = false;
+        position--;
+    }
+
+    for (int i = view->recent_count; i > position; i--) {
+        *recent_at(view, i) = *recent_at(view, i - 1);
+    }
+    *recent_at(view, position) = seq;
+    view->recent_count++;
+}
+
+/*
+ * Remove line from recent matches if it is there
+ */
+static void recent_remove(smartterm_view* view, unsigned long seq)
+{
+    /* Evictions take the oldest; updates are usually among the newest */
+    if (view->recent_count > 0 && *recent_at(view, 0) == seq) {
+        view->recent_head = (view->recent_head + 1) % VIEW_RECENT_MATCHES;
+        view->recent_count--;
+        return;
+    }
+
+    int position = view->recent_count - 1;
+    while (position > 0 && *recent_at(view, position) > seq) {
+        position--;
+    }
+    if (position <= 0 || *recent_at(view, position) != seq) {
+        return;
+    }
+
+    for (int i = position; i < view->recent_count - 1; i++) {
+        *recent_at(view, i) = *recent_at(view, i + 1);
+    }
+    view->recent_count--;
+}
+
+/*
+ * Rebuild recent matches by scanning back from the newest line
+ */
+static void recent_fill(smartterm_view* view)
+{
+    output_buffer_t* buf = &view->ctx->buffer;
+    int found = 0;
+    int i = buf->count - 1;
+
+    for (; i >= 0 && found < VIEW_RECENT_MATCHES; i--) {
+        if (view_matches(view, buf, i)) {
+            view->recent[VIEW_RECENT_MATCHES - 1 - found] = buf->base_seq + i;
+            found++;
+        }
+    }
+
+    view->recent_head = (VIEW_RECENT_MATCHES - found) % VIEW_RECENT_MATCHES;
+    view->recent_count = found;
+    view->recent_valid = true;
+    view->recent_all = i < 0;
+}
+
+/*
+ * Make sure recent matches cover a page of rows (false if rows exceed the ring)
+ */
+static bool recent_ready(smartterm_view* view, int rows)
+{
+    if (rows > VIEW_RECENT_MATCHES) {
+        return false;
+    }
+    if (!view->recent_valid || (view->recent_count < rows && !view->recent_all)) {
+        recent_fill(view);
+    }
+    return true;
+}
+
+/*
+ * Keep view match counts and recent matches in sync with appended line
+ */
+void view_on_append(output_buffer_t* buf, int index)
+{
+    for (int i = 0; i < buf->view_count; i++) {
+        smartterm_view* view = buf->views[i];
+        if ((view->match_count < 0 && !view->recent_valid) || !view_matches(view, buf, index)) {
+            continue;
+        }
+        if (view->match_count >= 0) {
+            view->match_count++;
+        }
+        if (view->recent_valid) {
+            recent_insert(view, buf->base_seq + index);
+        }
+    }
+}
+
+/*
+ * Keep view match counts and recent matches in sync with evicted line
+ *
+ * Anchors that point at evicted lines are clamped lazily on next use.
+ */
+void view_on_evict(output_buffer_t* buf, int index)
+{
+    for (int i = 0; i < buf->view_count; i++) {
+        smartterm_view* view = buf->views[i];
+        if (view->match_count > 0 && view_matches(view, buf, index)) {
+            view->match_count--;
+        }
+        if (view->recent_valid) {
+            recent_remove(view, buf->base_seq + index);
+        }
+    }
+}
+
+/*
+ * Keep anchors on their lines when lines up to seq move one sequence number later
+ *
+ * An anchor on the line at seq, which is being dropped, moves to the next one.
+ */
+void view_on_renumber(output_buffer_t* buf, unsigned long seq)
+{
+    for (int i = 0; i < buf->view_count; i++) {
+        smartterm_view* view = buf->views[i];
+        if (view->top_seq >= buf->base_seq && view->top_seq <= seq) {
+            view->top_seq++;
+        }
+        for (int j = 0; view->recent_valid && j < view->recent_count; j++) {
+            if (*recent_at(view, j) < seq) {
+                (*recent_at(view, j))++;
+            }
+        }
+    }
+}
+
+/*
+ * Reset views after buffer clear
+ */
+void view_on_clear(output_buffer_t* buf)
+{
+    for (int i = 0; i < buf->view_count; i++) {
+        smartterm_view* view = buf->views[i];
+        view->match_count = 0;
+        view->follow = true;
+        view->recent_count = 0;
+        view->recent_valid = true;
+        view->recent_all = true;
+    }
+}
+
+/*
+ * Force match counts and recent matches to be rebuilt after lines were dropped in bulk
+ */
+void view_invalidate_counts(output_buffer_t* buf)
+{
+    for (int i = 0; i < buf->view_count; i++) {
+        buf->views[i]->match_count = -1;
+        buf->views[i]->recent_valid = false;
+    }
+}
+
+/*
+ * Get buffer index of viewport anchor (clamped to live lines)
+ */
+static int anchor_index(const smartterm_view* view)
+{
+    const output_buffer_t* buf = &view->ctx->buffer;
+    if (view->top_seq < buf->base_seq) {
+        return 0;
+    }
+    unsigned long index = view->top_seq - buf->base_seq;
+    return (index > (unsigned long)buf->count) ? buf->count : (int)index;
+}
+
+/*
+ * Get index of top line of the last page (buffer count if no matches)
+ */
+static int bottom_page_top(smartterm_view* view, int rows)
+{
+    output_buffer_t* buf = &view->ctx->buffer;
+    if (recent_ready(view, rows)) {
+        int n = view->recent_count < rows ? view->recent_count : rows;
+        return n > 0 ? (int)(*recent_at(view, view->recent_count - n) - buf->base_seq) : buf->count;
+    }
+
+    int top = buf->count;
+    int found = 0;
+
+    for (int i = buf->count - 1; i >= 0 && found < rows; i--) {
+        if (view_matches(view, buf, i)) {
+            top = i;
+            found++;
+        }
+    }
+
+    return top;
+}
+
+/*
+ * Collect buffer indices of visible lines, top to bottom
+ */
+int view_collect(smartterm_view* view, int rows, int* indices)
+{
+    output_buffer_t* buf = &view->ctx->buffer;
+    int n = 0;
+
+    if (rows <= 0) {
+        return 0;
+    }
+
+    if (!view->follow) {
+        for (int i = anchor_index(view); i < buf->count && n < rows; i++) {
+            if (view_matches(view, buf, i)) {
+                indices[n++] = i;
+            }
+        }
+        if (n == rows) {
+            return n;
+        }
+        /* Ran off the end: show the last full page instead */
+        n = 0;
+    }
+
+    if (recent_ready(view, rows)) {
+        n = view->recent_count < rows ? view->recent_count : rows;
+        for (int i = 0; i < n; i++) {
+            indices[i] = (int)(*recent_at(view, view->recent_count - n + i) - buf->base_seq);
+        }
+        return n;
+    }
+
+    for (int i = buf->count - 1; i >= 0 && n < rows; i--) {
+        if (view_matches(view, buf, i)) {
+            indices[n++] = i;
+        }
+    }
+
+    /* Reverse into top-to-bottom order */
+    for (int i = 0; i < n / 2; i++) {
+        int tmp = indices[i];
+        indices[i] = indices[n - 1 - i];
+        indices[n - 1 - i] = tmp;
+    }
+
+    return n;
+}
+
+/*
+ * Get buffer index of top visible line
+ */
+int view_top_index(smartterm_view* view, int rows)
+{
+    if (view->follow) {
+        return bottom_page_top(view, rows);
+    }
+    return anchor_index(view);
+}
+
+/*
+ * Scroll viewport by matching lines (positive = up)
+ */
+void view_scroll(smartterm_view* view, int lines, int rows)
+{
+    output_buffer_t* buf = &view->ctx->buffer;
+    int top = view_top_index(view, rows);
+    int moved = 0;
+
+    if (lines > 0) {
+        for (int i = top - 1; i >= 0 && moved < lines; i--) {
+            if (view_matches(view, buf, i)) {
+                top = i;
+                moved++;
+            }
+        }
+    } else if (lines < 0) {
+        for (int i = top + 1; i < buf->count && moved < -lines; i++) {
+            if (view_matches(view, buf, i)) {
+                top = i;
+                moved++;
+            }
+        }
+    }
+
+    /* Reaching the last page re-attaches the viewport to new output */
+    if (top >= bottom_page_top(view, rows)) {
+        view->follow = true;
+    } else {
+        view->follow = false;
+        view->top_seq = buf->base_seq + top;
+    }
+}
+
+/*
+ * Anchor viewport at buffer index
+ */
+void view_scroll_to(smartterm_view* view, int index)
+{
+    view->follow = false;
+    view->top_seq = view->ctx->buffer.base_seq + (index > 0 ? index : 0);
+}
+
+/*
+ * Attach viewport to newest lines
+ */
+void view_follow(smartterm_view* view)
+{
+    view->follow = true;
+}
+
+/*
+ * Create filtered view
+ */
+smartterm_view* smartterm_view_create(smartterm_ctx* ctx)
+{
+    if (!ctx || !ctx->initialized) {
+        return NULL;
+    }
+
+    smartterm_view* view = calloc(1, sizeof(smartterm_view));
+    if (!view) {
+        return NULL;
+    }
+
+    view->ctx = ctx;
+    view->tag_id = -1;
+    view->follow = true;
+
+    output_buffer_t* buf = &ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    /* Check if we need to expand array */
+    if (buf->view_count >= buf->view_capacity) {
+        int new_capacity = buf->view_capacity ? buf->view_capacity * 2 : 4;
+        smartterm_view** new_views = realloc(buf->views, new_capacity * sizeof(smartterm_view*));
+        if (!new_views) {
+            pthread_mutex_unlock(&buf->mutex);
+            free(view);
+            return NULL;
+        }
+        buf->views = new_views;
+        buf->view_capacity = new_capacity;
+    }
+
+    buf->views[buf->view_count++] = view;
+    view->match_count = buf->count; /* No filters yet */
+
+    pthread_mutex_unlock(&buf->mutex);
+    return view;
+}
+
+/*
+ * Free filtered view
+ */
+void smartterm_view_free(smartterm_view* view)
+{
+    if (!view) {
+        return;
+    }
+
+    smartterm_ctx* ctx = view->ctx;
+    output_buffer_t* buf = &ctx->buffer;
+    bool was_active = false;
+
+    pthread_mutex_lock(&buf->mutex);
+
+    /* Detach from buffer */
+    for (int i = 0; i < buf->view_count; i++) {
+        if (buf->views[i] == view) {
+            for (int j = i; j < buf->view_count - 1; j++) {
+                buf->views[j] = buf->views[j + 1];
+            }
+            buf->view_count--;
+            break;
+        }
+    }
+
+    if (ctx->active_view == view) {
+        ctx->active_view = NULL;
+        was_active = true;
+    }
+
+    pthread_mutex_unlock(&buf->mutex);
+
+    free(view->substring);
+    free(view);
+
+    if (was_active) {
+        render_output(ctx);
+    }
+}
+
+/*
+ * Re-render if predicate of active view changed
+ */
+static int view_changed(smartterm_view* view)
+{
+    if (view->ctx->active_view != view) {
+        return SMARTTERM_OK;
+    }
+    return render_output(view->ctx);
+}
+
+/*
+ * Replace optional predicate string (NULL or "" clears it)
+ */
+static int view_set_string(smartterm_view* view, char** field, const char* value)
+{
+    char* copy = NULL;
+    if (value && value[0]) {
+        copy = strdup_safe(value);
+        if (!copy) {
+            return SMARTTERM_NOMEM;
+        }
+    }
+
+    pthread_mutex_lock(&view->ctx->buffer.mutex);
+    free(*field);
+    *field = copy;
+    view->match_count = -1;
+    view->recent_valid = false;
+    pthread_mutex_unlock(&view->ctx->buffer.mutex);
+
+    return view_changed(view);
+}
+
+/*
+ * Show or hide context
+ */
+int smartterm_view_set_context_visible(smartterm_view* view, smartterm_context_t context,
+                                       bool visible)
+{
+    if (!view || context < 0 || context >= VIEW_CONTEXT_SLOTS) {
+        return SMARTTERM_INVALID;
+    }
+
+    pthread_mutex_lock(&view->ctx->buffer.mutex);
+    if (view->hidden[context] != !visible) {
+        view->hidden[context] = !visible;
+        view->match_count = -1;
+        view->recent_valid = false;
+    }
+    pthread_mutex_unlock(&view->ctx->buffer.mutex);
+
+    return view_changed(view);
+}
+
+/*
+ * Restrict view to tag
+ */
+int smartterm_view_set_tag(smartterm_view* view, const char* tag)
+{
+    if (!view) {
+        return SMARTTERM_INVALID;
+    }
+
+    output_buffer_t* buf = &view->ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    /* Interning lets lines written later match by ID */
+    int tag_id = tag ? tag_table_intern(&buf->tags, tag) : -1;
+    if (tag && tag_id < 0) {
+        pthread_mutex_unlock(&buf->mutex);
+        return tag_id;
+    }
+    /* A name the full table cannot take is on no line */
+    view->tag_id = tag && tag_id == 0 ? MAX_TAGS + 1 : tag_id;
+    view->match_count = -1;
+    view->recent_valid = false;
+
+    pthread_mutex_unlock(&buf->mutex);
+
+    return view_changed(view);
+}
+
+/*
+ * Restrict view to substring
+ */
+int smartterm_view_set_substring(smartterm_view* view, const char* substring)
+{
+    if (!view) {
+        return SMARTTERM_INVALID;
+    }
+    return view_set_string(view, &view->substring, substring);
+}
+
+/*
+ * Remove all filters
+ */
+int smartterm_view_reset(smartterm_view* view)
+{
+    if (!view) {
+        return SMARTTERM_INVALID;
+    }
+
+    pthread_mutex_lock(&view->ctx->buffer.mutex);
+    memset(view->hidden, 0, sizeof(view->hidden));
+    free(view->substring);
+    view->tag_id = -1;
+    view->substring = NULL;
+    view->match_count = view->ctx->buffer.count;
+    view->recent_valid = false;
+    pthread_mutex_unlock(&view->ctx->buffer.mutex);
+
+    return view_changed(view);
+}
+
+/*
+ * Get number of matching lines
+ */
+int smartterm_view_get_line_count(smartterm_view* view)
+{
+    if (!view) {
+        return 0;
+    }
+
+    output_buffer_t* buf = &view->ctx->buffer;
+    pthread_mutex_lock(&buf->mutex);
+
+    if (view->match_count < 0) {
+        int count = 0;
+        for (int i = 0; i < buf->count; i++) {
+            if (view_matches(view, buf, i)) {
+                count++;
+            }
+        }
+        view->match_count = count;
+    }
+
+    int count = view->match_count;
+    pthread_mutex_unlock(&buf->mutex);
+
+    return count;
+}
+
+/*
+ * Display view in output window
+ */
+int smartterm_set_view(smartterm_ctx* ctx, smartterm_view* view)
+{
+    if (!ctx || !ctx->initialized) {
+        return SMARTTERM_NOTINIT;
+    }
+    if (view && view->ctx != ctx) {
+        return SMARTTERM_INVALID;
+    }
+
+    pthread_mutex_lock(&ctx->buffer.mutex);
+    ctx->active_view = view;
+    pthread_mutex_unlock(&ctx->buffer.mutex);
+
+    return render_output(ctx);
+}
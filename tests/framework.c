@@ -2,9 +2,87 @@
  * Simple Test Framework for SmartTerm - Implementation
  */
 
+#define _XOPEN_SOURCE 700
+
 #include "test_framework.h"
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
 
 /* Test counters - defined here, declared extern in header */
 int tests_run = 0;
 int tests_passed = 0;
 int tests_failed = 0;
+
+/*
+ * Discard screen output so the library never blocks on a full pty
+ */
+static void* terminal_reader(void* arg)
+{
+    test_terminal_t* term = arg;
+    char buffer[4096];
+    while (read(term->master, buffer, sizeof(buffer)) > 0) {
+    }
+    return NULL;
+}
+
+/*
+ * Open pseudo-terminal of given size
+ */
+int test_terminal_open(test_terminal_t* term, int rows, int cols)
+{
+    term->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (term->master < 0) {
+        return -1;
+    }
+    if (grantpt(term->master) != 0 || unlockpt(term->master) != 0) {
+        close(term->master);
+        return -1;
+    }
+
+    const char* name = ptsname(term->master);
+    term->slave = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+    if (term->slave < 0) {
+        close(term->master);
+        return -1;
+    }
+
+    struct winsize size = {.ws_row = (unsigned short)rows, .ws_col = (unsigned short)cols};
+    ioctl(term->slave, TIOCSWINSZ, &size);
+
+    if (pthread_create(&term->reader, NULL, terminal_reader, term) != 0) {
+        close(term->slave);
+        close(term->master);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Queue keys for the library to read
+ */
+void test_terminal_type(test_terminal_t* term, const char* keys)
+{
+    size_t length = strlen(keys);
+    while (length > 0) {
+        ssize_t written = write(term->master, keys, length);
+        if (written <= 0) {
+            return;
+        }
+        keys += written;
+        length -= (size_t)written;
+    }
+}
+
+/*
+ * Close pseudo-terminal
+ *
+ * Closing the slave makes reads on the master fail, which ends the reader.
+ */
+void test_terminal_close(test_terminal_t* term)
+{
+    close(term->slave);
+    pthread_join(term->reader, NULL);
+    close(term->master);
+}
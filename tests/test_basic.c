@@ -25,8 +25,13 @@ int main(void)
     /* Test 1: Default configuration */
     smartterm_config_t config = smartterm_default_config();
     TEST_ASSERT(config.max_lines == 1000, "Default max_lines is 1000");
+    TEST_ASSERT(config.max_bytes == 0, "No memory budget by default");
+    TEST_ASSERT(config.hot_lines == 10000, "Default hot_lines is 10000");
+    TEST_ASSERT(config.spill_dir == NULL, "Spillover disabled by default");
+    TEST_ASSERT(config.tee_file == NULL, "Tee log disabled by default");
     TEST_ASSERT(config.status_bar_enabled == true, "Status bar enabled by default");
     TEST_ASSERT(config.history_enabled == true, "History enabled by default");
+    TEST_ASSERT(config.multiline_height == 0, "Multi-line input grows to half the screen");
     TEST_ASSERT(config.thread_safe == true, "Thread safety enabled by default");
 
     /* Test 2: Initialization with NULL config (should use defaults) */
@@ -37,6 +42,12 @@ int main(void)
         tests_run++; /* Count as run but not failed */
     } else {
         TEST_ASSERT_NOT_NULL(ctx, "Initialize with NULL config");
+        TEST_ASSERT(smartterm_get_fd(ctx) >= 0, "Event loop descriptor available");
+        TEST_ASSERT(smartterm_step(ctx) == SMARTTERM_OK, "Step without pending work");
+        smartterm_line_handle_t line = smartterm_write_live(ctx, "Working 0%", CTX_INFO);
+        TEST_ASSERT(smartterm_line_update(line, "Working 100%") == SMARTTERM_OK,
+                    "Live line updated in place");
+        TEST_ASSERT(smartterm_get_line_count(ctx) == 1, "Update does not append");
         smartterm_cleanup(ctx);
     }
 
@@ -0,0 +1,721 @@
+/*
+ * Export tests: saved sessions, exported text and the tee log
+ *
+ * Sessions run on a pseudo-terminal, so these tests need no real terminal.
+ */
+
+#include "test_framework.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <smartterm.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static test_terminal_t term;
+
+/*
+ * Start a session on the test terminal
+ */
+static smartterm_ctx* start_session(smartterm_config_t* config)
+{
+    config->tty_fd = term.slave;
+    config->term_type = "xterm";
+    return smartterm_init(config);
+}
+
+/*
+ * Read whole file into allocated string (NULL on failure)
+ */
+static char* read_file(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* data = malloc(size + 1);
+    if (data) {
+        data[fread(data, 1, size, file)] = '\0';
+    }
+    fclose(file);
+    return data;
+}
+
+/*
+ * Check that every line of a JSON Lines log is one complete object
+ */
+static int count_records(const char* log)
+{
+    int records = 0;
+    for (const char* line = log; *line;) {
+        const char* end = strchr(line, '\n');
+        if (!end || line[0] != '{' || end[-1] != '}' || memchr(line + 1, '{', end - line - 1)) {
+            return -1;
+        }
+        records++;
+        line = end + 1;
+    }
+    return records;
+}
+
+/*
+ * Export one line as JSON Lines and return its allocated "text" value
+ */
+static char* json_text(smartterm_ctx* ctx, int index)
+{
+    char* record = smartterm_export_string(ctx, EXPORT_JSONL, index, index, false);
+    char* text = record ? strstr(record, "\"text\":\"") : NULL;
+    char* end = record ? strstr(record, "\"}\n") : NULL;
+    char* value = NULL;
+    if (text && end && end > text) {
+        text += strlen("\"text\":\"");
+        value = strndup(text, end - text);
+    }
+    free(record);
+    return value;
+}
+
+/*
+ * Length of valid UTF-8 sequence at s, by decoding (0 = invalid)
+ */
+static size_t utf8_decoded_length(const unsigned char* s, size_t len)
+{
+    static const unsigned long min[] = {0, 0, 0x80, 0x800, 0x10000};
+    size_t n = s[0] >= 0xf0 ? 4 : s[0] >= 0xe0 ? 3 : s[0] >= 0xc0 ? 2 : 0;
+    if (n == 0 || s[0] >= 0xf8 || len < n) {
+        return 0;
+    }
+
+    unsigned long cp = s[0] & (0x7f >> n);
+    for (size_t i = 1; i < n; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+    if (cp < min[n] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        return 0;
+    }
+    return n;
+}
+
+/*
+ * Reference JSON string escaping, one byte at a time
+ */
+static void json_reference(const char* text, char* out)
+{
+    const unsigned char* s = (const unsigned char*)text;
+    size_t len = strlen(text);
+    for (size_t i = 0; i < len;) {
+        unsigned char c = s[i];
+        size_t n = c >= 0x80 ? utf8_decoded_length(s + i, len - i) : 1;
+        if (c >= 0x80) {
+            if (n == 0) {
+                out += sprintf(out, "\\ufffd");
+                n = 1;
+            } else {
+                memcpy(out, s + i, n);
+                out += n;
+            }
+        } else if (c == '"' || c == '\\') {
+            out += sprintf(out, "\\%c", c);
+        } else if (c == '\n') {
+            out += sprintf(out, "\\n");
+        } else if (c == '\t') {
+            out += sprintf(out, "\\t");
+        } else if (c == '\r') {
+            out += sprintf(out, "\\r");
+        } else if (c == '\b') {
+            out += sprintf(out, "\\b");
+        } else if (c == '\f') {
+            out += sprintf(out, "\\f");
+        } else if (c < 0x20) {
+            out += sprintf(out, "\\u%04x", c);
+        } else {
+            *out++ = (char)c;
+        }
+        i += n;
+    }
+    *out = '\0';
+}
+
+static void test_json_escaping(void)
+{
+    BEGIN_TEST_SUITE("JSON Lines Escaping");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 4000;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    static const struct {
+        const char* text;
+        const char* json;
+        const char* message;
+    } cases[] = {
+        {"say \"hi\" \\ \x01", "say \\\"hi\\\" \\\\ \\u0001", "Quotes, backslash, control"},
+        {"caf\xc3\xa9 \xe2\x9c\x93 \xf0\x9f\x98\x80", "caf\xc3\xa9 \xe2\x9c\x93 \xf0\x9f\x98\x80",
+         "Valid UTF-8 copied"},
+        {"bad \xff byte", "bad \\ufffd byte", "Invalid byte replaced"},
+        {"cut \xc3", "cut \\ufffd", "Truncated sequence replaced"},
+        {"\xc0\xaf \xed\xa0\x80 \xf4\x90\x80\x80", "\\ufffd\\ufffd \\ufffd\\ufffd\\ufffd "
+                                                   "\\ufffd\\ufffd\\ufffd\\ufffd",
+         "Overlong, surrogate and out-of-range forms replaced"},
+        {"sixteen bytes in\xe2\x9c\x93 then \x80 after a long clean run",
+         "sixteen bytes in\xe2\x9c\x93 then \\ufffd after a long clean run",
+         "Vector scan steps over valid UTF-8"},
+    };
+
+    int count = (int)(sizeof(cases) / sizeof(cases[0]));
+    for (int i = 0; i < count; i++) {
+        smartterm_write(ctx, cases[i].text, CTX_NORMAL);
+        char* json = json_text(ctx, i);
+        TEST_ASSERT_STR_EQUAL(cases[i].json, json, cases[i].message);
+        free(json);
+    }
+
+    /* Random lines mixing specials, valid sequences and stray bytes */
+    static const char* pieces[] = {"a",        "\"",           "\\",       "\x01",    "\t",
+                                   "\xc3\xa9", "\xe2\x9c\x93", "\xf0\x9f", "\x98\x80", "\xff",
+                                   "\x80",     "\xed\xa0",     "\xc0",     "abcdefgh"};
+    int piece_count = (int)(sizeof(pieces) / sizeof(pieces[0]));
+    unsigned int seed = 1;
+    int mismatches = 0;
+    for (int i = 0; i < 2000; i++) {
+        char text[256] = "";
+        int length = 0;
+        seed = seed * 1103515245u + 12345u;
+        for (int n = (seed >> 16) % 24; n > 0; n--) {
+            seed = seed * 1103515245u + 12345u;
+            const char* piece = pieces[(seed >> 16) % piece_count];
+            length += snprintf(text + length, sizeof(text) - length, "%s", piece);
+        }
+
+        char expected[2048];
+        json_reference(text, expected);
+        smartterm_write(ctx, text, CTX_NORMAL);
+        char* json = json_text(ctx, count + i);
+        mismatches += !json || strcmp(json, expected) != 0;
+        free(json);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Random lines match reference escaping");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void test_formats(void)
+{
+    BEGIN_TEST_SUITE("Export Formats");
+    smartterm_config_t config = smartterm_default_config();
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    smartterm_write(ctx, "a <b> & \"c\"", CTX_NORMAL);
+    smartterm_write(ctx, "bell\a\tdel\x7f", CTX_ERROR);
+    smartterm_write(ctx, "  ````fence", CTX_INFO);
+
+    char* plain = smartterm_export_string(ctx, EXPORT_PLAIN, 0, -1, false);
+    TEST_ASSERT_STR_EQUAL("a <b> & \"c\"\nbell\a\tdel\x7f\n  ````fence\n", plain,
+                          "Plain text unchanged");
+    free(plain);
+
+    char* ansi = smartterm_export_string(ctx, EXPORT_ANSI, 0, -1, false);
+    TEST_ASSERT_STR_EQUAL("\033[0ma <b> & \"c\"\033[0m\n"
+                          "\033[1;31mbell^G\tdel^?\033[0m\n"
+                          "\033[1;36m  ````fence\033[0m\n",
+                          ansi, "ANSI colors with control characters in caret notation");
+    free(ansi);
+
+    char* html = smartterm_export_string(ctx, EXPORT_HTML, 0, 0, false);
+    char* body = html ? strstr(html, "<pre>\n") : NULL;
+    TEST_ASSERT_STR_EQUAL("<pre>\na &lt;b&gt; &amp; &quot;c&quot;\n</pre>\n</body>\n</html>\n",
+                          body, "HTML entities escaped");
+    free(html);
+    html = smartterm_export_string(ctx, EXPORT_HTML, 2, 2, false);
+    body = html ? strstr(html, "<pre>\n") : NULL;
+    TEST_ASSERT_STR_EQUAL("<pre>\n<span class=\"info\">  ````fence</span>\n"
+                          "</pre>\n</body>\n</html>\n",
+                          body, "HTML class from context");
+    free(html);
+
+    char* markdown = smartterm_export_string(ctx, EXPORT_MARKDOWN, 0, -1, false);
+    TEST_ASSERT_STR_EQUAL("# SmartTerm Export\n\n## Output\n\n`````\n"
+                          "a <b> & \"c\"\nbell\a\tdel\x7f\n  ````fence\n`````\n",
+                          markdown, "Markdown fence longer than any backtick run");
+    free(markdown);
+
+    TEST_ASSERT_NULL(smartterm_export_string(ctx, EXPORT_BINARY, 0, -1, false),
+                     "No string for binary image");
+    TEST_ASSERT_NULL(smartterm_export_string(ctx, EXPORT_PLAIN, 3, 3, false),
+                     "No string past last line");
+
+    /* Strings are sized by a measuring pass; lines of every length must fit */
+    const size_t frame = strlen("<pre>\n\n</pre>\n</body>\n</html>\n");
+    char text[3000];
+    int mismatches = 0;
+    for (int length = 0; length < (int)sizeof(text); length += 97) {
+        memset(text, '<', length);
+        text[length] = '\0';
+        smartterm_write(ctx, text, CTX_NORMAL);
+        int index = smartterm_get_line_count(ctx) - 1;
+        char* line = smartterm_export_string(ctx, EXPORT_HTML, index, index, false);
+        char* escaped = line ? strstr(line, "<pre>\n") : NULL;
+        mismatches += !escaped || strlen(escaped) != frame + 4 * (size_t)length;
+        free(line);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Escaped lines sized exactly");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/*
+ * Export range to file and compare it with the string export
+ */
+static bool export_matches_string(smartterm_ctx* ctx, const char* path,
+                                  smartterm_export_format_t format, int start_line, int end_line,
+                                  bool include_meta)
+{
+    char* expected = smartterm_export_string(ctx, format, start_line, end_line, include_meta);
+    char* actual = NULL;
+    if (expected &&
+        smartterm_export(ctx, path, format, start_line, end_line, include_meta) == SMARTTERM_OK) {
+        actual = read_file(path);
+    }
+
+    bool same = actual && strcmp(actual, expected) == 0;
+    free(expected);
+    free(actual);
+    return same;
+}
+
+/*
+ * Text and metadata of numbered sample line
+ */
+static void sample_line(int i, char* text, size_t size, smartterm_line_meta_t* meta)
+{
+    static const char* tags[] = {"db", "net", NULL};
+    static const char* words[] = {"connect", "query \"users\"", "timeout <5s>", "caf\xc3\xa9"};
+    snprintf(text, size, "%s #%d", words[i % 4], i);
+    meta->context = (smartterm_context_t)(i % 6);
+    meta->timestamp = 1700000000L + i * 7L;
+    meta->tag = tags[i % 3];
+}
+
+/*
+ * Write sample lines first..first+count-1
+ */
+static void write_samples(smartterm_ctx* ctx, int first, int count)
+{
+    char text[64];
+    smartterm_line_meta_t meta;
+    for (int i = first; i < first + count; i++) {
+        sample_line(i, text, sizeof(text), &meta);
+        smartterm_write_meta(ctx, text, &meta);
+    }
+}
+
+/*
+ * Count buffer lines from index that differ from sample lines first..
+ */
+static int check_samples(smartterm_ctx* ctx, int index, int first, int count)
+{
+    int mismatches = 0;
+    char text[64];
+    smartterm_line_meta_t expected;
+    for (int i = 0; i < count; i++) {
+        sample_line(first + i, text, sizeof(text), &expected);
+        char* line = smartterm_copy_line(ctx, index + i);
+        smartterm_line_meta_t meta = {0};
+        smartterm_get_line_meta(ctx, index + i, &meta);
+        bool tags_match = expected.tag ? meta.tag && strcmp(meta.tag, expected.tag) == 0
+                                       : meta.tag == NULL;
+        mismatches += !line || strcmp(line, text) != 0 || meta.context != expected.context ||
+                      meta.timestamp != expected.timestamp || !tags_match;
+        free(line);
+    }
+    return mismatches;
+}
+
+static void test_sessions(void)
+{
+    BEGIN_TEST_SUITE("Session Save and Load");
+    char dir[] = "/tmp/smartterm_session_XXXXXX";
+    if (!mkdtemp(dir)) {
+        TEST_ASSERT(false, "Temporary directory created");
+        return;
+    }
+    char session[64];
+    char range[64];
+    snprintf(session, sizeof(session), "%s/all.session", dir);
+    snprintf(range, sizeof(range), "%s/range.session", dir);
+
+    /* Lines in all three tiers: spilled, compressed and hot */
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 1500;
+    config.hot_lines = 512;
+    config.spill_dir = dir;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with spill directory starts");
+    if (!ctx) {
+        rmdir(dir);
+        return;
+    }
+    write_samples(ctx, 0, 4000);
+
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT_EQUAL(4000, smartterm_get_line_count(ctx), "Spilled lines stay reachable");
+    TEST_ASSERT(usage.spill_line_count > 0 && usage.cold_line_count > 0,
+                "Lines spilled and compressed");
+    TEST_ASSERT_EQUAL(0, check_samples(ctx, 0, 0, 4000), "All tiers read back");
+
+    TEST_ASSERT(smartterm_save_session(ctx, session) == SMARTTERM_OK, "Session saved");
+    int fd = open(range, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    TEST_ASSERT(fd >= 0 && smartterm_export_fd(ctx, fd, EXPORT_BINARY, 1000, 1099, false) ==
+                               SMARTTERM_OK,
+                "Range exported as session image");
+    if (fd >= 0) {
+        close(fd);
+    }
+    smartterm_cleanup(ctx);
+
+    /* Without a spill directory loaded lines count toward max_lines */
+    config = smartterm_default_config();
+    config.max_lines = 5000;
+    ctx = start_session(&config);
+    if (!ctx) {
+        TEST_ASSERT_NOT_NULL(ctx, "Second session starts");
+        rmdir(dir);
+        return;
+    }
+    smartterm_write(ctx, "replaced by load", CTX_NORMAL);
+
+    TEST_ASSERT(smartterm_load_session(ctx, session) == SMARTTERM_OK, "Session loaded");
+    TEST_ASSERT_EQUAL(4000, smartterm_get_line_count(ctx), "Every line restored");
+    TEST_ASSERT_EQUAL(0, check_samples(ctx, 0, 0, 4000), "Text, context, timestamp and tag kept");
+
+    write_samples(ctx, 4000, 10);
+    TEST_ASSERT_EQUAL(0, check_samples(ctx, 4000, 4000, 10), "New lines follow loaded ones");
+
+    TEST_ASSERT(smartterm_load_session(ctx, range) == SMARTTERM_OK, "Exported range loaded");
+    TEST_ASSERT_EQUAL(100, smartterm_get_line_count(ctx), "Range holds its lines only");
+    TEST_ASSERT_EQUAL(0, check_samples(ctx, 0, 1000, 100), "Range lines match");
+
+    /* A damaged file is refused and leaves the scrollback alone */
+    truncate(session, 100);
+    TEST_ASSERT(smartterm_load_session(ctx, session) == SMARTTERM_IOERROR,
+                "Truncated session refused");
+    TEST_ASSERT_EQUAL(100, smartterm_get_line_count(ctx), "Scrollback unchanged");
+    TEST_ASSERT(smartterm_load_session(ctx, "/nonexistent/session") == SMARTTERM_IOERROR,
+                "Missing session refused");
+
+    smartterm_cleanup(ctx);
+    unlink(session);
+    unlink(range);
+    rmdir(dir);
+    END_TEST_SUITE();
+}
+
+static void test_streams(void)
+{
+    BEGIN_TEST_SUITE("Streamed Export");
+    char path[] = "/tmp/smartterm_export_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        TEST_ASSERT(false, "Temporary file created");
+        return;
+    }
+    close(fd);
+
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 5000;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        unlink(path);
+        return;
+    }
+
+    /* Several chunks' worth, with lines longer than a chunk on their own */
+    write_samples(ctx, 0, 3000);
+    char* wide = malloc(100000);
+    if (wide) {
+        memset(wide, '&', 99999);
+        wide[99999] = '\0';
+        smartterm_write(ctx, wide, CTX_ERROR);
+        free(wide);
+    }
+    write_samples(ctx, 3000, 1000);
+
+    static const smartterm_export_format_t formats[] = {EXPORT_PLAIN, EXPORT_ANSI, EXPORT_HTML,
+                                                        EXPORT_JSONL};
+    int mismatches = 0;
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        mismatches += !export_matches_string(ctx, path, formats[i], 0, -1, true);
+        mismatches += !export_matches_string(ctx, path, formats[i], 2990, 3010, false);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "File export matches string export");
+    TEST_ASSERT(export_matches_string(ctx, path, EXPORT_MARKDOWN, 0, -1, false),
+                "Markdown file export matches string export");
+
+    /* Output buffered in a stream comes first */
+    FILE* file = fopen(path, "w");
+    if (file) {
+        fputs("before\n", file);
+        TEST_ASSERT(smartterm_export_file(ctx, file, EXPORT_PLAIN, 0, 0, false) == SMARTTERM_OK,
+                    "Export to stream succeeds");
+        fclose(file);
+    }
+    char* contents = read_file(path);
+    TEST_ASSERT_STR_EQUAL("before\nconnect #0\n", contents, "Stream flushed before export");
+    free(contents);
+
+    fd = open(path, O_RDONLY);
+    TEST_ASSERT(smartterm_export_fd(ctx, fd, EXPORT_PLAIN, 0, -1, false) == SMARTTERM_IOERROR,
+                "Write error reported");
+    close(fd);
+    TEST_ASSERT(smartterm_export_fd(ctx, -1, EXPORT_PLAIN, 0, -1, false) == SMARTTERM_INVALID,
+                "Invalid descriptor refused");
+    TEST_ASSERT(smartterm_export(ctx, "/nonexistent/export.txt", EXPORT_PLAIN, 0, -1, false) ==
+                    SMARTTERM_IOERROR,
+                "Unopenable file reported");
+
+    smartterm_cleanup(ctx);
+    unlink(path);
+    END_TEST_SUITE();
+}
+
+/* Last progress report of a background export */
+static smartterm_export_progress_t last_progress;
+static int progress_reports;
+
+static void record_progress(smartterm_ctx* ctx, const smartterm_export_progress_t* progress,
+                            void* data)
+{
+    (void)ctx;
+    (void)data;
+    last_progress = *progress;
+    progress_reports++;
+}
+
+static void test_large_export(void)
+{
+    BEGIN_TEST_SUITE("Large and Background Export");
+    char dir[] = "/tmp/smartterm_large_XXXXXX";
+    if (!mkdtemp(dir)) {
+        TEST_ASSERT(false, "Temporary directory created");
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "%s/export", dir);
+
+    /* Enough lines to be formatted on worker threads where there are several CPUs */
+    enum { LINES = 40000 };
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 16000;
+    config.hot_lines = 1024;
+    config.spill_dir = dir;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with spill directory starts");
+    if (!ctx) {
+        rmdir(dir);
+        return;
+    }
+    write_samples(ctx, 0, LINES);
+
+    static const smartterm_export_format_t formats[] = {EXPORT_PLAIN, EXPORT_ANSI, EXPORT_HTML,
+                                                        EXPORT_JSONL, EXPORT_MARKDOWN};
+    int mismatches = 0;
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        bool include_meta = formats[i] != EXPORT_MARKDOWN;
+        mismatches += !export_matches_string(ctx, path, formats[i], 0, -1, include_meta);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Spilled, cold and hot lines exported in order");
+    TEST_ASSERT(export_matches_string(ctx, path, EXPORT_ANSI, 100, LINES - 100, true),
+                "Range not aligned to blocks exported in order");
+
+    /* The range is fixed when the job starts; later output is not exported */
+    char* expected = smartterm_export_string(ctx, EXPORT_ANSI, 0, -1, true);
+    smartterm_export_job* job =
+        smartterm_export_async(ctx, path, EXPORT_ANSI, 0, -1, true, record_progress, NULL);
+    TEST_ASSERT_NOT_NULL(job, "Background export starts");
+    write_samples(ctx, LINES, 2000);
+    TEST_ASSERT(job && smartterm_export_wait(job) == SMARTTERM_OK, "Background export succeeds");
+
+    char* actual = read_file(path);
+    TEST_ASSERT(expected && actual && strcmp(expected, actual) == 0,
+                "Background export matches string export");
+    TEST_ASSERT(progress_reports > 0 && last_progress.finished &&
+                    last_progress.lines_done == LINES && last_progress.lines_total == LINES,
+                "Final progress report covers every line");
+    free(expected);
+    free(actual);
+
+    job = smartterm_export_async(ctx, path, EXPORT_PLAIN, 0, -1, false, NULL, NULL);
+    smartterm_export_cancel(job);
+    int result = smartterm_export_wait(job);
+    TEST_ASSERT(result == SMARTTERM_CANCELLED || result == SMARTTERM_OK,
+                "Cancelled export stops cleanly");
+
+    /* Cleanup reaps a job left running */
+    smartterm_export_async(ctx, path, EXPORT_HTML, 0, -1, false, NULL, NULL);
+    smartterm_cleanup(ctx);
+    unlink(path);
+    rmdir(dir);
+    END_TEST_SUITE();
+}
+
+static void test_tee(void)
+{
+    BEGIN_TEST_SUITE("Tee Log");
+    char path[] = "/tmp/smartterm_tee_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        TEST_ASSERT(fd >= 0, "Temporary log created");
+        return;
+    }
+    close(fd);
+
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 500;
+    config.tee_file = path;
+    config.tee_sync_bytes = 4096;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with tee log starts");
+    if (!ctx) {
+        unlink(path);
+        return;
+    }
+
+    /* The log keeps lines the scrollback has already dropped */
+    write_samples(ctx, 0, 500);
+    char* expected = smartterm_export_string(ctx, EXPORT_PLAIN, 0, -1, false);
+    write_samples(ctx, 500, 500);
+    char* rest = smartterm_export_string(ctx, EXPORT_PLAIN, 0, -1, false);
+    TEST_ASSERT(smartterm_tee_flush(ctx) == SMARTTERM_OK, "Log flushed");
+
+    char* log = read_file(path);
+    size_t head = expected ? strlen(expected) : 0;
+    TEST_ASSERT(log && expected && rest && strncmp(log, expected, head) == 0 &&
+                    strcmp(log + head, rest) == 0,
+                "Log matches plain export of every line");
+
+    smartterm_tee_status_t status;
+    smartterm_tee_get_status(ctx, &status);
+    TEST_ASSERT(status.lines_written == 1000 && status.lines_dropped == 0, "Lines counted");
+    TEST_ASSERT(log && status.bytes_written == strlen(log), "Written bytes match the log");
+    TEST_ASSERT(status.lines_queued == 0 && status.error == SMARTTERM_OK, "Queue drained");
+    free(expected);
+    free(rest);
+    free(log);
+    smartterm_cleanup(ctx);
+
+    /* JSON Lines: one object per line, appended after the earlier log */
+    config.tee_format = EXPORT_JSONL;
+    ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with JSON Lines tee log starts");
+    write_samples(ctx, 0, 100);
+    smartterm_cleanup(ctx);
+    log = read_file(path);
+    char* json = log ? strchr(log, '{') : NULL;
+    TEST_ASSERT_EQUAL(100, json ? count_records(json) : -1, "Cleanup writes every record");
+    free(log);
+
+    config.tee_format = EXPORT_HTML;
+    ctx = start_session(&config);
+    TEST_ASSERT_NULL(ctx, "Document formats refused for tee log");
+    smartterm_cleanup(ctx);
+
+    unlink(path);
+    END_TEST_SUITE();
+}
+
+static void test_tee_partial_write(void)
+{
+    BEGIN_TEST_SUITE("Tee Log Partial Write");
+    char path[] = "/tmp/smartterm_tee_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        TEST_ASSERT(fd >= 0, "Temporary log created");
+        return;
+    }
+    close(fd);
+
+    smartterm_config_t config = smartterm_default_config();
+    config.tee_file = path;
+    config.tee_format = EXPORT_JSONL;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with tee log starts");
+    if (!ctx) {
+        unlink(path);
+        return;
+    }
+
+    /* The file size limit cuts the third line short */
+    smartterm_write(ctx, "first", CTX_NORMAL);
+    smartterm_write(ctx, "second", CTX_NORMAL);
+    smartterm_tee_flush(ctx);
+    char* log = read_file(path);
+    long limit = log ? (long)strlen(log) + 20 : 0;
+    free(log);
+
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit small = {.rlim_cur = (rlim_t)limit, .rlim_max = saved.rlim_max};
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &small);
+
+    smartterm_write(ctx, "third line, longer than the space left", CTX_NORMAL);
+    TEST_ASSERT(smartterm_tee_flush(ctx) == SMARTTERM_IOERROR, "Failed write reported");
+
+    smartterm_tee_status_t status;
+    smartterm_tee_get_status(ctx, &status);
+    TEST_ASSERT(status.lines_written == 2, "Only complete lines count as written");
+    TEST_ASSERT(status.lines_dropped == 1, "Cut-off line counted as dropped");
+
+    setrlimit(RLIMIT_FSIZE, &saved);
+    smartterm_write(ctx, "fourth", CTX_NORMAL);
+    TEST_ASSERT(smartterm_tee_flush(ctx) == SMARTTERM_OK, "Writing resumes");
+
+    log = read_file(path);
+    TEST_ASSERT_EQUAL(3, log ? count_records(log) : -1, "Log holds only whole records");
+    TEST_ASSERT(log && strstr(log, "fourth") && !strstr(log, "third"),
+                "Next batch starts on a line boundary");
+    smartterm_tee_get_status(ctx, &status);
+    TEST_ASSERT(log && status.bytes_written == strlen(log), "Written bytes match the log");
+    free(log);
+
+    smartterm_cleanup(ctx);
+    unlink(path);
+    END_TEST_SUITE();
+}
+
+int main(void)
+{
+    if (test_terminal_open(&term, 24, 80) != 0) {
+        printf("\n⚠️  No pseudo-terminal available - skipping export tests\n");
+        return EXIT_SUCCESS;
+    }
+
+    test_formats();
+    test_json_escaping();
+    test_sessions();
+    test_streams();
+    test_large_export();
+    test_tee();
+    test_tee_partial_write();
+
+    test_terminal_close(&term);
+    TEST_SUMMARY();
+}
@@ -5,6 +5,7 @@
 #ifndef TEST_FRAMEWORK_H
 #define TEST_FRAMEWORK_H
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -81,4 +82,26 @@ extern int tests_failed;
         return (tests_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;                                  \
     } while (0)
 
+/*
+ * Pseudo-terminal standing in for the user's terminal
+ *
+ * Pass slave as smartterm_config_t.tty_fd with term_type "xterm". Keys
+ * written with test_terminal_type() are read by the library as typed
+ * input; screen output is read from master and discarded.
+ */
+typedef struct {
+    int master;       /* Test side: keys in, screen output out */
+    int slave;        /* Terminal given to the library */
+    pthread_t reader; /* Drains screen output */
+} test_terminal_t;
+
+/* Returns 0 on success, -1 if no pseudo-terminal is available */
+int test_terminal_open(test_terminal_t* term, int rows, int cols);
+
+/* Queue keys as if typed (escape sequences as the terminal sends them) */
+void test_terminal_type(test_terminal_t* term, const char* keys);
+
+/* Close both sides (after smartterm_cleanup()) */
+void test_terminal_close(test_terminal_t* term);
+
 #endif /* TEST_FRAMEWORK_H */
@@ -0,0 +1,602 @@
+/*
+ * Input tests: keys typed into the line editor, history and the event loop
+ *
+ * Keys are typed into a pseudo-terminal that the library runs on through
+ * tty_fd, so these tests need no real terminal.
+ */
+
+#include "test_framework.h"
+#include <errno.h>
+#include <smartterm.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define PASTE_START "\033[200~"
+#define PASTE_END "\033[201~"
+
+/* Keys as an xterm sends them in keypad mode */
+#define KEY_UP_SEQ "\033OA"
+#define KEY_DOWN_SEQ "\033OB"
+#define KEY_LEFT_SEQ "\033OD"
+#define KEY_RIGHT_SEQ "\033OC"
+
+static test_terminal_t term;
+
+/* Last batch passed to the paste handler */
+static char pasted[256];
+static int pasted_lines;
+static int paste_calls;
+
+/*
+ * Start a session on the test terminal with given configuration
+ */
+static smartterm_ctx* open_session(smartterm_config_t* config)
+{
+    config->tty_fd = term.slave;
+    config->term_type = "xterm";
+    return smartterm_init(config);
+}
+
+/*
+ * Start a session on the test terminal
+ */
+static smartterm_ctx* start_session(void)
+{
+    smartterm_config_t config = smartterm_default_config();
+    return open_session(&config);
+}
+
+/*
+ * Read one line after typing keys; returns allocated line or NULL
+ */
+static char* type_line(smartterm_ctx* ctx, const char* keys)
+{
+    test_terminal_type(&term, keys);
+    return smartterm_read_line(ctx, "> ");
+}
+
+/*
+ * Check a line read and release it
+ */
+static void expect_line(char* line, const char* expected, const char* message)
+{
+    TEST_ASSERT_STR_EQUAL(expected, line, message);
+    free(line);
+}
+
+static void test_editing(void)
+{
+    BEGIN_TEST_SUITE("Line Editing");
+    smartterm_ctx* ctx = start_session();
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    expect_line(type_line(ctx, "hello world\r"), "hello world", "Typed line returned");
+    expect_line(type_line(ctx, "world\x01hello \r"), "hello world", "Ctrl-A inserts at start");
+    expect_line(type_line(ctx, "abcdef" KEY_LEFT_SEQ KEY_LEFT_SEQ "\x7fX\r"), "abcXef",
+                "Backspace and insert after arrow keys");
+    expect_line(type_line(ctx, "h\xc3\xa9llo\x02\x02\x02\x08\r"), "hllo",
+                "Cursor moves and deletes whole UTF-8 characters");
+    expect_line(type_line(ctx, "ab\x01\x05" "c\r"), "abc", "Ctrl-E moves to end");
+
+    expect_line(type_line(ctx, "one two\x01\x0b\x19\x19\r"), "one twoone two",
+                "Ctrl-K kills to end, Ctrl-Y yanks");
+    expect_line(type_line(ctx, "junk\x15kept\r"), "kept", "Ctrl-U kills to start");
+    expect_line(type_line(ctx, "alpha beta gamma\x17X\r"), "alpha beta X",
+                "Ctrl-W kills previous word");
+    expect_line(type_line(ctx, "foo bar baz\033b\033d\r"), "foo bar ",
+                "Meta-B and Meta-D work on words");
+
+    expect_line(type_line(ctx, KEY_UP_SEQ "\r"), "foo bar ", "Up recalls last line");
+    expect_line(type_line(ctx, "\x10\x10\x10\r"), "kept", "Ctrl-P steps further back");
+    expect_line(type_line(ctx, "draft" KEY_UP_SEQ KEY_DOWN_SEQ "!\r"), "draft!",
+                "Down returns to the line being typed");
+    expect_line(type_line(ctx, "\x12two\r"), "one twoone two", "Ctrl-R finds entry");
+    expect_line(type_line(ctx, "\x12twoq\x7f\r"), "one twoone two",
+                "Backspace widens the search again");
+    expect_line(type_line(ctx, "x\x12zzz\x07\r"), "x", "Ctrl-G restores line");
+
+    TEST_ASSERT_NULL(type_line(ctx, "\x04"), "Ctrl-D on empty line ends input");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/* Lines passed to the line handler */
+static char* handled_lines[4];
+static int handled_count;
+static bool handled_eof;
+
+static void record_line(smartterm_ctx* ctx, char* line, void* data)
+{
+    (void)data;
+    if (!line) {
+        handled_eof = true;
+        smartterm_set_line_handler(ctx, NULL, NULL);
+    } else if (handled_count < 4) {
+        handled_lines[handled_count++] = line;
+    } else {
+        free(line);
+    }
+}
+
+/*
+ * Wait for the application's epoll set (true if it became readable)
+ */
+static bool wait_ready(int epoll_fd, int timeout_ms)
+{
+    struct epoll_event event;
+    int n;
+    do {
+        n = epoll_wait(epoll_fd, &event, 1, timeout_ms);
+    } while (n < 0 && errno == EINTR);
+    return n > 0;
+}
+
+/*
+ * Step session until the line handler has seen count lines or EOF
+ */
+static void step_until(smartterm_ctx* ctx, int epoll_fd, int count)
+{
+    for (int i = 0; i < 100 && handled_count < count && !handled_eof; i++) {
+        if (wait_ready(epoll_fd, 50)) {
+            smartterm_step(ctx);
+        }
+    }
+}
+
+static void test_event_loop(void)
+{
+    BEGIN_TEST_SUITE("Event Loop");
+    smartterm_ctx* ctx = start_session();
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    int fd = smartterm_get_fd(ctx);
+    TEST_ASSERT(fd >= 0, "Pollable descriptor created");
+    TEST_ASSERT_EQUAL(fd, smartterm_get_fd(ctx), "Same descriptor on every call");
+
+    /* The application's own loop watches the descriptor */
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event watch = {.events = EPOLLIN, .data.fd = fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &watch);
+    while (wait_ready(epoll_fd, 100)) {
+        smartterm_step(ctx);
+    }
+
+    smartterm_write(ctx, "queued", CTX_NORMAL);
+    TEST_ASSERT(wait_ready(epoll_fd, 1000), "Queued write wakes the loop");
+    smartterm_step(ctx);
+    TEST_ASSERT(!wait_ready(epoll_fd, 100), "Step renders the queued output");
+
+    /* A second frame within 16 ms waits for the timer */
+    smartterm_write(ctx, "soon after", CTX_NORMAL);
+    smartterm_step(ctx);
+    smartterm_write(ctx, "and again", CTX_NORMAL);
+    smartterm_step(ctx);
+    TEST_ASSERT(wait_ready(epoll_fd, 1000), "Deferred frame wakes the loop");
+    smartterm_step(ctx);
+    TEST_ASSERT(!wait_ready(epoll_fd, 100), "Deferred frame rendered");
+
+    TEST_ASSERT(smartterm_set_line_handler(ctx, record_line, NULL) == SMARTTERM_OK,
+                "Line handler installed");
+    test_terminal_type(&term, "typed line\r");
+    step_until(ctx, epoll_fd, 1);
+    TEST_ASSERT(handled_count == 1 && strcmp(handled_lines[0], "typed line") == 0,
+                "Line handler gets the typed line");
+    test_terminal_type(&term, "a\rb\r");
+    step_until(ctx, epoll_fd, 3);
+    TEST_ASSERT(handled_count == 3 && strcmp(handled_lines[1], "a") == 0 &&
+                    strcmp(handled_lines[2], "b") == 0,
+                "Following lines handled in order");
+    test_terminal_type(&term, "\x04");
+    step_until(ctx, epoll_fd, 4);
+    TEST_ASSERT(handled_eof, "Ctrl-D passes NULL to the handler");
+
+    for (int i = 0; i < handled_count; i++) {
+        free(handled_lines[i]);
+    }
+    close(epoll_fd);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void test_history_file(void)
+{
+    BEGIN_TEST_SUITE("History File");
+    char path[] = "/tmp/smartterm_history_XXXXXX";
+    int fd = mkstemp(path);
+    FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        TEST_ASSERT(false, "Temporary history file created");
+        END_TEST_SUITE();
+        return;
+    }
+
+    /* Many stale copies, an escaped backslash, and the newest copy last */
+    for (int i = 0; i < 600; i++) {
+        fprintf(file, "old %d\n", i % 50);
+    }
+    fputs("back\\\\slash\nold 7\n", file);
+    fclose(file);
+
+    smartterm_config_t config = smartterm_default_config();
+    config.history_file = path;
+    smartterm_ctx* ctx = open_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with history file starts");
+    if (!ctx) {
+        unlink(path);
+        return;
+    }
+
+    expect_line(type_line(ctx, KEY_UP_SEQ "\r"), "old 7", "Newest copy of entry loaded last");
+    expect_line(type_line(ctx, KEY_UP_SEQ KEY_UP_SEQ "\r"), "back\\slash",
+                "Escaped backslash decoded");
+    expect_line(type_line(ctx, KEY_UP_SEQ KEY_UP_SEQ KEY_UP_SEQ "\r"), "old 49",
+                "Older copies of an entry dropped");
+    expect_line(type_line(ctx, "new entry\r"), "new entry", "New line typed");
+    smartterm_cleanup(ctx);
+
+    /* Loading found the stale lines and compacted the file */
+    int lines = 0;
+    char last[64] = "";
+    char text[64];
+    file = fopen(path, "r");
+    while (file && fgets(text, sizeof(text), file)) {
+        lines++;
+        snprintf(last, sizeof(last), "%s", text);
+    }
+    if (file) {
+        fclose(file);
+    }
+    TEST_ASSERT(lines > 50 && lines < 60, "Stale lines compacted away");
+    TEST_ASSERT_STR_EQUAL("new entry\n", last, "New entry appended");
+
+    /* history_size caps what is loaded, newest kept */
+    config.history_size = 3;
+    ctx = open_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session reopens history file");
+    if (ctx) {
+        expect_line(type_line(ctx, KEY_UP_SEQ "\r"), "new entry", "Appended entry loaded");
+        expect_line(type_line(ctx, KEY_UP_SEQ KEY_UP_SEQ KEY_UP_SEQ KEY_UP_SEQ KEY_UP_SEQ "\r"),
+                    "back\\slash", "Only history_size entries kept");
+    }
+    smartterm_cleanup(ctx);
+
+    unlink(path);
+    END_TEST_SUITE();
+}
+
+/* Calls of the file name completion source */
+static int source_calls;
+
+/*
+ * Complete file names from a fixed list
+ */
+static char** complete_files(const char* line, int start, int end, void* data)
+{
+    static const char* files[] = {"alpha.txt", "alpine.txt", "beta.txt"};
+    (void)data;
+    source_calls++;
+
+    char** matches = calloc(4, sizeof(char*));
+    int count = 0;
+    for (int i = 0; matches && i < 3; i++) {
+        if (strncmp(files[i], line + start, end - start) == 0) {
+            matches[count++] = strdup(files[i]);
+        }
+    }
+    return matches;
+}
+
+/*
+ * Complete color names
+ */
+static char** complete_colors(const char* text, int start, int end, void* data)
+{
+    static const char* colors[] = {"green", "grey", "red"};
+    (void)start;
+    (void)end;
+    (void)data;
+
+    char** matches = calloc(4, sizeof(char*));
+    int count = 0;
+    for (int i = 0; matches && i < 3; i++) {
+        if (strncmp(colors[i], text, strlen(text)) == 0) {
+            matches[count++] = strdup(colors[i]);
+        }
+    }
+    return matches;
+}
+
+/*
+ * Set the completer over and over while another thread reads input
+ */
+static void* set_completer_repeatedly(void* ctx)
+{
+    static int data[2];
+    for (int i = 0; i < 2000; i++) {
+        smartterm_set_completer(ctx, complete_colors, &data[i % 2]);
+    }
+    return NULL;
+}
+
+static void test_completion(void)
+{
+    BEGIN_TEST_SUITE("Tab Completion");
+    smartterm_ctx* ctx = start_session();
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    static const char* commands[] = {"status", "start", "stop", "help", "cat", NULL};
+    static const char* options[] = {"--verbose", "--version"};
+    TEST_ASSERT(smartterm_completion_add_words(ctx, commands, -1, COMPLETE_COMMAND) > 0,
+                "Command words added");
+    TEST_ASSERT(smartterm_completion_add_words(ctx, options, 2, COMPLETE_ARGUMENT) > 0,
+                "Argument words added");
+
+    expect_line(type_line(ctx, "he\t\r"), "help ", "Single candidate completed with space");
+    expect_line(type_line(ctx, "st\ta\t\r"), "sta", "Several candidates extend to common prefix");
+    expect_line(type_line(ctx, "sta\tr\t\r"), "start ", "Typing narrows listed candidates");
+    expect_line(type_line(ctx, "help --v\t\r"), "help --ver", "Argument words extended");
+    expect_line(type_line(ctx, "help --verb\t\r"), "help --verbose ", "Argument word completed");
+    expect_line(type_line(ctx, "stop he\t\r"), "stop he", "Command words not offered as arguments");
+
+    int id = smartterm_completion_add_source(ctx, complete_files, NULL, COMPLETE_ARGUMENT,
+                                             SOURCE_CACHED);
+    TEST_ASSERT(id > 0, "Source added");
+    expect_line(type_line(ctx, "cat al\t\r"), "cat alp", "Source candidates extended");
+    expect_line(type_line(ctx, "cat b\t\r"), "cat beta.txt ", "Source candidate completed");
+
+    source_calls = 0;
+    expect_line(type_line(ctx, "cat a\th\t\r"), "cat alpha.txt ",
+                "Cached candidates filtered for longer word");
+    TEST_ASSERT_EQUAL(1, source_calls, "Source called once for the growing word");
+
+    TEST_ASSERT(smartterm_completion_remove(ctx, id) == SMARTTERM_OK, "Source removed");
+    expect_line(type_line(ctx, "cat al\t\r"), "cat al", "Removed source not asked");
+    TEST_ASSERT(smartterm_completion_remove(ctx, id) == SMARTTERM_INVALID, "Unknown ID refused");
+
+    smartterm_set_completer(ctx, complete_colors, NULL);
+    expect_line(type_line(ctx, "cat gree\t\r"), "cat green ", "Completer candidates completed");
+    pthread_t setter;
+    int mismatches = 0;
+    if (pthread_create(&setter, NULL, set_completer_repeatedly, ctx) == 0) {
+        for (int i = 0; i < 20; i++) {
+            char* line = type_line(ctx, "cat r\t\r");
+            mismatches += !line || strcmp(line, "cat red ") != 0;
+            free(line);
+        }
+        pthread_join(setter, NULL);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Completer replaced while reading input");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/* Keys passed to the keymap handlers, in order */
+static char handled[64];
+
+/*
+ * Record handler's tag character (data) and the key it was called with
+ */
+static void record_key(smartterm_ctx* ctx, int key, void* data)
+{
+    (void)ctx;
+    size_t used = strlen(handled);
+    if (used + 2 < sizeof(handled)) {
+        handled[used] = *(const char*)data;
+        handled[used + 1] = key < ' ' ? (char)('@' + key) : (char)key;
+        handled[used + 2] = '\0';
+    }
+}
+
+static void test_keymaps(void)
+{
+    BEGIN_TEST_SUITE("Keymaps");
+    smartterm_ctx* ctx = start_session();
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    smartterm_keymap* global = smartterm_get_global_keymap(ctx);
+    TEST_ASSERT(smartterm_keymap_bind(global, "C-x C-f", record_key, "g") == SMARTTERM_OK,
+                "Sequence bound");
+    TEST_ASSERT(smartterm_keymap_bind(global, "M-q", record_key, "g") == SMARTTERM_OK,
+                "Meta key bound");
+    TEST_ASSERT(smartterm_keymap_bind(global, "C-x", record_key, "g") == SMARTTERM_INVALID,
+                "Prefix of a bound sequence refused");
+    TEST_ASSERT(smartterm_keymap_bind(global, "C-x C-f C-g", record_key, "g") ==
+                    SMARTTERM_INVALID,
+                "Extension of a bound sequence refused");
+
+    handled[0] = '\0';
+    expect_line(type_line(ctx, "a\x18\x06" "b\r"), "ab", "Bound sequence kept from editor");
+    expect_line(type_line(ctx, "x\033qy\r"), "xy", "Meta key kept from editor");
+    TEST_ASSERT_STR_EQUAL("gFgq", handled, "Handlers called with last key");
+
+    /* C-x alone does nothing in the editor; z is inserted */
+    expect_line(type_line(ctx, "c\x18zd\r"), "czd", "Unmatched sequence passed on key by key");
+    expect_line(type_line(ctx, "ab\x18\x02X\r"), "aXb", "Key after unmatched prefix edits");
+
+    smartterm_keymap* mode = smartterm_keymap_create(ctx);
+    TEST_ASSERT_NOT_NULL(mode, "Keymap created");
+    smartterm_keymap_bind(mode, "q", record_key, "m");
+    smartterm_keymap_bind(mode, "C-x C-f", record_key, "m");
+    TEST_ASSERT(smartterm_set_keymap(ctx, mode) == SMARTTERM_OK, "Modal keymap set");
+
+    handled[0] = '\0';
+    expect_line(type_line(ctx, "aqb\x18\x06\033q\r"), "ab",
+                "Modal and global keys kept from editor");
+    TEST_ASSERT_STR_EQUAL("mqmFgq", handled, "Modal keymap looked up first");
+
+    smartterm_set_keymap(ctx, NULL);
+    expect_line(type_line(ctx, "aqb\r"), "aqb", "Keys typed again once mode is left");
+
+    TEST_ASSERT(smartterm_keymap_unbind(global, "C-x C-f") == SMARTTERM_OK, "Sequence unbound");
+    TEST_ASSERT(smartterm_keymap_unbind(global, "C-x C-f") == SMARTTERM_ERROR,
+                "Unbound sequence reported");
+    handled[0] = '\0';
+    expect_line(type_line(ctx, "ab\x18\x06" "c\r"), "abc", "Unbound sequence reaches editor");
+    TEST_ASSERT_STR_EQUAL("", handled, "No handler called");
+
+    smartterm_keymap_free(mode);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/*
+ * Type keys on a thread, for input larger than the terminal buffers
+ */
+static void* type_keys(void* keys)
+{
+    test_terminal_type(&term, keys);
+    return NULL;
+}
+
+/*
+ * Read multi-line input after typing keys; returns allocated text or NULL
+ */
+static char* type_text(smartterm_ctx* ctx, const char* keys)
+{
+    test_terminal_type(&term, keys);
+    return smartterm_read_multiline(ctx, "> ");
+}
+
+static void test_multiline(void)
+{
+    BEGIN_TEST_SUITE("Multi-line Input");
+    smartterm_config_t config = smartterm_default_config();
+    config.multiline_enabled = true;
+    config.multiline_height = 5;
+    smartterm_ctx* ctx = open_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    expect_line(type_text(ctx, "one\rtwo\r\r"), "one\ntwo", "Enter on empty last line submits");
+    expect_line(type_text(ctx, "x\r\033\r"), "x\n", "Meta-Enter submits as typed");
+    expect_line(type_text(ctx, "ace" KEY_LEFT_SEQ KEY_LEFT_SEQ "b" KEY_RIGHT_SEQ "d\x04"), "abcde",
+                "Insertions where the cursor moved");
+    expect_line(type_text(ctx, "abcdef\rxy" KEY_UP_SEQ "Z\x04"), "abZcdef\nxy",
+                "Up keeps the column");
+    expect_line(type_text(ctx, "abc\rx" KEY_UP_SEQ "\x05" KEY_DOWN_SEQ "Y\x04"), "abc\nxY",
+                "Down stops at a shorter line's end");
+    expect_line(type_text(ctx, "ab\rcd\x01\x7f\x04"), "abcd", "Backspace at line start joins");
+    expect_line(type_text(ctx, "ab\rcd" KEY_UP_SEQ "\x05\x0b\x04"), "abcd",
+                "Ctrl-K at line end joins");
+    expect_line(type_text(ctx, "a\tb\x04"), "a   b", "Tab to next stop");
+    expect_line(type_text(ctx, "ad" KEY_LEFT_SEQ PASTE_START "b\nc" PASTE_END "\x04"), "ab\ncd",
+                "Paste inserted at cursor");
+
+    /* Far more lines than rows, and more bytes than the terminal buffers */
+    enum { LINES = 3000 };
+    size_t size = strlen(PASTE_START) + LINES * 16 + strlen(PASTE_END) + 2;
+    char* keys = malloc(size);
+    char* expected = malloc(LINES * 16);
+    if (keys && expected) {
+        size_t used = (size_t)sprintf(keys, PASTE_START);
+        size_t text = 0;
+        for (int i = 0; i < LINES; i++) {
+            text += (size_t)sprintf(expected + text, "line %d\n", i);
+        }
+        memcpy(keys + used, expected, text);
+        sprintf(keys + used + text, PASTE_END "\r");
+        expected[text - 1] = '\0';
+
+        pthread_t typist;
+        if (pthread_create(&typist, NULL, type_keys, keys) == 0) {
+            char* pasted_text = smartterm_read_multiline(ctx, "> ");
+            pthread_join(typist, NULL);
+            TEST_ASSERT(pasted_text && strcmp(pasted_text, expected) == 0,
+                        "Large paste read back unchanged");
+            free(pasted_text);
+        }
+    }
+    free(keys);
+    free(expected);
+
+    expect_line(type_text(ctx, "more" KEY_UP_SEQ "\x04"), "more", "Editor reset after large text");
+    TEST_ASSERT_NULL(type_text(ctx, "\x04"), "Ctrl-D on empty text ends input");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void record_paste(smartterm_ctx* ctx, const char* text, int line_count, void* data)
+{
+    (void)ctx;
+    (void)data;
+    snprintf(pasted, sizeof(pasted), "%s", text);
+    pasted_lines = line_count;
+    paste_calls++;
+}
+
+static void test_paste(void)
+{
+    BEGIN_TEST_SUITE("Bracketed Paste");
+    smartterm_ctx* ctx = start_session();
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    expect_line(type_line(ctx, "a" PASTE_START "b\tc" PASTE_END "d\r"), "ab cd",
+                "Single-line paste inserted at cursor");
+
+    test_terminal_type(&term, PASTE_START "one\ntwo\nthree" PASTE_END "!\r");
+    expect_line(smartterm_read_line(ctx, "> "), "one", "First pasted line completes input");
+    expect_line(smartterm_read_line(ctx, "> "), "two", "Next pasted line read without typing");
+    expect_line(smartterm_read_line(ctx, "> "), "three!", "Text after last break stays editable");
+
+    smartterm_set_paste_handler(ctx, record_paste, NULL);
+    expect_line(type_line(ctx, "x" PASTE_START "ls -la\n" PASTE_END), "xls -la",
+                "Single line with trailing newline submitted with handler set");
+    TEST_ASSERT_EQUAL(0, paste_calls, "Handler not called for one line");
+
+    expect_line(type_line(ctx, "keep" PASTE_START "a\nb\nc\n" PASTE_END "\r"), "keep",
+                "Input line unchanged by batch paste");
+    TEST_ASSERT_EQUAL(1, paste_calls, "Handler called once per paste");
+    TEST_ASSERT_EQUAL(3, pasted_lines, "Trailing newline does not add a line");
+    TEST_ASSERT_STR_EQUAL("a\nb\nc", pasted, "Batch text without final newline");
+
+
+    expect_line(type_line(ctx, PASTE_START "\n\n" PASTE_END "\r"), "", "Blank lines pasted");
+    TEST_ASSERT_EQUAL(2, pasted_lines, "Two blank lines counted");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+int main(void)
+{
+    if (test_terminal_open(&term, 24, 80) != 0) {
+        printf("\n⚠️  No pseudo-terminal available - skipping input tests\n");
+        return EXIT_SUCCESS;
+    }
+
+    /* A missing key would leave a read waiting forever */
+    alarm(60);
+
+    test_editing();
+    test_event_loop();
+    test_history_file();
+    test_completion();
+    test_keymaps();
+    test_multiline();
+    test_paste();
+
+    test_terminal_close(&term);
+    TEST_SUMMARY();
+}
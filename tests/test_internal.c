@@ -0,0 +1,395 @@
+/*
+ * Unit tests of internal components
+ *
+ * Links against the library's internal functions, which are not part of
+ * the public API; see lib/smartterm/smartterm_internal.h.
+ */
+
+#include "test_framework.h"
+#include "../lib/smartterm/smartterm_internal.h"
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Deterministic pseudo-random numbers */
+static unsigned int seed = 1;
+
+static unsigned int next_random(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+}
+
+/*
+ * Compress and decompress data; returns true if it comes back unchanged
+ */
+static bool lz_round_trip(const unsigned char* data, size_t size)
+{
+    size_t bound = lz_compress_bound(size);
+    unsigned char* packed = malloc(bound);
+    unsigned char* unpacked = malloc(size + 1);
+    bool same = false;
+
+    size_t packed_size = packed ? lz_compress(data, size, packed, bound) : 0;
+    size_t out_size = 0;
+    if (packed_size > 0 && unpacked &&
+        lz_decompress(packed, packed_size, unpacked, size + 1, &out_size) == SMARTTERM_OK) {
+        same = out_size == size && memcmp(unpacked, data, size) == 0;
+    }
+
+    free(packed);
+    free(unpacked);
+    return same;
+}
+
+static void test_lz(void)
+{
+    BEGIN_TEST_SUITE("LZ Block Codec");
+    enum { SIZE = 200000 };
+    unsigned char* data = malloc(SIZE);
+    if (!data) {
+        TEST_ASSERT_NOT_NULL(data, "Test data allocated");
+        return;
+    }
+
+    TEST_ASSERT(lz_round_trip((const unsigned char*)"", 0), "Empty block");
+    TEST_ASSERT(lz_round_trip((const unsigned char*)"abc", 3), "Block shorter than a match");
+
+    memset(data, 'x', SIZE);
+    TEST_ASSERT(lz_round_trip(data, SIZE), "Long run (length extensions)");
+    unsigned char packed[1024];
+    TEST_ASSERT(lz_compress(data, 4096, packed, sizeof(packed)) < 64, "Run compresses well");
+
+    for (size_t i = 0; i < SIZE; i++) {
+        data[i] = (unsigned char)next_random();
+    }
+    TEST_ASSERT(lz_round_trip(data, SIZE), "Incompressible data within bound");
+
+    /* Log-like text: repeats within and beyond the 64KB window */
+    size_t used = 0;
+    while (used + 64 < SIZE) {
+        used += (size_t)snprintf((char*)data + used, 64, "[%05u] worker %u: request %u done\n",
+                                 next_random() % 1000, next_random() % 8, next_random());
+    }
+    TEST_ASSERT(lz_round_trip(data, used), "Log-like text");
+
+    int failures = 0;
+    for (int i = 0; i < 500; i++) {
+        size_t size = next_random() % 2048;
+        for (size_t j = 0; j < size; j++) {
+            /* Small alphabet so matches of every length occur */
+            data[j] = (unsigned char)('a' + next_random() % 3);
+        }
+        failures += !lz_round_trip(data, size);
+    }
+    TEST_ASSERT_EQUAL(0, failures, "Random blocks round-trip");
+
+    /* The decoder must reject bad input without writing past dst */
+    size_t bound = lz_compress_bound(4096);
+    unsigned char* block = malloc(bound);
+    size_t block_size = block ? lz_compress(data, 4096, block, bound) : 0;
+    unsigned char out[4096];
+    size_t out_size;
+    TEST_ASSERT(block_size > 0 &&
+                    lz_decompress(block, block_size, out, 100, &out_size) == SMARTTERM_ERROR,
+                "Output larger than dst rejected");
+
+    int accepted_bad = 0;
+    for (size_t cut = 1; block && cut < block_size; cut += 7) {
+        accepted_bad += lz_decompress(block, cut, out, sizeof(out), &out_size) == SMARTTERM_OK &&
+                        out_size == 4096 && memcmp(out, data, 4096) == 0;
+    }
+    TEST_ASSERT_EQUAL(0, accepted_bad, "Truncated block never decodes to the original");
+
+    unsigned char bad_offset[] = {0x40, 'a', 'b', 'c', 'd', 0x10, 0x00};
+    TEST_ASSERT(lz_decompress(bad_offset, sizeof(bad_offset), out, sizeof(out), &out_size) ==
+                    SMARTTERM_ERROR,
+                "Match before start of block rejected");
+
+    free(block);
+    free(data);
+    END_TEST_SUITE();
+}
+
+/*
+ * Format timestamp the slow way
+ */
+static void time_reference(long timestamp, char* out, size_t size)
+{
+    time_t t = (time_t)timestamp;
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    strftime(out, size, "%Y-%m-%d %H:%M:%S", &tm_info);
+}
+
+/*
+ * Count timestamps formatted differently from localtime_r() + strftime()
+ */
+static int time_mismatches(const char* tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+
+    /* 2024-03-10 06:59:00 UTC, just before the US spring-forward */
+    long timestamp = 1710053940L;
+    const long steps[] = {1, 1, 58, 1, 1, -1, -61, 3600, 59, 1, 86400, -86400, -3599, 7, 31};
+    time_format_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    char expected[64];
+    int mismatches = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        timestamp += steps[i % (sizeof(steps) / sizeof(steps[0]))] * (i % 7 == 6 ? 37 : 1);
+        time_reference(timestamp, expected, sizeof(expected));
+        mismatches += strcmp(expected, time_format(&cache, timestamp)) != 0;
+    }
+    return mismatches;
+}
+
+static void test_time_format(void)
+{
+    BEGIN_TEST_SUITE("Timestamp Formatting");
+    char* saved = getenv("TZ") ? strdup(getenv("TZ")) : NULL;
+
+    TEST_ASSERT_EQUAL(0, time_mismatches("UTC0"), "Rollovers and backward steps in UTC");
+    TEST_ASSERT_EQUAL(0, time_mismatches("EST5EDT,M3.2.0,M11.1.0"),
+                      "Daylight saving change formatted like strftime()");
+    TEST_ASSERT_EQUAL(0, time_mismatches("IST-5:30"), "Half-hour offset zone");
+
+    if (saved) {
+        setenv("TZ", saved, 1);
+        free(saved);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+    END_TEST_SUITE();
+}
+
+/* Ranking as documented in smartterm_history_search.c */
+#define RECENCY_HALF 64
+
+typedef struct {
+    int pos;
+    float score;
+} ranked_entry_t;
+
+/*
+ * Order brute-force matches: higher score, then newer
+ */
+static int compare_ranked(const void* a, const void* b)
+{
+    const ranked_entry_t* x = a;
+    const ranked_entry_t* y = b;
+    if (x->score != y->score) {
+        return x->score > y->score ? -1 : 1;
+    }
+    return y->pos - x->pos;
+}
+
+/*
+ * Compare every ranked search result with a scan of all entries
+ */
+static bool search_matches_scan(history_search_t* search, input_history_t* history,
+                                ranked_entry_t* expected)
+{
+    int count = 0;
+    for (int pos = 0; pos < history->count; pos++) {
+        if (strstr(history->entries[pos].text, search->query)) {
+            int age = history->count - 1 - pos;
+            float score = history->entries[pos].uses / (1.0f + (float)age / RECENCY_HALF);
+            expected[count++] = (ranked_entry_t){pos, score};
+        }
+    }
+    qsort(expected, count, sizeof(ranked_entry_t), compare_ranked);
+
+    for (int rank = 0; rank < count; rank++) {
+        if (history_search_result(search, history, rank) != expected[rank].pos) {
+            return false;
+        }
+    }
+    return history_search_result(search, history, count) == -1;
+}
+
+/*
+ * Random history line from a small alphabet, so queries match often
+ */
+static void random_entry(char* text, size_t size)
+{
+    static const char* commands[] = {"git ", "make ", "ls ", "cd ", ""};
+    size_t used = (size_t)snprintf(text, size, "%s", commands[next_random() % 5]);
+    size_t length = used + 1 + next_random() % 12;
+    while (used < length && used + 1 < size) {
+        text[used++] = "abcde-"[next_random() % 6];
+    }
+    text[used] = '\0';
+}
+
+/*
+ * Run random queries, checking results at every query length; returns mismatches
+ *
+ * Queries are cut from entries, so most match. Each byte is pushed and popped.
+ */
+static int check_queries(input_history_t* history, int rounds, int* queries)
+{
+    ranked_entry_t* expected = malloc(history->count * sizeof(ranked_entry_t));
+    history_search_t search = {0};
+    if (!expected || !history_search_start(&search, history)) {
+        free(expected);
+        return -1;
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < rounds; i++) {
+        const char* entry = history->entries[next_random() % history->count].text;
+        size_t entry_length = strlen(entry);
+        size_t start = next_random() % entry_length;
+        size_t length = 1 + next_random() % 8;
+        for (size_t n = 0; n < length; n++) {
+            char c = start + n < entry_length ? entry[start + n] : "abcde-"[next_random() % 6];
+            history_search_push(&search, history, c);
+            mismatches += !search_matches_scan(&search, history, expected);
+            (*queries)++;
+        }
+        while (search.length > 0) {
+            history_search_pop(&search);
+            if (search.length > 0 && next_random() % 2) {
+                mismatches += !search_matches_scan(&search, history, expected);
+                (*queries)++;
+            }
+        }
+    }
+
+    history_search_end(&search);
+    free(search.last_query);
+    free(expected);
+    return mismatches;
+}
+
+static void test_history_search(void)
+{
+    BEGIN_TEST_SUITE("History Search Index");
+    smartterm_config_t config = smartterm_default_config();
+    config.history_file = NULL;
+    config.history_size = 500;
+    input_history_t history = {0};
+    history_open(&history, &config);
+
+    /* Entered again moves an entry up and adds to its uses; the limit removes old ones */
+    char text[64];
+    char recent[32][64];
+    for (int i = 0; i < 300; i++) {
+        random_entry(text, sizeof(text));
+        history_add(&history, text);
+        snprintf(recent[i % 32], sizeof(recent[0]), "%s", text);
+    }
+    history_index_start(&history);
+    for (int i = 0; i < 1500; i++) {
+        if (next_random() % 3 == 0) {
+            history_add(&history, recent[next_random() % 32]);
+        } else {
+            random_entry(text, sizeof(text));
+            history_add(&history, text);
+            snprintf(recent[i % 32], sizeof(recent[0]), "%s", text);
+        }
+    }
+    TEST_ASSERT_EQUAL(500, history.count, "History trimmed to its limit");
+
+    int queries = 0;
+    int mismatches = check_queries(&history, 300, &queries);
+    TEST_ASSERT(queries > 1000, "Many queries checked");
+    TEST_ASSERT_EQUAL(0, mismatches, "Ranked results match a scan of every entry");
+
+    /* The search built the index; entries added now go into it directly */
+    for (int i = 0; i < 100; i++) {
+        random_entry(text, sizeof(text));
+        history_add(&history, i % 4 ? text : recent[i % 32]);
+    }
+    TEST_ASSERT(history.index.built, "Index kept across additions");
+    TEST_ASSERT_EQUAL(0, check_queries(&history, 100, &queries),
+                      "Entries added to the index found and ranked");
+
+    history_close(&history);
+    END_TEST_SUITE();
+}
+
+/*
+ * Find entry in history (-1 if absent)
+ */
+static int history_find(const input_history_t* history, const char* text)
+{
+    for (int i = 0; i < history->count; i++) {
+        if (strcmp(history->entries[i].text, text) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void test_history_sharing(void)
+{
+    BEGIN_TEST_SUITE("Shared History File");
+    char path[] = "/tmp/smartterm_history_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        TEST_ASSERT(false, "Temporary history file created");
+        END_TEST_SUITE();
+        return;
+    }
+    close(fd);
+
+    smartterm_config_t config = smartterm_default_config();
+    config.history_file = path;
+    config.history_size = 50;
+    input_history_t first = {0};
+    input_history_t second = {0};
+    history_open(&first, &config);
+    history_open(&second, &config);
+
+    /* The first session compacts the file several times while the second appends to it */
+    char text[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(text, sizeof(text), "first %d", i);
+        history_add(&first, text);
+        if (i % 10 == 0) {
+            snprintf(text, sizeof(text), "second %d", i / 10);
+            history_add(&second, text);
+        }
+    }
+    history_close(&first);
+    history_add(&second, "second last");
+    history_close(&second);
+
+    config.history_size = -1;
+    input_history_t reloaded = {0};
+    history_open(&reloaded, &config);
+    TEST_ASSERT(reloaded.count > 0 &&
+                    strcmp(reloaded.entries[reloaded.count - 1].text, "second last") == 0,
+                "Line added after the other session compacted is kept");
+    TEST_ASSERT(history_find(&reloaded, "first 999") >= 0 &&
+                    history_find(&reloaded, "second 99") >= 0,
+                "Newest lines of both sessions kept");
+    /* However late the compactor ran, the first pass dropped 300 stale lines or more */
+    TEST_ASSERT(reloaded.count < 800, "File compacted");
+
+    int foreign = 0;
+    for (int i = 0; i < reloaded.count; i++) {
+        const char* entry = reloaded.entries[i].text;
+        foreign += strncmp(entry, "first ", 6) != 0 && strncmp(entry, "second ", 7) != 0;
+    }
+    TEST_ASSERT_EQUAL(0, foreign, "Every line whole");
+
+    history_close(&reloaded);
+    unlink(path);
+    END_TEST_SUITE();
+}
+
+int main(void)
+{
+    test_lz();
+    test_time_format();
+    test_history_search();
+    test_history_sharing();
+
+    TEST_SUMMARY();
+}
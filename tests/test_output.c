@@ -0,0 +1,885 @@
+/*
+ * Output buffer tests: views, line storage and memory use
+ *
+ * Sessions run on a pseudo-terminal, so these tests need no real terminal.
+ */
+
+#include "test_framework.h"
+#include <pthread.h>
+#include <smartterm.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static test_terminal_t term;
+
+/*
+ * Start a session on the test terminal
+ */
+static smartterm_ctx* start_session(smartterm_config_t* config)
+{
+    config->tty_fd = term.slave;
+    config->term_type = "xterm";
+    return smartterm_init(config);
+}
+
+/*
+ * Write numbered line: every third is debug output, every fifth an error
+ */
+static void write_numbered(smartterm_ctx* ctx, int i)
+{
+    smartterm_context_t context = i % 3 == 0 ? CTX_DEBUG : CTX_INFO;
+    smartterm_write_fmt(ctx, context, "line %d%s", i, i % 5 == 0 ? " error" : "");
+}
+
+/*
+ * Check whether numbered line shows in a view hiding debug output
+ */
+static bool numbered_visible(int i, bool errors_only)
+{
+    return i % 3 != 0 && (!errors_only || i % 5 == 0);
+}
+
+/*
+ * Count numbered lines first..last shown in a view hiding debug output
+ */
+static int count_numbered(int first, int last, bool errors_only)
+{
+    int count = 0;
+    for (int i = first; i <= last; i++) {
+        count += numbered_visible(i, errors_only);
+    }
+    return count;
+}
+
+/*
+ * Get number of numbered line at index (-1 if none)
+ */
+static int line_number(smartterm_ctx* ctx, int index)
+{
+    const char* line = smartterm_get_line(ctx, index);
+    return line ? atoi(line + strlen("line ")) : -1;
+}
+
+static void test_views(void)
+{
+    BEGIN_TEST_SUITE("Filtered Views");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 100;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    smartterm_view* view = smartterm_view_create(ctx);
+    TEST_ASSERT_NOT_NULL(view, "View created");
+    for (int i = 0; i < 60; i++) {
+        write_numbered(ctx, i);
+    }
+    TEST_ASSERT_EQUAL(60, smartterm_view_get_line_count(view), "Unfiltered view counts every line");
+
+    smartterm_view_set_context_visible(view, CTX_DEBUG, false);
+    TEST_ASSERT_EQUAL(count_numbered(0, 59, false), smartterm_view_get_line_count(view),
+                      "Hidden context not counted");
+    smartterm_view_set_substring(view, "error");
+    TEST_ASSERT_EQUAL(count_numbered(0, 59, true), smartterm_view_get_line_count(view),
+                      "Context and substring filters combine");
+
+    /* Lines 0-59 are evicted as 60-159 arrive */
+    for (int i = 60; i < 160; i++) {
+        write_numbered(ctx, i);
+    }
+    TEST_ASSERT_EQUAL(count_numbered(60, 159, true), smartterm_view_get_line_count(view),
+                      "Count follows appends and evictions");
+    smartterm_view_set_substring(view, "no such text");
+    TEST_ASSERT_EQUAL(0, smartterm_view_get_line_count(view), "Substring matching no line");
+    smartterm_view_reset(view);
+    TEST_ASSERT_EQUAL(100, smartterm_view_get_line_count(view), "Reset view counts every line");
+
+    /* Scrolled back, the view stays on its top line while output arrives */
+    smartterm_view_set_context_visible(view, CTX_DEBUG, false);
+    smartterm_set_view(ctx, view);
+    smartterm_scroll(ctx, 10);
+    int top = smartterm_get_scroll_pos(ctx);
+    int number = line_number(ctx, top);
+    TEST_ASSERT(number >= 0 && numbered_visible(number, false), "Top line matches the view");
+
+    for (int i = 160; i < 170; i++) {
+        write_numbered(ctx, i);
+    }
+    TEST_ASSERT_EQUAL(number, line_number(ctx, smartterm_get_scroll_pos(ctx)),
+                      "Scrolled view anchored to its top line");
+
+    int next = number + 1;
+    while (!numbered_visible(next, false)) {
+        next++;
+    }
+    smartterm_scroll(ctx, -1);
+    TEST_ASSERT_EQUAL(next, line_number(ctx, smartterm_get_scroll_pos(ctx)),
+                      "Scrolling moves by matching lines");
+
+    /* Once its top line is evicted the view starts at the oldest line */
+    smartterm_scroll_top(ctx);
+    for (int i = 170; i < 180; i++) {
+        write_numbered(ctx, i);
+    }
+    TEST_ASSERT_EQUAL(0, smartterm_get_scroll_pos(ctx), "Evicted anchor moves to oldest line");
+
+    /* At the bottom the view follows new output, by matching lines */
+    smartterm_scroll_bottom(ctx);
+    number = line_number(ctx, smartterm_get_scroll_pos(ctx));
+    for (int i = 180; i < 190; i++) {
+        write_numbered(ctx, i);
+    }
+    for (int moved = 0; moved < count_numbered(180, 189, false);) {
+        moved += numbered_visible(++number, false);
+    }
+    TEST_ASSERT_EQUAL(number, line_number(ctx, smartterm_get_scroll_pos(ctx)),
+                      "Following view moves with new matching lines");
+
+    smartterm_set_view(ctx, NULL);
+    smartterm_view_free(view);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/* Deterministic pseudo-random numbers */
+static unsigned int seed = 1;
+
+static unsigned int next_random(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+}
+
+/*
+ * Get index of top line of the last page by scanning every line (count if none match)
+ */
+static int scanned_page_top(smartterm_ctx* ctx, int rows, bool hide_debug, bool needle_only)
+{
+    int count = smartterm_get_line_count(ctx);
+    int top = count;
+    int found = 0;
+
+    for (int i = count - 1; i >= 0 && found < rows; i--) {
+        smartterm_line_meta_t meta;
+        smartterm_get_line_meta(ctx, i, &meta);
+        if ((hide_debug && meta.context == CTX_DEBUG) ||
+            (needle_only && !strstr(smartterm_get_line(ctx, i), "needle"))) {
+            continue;
+        }
+        top = i;
+        found++;
+    }
+    return top;
+}
+
+static void test_view_follow(void)
+{
+    BEGIN_TEST_SUITE("Following Views");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 300;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    smartterm_view* view = smartterm_view_create(ctx);
+    smartterm_set_view(ctx, view);
+    for (int i = 0; i < 100; i++) {
+        smartterm_write_fmt(ctx, CTX_INFO, "fill %d", i);
+    }
+    int rows = 100 - smartterm_get_scroll_pos(ctx);
+    TEST_ASSERT(rows > 0 && rows < 100, "Page height known");
+
+    /* Appends, evictions, in-place updates, filter changes and clears, in random order */
+    smartterm_context_t contexts[] = {CTX_INFO, CTX_DEBUG, CTX_ERROR};
+    smartterm_line_handle_t live[16] = {{0}};
+    bool hide_debug = false;
+    bool needle_only = false;
+    int mismatches = 0;
+    char text[64];
+    for (int step = 0; step < 4000; step++) {
+        unsigned int action = next_random() % 100;
+        const char* needle = next_random() % 8 == 0 ? " needle" : "";
+        if (action < 70) {
+            snprintf(text, sizeof(text), "line %d%s", step, needle);
+            smartterm_context_t context = contexts[next_random() % 3];
+            if (next_random() % 4 == 0) {
+                live[step % 16] = smartterm_write_live(ctx, text, context);
+            } else {
+                smartterm_write(ctx, text, context);
+            }
+        } else if (action < 85) {
+            snprintf(text, sizeof(text), "updated %d%s", step, needle);
+            smartterm_line_update(live[next_random() % 16], text);
+        } else if (action < 92) {
+            needle_only = !needle_only;
+            smartterm_view_set_substring(view, needle_only ? "needle" : NULL);
+        } else if (action < 99) {
+            hide_debug = !hide_debug;
+            smartterm_view_set_context_visible(view, CTX_DEBUG, !hide_debug);
+        } else {
+            smartterm_clear(ctx);
+        }
+        mismatches += smartterm_get_scroll_pos(ctx) !=
+                      scanned_page_top(ctx, rows, hide_debug, needle_only);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Last page matches a scan of every line");
+
+    smartterm_set_view(ctx, NULL);
+    smartterm_view_free(view);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/*
+ * Write one tagged line
+ */
+static int write_tagged(smartterm_ctx* ctx, const char* text, const char* tag)
+{
+    smartterm_line_meta_t meta = {.context = CTX_NORMAL, .timestamp = 0, .tag = tag};
+    return smartterm_write_meta(ctx, text, &meta);
+}
+
+static void test_tags(void)
+{
+    BEGIN_TEST_SUITE("Tag Interning");
+    smartterm_config_t config = smartterm_default_config();
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    write_tagged(ctx, "connect", "db");
+    write_tagged(ctx, "request", "http");
+    write_tagged(ctx, "query", "db");
+    write_tagged(ctx, "plain", NULL);
+
+    int* lines = NULL;
+    int count = 0;
+    TEST_ASSERT(smartterm_get_tag_lines(ctx, "db", &lines, &count) == SMARTTERM_OK,
+                "Tag lookup succeeds");
+    TEST_ASSERT_EQUAL(2, count, "Both lines with tag found");
+    TEST_ASSERT(count == 2 && lines[0] == 0 && lines[1] == 2, "Lines found in order");
+    free(lines);
+
+    TEST_ASSERT(smartterm_get_tag_lines(ctx, "none", &lines, &count) == SMARTTERM_OK,
+                "Lookup of unknown tag succeeds");
+    TEST_ASSERT_EQUAL(0, count, "Unknown tag has no lines");
+    free(lines);
+
+    smartterm_line_meta_t meta;
+    smartterm_get_line_meta(ctx, 1, &meta);
+    TEST_ASSERT_STR_EQUAL("http", meta.tag, "Interned tag name returned");
+    smartterm_get_line_meta(ctx, 3, &meta);
+    TEST_ASSERT_NULL(meta.tag, "Untagged line has no tag");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void test_tag_overflow(void)
+{
+    BEGIN_TEST_SUITE("Tag Table Overflow");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 100;
+    smartterm_ctx* ctx = start_session(&config);
+    if (!ctx) {
+        TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+        return;
+    }
+
+    /* Fill the table; the lines themselves scroll out */
+    char tag[16];
+    int failed = 0;
+    for (int i = 0; i < 65535; i++) {
+        snprintf(tag, sizeof(tag), "t%d", i);
+        failed += write_tagged(ctx, "filler", tag) != SMARTTERM_OK;
+    }
+    TEST_ASSERT_EQUAL(0, failed, "65535 distinct tags interned");
+
+    smartterm_view* view = smartterm_view_create(ctx);
+    TEST_ASSERT(smartterm_view_set_tag(view, "late") == SMARTTERM_OK,
+                "View on tag the full table cannot take");
+
+    TEST_ASSERT(write_tagged(ctx, "overflow", "new") == SMARTTERM_OK,
+                "Line with new tag written once table is full");
+    TEST_ASSERT(write_tagged(ctx, "reused", "t7") == SMARTTERM_OK, "Known tag still accepted");
+
+    int last = smartterm_get_line_count(ctx) - 1;
+    smartterm_line_meta_t meta;
+    smartterm_get_line_meta(ctx, last - 1, &meta);
+    TEST_ASSERT_NULL(meta.tag, "Line with new tag stored untagged");
+    smartterm_get_line_meta(ctx, last, &meta);
+    TEST_ASSERT_STR_EQUAL("t7", meta.tag, "Known tag kept");
+
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(usage.untagged_lines == 1, "Untagged line counted");
+    TEST_ASSERT_EQUAL(0, smartterm_view_get_line_count(view),
+                      "Untagged line does not match tag view");
+
+    smartterm_view_free(view);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/*
+ * Timestamp of numbered line: years apart, some going backwards
+ */
+static long sample_time(int i)
+{
+    return 1700000000L + (long)(i * 7919 % 1000) * 100000L - 50000000L;
+}
+
+static void test_line_meta(void)
+{
+    BEGIN_TEST_SUITE("Line Metadata Columns");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 300;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session starts on pseudo-terminal");
+    if (!ctx) {
+        return;
+    }
+
+    /* The ring wraps several times */
+    char text[32];
+    for (int i = 0; i < 1000; i++) {
+        smartterm_line_meta_t meta = {.context = (smartterm_context_t)(i % 7),
+                                      .timestamp = sample_time(i),
+                                      .tag = i % 2 ? "odd" : NULL};
+        snprintf(text, sizeof(text), "meta %d", i);
+        smartterm_write_meta(ctx, text, &meta);
+    }
+    TEST_ASSERT_EQUAL(300, smartterm_get_line_count(ctx), "Buffer holds max_lines lines");
+
+    int text_mismatches = 0;
+    int meta_mismatches = 0;
+    for (int index = 0; index < 300; index++) {
+        int i = 700 + index;
+        snprintf(text, sizeof(text), "meta %d", i);
+        const char* line = smartterm_get_line(ctx, index);
+        text_mismatches += !line || strcmp(line, text) != 0;
+
+        smartterm_line_meta_t meta;
+        smartterm_get_line_meta(ctx, index, &meta);
+        bool tag_ok = i % 2 ? meta.tag && strcmp(meta.tag, "odd") == 0 : meta.tag == NULL;
+        meta_mismatches += !tag_ok || meta.context != (smartterm_context_t)(i % 7) ||
+                           meta.timestamp != sample_time(i);
+    }
+    TEST_ASSERT_EQUAL(0, text_mismatches, "Text read back in order after wrapping");
+    TEST_ASSERT_EQUAL(0, meta_mismatches, "Context, timestamp and tag read back");
+
+    int count_mismatches = 0;
+    for (int context = 0; context < 7; context++) {
+        int expected = 0;
+        for (int i = 700; i < 1000; i++) {
+            expected += i % 7 == context;
+        }
+        count_mismatches +=
+            smartterm_get_context_count(ctx, (smartterm_context_t)context) != expected;
+    }
+    TEST_ASSERT_EQUAL(0, count_mismatches, "Lines counted per context");
+
+    smartterm_line_meta_t meta = {.context = (smartterm_context_t)256, .timestamp = 0};
+    TEST_ASSERT(smartterm_write_meta(ctx, "too wide", &meta) == SMARTTERM_INVALID,
+                "Context above 255 refused");
+    TEST_ASSERT_EQUAL(300, smartterm_get_line_count(ctx), "Refused line not stored");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/*
+ * Write line of given length, returning bytes its text takes
+ */
+static size_t write_sized(smartterm_ctx* ctx, int i, int length)
+{
+    char text[2048];
+    snprintf(text, sizeof(text), "%0*d", length, i);
+    smartterm_write(ctx, text, CTX_NORMAL);
+    return strlen(text) + 1;
+}
+
+static void test_memory_budget(void)
+{
+    BEGIN_TEST_SUITE("Memory Budget");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 100000;
+    config.max_bytes = 64 * 1024;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with byte budget starts");
+    if (!ctx) {
+        return;
+    }
+
+    /* Usage is the text plus the metadata and index columns */
+    size_t text_bytes = 0;
+    for (int i = 0; i < 100; i++) {
+        text_bytes += write_sized(ctx, i, 10 + i % 50);
+    }
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    size_t slots = usage.index_bytes / sizeof(char*);
+    TEST_ASSERT(usage.text_bytes == text_bytes, "Text counted with terminators");
+    TEST_ASSERT(slots >= 100 && usage.index_bytes == slots * sizeof(char*),
+                "Index holds a pointer per slot");
+    /* Context byte, 32-bit timestamp delta and 16-bit tag ID per slot */
+    TEST_ASSERT(usage.meta_bytes == slots * 7, "Metadata columns sized with the index");
+    size_t parts = usage.text_bytes + usage.meta_bytes + usage.index_bytes;
+    parts += usage.cold_bytes;
+    TEST_ASSERT(usage.total_bytes == parts, "Total is the sum of the parts");
+    TEST_ASSERT(usage.line_count == 100 && usage.max_bytes == config.max_bytes,
+                "Line count and budget reported");
+
+    smartterm_line_meta_t meta = {.context = CTX_NORMAL, .timestamp = 0, .tag = "net"};
+    smartterm_write_meta(ctx, "tagged", &meta);
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(usage.meta_bytes > slots * 7, "Tag table counted with metadata");
+
+    /* The byte budget is reached long before max_lines */
+    for (int i = 0; i < 5000; i++) {
+        write_sized(ctx, i, 100);
+    }
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(usage.line_count < 5000 && usage.total_bytes <= config.max_bytes,
+                "Oldest lines evicted to stay within budget");
+    TEST_ASSERT_EQUAL(usage.line_count, smartterm_get_line_count(ctx), "Line counts agree");
+    char expected[128];
+    snprintf(expected, sizeof(expected), "%0*d", 100, 4999);
+    TEST_ASSERT_STR_EQUAL(expected, smartterm_get_line(ctx, usage.line_count - 1),
+                          "Newest line kept");
+    smartterm_cleanup(ctx);
+
+    /* With room in the budget, max_lines applies */
+    config.max_lines = 50;
+    config.max_bytes = 1024 * 1024;
+    ctx = start_session(&config);
+    for (int i = 0; ctx && i < 200; i++) {
+        write_sized(ctx, i, 20);
+    }
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(usage.line_count == 50 && usage.total_bytes <= config.max_bytes,
+                "Line limit applies when reached first");
+    smartterm_cleanup(ctx);
+
+    /* A line larger than the whole budget is kept until the next one */
+    config.max_lines = 1000;
+    config.max_bytes = 8192;
+    ctx = start_session(&config);
+    for (int i = 0; ctx && i < 20; i++) {
+        write_sized(ctx, i, 10);
+    }
+    char* big = malloc(20001);
+    if (ctx && big) {
+        memset(big, 'x', 20000);
+        big[20000] = '\0';
+        smartterm_write(ctx, big, CTX_NORMAL);
+        smartterm_get_memory_usage(ctx, &usage);
+        TEST_ASSERT(usage.line_count == 1 && usage.total_bytes > config.max_bytes,
+                    "Oversized line kept alone");
+        TEST_ASSERT_STR_EQUAL(big, smartterm_get_line(ctx, 0), "Oversized line intact");
+
+        smartterm_write(ctx, "small", CTX_NORMAL);
+        smartterm_get_memory_usage(ctx, &usage);
+        TEST_ASSERT(usage.line_count == 1 && usage.total_bytes <= config.max_bytes,
+                    "Oversized line evicted by the next one");
+        TEST_ASSERT_STR_EQUAL("small", smartterm_get_line(ctx, 0), "Next line kept");
+    }
+    free(big);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void test_line_copies(void)
+{
+    BEGIN_TEST_SUITE("Line Access");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 5000;
+    config.hot_lines = 256;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with small hot tier starts");
+    if (!ctx) {
+        return;
+    }
+
+    for (int i = 0; i < 2000; i++) {
+        smartterm_write_fmt(ctx, CTX_NORMAL, "line %d", i);
+    }
+
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(usage.cold_line_count >= 1536, "Older lines held compressed");
+
+    char* first = smartterm_copy_line(ctx, 0);
+    TEST_ASSERT_STR_EQUAL("line 0", first, "Cold line copied");
+
+    /* Reading other blocks cycles the decompression cache */
+    int mismatches = 0;
+    char expected[32];
+    for (int i = 300; i < 1800; i += 300) {
+        snprintf(expected, sizeof(expected), "line %d", i);
+        const char* line = smartterm_get_line(ctx, i);
+        mismatches += !line || strcmp(line, expected) != 0;
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Cold lines read back from every block");
+    TEST_ASSERT_STR_EQUAL("line 0", first, "Copy unaffected by later reads");
+    TEST_ASSERT_STR_EQUAL("line 0", smartterm_get_line(ctx, 0), "Evicted block read again");
+    free(first);
+
+    smartterm_line_handle_t live = smartterm_write_live(ctx, "Working 0%", CTX_INFO);
+    int index = smartterm_get_line_count(ctx) - 1;
+    char* before = smartterm_copy_line(ctx, index);
+    smartterm_line_update(live, "Working 100%, all items done");
+    TEST_ASSERT_STR_EQUAL("Working 0%", before, "Copy kept across live update");
+    TEST_ASSERT_STR_EQUAL("Working 100%, all items done", smartterm_get_line(ctx, index),
+                          "Live line shows update");
+    free(before);
+
+    int count = smartterm_get_line_count(ctx);
+    TEST_ASSERT_NULL(smartterm_copy_line(ctx, count), "No copy past last line");
+    TEST_ASSERT_NULL(smartterm_copy_line(ctx, -1), "No copy for negative index");
+
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void test_cold_tier(void)
+{
+    BEGIN_TEST_SUITE("Compressed Cold Tier");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 20000;
+    config.hot_lines = 512;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with small hot tier starts");
+    if (!ctx) {
+        return;
+    }
+
+    /* Repetitive and random lines, empty and long ones, with tags */
+    enum { LINES = 6000 };
+    char** expected = calloc(LINES, sizeof(char*));
+    unsigned int seed = 7;
+    for (int i = 0; expected && i < LINES; i++) {
+        char text[1024] = "";
+        seed = seed * 1103515245u + 12345u;
+        int kind = (seed >> 16) % 4;
+        if (kind == 0) {
+            snprintf(text, sizeof(text), "GET /api/items/%d 200", i % 37);
+        } else if (kind == 1) {
+            int length = (seed >> 8) % 900;
+            for (int n = 0; n < length; n++) {
+                seed = seed * 1103515245u + 12345u;
+                text[n] = (char)(' ' + (seed >> 16) % 95);
+            }
+            text[length] = '\0';
+        } else if (kind == 3) {
+            snprintf(text, sizeof(text), "%0*d", (int)((seed >> 8) % 300) + 1, 0);
+        }
+
+        expected[i] = strdup(text);
+        smartterm_line_meta_t meta = {
+            .context = (smartterm_context_t)(i % 5), .timestamp = 1700000000L + i,
+            .tag = kind == 0 ? "http" : NULL};
+        smartterm_write_meta(ctx, text, &meta);
+    }
+
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(usage.cold_line_count >= LINES - 1024, "Older lines held compressed");
+    TEST_ASSERT(usage.cold_bytes < usage.cold_line_count * 200UL, "Cold lines take less space");
+
+    /* Read in an order that misses the block cache often */
+    int text_mismatches = 0;
+    int meta_mismatches = 0;
+    for (int step = 0; expected && step < LINES; step++) {
+        int i = (int)((step * 2654435761u) % LINES);
+        char* line = smartterm_copy_line(ctx, i);
+        text_mismatches += !line || strcmp(line, expected[i]) != 0;
+        free(line);
+
+        smartterm_line_meta_t meta;
+        smartterm_get_line_meta(ctx, i, &meta);
+        meta_mismatches += meta.context != (smartterm_context_t)(i % 5) ||
+                           meta.timestamp != 1700000000L + i ||
+                           (meta.tag != NULL) != (strncmp(expected[i], "GET ", 4) == 0);
+    }
+    TEST_ASSERT_EQUAL(0, text_mismatches, "Every line reads back unchanged");
+    TEST_ASSERT_EQUAL(0, meta_mismatches, "Context, timestamp and tag kept");
+
+    for (int i = 0; expected && i < LINES; i++) {
+        free(expected[i]);
+    }
+    free(expected);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+static void test_spill(void)
+{
+    BEGIN_TEST_SUITE("Spill to Disk");
+    char dir[] = "/tmp/smartterm_spill_XXXXXX";
+    if (!mkdtemp(dir)) {
+        TEST_ASSERT(false, "Temporary directory created");
+        END_TEST_SUITE();
+        return;
+    }
+
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 1000;
+    config.hot_lines = 256;
+    config.spill_dir = dir;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with spill directory starts");
+    if (!ctx) {
+        rmdir(dir);
+        return;
+    }
+
+    for (int i = 0; i < 5000; i++) {
+        smartterm_write_fmt(ctx, (smartterm_context_t)(i % 4), "spilled %d", i);
+    }
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT_EQUAL(5000, smartterm_get_line_count(ctx), "Evicted lines stay reachable");
+    TEST_ASSERT(usage.spill_line_count >= 4000 && usage.spill_bytes > 0,
+                "Lines past max_lines spilled to disk");
+
+    int mismatches = 0;
+    char expected[32];
+    for (int i = 0; i < 5000; i += 7) {
+        snprintf(expected, sizeof(expected), "spilled %d", i);
+        char* line = smartterm_copy_line(ctx, i);
+        smartterm_line_meta_t meta;
+        smartterm_get_line_meta(ctx, i, &meta);
+        mismatches += !line || strcmp(line, expected) != 0 ||
+                      meta.context != (smartterm_context_t)(i % 4);
+        free(line);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches, "Spilled lines read back with context");
+    TEST_ASSERT_EQUAL(1250, smartterm_get_context_count(ctx, CTX_ERROR),
+                      "Context counts include spilled lines");
+
+    smartterm_clear(ctx);
+    smartterm_get_memory_usage(ctx, &usage);
+    TEST_ASSERT(smartterm_get_line_count(ctx) == 0 && usage.spill_line_count == 0,
+                "Clear drops spilled lines");
+    smartterm_write(ctx, "after clear", CTX_NORMAL);
+    TEST_ASSERT_STR_EQUAL("after clear", smartterm_get_line(ctx, 0), "Writing resumes after clear");
+
+    smartterm_cleanup(ctx);
+    TEST_ASSERT(rmdir(dir) == 0, "Segment files leave nothing behind");
+    END_TEST_SUITE();
+}
+
+/*
+ * Write numbered line of 256 KiB, so that 63 of them fill a spill segment
+ */
+static void write_big(smartterm_ctx* ctx, int i)
+{
+    enum { BIG_LINE = 256 * 1024 };
+    char* text = malloc(BIG_LINE + 1);
+    if (!text) {
+        return;
+    }
+    int used = snprintf(text, BIG_LINE + 1, "line %d ", i);
+    memset(text + used, 'x', BIG_LINE - used);
+    text[BIG_LINE] = '\0';
+    smartterm_write(ctx, text, CTX_INFO);
+    free(text);
+}
+
+static void test_spill_failure(void)
+{
+    BEGIN_TEST_SUITE("Spill Failure");
+    char dir[] = "/tmp/smartterm_spill_XXXXXX";
+    if (!mkdtemp(dir)) {
+        TEST_ASSERT(false, "Temporary directory created");
+        END_TEST_SUITE();
+        return;
+    }
+
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 4;
+    config.spill_dir = dir;
+    smartterm_ctx* ctx = start_session(&config);
+    TEST_ASSERT_NOT_NULL(ctx, "Session with spill directory starts");
+    if (!ctx) {
+        rmdir(dir);
+        return;
+    }
+
+    smartterm_view* view = smartterm_view_create(ctx);
+    smartterm_set_view(ctx, view);
+    for (int i = 0; i < 40; i++) {
+        write_big(ctx, i);
+    }
+    smartterm_scroll_top(ctx);
+    smartterm_scroll(ctx, -3);
+    TEST_ASSERT_EQUAL(3, line_number(ctx, smartterm_get_scroll_pos(ctx)),
+                      "Scrolled back to a spilled line");
+
+    /* Segment files are already unlinked; once the first is full no more can be created */
+    TEST_ASSERT(rmdir(dir) == 0, "Spill directory removed under the session");
+    for (int i = 40; i < 140; i++) {
+        write_big(ctx, i);
+    }
+
+    smartterm_memory_usage_t usage;
+    smartterm_get_memory_usage(ctx, &usage);
+    int count = smartterm_get_line_count(ctx);
+    TEST_ASSERT(usage.spill_dropped > 0, "Lines that could not be spilled are counted");
+    TEST_ASSERT_EQUAL(140, count + (int)usage.spill_dropped, "Only those lines were lost");
+    TEST_ASSERT_EQUAL(count - 4, usage.spill_line_count, "Spilled lines kept");
+
+    int previous = -1;
+    int out_of_order = 0;
+    for (int i = 0; i < count; i++) {
+        int number = line_number(ctx, i);
+        out_of_order += number <= previous;
+        previous = number;
+    }
+    TEST_ASSERT_EQUAL(0, out_of_order, "Remaining lines read back in order");
+    TEST_ASSERT_EQUAL(39, line_number(ctx, 39), "Earlier spilled lines stay readable");
+    TEST_ASSERT_EQUAL(139, line_number(ctx, count - 1), "Newest line kept");
+    TEST_ASSERT_EQUAL(3, line_number(ctx, smartterm_get_scroll_pos(ctx)),
+                      "Scrolled view stays on its line");
+
+    smartterm_set_view(ctx, NULL);
+    smartterm_view_free(view);
+    smartterm_cleanup(ctx);
+    END_TEST_SUITE();
+}
+
+/*
+ * Start a session, write a live line and bury it under count more lines
+ */
+static int update_buried_line(smartterm_config_t* config, int count)
+{
+    smartterm_ctx* ctx = start_session(config);
+    if (!ctx) {
+        return SMARTTERM_NOTINIT;
+    }
+
+    smartterm_line_handle_t live = smartterm_write_live(ctx, "Working 0%", CTX_INFO);
+    for (int i = 0; i < count; i++) {
+        smartterm_write_fmt(ctx, CTX_NORMAL, "line %d", i);
+    }
+    int result = smartterm_line_update(live, "Working 100%");
+
+    smartterm_cleanup(ctx);
+    return result;
+}
+
+static void test_live_expiry(void)
+{
+    BEGIN_TEST_SUITE("Live Lines Leaving Memory");
+    smartterm_config_t config = smartterm_default_config();
+    config.max_lines = 100;
+    TEST_ASSERT_EQUAL(SMARTTERM_OK, update_buried_line(&config, 99),
+                      "Oldest live line still updates");
+    TEST_ASSERT_EQUAL(SMARTTERM_INVALID, update_buried_line(&config, 100),
+                      "Evicted live line refuses updates");
+
+    config.max_lines = 5000;
+    config.hot_lines = 256;
+    TEST_ASSERT_EQUAL(SMARTTERM_INVALID, update_buried_line(&config, 2000),
+                      "Compressed live line refuses updates");
+
+    char dir[] = "/tmp/smartterm_spill_XXXXXX";
+    if (!mkdtemp(dir)) {
+        TEST_ASSERT(false, "Temporary directory created");
+        END_TEST_SUITE();
+        return;
+    }
+    config.max_lines = 1000;
+    config.spill_dir = dir;
+    TEST_ASSERT_EQUAL(SMARTTERM_INVALID, update_buried_line(&config, 2000),
+                      "Spilled live line refuses updates");
+    rmdir(dir);
+    END_TEST_SUITE();
+}
+
+/*
+ * Write numbered lines to one session, rendering now and then
+ */
+static void* write_session(void* data)
+{
+    smartterm_ctx* ctx = data;
+    for (int i = 0; i < 2000; i++) {
+        smartterm_write_fmt(ctx, CTX_INFO, "line %d", i);
+        if (i % 100 == 0) {
+            smartterm_render(ctx);
+        }
+    }
+    return NULL;
+}
+
+static void test_two_sessions(void)
+{
+    BEGIN_TEST_SUITE("Two Sessions on Two Terminals");
+    test_terminal_t second;
+    if (test_terminal_open(&second, 30, 100) != 0) {
+        TEST_ASSERT(false, "Second pseudo-terminal opens");
+        END_TEST_SUITE();
+        return;
+    }
+
+    smartterm_config_t config = smartterm_default_config();
+    smartterm_ctx* ctx = start_session(&config);
+    smartterm_config_t second_config = smartterm_default_config();
+    second_config.tty_fd = second.slave;
+    second_config.term_type = "xterm";
+    smartterm_ctx* second_ctx = smartterm_init(&second_config);
+    TEST_ASSERT(ctx && second_ctx, "Both sessions start");
+
+    if (ctx && second_ctx) {
+        pthread_t threads[2];
+        pthread_create(&threads[0], NULL, write_session, ctx);
+        pthread_create(&threads[1], NULL, write_session, second_ctx);
+        pthread_join(threads[0], NULL);
+        pthread_join(threads[1], NULL);
+
+        int rows = 0;
+        int cols = 0;
+        smartterm_get_terminal_size(second_ctx, &rows, &cols);
+        TEST_ASSERT(rows == 30 && cols == 100, "Second session sized from its own terminal");
+        TEST_ASSERT_STR_EQUAL("line 1999", smartterm_get_line(ctx, 999),
+                              "First session holds its own lines");
+        TEST_ASSERT_STR_EQUAL("line 1999", smartterm_get_line(second_ctx, 999),
+                              "Second session holds its own lines");
+    }
+
+    smartterm_cleanup(second_ctx);
+    smartterm_cleanup(ctx);
+    test_terminal_close(&second);
+    END_TEST_SUITE();
+}
+
+int main(void)
+{
+    if (test_terminal_open(&term, 24, 80) != 0) {
+        printf("\n⚠️  No pseudo-terminal available - skipping output tests\n");
+        return EXIT_SUCCESS;
+    }
+
+    test_views();
+    test_view_follow();
+    test_tags();
+    test_tag_overflow();
+    test_line_meta();
+    test_memory_budget();
+    test_line_copies();
+    test_cold_tier();
+    test_spill();
+    test_spill_failure();
+    test_live_expiry();
+    test_two_sessions();
+
+    test_terminal_close(&term);
+    TEST_SUMMARY();
+}